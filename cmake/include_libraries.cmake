@@ -10,6 +10,13 @@ find_package(SFBPF REQUIRED)
 find_package(ZLIB REQUIRED)
 find_package(HWLOC REQUIRED)
 
+# shm_open is in librt with older glibc
+include(CheckLibraryExists)
+check_library_exists(rt shm_open "" HAVE_LIBRT)
+if (HAVE_LIBRT)
+    set(RT_LIBRARIES rt)
+endif ()
+
 # optional libraries
 find_package(LibLZMA QUIET)
 find_package(OpenSSL QUIET)
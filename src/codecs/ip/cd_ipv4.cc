@@ -53,12 +53,16 @@ namespace
 const PegInfo pegs[]
 {
     { "bad checksum", "nonzero ip checksums" },
+    { "checksums computed", "ip checksums computed over the full header" },
+    { "checksums updated", "ip checksums updated incrementally" },
     { nullptr, nullptr }
 };
 
 struct Stats
 {
     PegCount bad_cksum;
+    PegCount cksum_computed;
+    PegCount cksum_updated;
 };
 
 static THREAD_LOCAL Stats stats;
@@ -238,6 +242,7 @@ bool Ipv4Codec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
          * option
          */
         int16_t csum = checksum::ip_cksum((uint16_t*)iph, hlen);
+        stats.cksum_computed++;
 
         if (csum && !codec.is_cooked())
         {
@@ -665,6 +670,7 @@ bool Ipv4Codec::encode(const uint8_t* const raw_in, const uint16_t /*raw_len*/,
     /* IPv4 encoded header is hardcoded 20 bytes, we save some
      * cycles and use the literal header size for checksum */
     ip4h_out->ip_csum = checksum::ip_cksum((uint16_t*)ip4h_out, ip::IP4_HEADER_LEN);
+    stats.cksum_computed++;
 
     enc.next_proto = IpProtocol::IPIP;
     enc.next_ethertype = ProtocolId::ETHERTYPE_IPV4;
@@ -677,13 +683,23 @@ void Ipv4Codec::update(const ip::IpApi&, const EncodeFlags flags,
     IP4Hdr* h = reinterpret_cast<IP4Hdr*>(raw_pkt);
     uint16_t hlen = h->hlen();
 
+    uint16_t old_len = h->ip_len;
+
     updated_len += hlen;
     h->set_ip_len((uint16_t)updated_len);
 
-    if ( !(flags & UPD_COOKED) || (flags & UPD_REBUILT_FRAG) )
+    // rebuilt frags get a new header; otherwise the normalizer keeps
+    // ip_csum current as it edits so only the length change remains
+    if ( flags & UPD_REBUILT_FRAG )
     {
         h->ip_csum = 0;
         h->ip_csum = checksum::ip_cksum((uint16_t*)h, hlen);
+        stats.cksum_computed++;
+    }
+    else if ( !(flags & UPD_COOKED) )
+    {
+        h->ip_csum = checksum::update(h->ip_csum, old_len, h->ip_len);
+        stats.cksum_updated++;
     }
 }
 
@@ -49,6 +49,8 @@ const PegInfo pegs[]
 {
     { "bad checksum (ip4)", "nonzero tcp over ip checksums" },
     { "bad checksum (ip6)", "nonzero tcp over ipv6 checksums" },
+    { "checksums computed", "tcp checksums computed to validate decoded packets" },
+    { "checksums offloaded", "tcp checksums verified by the nic and skipped" },
     { nullptr, nullptr }
 };
 
@@ -56,10 +58,23 @@ struct Stats
 {
     PegCount bad_ip4_cksum;
     PegCount bad_ip6_cksum;
+    PegCount cksum_computed;
+    PegCount cksum_offloaded;
 };
 
 static THREAD_LOCAL Stats stats;
 
+// the daq sets this flag when the nic has verified the checksum of the
+// outermost tcp header; pseudo packets have it cleared (see set_hdr())
+static inline bool nic_checksum_good(const RawData& raw, const CodecData& codec)
+{
+    if ( !(raw.pkth->flags & DAQ_PKT_FLAG_HW_TCP_CS_GOOD) || codec.ip_layer_cnt > 1 )
+        return false;
+
+    stats.cksum_offloaded++;
+    return true;
+}
+
 static const RuleMap tcp_rules[] =
 {
     { DECODE_TCP_DGRAM_LT_TCPHDR, "TCP packet len is smaller than 20 bytes" },
@@ -166,11 +181,13 @@ bool TcpCodec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
     /* Checksum code moved in front of the other decoder alerts.
        If it's a bad checksum (maybe due to encrypted ESP traffic), the other
        alerts could be false positives. */
-    if ( SnortConfig::tcp_checksums() )
+    if ( SnortConfig::tcp_checksums() && !nic_checksum_good(raw, codec) )
     {
         uint16_t csum;
         PegCount* bad_cksum_cnt;
 
+        stats.cksum_computed++;
+
         if (snort.ip_api.is_ip4())
         {
             bad_cksum_cnt = &(stats.bad_ip4_cksum);
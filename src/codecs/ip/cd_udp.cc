@@ -48,6 +48,7 @@ const PegInfo pegs[]
 {
     { "bad checksum (ip4)", "nonzero udp over ipv4 checksums" },
     { "bad checksum (ip6)", "nonzero udp over ipv6 checksums" },
+    { "checksums computed", "udp checksums computed to validate decoded packets" },
     { nullptr, nullptr }
 };
 
@@ -55,6 +56,7 @@ struct Stats
 {
     PegCount bad_ip4_cksum;
     PegCount bad_ip6_cksum;
+    PegCount cksum_computed;
 };
 
 static THREAD_LOCAL Stats stats;
@@ -242,6 +244,7 @@ bool UdpCodec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
                 ph.len = udph->uh_len;
 
                 csum = checksum::udp_cksum((uint16_t*)(udph), uhlen, &ph);
+                stats.cksum_computed++;
             }
             else
             {
@@ -273,6 +276,7 @@ bool UdpCodec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
                 ph6.len = htons((u_short)raw.len);
 
                 csum = checksum::udp_cksum((uint16_t*)(udph), uhlen, &ph6);
+                stats.cksum_computed++;
             }
             else
             {
@@ -24,6 +24,14 @@
 #include <stdlib.h>
 #include <cstddef>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define CHECKSUM_AVX2
+#endif
+#endif
+
 #include <protocols/protocol_ids.h>
 
 namespace checksum
@@ -56,6 +64,13 @@ inline uint16_t icmp_cksum(const uint16_t* buf, std::size_t len, const Pseudohea
 inline uint16_t icmp_cksum(const uint16_t* buf, std::size_t len);
 inline uint16_t ip_cksum(const uint16_t* buf, std::size_t len);
 
+//  rfc 1624 incremental update of cksum for a changed 16 bit word or
+//  range of words (len bytes, even).  words are passed as stored in the
+//  packet.  unlike a full recompute, these preserve a bad checksum.
+inline uint16_t update(uint16_t cksum, uint16_t old_word, uint16_t new_word);
+inline uint16_t update(
+    uint16_t cksum, const uint16_t* old_buf, const uint16_t* new_buf, std::size_t len);
+
 /*
  *  NOTE: Since multiple dynamic libraries use checksums, the choice
  *          is to either include all of the checksum details in a header,
@@ -89,8 +104,117 @@ struct Psuedoheader6Union
     };
 };
 
+#ifdef __SSE2__
+// buffers shorter than this (mostly headers) are summed by the scalar
+// loop below; longer ones are mostly summed 16 or 32 bytes at a time.
+// the vector paths add the same native 16 bit words into 32 bit lanes so
+// the folded result is identical to the scalar sum.
+constexpr std::size_t VECTOR_MIN = 64;
+
+// each block adds at most 2 * 0xFFFF to a lane so flush the lanes to the
+// 64 bit sum before 2^14 blocks to avoid overflow
+constexpr std::size_t VECTOR_FLUSH = 0x4000;
+
+inline uint64_t sse2_add(const uint8_t* p, std::size_t blocks)
+{
+    const __m128i lo = _mm_set1_epi32(0xFFFF);
+    uint64_t sum = 0;
+
+    while ( blocks )
+    {
+        std::size_t n = blocks < VECTOR_FLUSH ? blocks : VECTOR_FLUSH;
+        __m128i acc = _mm_setzero_si128();
+        blocks -= n;
+
+        while ( n-- )
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            acc = _mm_add_epi32(acc, _mm_and_si128(v, lo));
+            acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+            p += 16;
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return sum;
+}
+
+#ifdef CHECKSUM_AVX2
+__attribute__((target("avx2")))
+inline uint64_t avx2_add(const uint8_t* p, std::size_t blocks)
+{
+    const __m256i lo = _mm256_set1_epi32(0xFFFF);
+    uint64_t sum = 0;
+
+    while ( blocks )
+    {
+        std::size_t n = blocks < VECTOR_FLUSH ? blocks : VECTOR_FLUSH;
+        __m256i acc = _mm256_setzero_si256();
+        blocks -= n;
+
+        while ( n-- )
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            acc = _mm256_add_epi32(acc, _mm256_and_si256(v, lo));
+            acc = _mm256_add_epi32(acc, _mm256_srli_epi32(v, 16));
+            p += 32;
+        }
+        uint32_t lanes[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+
+        for ( auto l : lanes )
+            sum += l;
+    }
+    return sum;
+}
+
+inline bool use_avx2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+// sum the leading blocks of buf and advance past them; the returned sum
+// is folded to 17 bits so the scalar loop can't overflow the uint32_t
+inline uint32_t vector_add(const uint16_t*& buf, std::size_t& len, uint32_t cksum)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(buf);
+    uint64_t sum = cksum;
+    std::size_t n;
+
+#ifdef CHECKSUM_AVX2
+    if ( use_avx2() )
+    {
+        n = len / 32;
+        sum += avx2_add(p, n);
+        n *= 32;
+    }
+    else
+#endif
+    {
+        n = len / 16;
+        sum += sse2_add(p, n);
+        n *= 16;
+    }
+    buf = reinterpret_cast<const uint16_t*>(p + n);
+    len -= n;
+
+    while ( sum >> 16 )
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return (uint32_t)sum;
+}
+#endif
+
 inline uint16_t cksum_add(const uint16_t* buf, std::size_t len, uint32_t cksum)
 {
+#ifdef __SSE2__
+    if ( len >= VECTOR_MIN )
+        cksum = vector_add(buf, len, cksum);
+#endif
+
     const uint16_t* sp = buf;
     std::size_t n, sn;
 
@@ -342,6 +466,38 @@ inline uint16_t ip_cksum(const uint16_t* buf, std::size_t len)
 
 inline uint16_t cksum_add(const uint16_t* buf, std::size_t len)
 { return detail::cksum_add(buf, len, 0); }
+
+inline uint16_t update(uint16_t cksum, uint16_t old_word, uint16_t new_word)
+{
+    // HC' = ~(~HC + ~m + m')
+    uint32_t sum = (uint16_t)~cksum;
+    sum += (uint16_t)~old_word;
+    sum += new_word;
+
+    sum = (sum >> 16) + (sum & 0x0000ffff);
+    sum += (sum >> 16);
+
+    return (uint16_t)(~sum);
+}
+
+inline uint16_t update(
+    uint16_t cksum, const uint16_t* old_buf, const uint16_t* new_buf, std::size_t len)
+{
+    uint32_t sum = (uint16_t)~cksum;
+
+    for ( std::size_t i = 0; i < len / 2; ++i )
+    {
+        if ( old_buf[i] == new_buf[i] )
+            continue;
+
+        sum += (uint16_t)~old_buf[i];
+        sum += new_buf[i];
+    }
+    sum = (sum >> 16) + (sum & 0x0000ffff);
+    sum += (sum >> 16);
+
+    return (uint16_t)(~sum);
+}
 } // namespace checksum
 
 #endif  /* CODECS_CHECKSUM_H */
@@ -0,0 +1,229 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// checksum_test.cc compares the vector checksum paths and incremental
+// updates with a plain scalar computation
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+#include "codecs/ip/checksum.h"
+
+using namespace checksum;
+
+// one's complement sum of native 16 bit words, the trailing odd byte
+// padded with zero as stored
+static uint16_t scalar_cksum(const uint8_t* p, size_t len)
+{
+    uint64_t sum = 0;
+
+    while ( len > 1 )
+    {
+        uint16_t w;
+        memcpy(&w, p, 2);
+        sum += w;
+        p += 2;
+        len -= 2;
+    }
+    if ( len )
+        sum += *p;
+
+    while ( sum >> 16 )
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return (uint16_t)~sum;
+}
+
+// +0 and -0 are the same in one's complement
+static bool same_cksum(uint16_t a, uint16_t b)
+{
+    if ( a == 0xFFFF )
+        a = 0;
+
+    if ( b == 0xFFFF )
+        b = 0;
+
+    return a == b;
+}
+
+static void fill(std::vector<uint8_t>& buf)
+{
+    for ( auto& b : buf )
+        b = rand();
+}
+
+// 20 byte ipv4 header with the checksum at word 5
+#define IP_HDR_WORDS 10
+#define IP_CKSUM_WORD 5
+
+static void make_ip_header(uint16_t* h)
+{
+    for ( unsigned i = 0; i < IP_HDR_WORDS; ++i )
+        h[i] = rand();
+
+    h[IP_CKSUM_WORD] = 0;
+    h[IP_CKSUM_WORD] = ip_cksum(h, 2 * IP_HDR_WORDS);
+}
+
+// recompute with the checksum field zeroed
+static uint16_t recompute(const uint16_t* h)
+{
+    uint16_t tmp[IP_HDR_WORDS];
+    memcpy(tmp, h, sizeof(tmp));
+    tmp[IP_CKSUM_WORD] = 0;
+    return ip_cksum(tmp, sizeof(tmp));
+}
+
+TEST_GROUP(checksum)
+{
+    void setup() override
+    { srand(0x5EED); }
+};
+
+TEST(checksum, vector_matches_scalar)
+{
+    // room for every length and misalignment tried below
+    std::vector<uint8_t> buf(9000 + 64);
+    fill(buf);
+
+    for ( unsigned i = 0; i < 4000; ++i )
+    {
+        size_t off = rand() % 32;
+        size_t len = rand() % 9001;
+        const uint8_t* p = &buf[off];
+
+        uint16_t expected = scalar_cksum(p, len);
+        uint16_t actual = cksum_add((const uint16_t*)p, len);
+
+        CHECK(expected == actual);
+    }
+}
+
+TEST(checksum, vector_boundaries)
+{
+    std::vector<uint8_t> buf(512 + 64);
+    fill(buf);
+
+    // lengths around the vector minimum and block sizes at every offset
+    for ( size_t off = 0; off < 32; ++off )
+    {
+        for ( size_t len = 0; len <= 512; ++len )
+        {
+            const uint8_t* p = &buf[off];
+            CHECK(scalar_cksum(p, len) == cksum_add((const uint16_t*)p, len));
+        }
+    }
+}
+
+TEST(checksum, vector_all_ones)
+{
+    // worst case lane growth; long enough to flush the lanes several times
+    std::vector<uint8_t> buf(2 * 1024 * 1024 + 1, 0xFF);
+
+    for ( size_t off = 0; off < 2; ++off )
+    {
+        size_t len = buf.size() - off;
+        const uint8_t* p = &buf[off];
+        CHECK(scalar_cksum(p, len) == cksum_add((const uint16_t*)p, len));
+    }
+}
+
+TEST(checksum, update_word_matches_recompute)
+{
+    uint16_t h[IP_HDR_WORDS];
+
+    for ( unsigned i = 0; i < 10000; ++i )
+    {
+        make_ip_header(h);
+
+        unsigned w = rand() % IP_HDR_WORDS;
+
+        if ( w == IP_CKSUM_WORD )
+            continue;
+
+        uint16_t old_word = h[w];
+        h[w] = rand();
+
+        uint16_t ck = update(h[IP_CKSUM_WORD], old_word, h[w]);
+        CHECK(same_cksum(recompute(h), ck));
+    }
+}
+
+TEST(checksum, update_range_matches_recompute)
+{
+    uint16_t h[IP_HDR_WORDS];
+    uint16_t old_h[IP_HDR_WORDS];
+
+    for ( unsigned i = 0; i < 10000; ++i )
+    {
+        make_ip_header(h);
+        memcpy(old_h, h, sizeof(h));
+
+        // change some words, but not the checksum, in the leading range
+        unsigned n = 1 + rand() % IP_CKSUM_WORD;
+
+        for ( unsigned j = 0; j < n; ++j )
+        {
+            if ( rand() & 1 )
+                h[j] = rand();
+        }
+
+        uint16_t ck = update(h[IP_CKSUM_WORD], old_h, h, 2 * n);
+        CHECK(same_cksum(recompute(h), ck));
+    }
+}
+
+TEST(checksum, update_preserves_bad_checksum)
+{
+    uint16_t h[IP_HDR_WORDS];
+
+    for ( unsigned i = 0; i < 10000; ++i )
+    {
+        make_ip_header(h);
+
+        // corrupt the checksum; verifying the header now gives a nonzero
+        // residual which an update must preserve
+        h[IP_CKSUM_WORD] ^= 1 + rand() % 0xFFFE;
+        uint16_t residual = ip_cksum(h, sizeof(h));
+
+        if ( same_cksum(residual, 0) )
+            continue;
+
+        unsigned w = rand() % IP_HDR_WORDS;
+
+        if ( w == IP_CKSUM_WORD )
+            continue;
+
+        uint16_t old_word = h[w];
+        h[w] = rand();
+        h[IP_CKSUM_WORD] = update(h[IP_CKSUM_WORD], old_word, h[w]);
+
+        CHECK(same_cksum(ip_cksum(h, sizeof(h)), residual));
+        CHECK(!same_cksum(recompute(h), h[IP_CKSUM_WORD]));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,297 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#include "shm_connector.h"
+
+#include <string.h>
+
+#include <string>
+
+#include "shm_connector_module.h"
+#include "log/messages.h"
+#include "main/snort_types.h"
+#include "main/snort_debug.h"
+#include "main/thread.h"
+
+// how many idle handles each connector keeps for reuse
+#define SHM_CONNECTOR_HANDLES 16
+
+// a blocking receive rechecks the ring at least this often
+#define SHM_CONNECTOR_WAIT_MSEC 100
+
+/* Globals ****************************************************************/
+
+THREAD_LOCAL ShmConnectorStats shm_connector_stats;
+
+ShmConnectorMsgHandle::ShmConnectorMsgHandle(const uint32_t capacity)
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnectorMsgHandle::ShmConnectorMsgHandle()\n");
+
+    this->capacity = capacity;
+    connector_msg.length = capacity;
+    connector_msg.data = new uint8_t[capacity];
+}
+
+ShmConnectorMsgHandle::~ShmConnectorMsgHandle()
+{
+    delete[] connector_msg.data;
+}
+
+ShmConnectorCommon::ShmConnectorCommon(ShmConnectorConfig::ShmConnectorConfigSet* conf)
+{
+    config_set = (ConnectorConfig::ConfigSet*)conf;
+}
+
+ShmConnectorCommon::~ShmConnectorCommon()
+{
+    for ( auto conf : *config_set )
+        delete conf;
+
+    config_set->clear();
+    delete config_set;
+}
+
+ShmConnector::ShmConnector(ShmConnectorConfig* shm_connector_config, ShmRing* r)
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnector::ShmConnector()\n");
+    config = shm_connector_config;
+    ring = r;
+}
+
+ShmConnector::~ShmConnector()
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnector::~ShmConnector()\n");
+
+    for ( auto h : free_handles )
+        delete h;
+
+    delete ring;
+}
+
+// handles are sized to the slot so any message from the ring fits in a
+// recycled one.  larger requests still get a handle, as the side channel
+// requires, but transmit will reject them.
+ShmConnectorMsgHandle* ShmConnector::get_handle(uint32_t length)
+{
+    ShmConnectorMsgHandle* handle;
+    uint32_t slot_size = ((ShmConnectorConfig*)config)->slot_size;
+
+    if ( length <= slot_size and !free_handles.empty() )
+    {
+        handle = free_handles.back();
+        free_handles.pop_back();
+    }
+    else
+        handle = new ShmConnectorMsgHandle(length > slot_size ? length : slot_size);
+
+    handle->connector_msg.length = length;
+    return handle;
+}
+
+void ShmConnector::put_handle(ShmConnectorMsgHandle* handle)
+{
+    if ( handle->capacity == ((ShmConnectorConfig*)config)->slot_size and
+        free_handles.size() < SHM_CONNECTOR_HANDLES )
+        free_handles.push_back(handle);
+    else
+        delete handle;
+}
+
+ConnectorMsgHandle* ShmConnector::alloc_message(const uint32_t length, const uint8_t** data)
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnector::alloc_message()\n");
+    ShmConnectorMsgHandle* msg = get_handle(length);
+
+    *data = (uint8_t*)msg->connector_msg.data;
+
+    return msg;
+}
+
+void ShmConnector::discard_message(ConnectorMsgHandle* msg)
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnector::discard_message()\n");
+    put_handle((ShmConnectorMsgHandle*)msg);
+}
+
+// the message is copied into the ring so the handle can be recycled at once;
+// no system call is made unless the receiver is parked in a blocking receive
+bool ShmConnector::transmit_message(ConnectorMsgHandle* msg)
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnector::transmit_message()\n");
+    ShmConnectorMsgHandle* smsg = (ShmConnectorMsgHandle*)msg;
+    bool ok = false;
+
+    if ( ring )
+    {
+        ok = ring->push(smsg->connector_msg.data, smsg->connector_msg.length);
+
+        if ( ok )
+            shm_connector_stats.transmitted++;
+
+        else if ( smsg->connector_msg.length > ring->get_slot_size() )
+            shm_connector_stats.too_big++;
+
+        else
+            shm_connector_stats.ring_full++;
+    }
+
+    put_handle(smsg);
+    return ok;
+}
+
+// the message is copied out of the ring so the slot is released before the
+// side channel handler runs
+ConnectorMsgHandle* ShmConnector::receive_message(bool block)
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnector::receive_message()\n");
+
+    if ( !ring )
+        return nullptr;
+
+    uint32_t length;
+    const uint8_t* data = ring->peek(length);
+
+    if ( !data )
+    {
+        if ( !block )
+            return nullptr;
+
+        shm_connector_stats.waits++;
+
+        while ( !ring->wait(SHM_CONNECTOR_WAIT_MSEC) )
+            ;
+
+        data = ring->peek(length);
+    }
+
+    ShmConnectorMsgHandle* handle = get_handle(length);
+    memcpy(handle->connector_msg.data, data, length);
+    ring->pop();
+
+    shm_connector_stats.received++;
+    return handle;
+}
+
+//-------------------------------------------------------------------------
+// api stuff
+//-------------------------------------------------------------------------
+
+static Module* mod_ctor()
+{
+    DebugMessage(DEBUG_CONNECTORS,"shm_connector:mod_ctor()\n");
+    return new ShmConnectorModule;
+}
+
+static void mod_dtor(Module* m)
+{
+    delete m;
+    DebugMessage(DEBUG_CONNECTORS,"shm_connector:mod_dtor(Module*)\n");
+}
+
+// Create a per-thread object.  Each packet thread gets its own ring so
+// the names of both ends must match instance for instance.
+static Connector* shm_connector_tinit(ConnectorConfig* config)
+{
+    DebugMessage(DEBUG_CONNECTORS,"shm_connector:shm_connector_tinit()\n");
+    ShmConnectorConfig* cfg = (ShmConnectorConfig*)config;
+
+    if ( cfg->direction != Connector::CONN_TRANSMIT and
+        cfg->direction != Connector::CONN_RECEIVE )
+        return nullptr;
+
+    std::string name = "/" SHM_CONNECTOR_NAME "_";
+    name += cfg->name;
+    name += "_";
+    name += std::to_string(get_instance_id());
+
+    ShmRing* ring = ShmRing::attach(name.c_str(), cfg->slots, cfg->slot_size);
+
+    if ( !ring )
+        ErrorMessage("%s: can't attach ring %s with %u slots of %u bytes\n",
+            SHM_CONNECTOR_NAME, name.c_str(), cfg->slots, cfg->slot_size);
+
+    DebugFormat(DEBUG_CONNECTORS,"shm_connector:shm_connector_tinit(): ring: %s\n",
+        name.c_str());
+
+    return new ShmConnector(cfg, ring);
+}
+
+// the receiver owns the name; a later run starts with an empty ring while
+// a transmitter still attached keeps its mapping until it terminates
+static void shm_connector_tterm(Connector* connector)
+{
+    DebugMessage(DEBUG_CONNECTORS,"shm_connector:shm_connector_tterm()\n");
+    ShmConnector* shm_connector = (ShmConnector*)connector;
+
+    if ( shm_connector->ring and
+        shm_connector->get_connector_direction() == Connector::CONN_RECEIVE )
+        shm_connector->ring->unlink();
+
+    delete shm_connector;
+}
+
+static ConnectorCommon* shm_connector_ctor(Module* m)
+{
+    DebugMessage(DEBUG_CONNECTORS,"shm_connector:shm_connector_ctor(Module*)\n");
+    ShmConnectorModule* mod = (ShmConnectorModule*)m;
+    ShmConnectorCommon* shm_connector_common = new ShmConnectorCommon(
+        mod->get_and_clear_config());
+
+    return shm_connector_common;
+}
+
+static void shm_connector_dtor(ConnectorCommon* c)
+{
+    DebugMessage(DEBUG_CONNECTORS,"shm_connector:shm_connector_dtor(ConnectorCommon*)\n");
+    ShmConnectorCommon* sc = (ShmConnectorCommon*)c;
+    delete sc;
+}
+
+const ConnectorApi shm_connector_api =
+{
+    {
+        PT_CONNECTOR,
+        sizeof(ConnectorApi),
+        CONNECTOR_API_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        SHM_CONNECTOR_NAME,
+        SHM_CONNECTOR_HELP,
+        mod_ctor,
+        mod_dtor
+    },
+    0,
+    nullptr,
+    nullptr,
+    shm_connector_tinit,
+    shm_connector_tterm,
+    shm_connector_ctor,
+    shm_connector_dtor
+};
+
+#ifdef BUILDING_SO
+SO_PUBLIC const BaseApi* snort_plugins[] =
+{
+    &shm_connector_api.base,
+    nullptr
+};
+#else
+const BaseApi* shm_connector = &shm_connector_api.base;
+#endif
+
@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifndef SHM_CONNECTOR_H
+#define SHM_CONNECTOR_H
+
+#include <vector>
+
+#include "shm_connector_config.h"
+#include "shm_ring.h"
+#include "framework/connector.h"
+#include "main/thread.h"
+
+//-------------------------------------------------------------------------
+// class stuff
+//-------------------------------------------------------------------------
+
+class ShmConnectorMsgHandle : public ConnectorMsgHandle
+{
+public:
+    ShmConnectorMsgHandle(const uint32_t capacity);
+    ~ShmConnectorMsgHandle();
+    ConnectorMsg connector_msg;
+    uint32_t capacity;
+};
+
+class ShmConnectorCommon : public ConnectorCommon
+{
+public:
+    ShmConnectorCommon(ShmConnectorConfig::ShmConnectorConfigSet*);
+    ~ShmConnectorCommon();
+};
+
+class ShmConnector : public Connector
+{
+public:
+    ShmConnector(ShmConnectorConfig*, ShmRing*);
+    ~ShmConnector();
+    ConnectorMsgHandle* alloc_message(const uint32_t, const uint8_t**);
+    void discard_message(ConnectorMsgHandle*);
+    bool transmit_message(ConnectorMsgHandle*);
+    ConnectorMsgHandle* receive_message(bool);
+
+    ConnectorMsg* get_connector_msg(ConnectorMsgHandle* handle)
+    { return( &((ShmConnectorMsgHandle*)handle)->connector_msg ); }
+    Direction get_connector_direction()
+    { return( ((ShmConnectorConfig*)config)->direction ); }
+
+    ShmRing* ring;
+
+private:
+    ShmConnectorMsgHandle* get_handle(uint32_t length);
+    void put_handle(ShmConnectorMsgHandle*);
+
+    // handles are recycled so that the fast path does not hit the heap
+    std::vector<ShmConnectorMsgHandle*> free_handles;
+};
+
+#endif
+
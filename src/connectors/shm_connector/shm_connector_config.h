@@ -1,5 +1,5 @@
 //--------------------------------------------------------------------------
-// Copyright (C) 2015-2016 Cisco and/or its affiliates. All rights reserved.
+// Copyright (C) 2016 Cisco and/or its affiliates. All rights reserved.
 //
 // This program is free software; you can redistribute it and/or modify it
 // under the terms of the GNU General Public License Version 2 as published
@@ -16,13 +16,24 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 //--------------------------------------------------------------------------
 
-// hyperscan.h author Russ Combs <rucombs@cisco.com>
+#ifndef SHM_CONNECTOR_CONFIG_H
+#define SHM_CONNECTOR_CONFIG_H
 
-#ifndef HYPERSCAN_H
-#define HYPERSCAN_H
+#include <vector>
 
-struct SnortConfig;
-void hyperscan_setup(SnortConfig*);
-void hyperscan_cleanup(SnortConfig*);
+#include "framework/connector.h"
+
+class ShmConnectorConfig : public ConnectorConfig
+{
+public:
+    ShmConnectorConfig()
+    { direction = Connector::CONN_UNDEFINED; slots = 1024; slot_size = 1520; }
+
+    unsigned slots;
+    unsigned slot_size;
+
+    typedef std::vector<ShmConnectorConfig*> ShmConnectorConfigSet;
+};
 
 #endif
+
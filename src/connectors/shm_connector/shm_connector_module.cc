@@ -0,0 +1,166 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#include "shm_connector_module.h"
+
+#include "main/snort_debug.h"
+
+static const Parameter shm_connector_params[] =
+{
+    { "connector", Parameter::PT_STRING, nullptr, nullptr,
+      "connector name" },
+
+    { "name", Parameter::PT_STRING, nullptr, nullptr,
+      "channel name; both ends of a channel must use the same name" },
+
+    { "direction", Parameter::PT_ENUM, "receive | transmit", nullptr,
+      "usage" },
+
+    { "slots", Parameter::PT_INT, "2:1048576", "1024",
+      "number of messages the ring can hold; rounded up to a power of 2" },
+
+    { "slot_size", Parameter::PT_INT, "64:65535", "1520",
+      "maximum message length in bytes including the side channel header" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
+static const PegInfo shm_connector_pegs[] =
+{
+    { "transmitted", "messages written to the ring" },
+    { "received", "messages read from the ring" },
+    { "ring full", "messages dropped because the ring was full" },
+    { "too big", "messages dropped because they exceed slot_size" },
+    { "waits", "blocking receives that had to wait for a message" },
+    { nullptr, nullptr }
+};
+
+extern THREAD_LOCAL ShmConnectorStats shm_connector_stats;
+
+//-------------------------------------------------------------------------
+// shm_connector module
+//-------------------------------------------------------------------------
+
+ShmConnectorModule::ShmConnectorModule() :
+    Module(SHM_CONNECTOR_NAME, SHM_CONNECTOR_HELP, shm_connector_params)
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnectorModule::ShmConnectorModule()\n");
+    config = nullptr;
+    config_set = new ShmConnectorConfig::ShmConnectorConfigSet;
+}
+
+ShmConnectorModule::~ShmConnectorModule()
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnectorModule::~ShmConnectorModule()\n");
+    if ( config )
+        delete config;
+    if ( config_set )
+        delete config_set;
+}
+
+bool ShmConnectorModule::set(const char* fqn, Value& v, SnortConfig*)
+{
+#ifdef DEBUG_MSGS
+    DebugFormat(DEBUG_CONNECTORS,"ShmConnectorModule::set(): %s, %s\n", fqn, v.get_name());
+#else
+    UNUSED(fqn);
+#endif
+
+    if ( v.is("connector") )
+        config->connector_name = v.get_string();
+
+    else if ( v.is("name") )
+        config->name = v.get_string();
+
+    else if ( v.is("direction") )
+        switch ( v.get_long() )
+        {
+        case 0:
+        {
+            config->direction = Connector::CONN_RECEIVE;
+            break;
+        }
+        case 1:
+        {
+            config->direction = Connector::CONN_TRANSMIT;
+            break;
+        }
+        default:
+            return false;
+        }
+
+    else if ( v.is("slots") )
+        config->slots = v.get_long();
+
+    else if ( v.is("slot_size") )
+        config->slot_size = v.get_long();
+
+    else
+        return false;
+
+    return true;
+}
+
+// clear my working config and hand-over the compiled list to the caller
+ShmConnectorConfig::ShmConnectorConfigSet* ShmConnectorModule::get_and_clear_config()
+{
+    DebugMessage(DEBUG_CONNECTORS,"ShmConnectorModule::get_and_clear_config()\n");
+    ShmConnectorConfig::ShmConnectorConfigSet* temp_config = config_set;
+    config = nullptr;
+    config_set = nullptr;
+    return temp_config;
+}
+
+bool ShmConnectorModule::begin(const char* fqn, int idx, SnortConfig*)
+{
+#ifdef DEBUG_MSGS
+    DebugFormat(DEBUG_CONNECTORS,"ShmConnectorModule::begin(): %s, %d\n", fqn, idx);
+#else
+    UNUSED(fqn);
+    UNUSED(idx);
+#endif
+    if ( !config )
+    {
+        config = new ShmConnectorConfig;
+    }
+    return true;
+}
+
+bool ShmConnectorModule::end(const char* fqn, int idx, SnortConfig*)
+{
+#ifdef DEBUG_MSGS
+    DebugFormat(DEBUG_CONNECTORS,"ShmConnectorModule::end(): %s, %d\n", fqn, idx);
+#else
+    UNUSED(fqn);
+#endif
+
+    if (idx != 0)
+    {
+        config_set->push_back(config);
+        config = nullptr;
+    }
+
+    return true;
+}
+
+const PegInfo* ShmConnectorModule::get_pegs() const
+{ return shm_connector_pegs; }
+
+PegCount* ShmConnectorModule::get_counts() const
+{ return (PegCount*)&shm_connector_stats; }
+
@@ -0,0 +1,381 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "shm_ring.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include <new>
+
+// the ring is shared with other processes so the atomics must be plain
+// memory operations and not hidden behind a library lock
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64 bit atomics must be lock free");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "32 bit atomics must be lock free");
+
+#define SHM_RING_MAGIC 0x52494E47  // "RING"
+#define SHM_RING_VERSION 1
+
+// a waiting consumer spins this many times before parking on the futex
+#define SHM_RING_SPINS 2048
+
+// how long an attaching process waits for the creator to initialize
+#define SHM_RING_ATTACH_MSEC 1000
+
+//-------------------------------------------------------------------------
+// shared layout
+// head is written by producers, tail by the consumer, and waiters / wake by
+// both only when the consumer blocks, so each gets its own cache line.
+//-------------------------------------------------------------------------
+
+struct ShmRing::Header
+{
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slot_size;
+    uint32_t stride;
+
+    alignas(SHM_RING_CACHE_LINE) std::atomic<uint64_t> head;
+    alignas(SHM_RING_CACHE_LINE) std::atomic<uint64_t> tail;
+
+    alignas(SHM_RING_CACHE_LINE) std::atomic<uint32_t> waiters;
+    std::atomic<uint32_t> wake;
+};
+
+// seq == pos means the slot is free for the producer claiming pos
+// seq == pos + 1 means the message for pos is ready for the consumer
+struct ShmRing::Slot
+{
+    std::atomic<uint64_t> seq;
+    uint32_t length;
+    uint32_t reserved;
+
+    uint8_t* data()
+    { return (uint8_t*)(this + 1); }
+};
+
+static inline unsigned round_up(unsigned n, unsigned align)
+{ return (n + align - 1) & ~(align - 1); }
+
+inline unsigned ShmRing::data_offset()
+{ return round_up(sizeof(Header), SHM_RING_CACHE_LINE); }
+
+static inline void relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static void msleep(unsigned msec)
+{
+    struct timespec ts = { (time_t)(msec / 1000), (long)(msec % 1000) * 1000000 };
+    nanosleep(&ts, nullptr);
+}
+
+#ifdef __linux__
+// these are not FUTEX_PRIVATE_FLAG ops because the word is in memory shared
+// with another process
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t val, unsigned msec)
+{
+    struct timespec ts = { (time_t)(msec / 1000), (long)(msec % 1000) * 1000000 };
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, val, &ts, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>* word)
+{
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+#else
+// without futexes a blocked consumer just polls at a coarse interval
+static void futex_wait(std::atomic<uint32_t>*, uint32_t, unsigned msec)
+{ msleep(msec > 1 ? 1 : msec); }
+
+static void futex_wake(std::atomic<uint32_t>*)
+{ }
+#endif
+
+//-------------------------------------------------------------------------
+// attach / detach
+//-------------------------------------------------------------------------
+
+ShmRing::ShmRing(const std::string& s, uint8_t* b, size_t n) : name(s)
+{
+    base = b;
+    size = n;
+    hdr = (Header*)base;
+    mask = hdr->slots - 1;
+    stride = hdr->stride;
+}
+
+ShmRing::~ShmRing()
+{
+    munmap(base, size);
+}
+
+static bool wait_for_size(int fd, size_t size)
+{
+    struct stat sb;
+
+    for ( unsigned msec = 0; msec < SHM_RING_ATTACH_MSEC; ++msec )
+    {
+        if ( fstat(fd, &sb) )
+            return false;
+
+        // zero means the creator has not sized it yet
+        if ( sb.st_size )
+            return (size_t)sb.st_size == size;
+
+        msleep(1);
+    }
+    return false;
+}
+
+ShmRing* ShmRing::attach(const char* s, unsigned slots, unsigned slot_size)
+{
+    std::string name = s;
+
+    if ( name[0] != '/' )
+        name.insert(0, "/");
+
+    unsigned n = 2;
+
+    while ( n < slots )
+        n <<= 1;
+
+    slots = n;
+
+    unsigned stride = round_up(sizeof(Slot) + slot_size, SHM_RING_CACHE_LINE);
+    size_t size = data_offset() + (size_t)slots * stride;
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    bool creator = (fd >= 0);
+
+    if ( !creator )
+    {
+        if ( errno != EEXIST )
+            return nullptr;
+
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+
+        if ( fd < 0 )
+            return nullptr;
+
+        if ( !wait_for_size(fd, size) )
+        {
+            close(fd);
+            return nullptr;
+        }
+    }
+    else if ( ftruncate(fd, size) )
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if ( p == MAP_FAILED )
+    {
+        if ( creator )
+            shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    uint8_t* base = (uint8_t*)p;
+    Header* hdr = (Header*)base;
+
+    if ( creator )
+    {
+        // ftruncate zero fills so only the nonzero fields need setting
+        new (hdr) Header;
+        hdr->version = SHM_RING_VERSION;
+        hdr->slots = slots;
+        hdr->slot_size = slot_size;
+        hdr->stride = stride;
+        hdr->head.store(0, std::memory_order_relaxed);
+        hdr->tail.store(0, std::memory_order_relaxed);
+        hdr->waiters.store(0, std::memory_order_relaxed);
+        hdr->wake.store(0, std::memory_order_relaxed);
+
+        for ( unsigned i = 0; i < slots; ++i )
+        {
+            Slot* slot = (Slot*)(base + data_offset() + (size_t)i * stride);
+            slot->seq.store(i, std::memory_order_relaxed);
+        }
+        hdr->magic.store(SHM_RING_MAGIC, std::memory_order_release);
+    }
+    else
+    {
+        unsigned msec = 0;
+
+        while ( hdr->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC and
+            msec++ < SHM_RING_ATTACH_MSEC )
+            msleep(1);
+
+        if ( hdr->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC or
+            hdr->version != SHM_RING_VERSION or hdr->slots != slots or
+            hdr->slot_size != slot_size or hdr->stride != stride )
+        {
+            munmap(p, size);
+            return nullptr;
+        }
+    }
+    return new ShmRing(name, base, size);
+}
+
+void ShmRing::unlink()
+{
+    shm_unlink(name.c_str());
+}
+
+unsigned ShmRing::get_slots() const
+{ return hdr->slots; }
+
+unsigned ShmRing::get_slot_size() const
+{ return hdr->slot_size; }
+
+inline ShmRing::Slot* ShmRing::get_slot(uint64_t pos) const
+{ return (Slot*)(base + data_offset() + (size_t)(pos & mask) * stride); }
+
+//-------------------------------------------------------------------------
+// producer
+// a producer claims the head position with a cas and publishes the slot by
+// advancing its sequence.  with a single producer the cas never fails.
+//-------------------------------------------------------------------------
+
+bool ShmRing::push(const uint8_t* data, uint32_t len)
+{
+    if ( len > hdr->slot_size )
+        return false;
+
+    uint64_t pos = hdr->head.load(std::memory_order_relaxed);
+    Slot* slot;
+
+    while ( true )
+    {
+        slot = get_slot(pos);
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        int64_t dif = (int64_t)(seq - pos);
+
+        if ( !dif )
+        {
+            if ( hdr->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+                break;
+        }
+        else if ( dif < 0 )
+            return false;  // full
+
+        else
+            pos = hdr->head.load(std::memory_order_relaxed);
+    }
+
+    memcpy(slot->data(), data, len);
+    slot->length = len;
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    // pairs with the fence in wait(); either the consumer sees the message
+    // or we see the waiter.  the syscall is only made for a parked consumer.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if ( hdr->waiters.load(std::memory_order_relaxed) )
+    {
+        hdr->wake.fetch_add(1, std::memory_order_relaxed);
+        futex_wake(&hdr->wake);
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// consumer
+//-------------------------------------------------------------------------
+
+inline bool ShmRing::ready() const
+{
+    uint64_t pos = hdr->tail.load(std::memory_order_relaxed);
+    return get_slot(pos)->seq.load(std::memory_order_acquire) == pos + 1;
+}
+
+const uint8_t* ShmRing::peek(uint32_t& len)
+{
+    uint64_t pos = hdr->tail.load(std::memory_order_relaxed);
+    Slot* slot = get_slot(pos);
+
+    if ( slot->seq.load(std::memory_order_acquire) != pos + 1 )
+        return nullptr;
+
+    len = slot->length;
+    return slot->data();
+}
+
+void ShmRing::pop()
+{
+    uint64_t pos = hdr->tail.load(std::memory_order_relaxed);
+    Slot* slot = get_slot(pos);
+
+    assert(slot->seq.load(std::memory_order_relaxed) == pos + 1);
+    slot->seq.store(pos + mask + 1, std::memory_order_release);
+    hdr->tail.store(pos + 1, std::memory_order_relaxed);
+}
+
+bool ShmRing::wait(unsigned msec)
+{
+    // most gaps between messages are shorter than a futex round trip
+    for ( unsigned i = 0; i < SHM_RING_SPINS; ++i )
+    {
+        if ( ready() )
+            return true;
+
+        relax();
+    }
+
+    hdr->waiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    uint32_t wake = hdr->wake.load(std::memory_order_relaxed);
+    bool ok = ready();
+
+    if ( !ok and msec )
+    {
+        futex_wait(&hdr->wake, wake, msec);
+        ok = ready();
+    }
+
+    hdr->waiters.fetch_sub(1, std::memory_order_relaxed);
+    return ok;
+}
+
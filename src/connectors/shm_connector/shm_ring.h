@@ -0,0 +1,79 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+// ShmRing is a bounded multi-producer, single-consumer message ring in a
+// POSIX shared memory segment.  Slots are cache line aligned and carry a
+// sequence number so that push and pop are lock free and make no system
+// calls.  The only syscall outside of attach / detach is the futex used to
+// park a consumer that asked to block on an empty ring.
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#define SHM_RING_CACHE_LINE 64
+
+class ShmRing
+{
+public:
+    // create the named segment or attach to an existing one with the same
+    // geometry.  returns nullptr on failure.  slots is rounded up to a power
+    // of 2 and slot_size is the maximum message length.
+    static ShmRing* attach(const char* name, unsigned slots, unsigned slot_size);
+    ~ShmRing();
+
+    // producer side; false if the ring is full or len exceeds the slot size
+    bool push(const uint8_t* data, uint32_t len);
+
+    // consumer side; peek returns the oldest message in place or nullptr if
+    // the ring is empty.  pop releases it back to the producers.
+    const uint8_t* peek(uint32_t& len);
+    void pop();
+
+    // park the consumer until a message is pushed or msec elapses.
+    // returns true if a message is ready.
+    bool wait(unsigned msec);
+
+    // remove the name; existing mappings stay valid until detached
+    void unlink();
+
+    unsigned get_slots() const;
+    unsigned get_slot_size() const;
+
+private:
+    struct Header;
+    struct Slot;
+
+    ShmRing(const std::string&, uint8_t*, size_t);
+    static unsigned data_offset();
+    Slot* get_slot(uint64_t) const;
+    bool ready() const;
+
+    std::string name;
+    uint8_t* base;
+    size_t size;
+    Header* hdr;
+    uint64_t mask;
+    unsigned stride;
+};
+
+#endif
+
@@ -0,0 +1,226 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// unit test main
+
+#include "connectors/shm_connector/shm_connector.h"
+#include "connectors/shm_connector/shm_connector_module.h"
+
+#include <string.h>
+
+#include "main/snort_debug.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+extern const BaseApi* shm_connector;
+extern THREAD_LOCAL ShmConnectorStats shm_connector_stats;
+ConnectorApi* sc_api = nullptr;
+
+ShmConnectorConfig connector_tx_config;
+ShmConnectorConfig connector_rx_config;
+
+Module* mod;
+
+ConnectorCommon* connector_common;
+
+Connector* connector_tx;
+Connector* connector_rx;
+
+void show_stats(PegCount*, const PegInfo*, unsigned, const char*) { }
+
+void show_stats(PegCount*, const PegInfo*, IndexVec&, const char*) { }
+
+void show_stats(PegCount*, const PegInfo*, IndexVec&, const char*, FILE*) { }
+
+unsigned get_instance_id()
+{ return 0; }
+
+void ErrorMessage(const char*, ...) { }
+
+void Debug::print(const char*, int, uint64_t, const char*, ...) { }
+
+ShmConnectorModule::ShmConnectorModule() :
+    Module("SC", "SC Help", nullptr)
+{ }
+
+ShmConnectorConfig::ShmConnectorConfigSet* ShmConnectorModule::get_and_clear_config()
+{
+    ShmConnectorConfig::ShmConnectorConfigSet* config_set = new ShmConnectorConfig::ShmConnectorConfigSet;
+
+    return config_set;
+}
+
+ShmConnectorModule::~ShmConnectorModule() { }
+
+bool ShmConnectorModule::set(const char*, Value&, SnortConfig*) { return true; }
+
+bool ShmConnectorModule::begin(const char*, int, SnortConfig*) { return true; }
+
+bool ShmConnectorModule::end(const char*, int, SnortConfig*) { return true; }
+
+const PegInfo* ShmConnectorModule::get_pegs() const { return nullptr; }
+
+PegCount* ShmConnectorModule::get_counts() const { return nullptr; }
+
+TEST_GROUP(shm_connector)
+{
+    void setup()
+    {
+        // FIXIT-L workaround for CppUTest mem leak detector issue
+        MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+        sc_api = (ConnectorApi*)shm_connector;
+    }
+
+    void teardown()
+    {
+        MemoryLeakWarningPlugin::turnOnNewDeleteOverloads();
+    }
+};
+
+TEST(shm_connector, mod_ctor_dtor)
+{
+    CHECK(shm_connector != nullptr);
+    mod = shm_connector->mod_ctor();
+    CHECK(mod != nullptr);
+    shm_connector->mod_dtor(mod);
+}
+
+TEST(shm_connector, mod_instance_ctor_dtor)
+{
+    CHECK(shm_connector != nullptr);
+    mod = shm_connector->mod_ctor();
+    CHECK(mod != nullptr);
+    connector_common = sc_api->ctor(mod);
+    CHECK(connector_common != nullptr);
+    sc_api->dtor(connector_common);
+    shm_connector->mod_dtor(mod);
+}
+
+TEST_GROUP(shm_connector_tinit_tterm)
+{
+    void setup()
+    {
+        // FIXIT-L workaround for CppUTest mem leak detector issue
+        MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+        sc_api = (ConnectorApi*)shm_connector;
+        connector_tx_config.direction = Connector::CONN_TRANSMIT;
+        connector_tx_config.connector_name = "tx";
+        connector_tx_config.name = "unit_test_" + std::to_string(getpid());
+        connector_tx_config.slots = 4;
+        connector_tx_config.slot_size = 64;
+        connector_rx_config.direction = Connector::CONN_RECEIVE;
+        connector_rx_config.connector_name = "rx";
+        connector_rx_config.name = connector_tx_config.name;
+        connector_rx_config.slots = 4;
+        connector_rx_config.slot_size = 64;
+        CHECK(shm_connector != nullptr);
+        mod = shm_connector->mod_ctor();
+        CHECK(mod != nullptr);
+        connector_common = sc_api->ctor(mod);
+        CHECK(connector_common != nullptr);
+        connector_tx = sc_api->tinit(&connector_tx_config);
+        connector_rx = sc_api->tinit(&connector_rx_config);
+        CHECK(connector_tx != nullptr);
+        CHECK(connector_rx != nullptr);
+        CHECK(((ShmConnector*)connector_tx)->ring != nullptr);
+        CHECK(((ShmConnector*)connector_rx)->ring != nullptr);
+        memset(&shm_connector_stats, 0, sizeof(shm_connector_stats));
+    }
+
+    void teardown()
+    {
+        sc_api->tterm(connector_tx);
+        sc_api->tterm(connector_rx);
+        sc_api->dtor(connector_common);
+        shm_connector->mod_dtor(mod);
+        MemoryLeakWarningPlugin::turnOnNewDeleteOverloads();
+    }
+};
+
+TEST(shm_connector_tinit_tterm, alloc_discard)
+{
+    const uint8_t* data = nullptr;
+    ShmConnector* sc_tx = (ShmConnector*)connector_tx;
+
+    ShmConnectorMsgHandle* handle = (ShmConnectorMsgHandle*)(sc_tx->alloc_message(40,&data));
+    CHECK(data != nullptr);
+    CHECK(handle->connector_msg.length == 40);
+    CHECK(handle->connector_msg.data == data);
+    sc_tx->discard_message(handle);
+
+    // the handle is recycled
+    ShmConnectorMsgHandle* again = (ShmConnectorMsgHandle*)(sc_tx->alloc_message(20,&data));
+    CHECK(again == handle);
+    CHECK(again->connector_msg.length == 20);
+    sc_tx->discard_message(again);
+}
+
+TEST(shm_connector_tinit_tterm, alloc_transmit_receive_discard)
+{
+    ShmConnector* sc_tx = (ShmConnector*)connector_tx;
+    ShmConnector* sc_rx = (ShmConnector*)connector_rx;
+
+    CHECK(sc_rx->receive_message(false) == nullptr);
+
+    const uint8_t* data = nullptr;
+    ConnectorMsgHandle* t_handle = sc_tx->alloc_message(40,&data);
+    memset((uint8_t*)data, 0x5A, 40);
+    CHECK(sc_tx->transmit_message(t_handle) == true);
+
+    ConnectorMsgHandle* r_handle = sc_rx->receive_message(true);
+    CHECK(r_handle != nullptr);
+
+    ConnectorMsg* msg = sc_rx->get_connector_msg(r_handle);
+    CHECK(msg->length == 40);
+    CHECK(msg->data[0] == 0x5A and msg->data[39] == 0x5A);
+    sc_rx->discard_message(r_handle);
+
+    CHECK(sc_rx->receive_message(false) == nullptr);
+    CHECK(shm_connector_stats.transmitted == 1);
+    CHECK(shm_connector_stats.received == 1);
+}
+
+TEST(shm_connector_tinit_tterm, ring_full)
+{
+    ShmConnector* sc_tx = (ShmConnector*)connector_tx;
+    const uint8_t* data = nullptr;
+
+    for ( unsigned i = 0; i < 4; ++i )
+        CHECK(sc_tx->transmit_message(sc_tx->alloc_message(8,&data)) == true);
+
+    CHECK(sc_tx->transmit_message(sc_tx->alloc_message(8,&data)) == false);
+    CHECK(shm_connector_stats.ring_full == 1);
+}
+
+TEST(shm_connector_tinit_tterm, too_big)
+{
+    ShmConnector* sc_tx = (ShmConnector*)connector_tx;
+    const uint8_t* data = nullptr;
+
+    ConnectorMsgHandle* handle = sc_tx->alloc_message(65,&data);
+    CHECK(data != nullptr);
+    CHECK(sc_tx->transmit_message(handle) == false);
+    CHECK(shm_connector_stats.too_big == 1);
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
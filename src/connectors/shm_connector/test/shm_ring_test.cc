@@ -0,0 +1,203 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// unit test main
+
+#include "connectors/shm_connector/shm_ring.h"
+
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+static std::string ring_name(const char* s)
+{
+    std::string name = "/shm_ring_test_";
+    name += s;
+    name += "_";
+    name += std::to_string(getpid());
+    return name;
+}
+
+TEST_GROUP(shm_ring)
+{
+    ShmRing* ring = nullptr;
+
+    void setup()
+    {
+        // FIXIT-L workaround for CppUTest mem leak detector issue
+        MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+        ring = ShmRing::attach(ring_name("basic").c_str(), 5, 100);
+        CHECK(ring != nullptr);
+    }
+
+    void teardown()
+    {
+        ring->unlink();
+        delete ring;
+        MemoryLeakWarningPlugin::turnOnNewDeleteOverloads();
+    }
+};
+
+TEST(shm_ring, geometry)
+{
+    CHECK(ring->get_slots() == 8);
+    CHECK(ring->get_slot_size() == 100);
+}
+
+TEST(shm_ring, empty)
+{
+    uint32_t len;
+    CHECK(ring->peek(len) == nullptr);
+    CHECK(ring->wait(0) == false);
+}
+
+TEST(shm_ring, push_peek_pop)
+{
+    const uint8_t msg[] = "hello ring";
+    CHECK(ring->push(msg, sizeof(msg)) == true);
+
+    uint32_t len = 0;
+    const uint8_t* data = ring->peek(len);
+    CHECK(data != nullptr);
+    CHECK(len == sizeof(msg));
+    CHECK(!memcmp(data, msg, len));
+
+    ring->pop();
+    CHECK(ring->peek(len) == nullptr);
+}
+
+TEST(shm_ring, too_big)
+{
+    uint8_t msg[101] = { };
+    CHECK(ring->push(msg, sizeof(msg)) == false);
+    CHECK(ring->push(msg, sizeof(msg) - 1) == true);
+}
+
+TEST(shm_ring, full_and_wrap)
+{
+    uint8_t msg[4];
+
+    for ( unsigned n = 0; n < 3; ++n )
+    {
+        for ( uint8_t i = 0; i < 8; ++i )
+        {
+            memset(msg, i, sizeof(msg));
+            CHECK(ring->push(msg, sizeof(msg)) == true);
+        }
+        CHECK(ring->push(msg, sizeof(msg)) == false);
+
+        for ( uint8_t i = 0; i < 8; ++i )
+        {
+            uint32_t len = 0;
+            const uint8_t* data = ring->peek(len);
+            CHECK(data != nullptr);
+            CHECK(len == sizeof(msg));
+            CHECK(data[0] == i and data[3] == i);
+            ring->pop();
+        }
+        uint32_t len;
+        CHECK(ring->peek(len) == nullptr);
+    }
+}
+
+TEST(shm_ring, attach_existing)
+{
+    ShmRing* other = ShmRing::attach(ring_name("basic").c_str(), 8, 100);
+    CHECK(other != nullptr);
+
+    const uint8_t msg[] = "shared";
+    CHECK(other->push(msg, sizeof(msg)) == true);
+
+    uint32_t len = 0;
+    const uint8_t* data = ring->peek(len);
+    CHECK(data != nullptr);
+    CHECK(len == sizeof(msg));
+    ring->pop();
+
+    delete other;
+}
+
+TEST(shm_ring, attach_mismatch)
+{
+    CHECK(ShmRing::attach(ring_name("basic").c_str(), 16, 100) == nullptr);
+    CHECK(ShmRing::attach(ring_name("basic").c_str(), 8, 200) == nullptr);
+}
+
+// a forked producer streams more messages than the ring holds so the
+// consumer has to block and the producer has to retry when full
+TEST(shm_ring, two_process)
+{
+    const unsigned count = 10000;
+    std::string name = ring_name("basic");
+    pid_t pid = fork();
+
+    if ( !pid )
+    {
+        ShmRing* tx = ShmRing::attach(name.c_str(), 8, 100);
+
+        if ( !tx )
+            _exit(1);
+
+        for ( unsigned i = 0; i < count; ++i )
+        {
+            while ( !tx->push((const uint8_t*)&i, sizeof(i)) )
+                usleep(10);
+        }
+        delete tx;
+        _exit(0);
+    }
+    CHECK(pid > 0);
+
+    unsigned expected = 0;
+
+    while ( expected < count )
+    {
+        uint32_t len = 0;
+        const uint8_t* data = ring->peek(len);
+
+        if ( !data )
+        {
+            ring->wait(100);
+            continue;
+        }
+        unsigned got;
+        memcpy(&got, data, sizeof(got));
+        ring->pop();
+
+        if ( len != sizeof(got) or got != expected )
+            break;
+
+        ++expected;
+    }
+    CHECK(expected == count);
+
+    int status = -1;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) and WEXITSTATUS(status) == 0);
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
@@ -20,6 +20,9 @@
 #ifndef IDLE_PROCESSING_H
 #define IDLE_PROCESSING_H
 
+// handlers run on the main thread and on packet threads when the DAQ is
+// idle so they must only touch thread local state
+
 using IdleHook = void (*)();
 
 class IdleProcessing
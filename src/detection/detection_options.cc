@@ -32,6 +32,9 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+#include <vector>
+
 #include "detection_defines.h"
 #include "detection_util.h"
 #include "treenodes.h"
@@ -46,6 +49,8 @@
 #include "hash/sfhashfcn.h"
 #include "parser/parser.h"
 #include "ips_options/ips_byte_extract.h"
+#include "ips_options/ips_content.h"
+#include "ips_options/ips_flow.h"
 #include "ips_options/ips_flowbits.h"
 #include "ips_options/ips_pcre.h"
 #include "filters/detection_filter.h"
@@ -336,6 +341,100 @@ void* add_detection_option_tree(
     return nullptr;
 }
 
+// Add the match for this otn to the queue.
+static int detection_option_leaf_evaluate(
+    OptTreeNode* otn, detection_option_eval_data_t* eval_data, RuleContext& profile)
+{
+    Packet* p = eval_data->p;
+    void* pomd = eval_data->pomd;
+    int16_t app_proto = p->get_application_protocol();
+    int check_ports = 1;
+
+    if ( app_proto and ((OTNX_MATCH_DATA*)(pomd))->check_ports != 2 )
+    {
+        auto sig_info = otn->sigInfo;
+
+        for ( unsigned svc_idx = 0; svc_idx < sig_info.num_services; ++svc_idx )
+        {
+            if ( app_proto == sig_info.services[svc_idx].service_ordinal )
+            {
+                check_ports = 0;
+                break;  // out of for
+            }
+        }
+
+        if (sig_info.num_services && check_ports)
+        {
+            // none of the services match
+            DebugFormat(DEBUG_DETECT,
+                "[**] SID %d not matched because of service mismatch (%d!=%d [**]\n",
+                sig_info.id, app_proto, sig_info.services[0].service_ordinal);
+
+            return DETECTION_OPTION_NO_MATCH;
+        }
+    }
+
+    int eval_rtn_result = 0;
+
+    // Don't include RTN time
+    {
+        RulePause pause(profile);
+        eval_rtn_result = fpEvalRTN(getRuntimeRtnFromOtn(otn), p,
+            check_ports);
+    }
+
+    if ( eval_rtn_result )
+    {
+        bool f_result = true;
+
+        if ( otn->detection_filter )
+            f_result = detection_filter_test(otn->detection_filter,
+                p->ptrs.ip_api.get_src(), p->ptrs.ip_api.get_dst(),
+                p->pkth->ts.tv_sec);
+
+        if ( f_result )
+        {
+            otn->state[get_instance_id()].matches++;
+
+            if ( !eval_data->flowbit_noalert )
+            {
+                PatternMatchData* pmd = (PatternMatchData*)eval_data->pmd;
+                int pattern_size = pmd ? pmd->pattern_size : 0;
+                fpAddMatch((OTNX_MATCH_DATA*)pomd, pattern_size, otn);
+            }
+            return DETECTION_OPTION_MATCH;
+        }
+    }
+    return DETECTION_OPTION_NO_MATCH;
+}
+
+static inline bool last_check_valid(
+    const dot_last_check_t& last_check, Packet* p, uint64_t cur_eval_pkt_count)
+{
+    if ( last_check.ts == p->pkth->ts &&
+         last_check.packet_number == cur_eval_pkt_count &&
+         last_check.rebuild_flag == (p->packet_flags & PKT_REBUILT_STREAM) &&
+         !(p->packet_flags & PKT_ALLOW_MULTIPLE_DETECT) )
+    {
+        if ( !last_check.flowbit_failed &&
+             !(p->packet_flags & PKT_IP_RULE_2ND) &&
+             !(p->proto_bits & (PROTO_BIT__TEREDO|PROTO_BIT__GTP)) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void last_check_set(
+    dot_last_check_t& last_check, Packet* p, uint64_t cur_eval_pkt_count)
+{
+    last_check.ts = p->pkth->ts;
+    last_check.packet_number = cur_eval_pkt_count;
+    last_check.flowbit_failed = 0;
+    last_check.rebuild_flag = p->packet_flags & PKT_REBUILT_STREAM;
+}
+
 int detection_option_node_evaluate(
     detection_option_tree_node_t* node, detection_option_eval_data_t* eval_data,
     Cursor& orig_cursor)
@@ -362,31 +461,12 @@ int detection_option_node_evaluate(
         return 0;
 
     auto p = eval_data->p;
-    auto pomd = eval_data->pomd;
 
     // see if evaluated it before ...
-    if ( !node->is_relative )
-    {
-        auto last_check = state.last_check;
-
-        if ( last_check.ts == p->pkth->ts &&
-             last_check.packet_number == cur_eval_pkt_count &&
-             last_check.rebuild_flag == (p->packet_flags & PKT_REBUILT_STREAM) &&
-             !(p->packet_flags & PKT_ALLOW_MULTIPLE_DETECT) )
-        {
-            if ( !last_check.flowbit_failed &&
-                 !(p->packet_flags & PKT_IP_RULE_2ND) &&
-                 !(p->proto_bits & (PROTO_BIT__TEREDO|PROTO_BIT__GTP)) )
-            {
-                return last_check.result;
-            }
-        }
-    }
+    if ( !node->is_relative and last_check_valid(state.last_check, p, cur_eval_pkt_count) )
+        return state.last_check.result;
 
-    state.last_check.ts = eval_data->p->pkth->ts;
-    state.last_check.packet_number = cur_eval_pkt_count;
-    state.last_check.flowbit_failed = 0;
-    state.last_check.rebuild_flag = p->packet_flags & PKT_REBUILT_STREAM;
+    last_check_set(state.last_check, p, cur_eval_pkt_count);
 
     // Save some stuff off for repeated pattern tests
     bool try_again = false;
@@ -409,70 +489,13 @@ int detection_option_node_evaluate(
         switch ( node->option_type )
         {
         case RULE_OPTION_TYPE_LEAF_NODE:
-        // Add the match for this otn to the queue.
-        {
-            OptTreeNode* otn = (OptTreeNode*)node->option_data;
-            int16_t app_proto = p->get_application_protocol();
-            int check_ports = 1;
+            rval = detection_option_leaf_evaluate(
+                (OptTreeNode*)node->option_data, eval_data, profile);
 
-            if ( app_proto and ((OTNX_MATCH_DATA*)(pomd))->check_ports != 2 )
-            {
-                auto sig_info = otn->sigInfo;
-
-                for ( unsigned svc_idx = 0; svc_idx < sig_info.num_services; ++svc_idx )
-                {
-                    if ( app_proto == sig_info.services[svc_idx].service_ordinal )
-                    {
-                        check_ports = 0;
-                        break;  // out of for
-                    }
-                }
-
-                if (sig_info.num_services && check_ports)
-                {
-                    // none of the services match
-                    DebugFormat(DEBUG_DETECT,
-                        "[**] SID %d not matched because of service mismatch (%d!=%d [**]\n",
-                        sig_info.id, app_proto, sig_info.services[0].service_ordinal);
-
-                    break;  // out of case
-                }
-            }
-
-            int eval_rtn_result = 0;
-
-            // Don't include RTN time
-            {
-                RulePause pause(profile);
-                eval_rtn_result = fpEvalRTN(getRuntimeRtnFromOtn(otn), p,
-                    check_ports);
-            }
-
-            if ( eval_rtn_result )
-            {
-                bool f_result = true;
-
-                if ( otn->detection_filter )
-                    f_result = detection_filter_test(otn->detection_filter,
-                        p->ptrs.ip_api.get_src(), p->ptrs.ip_api.get_dst(),
-                        p->pkth->ts.tv_sec);
-
-                if ( f_result )
-                {
-                    otn->state[get_instance_id()].matches++;
-
-                    if ( !eval_data->flowbit_noalert )
-                    {
-                        PatternMatchData* pmd = (PatternMatchData*)eval_data->pmd;
-                        int pattern_size = pmd ? pmd->pattern_size : 0;
-                        fpAddMatch((OTNX_MATCH_DATA*)pomd, pattern_size, otn);
-                    }
-                    result = rval = DETECTION_OPTION_MATCH;
-                }
-            }
+            if ( rval == DETECTION_OPTION_MATCH )
+                result = rval;
 
             break;
-        }
 
         case RULE_OPTION_TYPE_CONTENT:
             if ( node->evaluate )
@@ -706,6 +729,313 @@ int detection_option_node_evaluate(
     return result;
 }
 
+//--------------------------------------------------------------------------
+// flat trees
+//--------------------------------------------------------------------------
+
+// this must do exactly what detection_option_node_evaluate() does
+static int flat_node_evaluate(
+    dot_flat_tree_t* tree, dot_flat_state_t* hot, unsigned idx,
+    detection_option_eval_data_t* eval_data, Cursor& orig_cursor)
+{
+    const dot_flat_node_t& node = tree->nodes[idx];
+    dot_flat_state_t& state = hot[idx];
+    RuleContext profile(node.node->state[get_instance_id()]);
+
+    int result = 0;
+    int rval = DETECTION_OPTION_NO_MATCH;
+    char tmp_noalert_flag = 0;
+    Cursor cursor = orig_cursor;
+    bool continue_loop = true;
+    char flowbits_setoperation = 0;
+    int loop_count = 0;
+    uint32_t tmp_byte_extract_vars[NUM_BYTE_EXTRACT_VARS];
+    uint64_t cur_eval_pkt_count =
+        (rule_eval_pkt_count + (PacketManager::get_rebuilt_packet_count()));
+
+    Packet* p = eval_data->p;
+
+    if ( !node.is_relative and last_check_valid(state.last_check, p, cur_eval_pkt_count) )
+        return state.last_check.result;
+
+    last_check_set(state.last_check, p, cur_eval_pkt_count);
+
+    PmdLastCheck* content_last = nullptr;
+
+    if ( node.pmd and node.pmd->last_check )
+        content_last = node.pmd->last_check + get_instance_id();
+
+    do
+    {
+        if ( content_last and node.option_type == RULE_OPTION_TYPE_CONTENT and
+             content_last->ts == p->pkth->ts &&
+             content_last->packet_number == cur_eval_pkt_count &&
+             content_last->rebuild_flag == (p->packet_flags & PKT_REBUILT_STREAM) )
+        {
+            // see the content case in detection_option_node_evaluate()
+            rval = DETECTION_OPTION_NO_MATCH;
+        }
+        else switch ( node.op )
+        {
+        case DOT_OP_LEAF:
+            rval = detection_option_leaf_evaluate(
+                (OptTreeNode*)node.option_data, eval_data, profile);
+
+            if ( rval == DETECTION_OPTION_MATCH )
+                result = rval;
+
+            break;
+
+        case DOT_OP_CONTENT:
+            rval = content_option_eval(node.option_data, cursor, p);
+            break;
+
+        case DOT_OP_PCRE:
+            rval = pcre_option_eval(node.option_data, cursor, p);
+            break;
+
+        case DOT_OP_FLOWBITS:
+            flowbits_setoperation = FlowBits_SetOperation(node.option_data);
+
+            if ( flowbits_setoperation )
+                // set to match so we don't bail early
+                rval = DETECTION_OPTION_MATCH;
+
+            else
+                rval = flowbits_option_eval(node.option_data, cursor, p);
+
+            break;
+
+        default:
+            if ( node.evaluate )
+                rval = node.evaluate(node.option_data, cursor, p);
+
+            break;
+        }
+
+        if ( rval == DETECTION_OPTION_NO_MATCH )
+        {
+            state.last_check.result = result;
+            return result;
+        }
+
+        else if ( rval == DETECTION_OPTION_FAILED_BIT )
+        {
+            eval_data->flowbit_failed = 1;
+            state.last_check.flowbit_failed = 1;
+            state.last_check.result = result;
+            return 0;
+        }
+
+        else if ( rval == DETECTION_OPTION_NO_ALERT )
+        {
+            tmp_noalert_flag = eval_data->flowbit_noalert;
+            eval_data->flowbit_noalert = 1;
+        }
+
+        for ( int i = 0; i < NUM_BYTE_EXTRACT_VARS; ++i )
+            GetByteExtractValue(&(tmp_byte_extract_vars[i]), (int8_t)i);
+
+        if ( PacketLatency::fastpath() )
+        {
+            profile.stop(result != DETECTION_OPTION_NO_MATCH);
+            state.last_check.result = result;
+            return result;
+        }
+
+        if ( node.num_children )
+        {
+            RulePause pause(profile);
+            unsigned end = node.first_child + node.num_children;
+
+            for ( unsigned i = node.first_child; i < end; ++i )
+            {
+                const dot_flat_node_t& child_node = tree->nodes[i];
+                dot_flat_state_t& child_state = hot[i];
+
+                for ( int j = 0; j < NUM_BYTE_EXTRACT_VARS; ++j )
+                    SetByteExtractValue(tmp_byte_extract_vars[j], (int8_t)j);
+
+                if ( loop_count > 0 )
+                {
+                    if ( child_state.result == DETECTION_OPTION_NO_MATCH )
+                    {
+                        if ( child_node.option_type == RULE_OPTION_TYPE_CONTENT and
+                             (!child_node.is_relative or (node.pmd and node.pmd->unbounded())) )
+                        {
+                            if ( loop_count == 1 )
+                                ++result;
+
+                            continue;
+                        }
+                    }
+
+                    else if ( child_node.op == DOT_OP_LEAF )
+                        continue;
+
+                    else if ( child_state.result == child_node.num_children )
+                        continue;
+                }
+
+                child_state.result = flat_node_evaluate(tree, hot, i, eval_data, cursor);
+
+                if ( child_node.op == DOT_OP_LEAF )
+                    result += child_state.result;
+
+                else if ( child_state.result == child_node.num_children )
+                    ++result;
+
+                if ( PacketLatency::fastpath() )
+                {
+                    state.last_check.result = result;
+                    return result;
+                }
+            }
+
+            if ( result == node.num_children )
+                continue_loop = false;
+        }
+
+        if ( rval == DETECTION_OPTION_NO_ALERT )
+            eval_data->flowbit_noalert = tmp_noalert_flag;
+
+        if ( continue_loop && rval == DETECTION_OPTION_MATCH && node.relative_children )
+            continue_loop = node.retry;
+        else
+            continue_loop = false;
+
+        if ( continue_loop )
+            node.node->state[get_instance_id()].checks++;
+
+        loop_count++;
+    }
+    while ( continue_loop );
+
+    if ( flowbits_setoperation && result == DETECTION_OPTION_MATCH )
+    {
+        rval = flowbits_option_eval(node.option_data, cursor, p);
+
+        if ( rval != DETECTION_OPTION_MATCH )
+            result = rval;
+    }
+
+    if ( eval_data->flowbit_failed )
+        state.last_check.flowbit_failed = 1;
+
+    state.last_check.result = result;
+
+    profile.stop(result != DETECTION_OPTION_NO_MATCH);
+
+    return result;
+}
+
+int detection_option_flat_evaluate(
+    dot_flat_tree_t* tree, detection_option_eval_data_t* eval_data, Cursor& cursor)
+{
+    if ( !eval_data || !eval_data->p || !eval_data->pomd )
+        return 0;
+
+    dot_flat_state_t* hot = tree->state + get_instance_id() * tree->num_nodes;
+    return flat_node_evaluate(tree, hot, 0, eval_data, cursor);
+}
+
+static dot_op_t get_flat_op(detection_option_tree_node_t* node)
+{
+    if ( node->option_type == RULE_OPTION_TYPE_LEAF_NODE )
+        return DOT_OP_LEAF;
+
+    // only options evaluated the usual way can be called directly
+    eval_func_t ips_eval = IpsOption::eval;
+
+    if ( node->evaluate != ips_eval )
+        return DOT_OP_OTHER;
+
+    const char* name = ((IpsOption*)node->option_data)->get_name();
+
+    if ( !strcmp(name, "content") )
+        return DOT_OP_CONTENT;
+
+    if ( !strcmp(name, "pcre") )
+        return DOT_OP_PCRE;
+
+    if ( !strcmp(name, "flowbits") )
+        return DOT_OP_FLOWBITS;
+
+    return DOT_OP_OTHER;
+}
+
+static dot_flat_tree_t* flatten_tree(detection_option_tree_node_t* root)
+{
+    std::vector<detection_option_tree_node_t*> order;
+    std::vector<unsigned> first;
+    order.push_back(root);
+
+    // breadth first so children are contiguous
+    for ( unsigned i = 0; i < order.size(); ++i )
+    {
+        detection_option_tree_node_t* node = order[i];
+        first.push_back(order.size());
+
+        for ( int j = 0; j < node->num_children; ++j )
+            order.push_back(node->children[j]);
+    }
+
+    dot_flat_tree_t* tree = (dot_flat_tree_t*)snort_calloc(sizeof(*tree));
+    tree->num_nodes = order.size();
+
+    tree->nodes = (dot_flat_node_t*)snort_calloc(tree->num_nodes, sizeof(*tree->nodes));
+
+    tree->state = (dot_flat_state_t*)snort_calloc(
+        tree->num_nodes * ThreadConfig::get_instance_max(), sizeof(*tree->state));
+
+    for ( unsigned i = 0; i < order.size(); ++i )
+    {
+        detection_option_tree_node_t* node = order[i];
+        dot_flat_node_t& fn = tree->nodes[i];
+
+        fn.option_data = node->option_data;
+        fn.evaluate = node->evaluate;
+        fn.node = node;
+
+        fn.first_child = first[i];
+        fn.num_children = node->num_children;
+        fn.op = get_flat_op(node);
+        fn.option_type = node->option_type;
+
+        fn.is_relative = node->is_relative;
+        fn.relative_children = node->relative_children;
+
+        if ( node->option_type != RULE_OPTION_TYPE_LEAF_NODE )
+        {
+            IpsOption* opt = (IpsOption*)node->option_data;
+            fn.retry = opt->retry();
+            fn.pmd = opt->get_pattern();
+        }
+    }
+    return tree;
+}
+
+static void free_flat_tree(dot_flat_tree_t* tree)
+{
+    snort_free(tree->nodes);
+    snort_free(tree->state);
+    snort_free(tree);
+}
+
+void detection_option_tree_flatten(SFXHASH* doth)
+{
+    if ( !doth )
+        return;
+
+    for ( auto hnode = sfxhash_findfirst(doth); hnode; hnode = sfxhash_findnext(doth) )
+    {
+        auto* node = (detection_option_tree_node_t*)hnode->data;
+
+        if ( !node->flat )
+            node->flat = flatten_tree(node);
+    }
+}
+
 struct node_profile_stats
 {
     // FIXIT-L duplicated from dot_node_state_t and OtnState
@@ -718,7 +1048,8 @@ struct node_profile_stats
 };
 
 static void detection_option_node_update_otn_stats(detection_option_tree_node_t* node,
-    node_profile_stats* stats, uint64_t checks, uint64_t timeouts, uint64_t suspends)
+    node_profile_stats* stats, uint64_t checks, uint64_t timeouts, uint64_t suspends,
+    uint64_t rejects)
 {
     node_profile_stats local_stats; /* cumulative stats for this node */
     node_profile_stats node_stats;  /* sum of all instances */
@@ -776,13 +1107,14 @@ static void detection_option_node_update_otn_stats(detection_option_tree_node_t*
 
         state.latency_timeouts += local_stats.latency_timeouts;
         state.latency_suspends += local_stats.latency_suspends;
+        state.rejects += rejects;
     }
 
     if ( node->num_children )
     {
         for ( int i=0; i < node->num_children; ++i )
             detection_option_node_update_otn_stats(node->children[i], &local_stats, checks,
-                timeouts, suspends);
+                timeouts, suspends, rejects);
     }
 }
 
@@ -799,19 +1131,82 @@ void detection_option_tree_update_otn_stats(SFXHASH* doth)
         uint64_t checks = 0;
         uint64_t timeouts = 0;
         uint64_t suspends = 0;
+        uint64_t rejects = 0;
 
         for ( unsigned i = 0; i < ThreadConfig::get_instance_max(); ++i )
         {
             checks += node->state[i].checks;
             timeouts += node->state[i].latency_timeouts;
             suspends += node->state[i].latency_suspends;
+            rejects += node->state[i].rejects;
         }
 
-        if ( checks )
-            detection_option_node_update_otn_stats(node, nullptr, checks, timeouts, suspends);
+        // rejects are only counted on root children and are charged to
+        // every rule under them
+        if ( checks or rejects )
+            detection_option_node_update_otn_stats(
+                node, nullptr, checks, timeouts, suspends, rejects);
     }
 }
 
+static uint32_t set_quick_reject_needs(detection_option_tree_node_t* node)
+{
+    uint32_t needs = 0;
+
+    if ( node->option_type == RULE_OPTION_TYPE_OTHER )
+        needs = FlowQuickRejectNeeds((IpsOption*)node->option_data);
+
+    // flowbits may set state before a later option fails so the needs of
+    // their children can't be hoisted above them
+    if ( node->num_children and node->option_type != RULE_OPTION_TYPE_FLOWBIT )
+    {
+        uint32_t all = ~0u;
+
+        for ( int i = 0; i < node->num_children; ++i )
+            all &= set_quick_reject_needs(node->children[i]);
+
+        needs |= all;
+    }
+    node->needs = needs;
+    return needs;
+}
+
+void set_quick_reject_needs(detection_option_tree_root_t* root)
+{
+    for ( int i = 0; i < root->num_children; ++i )
+        set_quick_reject_needs(root->children[i]);
+}
+
+// must agree with FlowCheckOption::eval()
+uint32_t get_quick_reject_bits(Packet* p)
+{
+    uint32_t bits = 0;
+
+    if ( p->packet_flags & PKT_STREAM_EST )
+        bits |= QR_ESTABLISHED;
+    else
+        bits |= QR_UNESTABLISHED;
+
+    if ( p->is_from_client() or !p->is_from_server() )
+        bits |= QR_CLIENT;
+
+    if ( p->is_from_server() or !p->is_from_client() )
+        bits |= QR_SERVER;
+
+    if ( !(p->packet_flags & PKT_REBUILT_STREAM) )
+        bits |= QR_NO_STREAM;
+
+    if ( p->packet_flags & PKT_REBUILT_FRAG )
+        bits |= QR_ONLY_FRAG;
+    else
+        bits |= QR_NO_FRAG;
+
+    if ( p->has_paf_payload() )
+        bits |= QR_ONLY_STREAM;
+
+    return bits;
+}
+
 
 detection_option_tree_root_t* new_root()
 {
@@ -862,6 +1257,10 @@ void free_detection_option_tree(detection_option_tree_node_t* node)
     }
     snort_free(node->children);
     snort_free(node->state);
+
+    if ( node->flat )
+        free_flat_tree(node->flat);
+
     snort_free(node);
 }
 
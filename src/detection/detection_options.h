@@ -44,20 +44,34 @@
 struct Packet;
 struct SFXHASH;
 
+// quick reject bits are cheap packet properties.  each tree node needs the
+// bits that must be set for any rule under it to match so a root child
+// can be skipped before any option is evaluated.
+#define QR_ESTABLISHED     0x01
+#define QR_UNESTABLISHED   0x02
+#define QR_CLIENT          0x04  // not only from server
+#define QR_SERVER          0x08  // not only from client
+#define QR_NO_STREAM       0x10  // not a rebuilt stream
+#define QR_NO_FRAG         0x20  // not a rebuilt frag
+#define QR_ONLY_STREAM     0x40  // has paf payload
+#define QR_ONLY_FRAG       0x80  // rebuilt frag
+
 typedef int (* eval_func_t)(void* option_data, class Cursor&, Packet*);
 
+struct dot_last_check_t
+{
+    struct timeval ts;
+    uint64_t packet_number;
+    uint32_t rebuild_flag;
+    char result;
+    char flowbit_failed;
+};
+
 // this is per packet thread
 struct dot_node_state_t
 {
     int result;
-    struct
-    {
-        struct timeval ts;
-        uint64_t packet_number;
-        uint32_t rebuild_flag;
-        char result;
-        char flowbit_failed;
-    } last_check;
+    dot_last_check_t last_check;
 
     // FIXIT-L perf profiler stuff should be factored of the node state struct
     hr_duration elapsed;
@@ -65,6 +79,7 @@ struct dot_node_state_t
     hr_duration elapsed_no_match;
     uint64_t checks;
     uint64_t disables;
+    uint64_t rejects;
 
     unsigned latency_timeouts;
     unsigned latency_suspends;
@@ -93,6 +108,55 @@ struct detection_option_tree_node_t
     option_type_t option_type;
     detection_option_tree_node_t** children;
     dot_node_state_t* state;
+    uint32_t needs;
+    struct dot_flat_tree_t* flat;
+};
+
+// a flat tree is a breadth first copy of a root child subtree so each
+// node's children are a contiguous index range.  the hot per thread eval
+// state is kept apart from the profiling state, which stays with the
+// original nodes.  common options are dispatched directly instead of
+// through the function pointer and virtual eval.
+enum dot_op_t : uint8_t
+{
+    DOT_OP_LEAF,
+    DOT_OP_CONTENT,
+    DOT_OP_PCRE,
+    DOT_OP_FLOWBITS,
+    DOT_OP_OTHER
+};
+
+struct dot_flat_node_t
+{
+    void* option_data;
+    eval_func_t evaluate;
+    struct PatternMatchData* pmd;
+    detection_option_tree_node_t* node;
+
+    // same type as detection_option_tree_node_t::num_children so the
+    // child counts compared with results can't be truncated
+    uint32_t first_child;
+    int num_children;
+    uint8_t op;
+    uint8_t option_type;
+
+    bool is_relative;
+    bool relative_children;
+    bool retry;
+};
+
+// this is per packet thread
+struct dot_flat_state_t
+{
+    int result;
+    dot_last_check_t last_check;
+};
+
+struct dot_flat_tree_t
+{
+    unsigned num_nodes;
+    dot_flat_node_t* nodes;
+    dot_flat_state_t* state;  // num_nodes per packet thread
 };
 
 struct detection_option_tree_root_t
@@ -118,6 +182,11 @@ void* add_detection_option_tree(struct SnortConfig*, detection_option_tree_node_
 int detection_option_node_evaluate(
     detection_option_tree_node_t*, detection_option_eval_data_t*, class Cursor&);
 
+int detection_option_flat_evaluate(
+    dot_flat_tree_t*, detection_option_eval_data_t*, class Cursor&);
+
+void detection_option_tree_flatten(SFXHASH*);
+
 void DetectionHashTableFree(SFXHASH*);
 void DetectionTreeHashTableFree(SFXHASH*);
 
@@ -126,6 +195,9 @@ void print_option_tree(detection_option_tree_node_t*, int level);
 #endif
 void detection_option_tree_update_otn_stats(SFXHASH*);
 
+void set_quick_reject_needs(detection_option_tree_root_t*);
+uint32_t get_quick_reject_bits(Packet*);
+
 detection_option_tree_root_t* new_root();
 void free_detection_option_root(void** existing_tree);
 
@@ -33,6 +33,7 @@
 #include "framework/mpse.h"
 #include "managers/mpse_manager.h"
 #include "log/messages.h"
+#include "utils/util.h"
 
 FastPatternConfig::FastPatternConfig()
 {
@@ -41,6 +42,9 @@ FastPatternConfig::FastPatternConfig()
     inspect_stream_insert = false;
     max_queue_events = 5;
     bleedover_port_limit = 1024;
+    teddy_max_patterns = 0;
+    stream_file_data_memcap = 8388608;
+    cache_max_size = 268435456;
 
     search_api = MpseManager::get_search_api("ac_bnfa");
     assert(search_api);
@@ -48,7 +52,18 @@ FastPatternConfig::FastPatternConfig()
 }
 
 FastPatternConfig::~FastPatternConfig()
-{ }
+{
+    if ( cache_dir )
+        snort_free(cache_dir);
+}
+
+void FastPatternConfig::set_cache_dir(const char* dir)
+{
+    if ( cache_dir )
+        snort_free(cache_dir);
+
+    cache_dir = (dir and *dir) ? snort_strdup(dir) : nullptr;
+}
 
 bool FastPatternConfig::set_detect_search_method(const char* method)
 {
@@ -52,6 +52,47 @@ public:
     bool get_stream_insert()
     { return inspect_stream_insert; }
 
+    void set_stream_file_data(bool enable)
+    { stream_file_data = enable; }
+
+    bool get_stream_file_data()
+    { return stream_file_data; }
+
+    void set_stream_file_data_memcap(unsigned long n)
+    { stream_file_data_memcap = n; }
+
+    unsigned long get_stream_file_data_memcap()
+    { return stream_file_data_memcap; }
+
+    void set_compile_threads(unsigned n)
+    { compile_threads = n; }
+
+    unsigned get_compile_threads()
+    { return compile_threads; }
+
+    void set_flat_option_trees(bool enable)
+    { flat_option_trees = enable; }
+
+    bool get_flat_option_trees()
+    { return flat_option_trees; }
+
+    void set_teddy_max_patterns(unsigned n)
+    { teddy_max_patterns = n; }
+
+    unsigned get_teddy_max_patterns()
+    { return teddy_max_patterns; }
+
+    void set_cache_dir(const char*);
+
+    const char* get_cache_dir()
+    { return cache_dir; }
+
+    void set_cache_max_size(unsigned long n)
+    { cache_max_size = n; }
+
+    unsigned long get_cache_max_size()
+    { return cache_max_size; }
+
     void set_max_queue_events(unsigned int num_events)
     { max_queue_events = num_events; }
 
@@ -143,15 +184,22 @@ public:
 
 private:
     const struct MpseApi* search_api;
+    char* cache_dir;
 
     bool inspect_stream_insert;
+    bool stream_file_data;
+    bool flat_option_trees;
     bool trim;
     bool split_any_any;
     bool debug_print_fast_pattern;
     bool debug;
 
     unsigned max_queue_events;
+    unsigned compile_threads;
+    unsigned teddy_max_patterns;
     unsigned bleedover_port_limit;
+    unsigned long stream_file_data_memcap;
+    unsigned long cache_max_size;
 
     int search_opt;
     int portlists_flags;
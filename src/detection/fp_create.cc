@@ -39,6 +39,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
 #include "main/snort_config.h"
 #include "hash/sfghash.h"
 #include "ips_options/ips_flow.h"
@@ -54,6 +64,7 @@
 #include "framework/ips_option.h"
 #include "managers/mpse_manager.h"
 #include "target_based/snort_protocols.h"
+#include "time/clock_defs.h"
 
 #include "fp_config.h"
 #include "service_map.h"
@@ -67,6 +78,137 @@
 
 static unsigned mpse_count = 0;
 
+// port group mpse are compiled after all groups are built so that the
+// compiles can be spread across threads; see fp_compile_mpse()
+struct MpseCompile
+{
+    Mpse* mpse;
+    int status;
+    hr_duration time;
+};
+
+static std::vector<MpseCompile> s_compiles;
+
+// port groups with identical fast pattern sets share one mpse.  the set
+// is identified by the pm type and the pattern, flags, and rule of each
+// entry.  rules in the user trees are the same so matches are evaluated
+// the same no matter which group selected the mpse.  the pmx is carried
+// along so the patterns can be added once the engine is chosen but it is
+// not part of the signature.
+struct MpseEntry
+{
+    std::string pattern;
+    unsigned flags;
+    const OptTreeNode* otn;
+    PMX* pmx;
+
+    bool operator<(const MpseEntry& rhs) const
+    { return std::tie(pattern, flags, otn) < std::tie(rhs.pattern, rhs.flags, rhs.otn); }
+
+    bool operator==(const MpseEntry& rhs) const
+    { return pattern == rhs.pattern and flags == rhs.flags and otn == rhs.otn; }
+};
+
+struct MpseSignature
+{
+    unsigned type;
+    std::vector<MpseEntry> entries;
+
+    bool operator==(const MpseSignature& rhs) const
+    { return type == rhs.type and entries == rhs.entries; }
+
+    size_t hash() const;
+};
+
+size_t MpseSignature::hash() const
+{
+    std::hash<std::string> hs;
+    size_t h = type;
+
+    for ( auto& e : entries )
+    {
+        h = h * 31 + hs(e.pattern);
+        h = h * 31 + e.flags;
+        h = h * 31 + std::hash<const void*>()(e.otn);
+    }
+    return h;
+}
+
+// signatures are only kept while building; refs are kept until the port
+// groups are deleted (possibly after a reload has built new ones)
+static std::unordered_map<Mpse*, MpseSignature> s_signatures;
+static std::unordered_multimap<size_t, Mpse*> s_unique;
+static std::unordered_map<Mpse*, unsigned> s_mpse_refs;
+
+static unsigned s_mpse_groups = 0;
+static unsigned s_mpse_shared = 0;
+static uint64_t s_patterns_saved = 0;
+
+// if enabled, small groups of plain literals are searched with teddy
+// instead of the configured engine.  teddy buckets on the first 3 bytes so
+// a group with any shorter pattern keeps the configured engine.
+#define TEDDY_MIN_PATTERN 3
+
+static const MpseApi* s_teddy_api = nullptr;
+static unsigned s_teddy_count = 0;
+
+static void fp_add_entry(
+    Mpse* mpse, unsigned type, const char* pat, int len, PMX* pmx, OptTreeNode* otn)
+{
+    MpseSignature& sig = s_signatures[mpse];
+    sig.type = type;
+
+    PatternMatchData* pmd = pmx->pmd;
+    unsigned flags = (pmd->no_case ? 1 : 0) | (pmd->negated ? 2 : 0) | (pmd->literal ? 4 : 0);
+    sig.entries.push_back({ std::string(pat, len), flags, otn, pmx });
+}
+
+// returns the mpse to use for the group; if an identical one exists this
+// one is deleted
+static Mpse* fp_share_mpse(Mpse* mpse)
+{
+    MpseSignature& sig = s_signatures[mpse];
+    std::sort(sig.entries.begin(), sig.entries.end());
+
+    size_t h = sig.hash();
+    auto range = s_unique.equal_range(h);
+    ++s_mpse_groups;
+
+    for ( auto it = range.first; it != range.second; ++it )
+    {
+        if ( s_signatures[it->second] == sig )
+        {
+            ++s_mpse_refs[it->second];
+            ++s_mpse_shared;
+            s_patterns_saved += sig.entries.size();
+
+            s_signatures.erase(mpse);
+            MpseManager::delete_search_engine(mpse);
+            mpse_count--;
+            return it->second;
+        }
+    }
+
+    s_unique.insert(std::make_pair(h, mpse));
+    s_mpse_refs[mpse] = 1;
+    s_compiles.push_back({ mpse, 0, hr_duration::zero() });
+    return mpse;
+}
+
+static void fp_release_mpse(Mpse* mpse)
+{
+    auto it = s_mpse_refs.find(mpse);
+
+    if ( it != s_mpse_refs.end() )
+    {
+        if ( --it->second )
+            return;
+
+        s_mpse_refs.erase(it);
+    }
+    MpseManager::delete_search_engine(mpse);
+}
+
 static void fpDeletePMX(void* data);
 
 static int fpGetFinalPattern(
@@ -99,7 +241,7 @@ static int finalize_detection_option_tree(SnortConfig* sc, detection_option_tree
         print_option_tree(root->children[i], 0);
 #endif
     }
-
+    set_quick_reject_needs(root);
     return 0;
 }
 
@@ -550,6 +692,12 @@ static PatternMatchData* get_fp_content(OptTreeNode* otn, OptFpList*& next)
     return nullptr;
 }
 
+static MpseAgent s_agent =
+{
+      pmx_create_tree, add_patrn_to_neg_list,
+      fpDeletePMX, free_detection_option_root, neg_list_free
+};
+
 static int fpFinishPortGroupRule(
     SnortConfig* sc, PortGroup* pg,
     OptTreeNode* otn, PatternMatchData* pmd, FastPatternConfig* fp)
@@ -583,14 +731,8 @@ static int fpFinishPortGroupRule(
 
         if ( !pg->mpse[pmd->pm_type] )
         {
-            static MpseAgent agent =
-            {
-                  pmx_create_tree, add_patrn_to_neg_list,
-                  fpDeletePMX, free_detection_option_root, neg_list_free
-            };
-
             pg->mpse[pmd->pm_type] = MpseManager::get_search_engine(
-                sc, fp->get_search_api(), true, &agent);
+                sc, fp->get_search_api(), true, &s_agent);
 
             if ( !pg->mpse[pmd->pm_type] )
             {
@@ -601,15 +743,60 @@ static int fpFinishPortGroupRule(
 
             if ( fp->get_search_opt() )
                 pg->mpse[pmd->pm_type]->set_opt(1);
+
+            if ( pmd->pm_type == PM_TYPE_FILE and fp->get_stream_file_data() )
+                pg->mpse[pmd->pm_type]->set_stream(true);
         }
 
-        Mpse::PatternDescriptor desc(pmd->no_case, pmd->negated, pmd->literal);
-        pg->mpse[pmd->pm_type]->add_pattern(sc, (uint8_t*)pattern, pattern_length, desc, pmx);
+        // patterns are added by fp_load_mpse()
+        fp_add_entry(pg->mpse[pmd->pm_type], pmd->pm_type, pattern, pattern_length, pmx, otn);
     }
 
     return 0;
 }
 
+static bool fp_use_teddy(const MpseSignature& sig, FastPatternConfig* fp)
+{
+    if ( !s_teddy_api or sig.entries.size() > fp->get_teddy_max_patterns() )
+        return false;
+
+    if ( sig.type == PM_TYPE_FILE and fp->get_stream_file_data() )
+        return false;
+
+    for ( auto& e : sig.entries )
+    {
+        if ( !e.pmx->pmd->literal or e.pattern.size() < TEDDY_MIN_PATTERN )
+            return false;
+    }
+    return true;
+}
+
+// the engine is chosen once all the patterns for the group are known;
+// they are added in rule order so the result is the same as before
+static Mpse* fp_load_mpse(SnortConfig* sc, Mpse* mpse, FastPatternConfig* fp)
+{
+    if ( fp_use_teddy(s_signatures[mpse], fp) )
+    {
+        Mpse* ted = MpseManager::get_search_engine(sc, s_teddy_api, true, &s_agent);
+        MpseSignature sig = std::move(s_signatures[mpse]);
+
+        s_signatures.erase(mpse);
+        MpseManager::delete_search_engine(mpse);
+
+        mpse = ted;
+        s_signatures[mpse] = std::move(sig);
+        ++s_teddy_count;
+    }
+
+    for ( auto& e : s_signatures[mpse].entries )
+    {
+        PatternMatchData* pmd = e.pmx->pmd;
+        Mpse::PatternDescriptor desc(pmd->no_case, pmd->negated, pmd->literal);
+        mpse->add_pattern(sc, (const uint8_t*)e.pattern.c_str(), e.pattern.size(), desc, e.pmx);
+    }
+    return mpse;
+}
+
 static int fpFinishPortGroup(
     SnortConfig* sc, PortGroup* pg, FastPatternConfig* fp)
 {
@@ -623,19 +810,15 @@ static int fpFinishPortGroup(
     {
         if (pg->mpse[i] != NULL)
         {
-            if (pg->mpse[i]->get_pattern_count() != 0)
+            if ( !s_signatures[pg->mpse[i]].entries.empty() )
             {
-                if (pg->mpse[i]->prep_patterns(sc) != 0)
-                {
-                    FatalError("Failed to compile port group patterns.\n");
-                }
-
-                if (fp->get_debug_mode())
-                    pg->mpse[i]->print_info();
+                pg->mpse[i] = fp_load_mpse(sc, pg->mpse[i], fp);
+                pg->mpse[i] = fp_share_mpse(pg->mpse[i]);
                 rules = 1;
             }
             else
             {
+                s_signatures.erase(pg->mpse[i]);
                 MpseManager::delete_search_engine(pg->mpse[i]);
                 pg->mpse[i] = NULL;
             }
@@ -1040,7 +1223,7 @@ void fpDeletePortGroup(void* data)
     {
         if (pg->mpse[i] != NULL)
         {
-            MpseManager::delete_search_engine(pg->mpse[i]);
+            fp_release_mpse(pg->mpse[i]);
             pg->mpse[i] = NULL;
         }
     }
@@ -1710,6 +1893,99 @@ static int fpCreateServicePortGroups(SnortConfig* sc)
 *  Build Pattern Groups for 1st pass of content searching using
 *  multi-pattern search method.
 */
+static void fp_compile_worker(SnortConfig* sc, std::atomic<unsigned>* next)
+{
+    unsigned idx;
+
+    while ( (idx = (*next)++) < s_compiles.size() )
+    {
+        MpseCompile& c = s_compiles[idx];
+        hr_time start = hr_clock::now();
+        c.status = c.mpse->compile(sc);
+        c.time = hr_clock::now() - start;
+    }
+}
+
+// compile() runs in parallel but finish() runs in the original port group
+// order so the resulting detection option trees are the same as with a
+// serial build regardless of the number of threads.
+static void fp_compile_mpse(SnortConfig* sc, FastPatternConfig* fp)
+{
+    unsigned threads = fp->get_compile_threads();
+
+    if ( threads > s_compiles.size() )
+        threads = s_compiles.size();
+
+    hr_time start = hr_clock::now();
+    std::atomic<unsigned> next(0);
+
+    if ( threads < 2 )
+        fp_compile_worker(sc, &next);
+
+    else
+    {
+        std::vector<std::thread> workers;
+
+        for ( unsigned i = 0; i < threads; ++i )
+            workers.emplace_back(fp_compile_worker, sc, &next);
+
+        for ( auto& w : workers )
+            w.join();
+    }
+
+    std::map<std::string, hr_duration> times;
+
+    for ( auto& c : s_compiles )
+    {
+        if ( c.status or c.mpse->finish(sc) )
+            FatalError("Failed to compile port group patterns.\n");
+
+        if ( fp->get_debug_mode() )
+            c.mpse->print_info();
+
+        times[c.mpse->get_method()] += c.time;
+    }
+
+    hr_duration wall = hr_clock::now() - start;
+
+    if ( !s_compiles.empty() )
+    {
+        using std::chrono::duration_cast;
+        using std::chrono::milliseconds;
+
+        LogLabel("search engine compile");
+        LogCount("instances", s_compiles.size());
+        LogCount("threads", threads ? threads : 1);
+
+        for ( auto& t : times )
+        {
+            LogMessage("%25.25s: %-12lu\n", (t.first + " msec").c_str(),
+                (unsigned long)duration_cast<milliseconds>(t.second).count());
+        }
+        LogMessage("%25.25s: %-12lu\n", "wall msec",
+            (unsigned long)duration_cast<milliseconds>(wall).count());
+    }
+    s_compiles.clear();
+}
+
+static void fp_print_mpse_sharing()
+{
+    if ( s_mpse_shared )
+    {
+        LogLabel("search engine sharing");
+        LogCount("port group mpse", s_mpse_groups);
+        LogCount("unique mpse", s_mpse_groups - s_mpse_shared);
+        LogCount("shared mpse", s_mpse_shared);
+        LogCount("patterns saved", s_patterns_saved);
+        LogMessage("%25.25s: %.2f\n", "share ratio",
+            (double)s_mpse_groups / (s_mpse_groups - s_mpse_shared));
+    }
+    s_signatures.clear();
+    s_unique.clear();
+    s_mpse_groups = s_mpse_shared = 0;
+    s_patterns_saved = 0;
+}
+
 int fpCreateFastPacketDetection(SnortConfig* sc)
 {
     assert(sc);
@@ -1727,6 +2003,13 @@ int fpCreateFastPacketDetection(SnortConfig* sc)
     }
 
     mpse_count = 0;
+    s_teddy_count = 0;
+
+    // hyperscan does its own small group literal matching
+    if ( fp->get_teddy_max_patterns() and strcmp(fp->get_search_api()->base.name, "hyperscan") )
+        s_teddy_api = MpseManager::get_search_api("teddy");
+    else
+        s_teddy_api = nullptr;
 
     MpseManager::start_search_engine(fp->get_search_api());
 
@@ -1764,6 +2047,9 @@ int fpCreateFastPacketDetection(SnortConfig* sc)
     if (fp->get_debug_print_rule_group_build_details())
         LogMessage("Service Based Rule Maps Done....\n");
 
+    fp_print_mpse_sharing();
+    fp_compile_mpse(sc, fp);
+
     fp_print_port_groups(port_tables);
     fp_print_service_groups(sc->spgmmTable);
 
@@ -1773,6 +2059,12 @@ int fpCreateFastPacketDetection(SnortConfig* sc)
         MpseManager::print_mpse_summary(fp->get_search_api());
     }
 
+    if ( s_teddy_count )
+    {
+        LogLabel("teddy");
+        MpseManager::print_mpse_summary(s_teddy_api);
+    }
+
     if ( fp->get_num_patterns_truncated() )
         LogMessage("%25.25s: %-12u\n", "truncated patterns", fp->get_num_patterns_truncated());
 
@@ -1781,6 +2073,9 @@ int fpCreateFastPacketDetection(SnortConfig* sc)
 
     MpseManager::setup_search_engine(fp->get_search_api(), sc);
 
+    if ( fp->get_flat_option_trees() )
+        detection_option_tree_flatten(sc->detection_option_tree_hash_table);
+
     return 0;
 }
 
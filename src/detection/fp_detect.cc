@@ -40,6 +40,7 @@
 #include "config.h"
 #endif
 
+#include <string.h>
 #include <strings.h>
 
 #include "detect.h"
@@ -396,16 +397,43 @@ static int detection_option_tree_evaluate(detection_option_tree_root_t* root,
 
     RuleLatency::Context rule_latency_ctx(root);
 
+    // suspended rules aren't evaluated so they aren't counted as rejects
     if ( RuleLatency::suspended() )
         return 0;
 
+    uint32_t have = get_quick_reject_bits(eval_data->p);
+    unsigned rejects = 0;
+
+    for ( int i = 0; i < root->num_children; ++i )
+    {
+        if ( root->children[i]->needs & ~have )
+        {
+            root->children[i]->state[get_instance_id()].rejects++;
+            ++rejects;
+        }
+    }
+
+    if ( rejects == (unsigned)root->num_children )
+    {
+        pmqs.quick_rejects++;
+        return 0;
+    }
+
     Cursor c(eval_data->p);
     int rval = 0;
 
     for ( int i = 0; i < root->num_children; ++i )
     {
+        if ( root->children[i]->needs & ~have )
+            continue;
+
+        detection_option_tree_node_t* child = root->children[i];
+
         // Increment number of events generated from that child 
-        rval += detection_option_node_evaluate(root->children[i], eval_data, c);
+        if ( child->flat )
+            rval += detection_option_flat_evaluate(child->flat, eval_data, c);
+        else
+            rval += detection_option_node_evaluate(child, eval_data, c);
     }
 
     return rval;
@@ -905,15 +933,82 @@ static int rule_tree_queue(
     return 0;
 }
 
+// all buffers searched for a packet feed the same stash which is processed
+// once by fp_search() so a rule tree matched by more than one buffer is
+// evaluated just once.  rule evaluation gets its buffers from the cursor,
+// not from the buffer that matched.
 #define SEARCH_DATA(buf, len, cnt) \
     { \
         assert(so->get_pattern_count() > 0); \
         int start_state = 0; \
         cnt++; \
-        omd->data = buf; omd->size = len; \
-        stash.init(); \
         so->search(buf, len, rule_tree_queue, omd, &start_state); \
-        stash.process(rule_tree_match, omd); \
+        if ( PacketLatency::fastpath() ) \
+            return 1; \
+    }
+
+// file_data may be searched as a stream per flow direction so that fast
+// patterns split across file segments are still found.  the stream is
+// reset if the port group mpse changes, including on reload.  mpse are
+// matched by id since a freed mpse's address can be reused by a new one.
+
+class FileStreamData : public FlowData
+{
+public:
+    FileStreamData() : FlowData(flow_id)
+    { memset(dir, 0, sizeof(dir)); }
+
+    ~FileStreamData()
+    {
+        for ( auto& d : dir )
+            delete d.stream;
+    }
+
+    MpseStream*& get_stream(const Mpse*, bool c2s);
+
+    static unsigned flow_id;
+
+private:
+    struct
+    {
+        uint64_t mpse_id;
+        MpseStream* stream;
+    } dir[2];
+};
+
+unsigned FileStreamData::flow_id = FlowData::get_flow_id();
+
+MpseStream*& FileStreamData::get_stream(const Mpse* so, bool c2s)
+{
+    auto& d = dir[c2s ? 0 : 1];
+
+    if ( d.mpse_id != so->get_id() )
+    {
+        delete d.stream;
+        d.stream = nullptr;
+        d.mpse_id = so->get_id();
+    }
+    return d.stream;
+}
+
+static MpseStream*& get_file_stream(Packet* p, Mpse* so)
+{
+    FileStreamData* fsd =
+        (FileStreamData*)p->flow->get_application_data(FileStreamData::flow_id);
+
+    if ( !fsd )
+    {
+        fsd = new FileStreamData;
+        p->flow->set_application_data(fsd);
+    }
+    return fsd->get_stream(so, p->is_from_client());
+}
+
+#define SEARCH_STREAM(buf, len, cnt) \
+    { \
+        assert(so->get_pattern_count() > 0); \
+        cnt++; \
+        so->search_stream(get_file_stream(p, so), buf, len, rule_tree_queue, omd); \
         if ( PacketLatency::fastpath() ) \
             return 1; \
     }
@@ -925,17 +1020,12 @@ static int rule_tree_queue(
             SEARCH_DATA(buf.data, buf.len, cnt) \
     }
 
-static int fp_search(
-    PortGroup* port_group, Packet* p,
-    int check_ports, int type, OTNX_MATCH_DATA* omd)
+static int fp_search_buffers(
+    PortGroup* port_group, Packet* p, int type, OTNX_MATCH_DATA* omd)
 {
     Inspector* gadget = p->flow ? p->flow->gadget : nullptr;
     InspectionBuffer buf;
 
-    omd->pg = port_group;
-    omd->p = p;
-    omd->check_ports = check_ports;
-
     bool user_mode = snort_conf->sopgTable->user_mode;
 
     if ( (!user_mode or type < 2) and p->data and p->dsize )
@@ -977,12 +1067,32 @@ static int fp_search(
             // FIXIT-M file data should be obtained from
             // inspector gadget as is done with SEARCH_BUFFER
             if ( g_file_data.len )
-                SEARCH_DATA(g_file_data.data, g_file_data.len, pc.file_searches);
+            {
+                if ( p->flow and so->can_stream() )
+                    SEARCH_STREAM(g_file_data.data, g_file_data.len, pc.file_searches)
+                else
+                    SEARCH_DATA(g_file_data.data, g_file_data.len, pc.file_searches)
+            }
         }
     }
     return 0;
 }
 
+static int fp_search(
+    PortGroup* port_group, Packet* p,
+    int check_ports, int type, OTNX_MATCH_DATA* omd)
+{
+    omd->pg = port_group;
+    omd->p = p;
+    omd->check_ports = check_ports;
+
+    stash.init();
+    int ret = fp_search_buffers(port_group, p, type, omd);
+    stash.process(rule_tree_match, omd);
+
+    return ret;
+}
+
 /*
 **
 **  NAME
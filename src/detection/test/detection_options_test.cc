@@ -0,0 +1,483 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// detection_options_test.cc
+// runs the pointer and flat tree evaluators on the same trees and packets
+// and checks that they return the same results, evaluate the same options
+// at the same offsets, and match the same rules
+
+#include "detection/detection_options.h"
+
+#include <random>
+#include <vector>
+
+#include "detection/detection_defines.h"
+#include "detection/fp_detect.h"
+#include "detection/pattern_match_data.h"
+#include "detection/treenodes.h"
+#include "filters/detection_filter.h"
+#include "framework/cursor.h"
+#include "framework/ips_option.h"
+#include "hash/sfxhash.h"
+#include "ips_options/ips_byte_extract.h"
+#include "ips_options/ips_content.h"
+#include "ips_options/ips_flow.h"
+#include "ips_options/ips_flowbits.h"
+#include "ips_options/ips_pcre.h"
+#include "latency/packet_latency.h"
+#include "main/policy.h"
+#include "main/thread_config.h"
+#include "managers/ips_manager.h"
+#include "profiler/rule_profiler_defs.h"
+#include "protocols/packet.h"
+#include "protocols/packet_manager.h"
+#include "utils/util.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+//-------------------------------------------------------------------------
+// stubs, spies, etc.
+//-------------------------------------------------------------------------
+
+THREAD_LOCAL uint64_t rule_eval_pkt_count = 0;
+
+unsigned get_instance_id()
+{ return 0; }
+
+unsigned ThreadConfig::get_instance_max()
+{ return 1; }
+
+uint64_t PacketManager::get_rebuilt_packet_count()
+{ return 0; }
+
+bool PacketLatency::fastpath()
+{ return false; }
+
+void RuleContext::stop(bool) { }
+
+Cursor::Cursor(Packet*) { }
+
+Cursor::Cursor(const Cursor& c)
+{ memcpy(this, &c, sizeof(*this)); }
+
+void mix_str(uint32_t& a, uint32_t&, uint32_t&, const char* s, unsigned)
+{ a += strlen(s); }
+
+void FatalError(const char*, ...) { abort(); }
+
+#ifdef DEBUG_MSGS
+void Debug::print(const char*, int, uint64_t, const char*, ...) { }
+#endif
+
+// zeroed so policy_id is 0
+static uint8_t s_policy[sizeof(IpsPolicy)];
+
+IpsPolicy* get_ips_policy()
+{ return (IpsPolicy*)s_policy; }
+
+int detection_filter_test(void*, const sfip_t*, const sfip_t*, long)
+{ return 1; }
+
+int GetByteExtractValue(uint32_t*, int8_t)
+{ return 0; }
+
+int SetByteExtractValue(uint32_t, int8_t)
+{ return 0; }
+
+int content_option_eval(void*, Cursor&, Packet*)
+{ return DETECTION_OPTION_NO_MATCH; }
+
+int pcre_option_eval(void*, Cursor&, Packet*)
+{ return DETECTION_OPTION_NO_MATCH; }
+
+int flowbits_option_eval(void*, Cursor&, Packet*)
+{ return DETECTION_OPTION_NO_MATCH; }
+
+int FlowBits_SetOperation(void*)
+{ return 0; }
+
+uint32_t FlowQuickRejectNeeds(IpsOption*)
+{ return 0; }
+
+void IpsManager::delete_option(IpsOption*) { }
+
+SFXHASH* sfxhash_new(int, int, int, unsigned long, int,
+    int (*)(void*, void*), int (*)(void*, void*), int)
+{ return nullptr; }
+
+void sfxhash_delete(SFXHASH*) { }
+
+int sfxhash_add(SFXHASH*, void*, void*)
+{ return 0; }
+
+void* sfxhash_find(SFXHASH*, void*)
+{ return nullptr; }
+
+int sfxhash_set_keyops(SFXHASH*, unsigned (*)(SFHASHFCN*, unsigned char*, int),
+    int (*)(const void*, const void*, size_t))
+{ return 0; }
+
+// the tree hash is just the list of trees to flatten
+static std::vector<SFXHASH_NODE> s_trees;
+static unsigned s_next_tree = 0;
+
+SFXHASH_NODE* sfxhash_findfirst(SFXHASH*)
+{
+    s_next_tree = 0;
+    return s_trees.empty() ? nullptr : &s_trees[s_next_tree++];
+}
+
+SFXHASH_NODE* sfxhash_findnext(SFXHASH*)
+{ return s_next_tree < s_trees.size() ? &s_trees[s_next_tree++] : nullptr; }
+
+// every rule header matches and each rule match is recorded
+static std::vector<const OptTreeNode*> s_matches;
+
+int fpEvalRTN(RuleTreeNode* rtn, Packet*, int)
+{ return rtn ? 1 : 0; }
+
+int fpAddMatch(OTNX_MATCH_DATA*, int, const OptTreeNode* otn)
+{
+    s_matches.push_back(otn);
+    return 0;
+}
+
+//-------------------------------------------------------------------------
+// trees
+//-------------------------------------------------------------------------
+
+// each option evaluation is recorded as id and cursor position
+static std::vector<unsigned> s_evals;
+
+// a content like option that searches for one byte, absolute or relative
+// to the cursor, and resumes after its last match when retried.  the
+// evaluators only look at the pattern's depth.
+class TestOption : public IpsOption
+{
+public:
+    TestOption(unsigned n, uint8_t b, bool r, bool t, unsigned depth) :
+        IpsOption("test"), id(n), byte(b), rel(r), again(t)
+    {
+        memset(&pmd, 0, sizeof(pmd));
+        pmd.depth = depth;
+    }
+
+    PatternMatchData* get_pattern() override
+    { return &pmd; }
+
+    bool is_relative() override
+    { return rel; }
+
+    bool retry() override
+    { return again; }
+
+    int eval(Cursor& c, Packet*) override
+    {
+        s_evals.push_back((id << 16) | c.get_pos());
+        unsigned start = std::max(rel ? c.get_pos() : 0, c.get_delta());
+
+        for ( unsigned i = start; i < c.size(); ++i )
+        {
+            if ( c.buffer()[i] == byte )
+            {
+                c.set_pos(i + 1);
+                c.set_delta(i + 1);
+                return DETECTION_OPTION_MATCH;
+            }
+        }
+        return DETECTION_OPTION_NO_MATCH;
+    }
+
+private:
+    PatternMatchData pmd;
+    unsigned id;
+    uint8_t byte;
+    bool rel;
+    bool again;
+};
+
+static std::vector<detection_option_tree_node_t*> s_nodes;
+static std::vector<OptTreeNode*> s_otns;
+static std::vector<IpsOption*> s_opts;
+static uint8_t s_rtn[sizeof(RuleTreeNode)];
+static RuleTreeNode* s_rtn_ptr = (RuleTreeNode*)s_rtn;
+static SFXHASH s_hash;
+
+static detection_option_tree_node_t* new_node(option_type_t type, void* data, int children)
+{
+    auto node = (detection_option_tree_node_t*)snort_calloc(sizeof(detection_option_tree_node_t));
+    node->option_type = type;
+    node->option_data = data;
+    node->num_children = children;
+
+    if ( children )
+        node->children = (detection_option_tree_node_t**)snort_calloc(
+            children, sizeof(*node->children));
+
+    node->state = (dot_node_state_t*)snort_calloc(sizeof(dot_node_state_t));
+    s_nodes.push_back(node);
+    return node;
+}
+
+static detection_option_tree_node_t* new_leaf()
+{
+    auto otn = (OptTreeNode*)snort_calloc(sizeof(OptTreeNode));
+    otn->state = (OtnState*)snort_calloc(sizeof(OtnState));
+    otn->proto_nodes = &s_rtn_ptr;
+    otn->proto_node_num = 1;
+    s_otns.push_back(otn);
+
+    return new_node(RULE_OPTION_TYPE_LEAF_NODE, otn, 0);
+}
+
+static detection_option_tree_node_t* new_option(
+    uint8_t b, bool rel, bool retry, int children, unsigned depth = 0)
+{
+    auto opt = new TestOption(s_opts.size(), b, rel, retry, depth);
+    s_opts.push_back(opt);
+
+    auto node = new_node(RULE_OPTION_TYPE_CONTENT, opt, children);
+    node->evaluate = IpsOption::eval;
+    node->is_relative = rel;
+    return node;
+}
+
+static detection_option_tree_node_t* random_tree(std::mt19937& rng, unsigned depth)
+{
+    if ( !depth or !(rng() % 5) )
+        return new_leaf();
+
+    int n = 1 + rng() % 3;
+    auto node = new_option('a' + rng() % 4, rng() % 2, rng() % 4, n, rng() % 2);
+
+    for ( int i = 0; i < n; ++i )
+    {
+        node->children[i] = random_tree(rng, depth - 1);
+
+        if ( node->children[i]->is_relative )
+            node->relative_children++;
+    }
+    return node;
+}
+
+static void flatten(detection_option_tree_node_t* root)
+{
+    SFXHASH_NODE hn;
+    memset(&hn, 0, sizeof(hn));
+    hn.data = root;
+
+    s_trees.clear();
+    s_trees.push_back(hn);
+
+    detection_option_tree_flatten(&s_hash);
+    CHECK(root->flat);
+}
+
+static void free_trees()
+{
+    for ( auto node : s_nodes )
+    {
+        if ( node->flat )
+        {
+            snort_free(node->flat->nodes);
+            snort_free(node->flat->state);
+            snort_free(node->flat);
+        }
+        snort_free(node->children);
+        snort_free(node->state);
+        snort_free(node);
+    }
+    for ( auto otn : s_otns )
+    {
+        snort_free(otn->state);
+        snort_free(otn);
+    }
+    for ( auto opt : s_opts )
+        delete opt;
+
+    s_nodes.clear();
+    s_otns.clear();
+    s_opts.clear();
+    s_trees.clear();
+}
+
+//-------------------------------------------------------------------------
+// evaluation
+//-------------------------------------------------------------------------
+
+struct Outcome
+{
+    int result;
+    std::vector<unsigned> evals;
+    std::vector<const OptTreeNode*> matches;
+};
+
+static Outcome evaluate(
+    detection_option_tree_node_t* root, const std::string& data, bool flat)
+{
+    uint8_t pkth[sizeof(DAQ_PktHdr_t)] = { };
+    uint8_t pbuf[sizeof(Packet)] = { };
+    Packet* p = (Packet*)pbuf;
+    p->pkth = (DAQ_PktHdr_t*)pkth;
+
+    int pomd = 0;
+    detection_option_eval_data_t eval_data = { &pomd, nullptr, p, 0, 0 };
+
+    Cursor c(p);
+    c.set("pkt_data", (const uint8_t*)data.data(), data.size());
+
+    s_evals.clear();
+    s_matches.clear();
+
+    // each run is a new packet so nothing is cached from the last one
+    ++rule_eval_pkt_count;
+
+    Outcome o;
+
+    if ( flat )
+        o.result = detection_option_flat_evaluate(root->flat, &eval_data, c);
+    else
+        o.result = detection_option_node_evaluate(root, &eval_data, c);
+
+    o.evals = s_evals;
+    o.matches = s_matches;
+    return o;
+}
+
+static void check_same(detection_option_tree_node_t* root, const std::string& data)
+{
+    Outcome a = evaluate(root, data, false);
+    Outcome b = evaluate(root, data, true);
+
+    LONGS_EQUAL(a.result, b.result);
+    CHECK(a.evals == b.evals);
+    CHECK(a.matches == b.matches);
+}
+
+static std::string random_data(std::mt19937& rng, unsigned len)
+{
+    std::string s;
+
+    while ( s.size() < len )
+        s += (char)('a' + rng() % 5);
+
+    return s;
+}
+
+//-------------------------------------------------------------------------
+// tests
+//-------------------------------------------------------------------------
+
+TEST_GROUP(flat_tree)
+{
+    void teardown()
+    { free_trees(); }
+};
+
+TEST(flat_tree, layout)
+{
+    auto root = new_option('a', false, true, 2);
+    root->children[0] = new_option('b', true, true, 1);
+    root->children[0]->children[0] = new_leaf();
+    root->children[1] = new_leaf();
+    root->relative_children = 1;
+
+    flatten(root);
+    dot_flat_tree_t* t = root->flat;
+
+    // breadth first with contiguous children
+    UNSIGNED_LONGS_EQUAL(4, t->num_nodes);
+    CHECK(t->nodes[0].node == root);
+    CHECK(t->nodes[1].node == root->children[0]);
+    CHECK(t->nodes[2].node == root->children[1]);
+    CHECK(t->nodes[3].node == root->children[0]->children[0]);
+
+    UNSIGNED_LONGS_EQUAL(1, t->nodes[0].first_child);
+    LONGS_EQUAL(2, t->nodes[0].num_children);
+    UNSIGNED_LONGS_EQUAL(3, t->nodes[1].first_child);
+    LONGS_EQUAL(1, t->nodes[1].num_children);
+    LONGS_EQUAL(0, t->nodes[2].num_children);
+
+    LONGS_EQUAL(DOT_OP_OTHER, t->nodes[0].op);
+    LONGS_EQUAL(DOT_OP_LEAF, t->nodes[2].op);
+}
+
+TEST(flat_tree, retry_relative)
+{
+    // the relative child only matches after the parent is retried
+    auto root = new_option('a', false, true, 1);
+    root->children[0] = new_option('b', true, true, 1);
+    root->children[0]->children[0] = new_leaf();
+    root->relative_children = 1;
+
+    flatten(root);
+
+    check_same(root, "axxxab");
+    check_same(root, "aaaaa");
+    check_same(root, "ba");
+
+    Outcome o = evaluate(root, "axxxab", true);
+    LONGS_EQUAL(1, o.result);
+    UNSIGNED_LONGS_EQUAL(1, o.matches.size());
+}
+
+TEST(flat_tree, wide)
+{
+    // more children than fit in 16 bits
+    const int n = 70000;
+    auto root = new_option('a', false, false, n);
+
+    for ( int i = 0; i < n; ++i )
+        root->children[i] = new_leaf();
+
+    flatten(root);
+    LONGS_EQUAL(n, root->flat->nodes[0].num_children);
+
+    check_same(root, "xa");
+
+    Outcome o = evaluate(root, "xa", true);
+    LONGS_EQUAL(n, o.result);
+    UNSIGNED_LONGS_EQUAL(n, o.matches.size());
+}
+
+TEST(flat_tree, random)
+{
+    std::mt19937 rng(2016);
+
+    for ( unsigned i = 0; i < 200; ++i )
+    {
+        auto root = random_tree(rng, 1 + rng() % 5);
+        flatten(root);
+
+        for ( unsigned j = 0; j < 20; ++j )
+            check_same(root, random_data(rng, rng() % 24));
+
+        free_trees();
+    }
+}
+
+//-------------------------------------------------------------------------
+// main
+//-------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
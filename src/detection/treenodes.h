@@ -69,8 +69,11 @@ struct OtnState
     uint64_t latency_timeouts = 0;
     uint64_t latency_suspends = 0;
 
+    // skipped by quick reject
+    uint64_t rejects = 0;
+
     operator bool() const
-    { return elapsed > 0_ticks || checks > 0; }
+    { return elapsed > 0_ticks || checks > 0 || rejects > 0; }
 };
 
 // one of these for each rule
@@ -34,6 +34,7 @@
 #include "flow/flow_key.h"
 #include "framework/inspector.h"
 #include "framework/codec.h"
+#include "memory/slab_allocator.h"
 
 #define SSNFLAG_SEEN_CLIENT         0x00000001
 #define SSNFLAG_SEEN_SENDER         0x00000001
@@ -88,7 +89,7 @@ struct Packet;
 
 typedef void (* StreamAppDataFree)(void*);
 
-class SO_PUBLIC FlowData
+class SO_PUBLIC FlowData : public memory::SlabObject
 {
 public:
     FlowData(unsigned u, Inspector* = nullptr);
@@ -291,6 +292,9 @@ public:  // FIXIT-M privatize if possible
 
     // these fields are always set; not zeroed
     Flow* prev, * next;
+    Flow* timer_prev, * timer_next;  // managed by FlowTimer
+    time_t timer_expire;
+    uint16_t timer_slot;
     Inspector* ssn_client;
     Inspector* ssn_server;
     long last_data_seen;
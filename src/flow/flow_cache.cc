@@ -24,7 +24,7 @@
 #include "config.h"
 #endif
 
-#include "hash/zhash.h"
+#include "hash/tag_hash.h"
 #include "helpers/flag_context.h"
 #include "ips_options/ips_flowbits.h"
 #include "main/snort_debug.h"
@@ -33,10 +33,18 @@
 
 #define SESSION_CACHE_FLAG_PURGING  0x01
 
+// live flows skipped per stale scan since the clock order does
+// not guarantee that older flows precede newer ones
+static const unsigned max_scan = 64;
+
 //-------------------------------------------------------------------------
 // FlowCache stuff
 //-------------------------------------------------------------------------
 
+// flow->key points at the copy stored in the table
+static void move_flow(void* data, const void* key)
+{ ((Flow*)data)->key = (FlowKey*)key; }
+
 FlowCache::FlowCache (const FlowConfig& cfg) : config(cfg)
 {
     cleanup_flows = cfg.max_sessions * cfg.cleanup_pct / 100;
@@ -46,8 +54,9 @@ FlowCache::FlowCache (const FlowConfig& cfg) : config(cfg)
     assert(cleanup_flows <= cfg.max_sessions);
     assert(cleanup_flows > 0);
 
-    hash_table = new ZHash(config.max_sessions, sizeof(FlowKey));
+    hash_table = new TagHash(config.max_sessions, sizeof(FlowKey));
     hash_table->set_keyops(FlowKey::hash, FlowKey::compare);
+    hash_table->set_move_fcn(move_flow);
 
     uni_head = new Flow;
     uni_tail = new Flow;
@@ -72,10 +81,11 @@ FlowCache::~FlowCache ()
     delete hash_table;
 }
 
+// the key is stored in the hash table slot when the flow is used
 void FlowCache::push(Flow* flow)
 {
-    void* key = hash_table->push(flow);
-    flow->key = (FlowKey*)key;
+    hash_table->push(flow);
+    flow->key = nullptr;
 }
 
 unsigned FlowCache::get_count()
@@ -127,7 +137,8 @@ void FlowCache::unlink_uni(Flow* flow)
 Flow* FlowCache::get(const FlowKey* key)
 {
     time_t timestamp = packet_time();
-    Flow* flow = (Flow*)hash_table->get(key);
+    unsigned hash = hash_table->hash(key);
+    Flow* flow = (Flow*)hash_table->get(key, hash);
 
     if ( !flow )
     {
@@ -137,11 +148,13 @@ Flow* FlowCache::get(const FlowKey* key)
                 prune_excess(nullptr);
         }
 
-        flow = (Flow*)hash_table->get(key);
+        flow = (Flow*)hash_table->get(key, hash);
 
         assert(flow);
+        flow->key = (FlowKey*)hash_table->get_key();
         flow->reset();
         link_uni(flow);
+        timer.add(flow, timestamp + config.nominal_timeout);
     }
 
     flow->last_data_seen = timestamp;
@@ -161,6 +174,8 @@ int FlowCache::remove(Flow* flow)
     if ( flow->next )
         unlink_uni(flow);
 
+    timer.remove(flow);
+
     return hash_table->remove(flow->key);
 }
 
@@ -169,38 +184,27 @@ unsigned FlowCache::prune_stale(uint32_t thetime, const Flow* save_me)
     ActiveSuspendContext act_susp;
 
     unsigned pruned = 0;
+    unsigned checked = 0;
     auto flow = static_cast<Flow*>(hash_table->first());
 
     while ( flow and pruned <= cleanup_flows )
     {
-#if 0
-        // FIXIT-H this loops forever if 1 flow in cache
-        if (flow == save_me)
+        // in clock order the current flow may come first; step over it
+        if ( flow == save_me or flow->last_data_seen + config.pruning_timeout >= thetime )
         {
-            break;
-            if ( hash_table->get_count() == 1 )
+            if ( ++checked >= max_scan )
                 break;
 
-            hash_table->touch();
-        }
-#else
-        // Reached the current flow. This *should* be the newest flow
-        if ( flow == save_me )
-        {
-            // assert( flow->last_data_seen + config.pruning_timeout >= thetime );
-            // bool rv = hash_table->touch(); assert( !rv );
-            break;
+            flow = static_cast<Flow*>(hash_table->next());
+            continue;
         }
-#endif
-        if ( flow->last_data_seen + config.pruning_timeout >= thetime )
-            break;
 
         DebugMessage(DEBUG_STREAM, "pruning stale flow\n");
         flow->ssn_state.session_flags |= SSNFLAG_TIMEDOUT;
         release(flow, PruneReason::TIMEOUT);
         ++pruned;
 
-        flow = static_cast<Flow*>(hash_table->first());
+        flow = static_cast<Flow*>(hash_table->current());
     }
 
     return pruned;
@@ -271,16 +275,25 @@ unsigned FlowCache::prune_excess(const Flow* save_me)
     return pruned;
 }
 
-bool FlowCache::prune_one(PruneReason reason, bool do_cleanup)
+bool FlowCache::prune_one(PruneReason reason, bool do_cleanup, const Flow* save_me)
 {
 
-    // so we don't prune the current flow (assume current == MRU)
+    // the clock hand may land on the current flow so callers must pass
+    // it as save_me; with one flow there is nothing else to prune
     if ( hash_table->get_count() <= 1 )
         return false;
 
     auto flow = static_cast<Flow*>(hash_table->first());
     assert(flow);
 
+    if ( flow == save_me )
+    {
+        flow = static_cast<Flow*>(hash_table->next());
+
+        if ( !flow or flow == save_me )
+            return false;
+    }
+
     flow->ssn_state.session_flags |= SSNFLAG_PRUNED;
     release(flow, reason, do_cleanup);
 
@@ -296,28 +309,33 @@ bool FlowCache::prune_one(PruneReason reason, bool do_cleanup)
     return true;
 }
 
+// flows are only scheduled when created so a flow that comes due may
+// have seen traffic since; if so it is rescheduled from last_data_seen
 unsigned FlowCache::timeout(unsigned num_flows, time_t thetime)
 {
     // FIXIT-H should Active be suspended here too?
     unsigned retired = 0;
 
-    auto flow = static_cast<Flow*>(hash_table->current());
-
-    if ( !flow )
-        flow = static_cast<Flow*>(hash_table->first());
-
-    while ( flow and retired < num_flows )
+    while ( retired < num_flows )
     {
-        if ( flow->last_data_seen + config.nominal_timeout > thetime )
+        Flow* flow = timer.expired(thetime);
+
+        if ( !flow )
             break;
 
+        time_t expire = flow->last_data_seen + config.nominal_timeout;
+
+        if ( expire > thetime )
+        {
+            timer.add(flow, expire);
+            continue;
+        }
+
         DebugMessage(DEBUG_STREAM, "retiring stale flow\n");
         flow->ssn_state.session_flags |= SSNFLAG_TIMEDOUT;
         release(flow, PruneReason::TIMEOUT);
 
         ++retired;
-
-        flow = static_cast<Flow*>(hash_table->current());
     }
 
     return retired;
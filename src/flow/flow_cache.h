@@ -23,12 +23,17 @@
 #define FLOW_CACHE_H
 
 // there is a FlowCache instance for each protocol.
-// Flows are stored in a ZHash instance by FlowKey.
+// Flows are stored in a TagHash instance by FlowKey.  TagHash only
+// approximates LRU order so the stale and timeout scans skip over live
+// flows for a bounded distance instead of stopping at the first one.
+// Idle timeouts are driven by a FlowTimer so timeout() only visits flows
+// that are due.
 
 #include <ctime>
 #include <type_traits>
 
 #include "flow_config.h"
+#include "flow_timer.h"
 #include "prune_stats.h"
 
 class Flow;
@@ -51,7 +56,7 @@ public:
     unsigned prune_unis();
     unsigned prune_stale(uint32_t thetime, const Flow* save_me);
     unsigned prune_excess(const Flow* save_me);
-    bool prune_one(PruneReason, bool do_cleanup);
+    bool prune_one(PruneReason, bool do_cleanup, const Flow* save_me = nullptr);
     unsigned timeout(unsigned num_flows, time_t cur_time);
 
     unsigned purge();
@@ -81,8 +86,9 @@ private:
     unsigned uni_count;
     uint32_t flags;
 
-    class ZHash* hash_table;
+    class TagHash* hash_table;
     Flow* uni_head, * uni_tail;
+    FlowTimer timer;
     PruneStats prune_stats;
 };
 
@@ -257,10 +257,10 @@ void FlowControl::prune_flows(PktType type, const Packet* p)
 }
 
 // hole for memory manager/prune handler
-bool FlowControl::prune_one(PruneReason reason, bool do_cleanup)
+bool FlowControl::prune_one(PruneReason reason, bool do_cleanup, const Flow* save_me)
 {
     auto cache = get_cache(last_pkt_type);
-    return cache ? cache->prune_one(reason, do_cleanup) : false;
+    return cache ? cache->prune_one(reason, do_cleanup, save_me) : false;
 }
 
 void FlowControl::timeout_flows(uint32_t flowCount, time_t cur_time)
@@ -288,7 +288,7 @@ void FlowControl::timeout_flows(uint32_t flowCount, time_t cur_time)
     Active::resume();
 }
 
-void FlowControl::preemptive_cleanup()
+void FlowControl::preemptive_cleanup(const Flow* save_me)
 {
     DebugFormat(DEBUG_FLOW, "doing preemptive cleanup for packet of type %u",
             (unsigned) last_pkt_type);
@@ -296,7 +296,7 @@ void FlowControl::preemptive_cleanup()
     // FIXIT-H is there a possibility of this looping forever?
     while ( memory::MemoryCap::over_threshold() )
     {
-        if ( !prune_one(PruneReason::PREEMPTIVE, true) )
+        if ( !prune_one(PruneReason::PREEMPTIVE, true, save_me) )
             break;
     }
 }
@@ -457,7 +457,7 @@ unsigned FlowControl::process(Flow* flow, Packet* p)
     p->disable_inspect = flow->is_inspection_disabled();
 
     last_pkt_type = p->type();
-    preemptive_cleanup();
+    preemptive_cleanup(flow);
 
     if ( flow->flow_state )
         set_policies(snort_conf, flow->policy_id);
@@ -70,7 +70,7 @@ public:
     void delete_flow(Flow*, PruneReason);
     void purge_flows(PktType);
     void prune_flows(PktType, const Packet*);
-    bool prune_one(PruneReason, bool do_cleanup);
+    bool prune_one(PruneReason, bool do_cleanup, const Flow* save_me = nullptr);
     void timeout_flows(uint32_t flowCount, time_t cur_time);
 
     char expected_flow(Flow*, Packet*);
@@ -101,7 +101,7 @@ private:
     void set_key(FlowKey*, Packet*);
 
     unsigned process(Flow*, Packet*);
-    void preemptive_cleanup();
+    void preemptive_cleanup(const Flow* save_me);
 
 private:
     FlowCache* ip_cache;
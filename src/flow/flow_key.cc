@@ -24,6 +24,16 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
 #include "main/snort_config.h"
 #include "utils/util.h"
 #include "sfip/sf_ip.h"
@@ -35,6 +45,71 @@
 // init foo
 //-------------------------------------------------------------------------
 
+// the low side of the key is the lower address, or the lower port when
+// the addresses are equal; the sides are selected with masks rather than
+// branches since the outcome is effectively random per packet.
+
+// returns a mask of the words in which a is greater than b and sets lt to
+// the mask of the words in which a is less than b
+#ifdef __SSE2__
+static inline unsigned cmp6(const uint32_t* a, const uint32_t* b, unsigned& lt)
+{
+    // bias to signed for the compares
+    const __m128i bias = _mm_set1_epi32(0x80000000);
+    __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)a), bias);
+    __m128i y = _mm_xor_si128(_mm_loadu_si128((const __m128i*)b), bias);
+
+    lt = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(x, y)));
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(x, y)));
+}
+
+static inline void select6(
+    uint32_t* lo, uint32_t* hi, const uint32_t* a, const uint32_t* b, bool swap)
+{
+    __m128i x = _mm_loadu_si128((const __m128i*)a);
+    __m128i y = _mm_loadu_si128((const __m128i*)b);
+    __m128i m = _mm_set1_epi32(-(int32_t)swap);
+    __m128i d = _mm_and_si128(_mm_xor_si128(x, y), m);
+
+    _mm_storeu_si128((__m128i*)lo, _mm_xor_si128(x, d));
+    _mm_storeu_si128((__m128i*)hi, _mm_xor_si128(y, d));
+}
+#else
+static inline unsigned cmp6(const uint32_t* a, const uint32_t* b, unsigned& lt)
+{
+    unsigned gt = 0;
+    lt = 0;
+
+    for ( unsigned i = 0; i < 4; ++i )
+    {
+        gt |= (unsigned)(a[i] > b[i]) << i;
+        lt |= (unsigned)(a[i] < b[i]) << i;
+    }
+    return gt;
+}
+
+static inline void select6(
+    uint32_t* lo, uint32_t* hi, const uint32_t* a, const uint32_t* b, bool swap)
+{
+    uint32_t m = -(uint32_t)swap;
+
+    for ( unsigned i = 0; i < 4; ++i )
+    {
+        uint32_t d = (a[i] ^ b[i]) & m;
+        lo[i] = a[i] ^ d;
+        hi[i] = b[i] ^ d;
+    }
+}
+#endif
+
+static inline void select_ports(
+    uint16_t& lo, uint16_t& hi, uint16_t a, uint16_t b, bool swap)
+{
+    uint16_t d = (a ^ b) & -(uint16_t)swap;
+    lo = a ^ d;
+    hi = b ^ d;
+}
+
 inline void FlowKey::init4(
     IpProtocol ip_proto,
     const sfip_t *srcIP, uint16_t srcPort,
@@ -60,36 +135,13 @@ inline void FlowKey::init4(
     src = srcIP->ip32;
     dst = dstIP->ip32;
 
-    /* These comparisons are done in this fashion for performance reasons */
-    if ( !order || *src < *dst)
-    {
-        COPY4(ip_l, src);
-        COPY4(ip_h, dst);
-        port_l = srcPort;
-        port_h = dstPort;
-    }
-    else if (*src == *dst)
-    {
-        COPY4(ip_l, src);
-        COPY4(ip_h, dst);
-        if (srcPort < dstPort)
-        {
-            port_l = srcPort;
-            port_h = dstPort;
-        }
-        else
-        {
-            port_l = dstPort;
-            port_h = srcPort;
-        }
-    }
-    else
-    {
-        COPY4(ip_l, dst);
-        port_l = dstPort;
-        COPY4(ip_h, src);
-        port_h = srcPort;
-    }
+    // only the first word is compared; equal addresses are not swapped
+    bool gt = *src > *dst;
+    bool swap_port = order & (gt | ((*src == *dst) & (srcPort > dstPort)));
+
+    select6(ip_l, ip_h, src, dst, order & gt);
+    select_ports(port_l, port_h, srcPort, dstPort, swap_port);
+
     if (SnortConfig::mpls_overlapping_ip() &&
         ip::isPrivateIP(*src) && ip::isPrivateIP(*dst))
         mplsLabel = mplsId;
@@ -103,9 +155,6 @@ inline void FlowKey::init6(
     const sfip_t *dstIP, uint16_t dstPort,
     uint32_t mplsId, bool order)
 {
-    const sfip_t* src;
-    const sfip_t* dst;
-
     if ( ip_proto == IpProtocol::ICMPV4 )
     {
         if (srcPort == ICMP_ECHOREPLY)
@@ -135,38 +184,17 @@ inline void FlowKey::init6(
         }
     }
 
-    src = srcIP;
-    dst = dstIP;
+    unsigned lt;
+    unsigned gt = cmp6(srcIP->ip32, dstIP->ip32, lt);
 
-    if ( !order || sfip_fast_lt6(src, dst))
-    {
-        COPY4(ip_l, src->ip32);
-        port_l = srcPort;
-        COPY4(ip_h, dst->ip32);
-        port_h = dstPort;
-    }
-    else if (sfip_fast_eq6(src, dst))
-    {
-        COPY4(ip_l, src->ip32);
-        COPY4(ip_h, dst->ip32);
-        if (srcPort < dstPort)
-        {
-            port_l = srcPort;
-            port_h = dstPort;
-        }
-        else
-        {
-            port_l = dstPort;
-            port_h = srcPort;
-        }
-    }
-    else
-    {
-        COPY4(ip_l, dst->ip32);
-        port_l = dstPort;
-        COPY4(ip_h, src->ip32);
-        port_h = srcPort;
-    }
+    // the first differing word decides the order
+    unsigned first = (gt | lt) & -(gt | lt);
+    bool src_gt = (gt & first) != 0;
+    bool eq = !(gt | lt);
+    bool swap_port = order & (src_gt | (eq & (srcPort > dstPort)));
+
+    select6(ip_l, ip_h, srcIP->ip32, dstIP->ip32, order & src_gt);
+    select_ports(port_l, port_h, srcPort, dstPort, swap_port);
 
     if (SnortConfig::mpls_overlapping_ip())
         mplsLabel = mplsId;
@@ -258,36 +286,59 @@ void FlowKey::init(
 // hash foo
 //-------------------------------------------------------------------------
 
-uint32_t FlowKey::hash(SFHASHFCN*, unsigned char* d, int)
+// the key is hashed as 6 64 bit words in 2 independent chains to overlap
+// the latencies; the result is finalized so the low bits used for tags and
+// the high bits used for rows are both well mixed.
+static_assert(sizeof(FlowKey) == 48, "FlowKey::hash assumes 48 byte keys");
+
+static inline uint64_t get_word(const unsigned char* d, unsigned i)
 {
-    uint32_t a,b,c;
+    uint64_t w;
+    memcpy(&w, d + 8 * i, sizeof(w));
+    return w;
+}
 
-    a = *(uint32_t*)d;         /* IPv6 lo[0] */
-    b = *(uint32_t*)(d+4);     /* IPv6 lo[1] */
-    c = *(uint32_t*)(d+8);     /* IPv6 lo[2] */
+static inline uint32_t fmix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
 
-    mix(a,b,c);
+#ifdef __SSE4_2__
+uint32_t FlowKey::hash(SFHASHFCN*, unsigned char* d, int)
+{
+    uint64_t a = _mm_crc32_u64(0x9E3779B9, get_word(d, 0));
+    uint64_t b = _mm_crc32_u64(0x7F4A7C15, get_word(d, 1));
 
-    a += *(uint32_t*)(d+12);   /* IPv6 lo[3] */
-    b += *(uint32_t*)(d+16);   /* IPv6 hi[0] */
-    c += *(uint32_t*)(d+20);   /* IPv6 hi[1] */
+    a = _mm_crc32_u64(a, get_word(d, 2));
+    b = _mm_crc32_u64(b, get_word(d, 3));
 
-    mix(a,b,c);
+    a = _mm_crc32_u64(a, get_word(d, 4));
+    b = _mm_crc32_u64(b, get_word(d, 5));
 
-    a += *(uint32_t*)(d+24);   /* IPv6 hi[2] */
-    b += *(uint32_t*)(d+28);   /* IPv6 hi[3] */
-    c += *(uint32_t*)(d+32);   /* port lo & port hi */
+    return fmix((a << 32) | b);
+}
+#else
+uint32_t FlowKey::hash(SFHASHFCN*, unsigned char* d, int)
+{
+    const uint64_t k = 0x9E3779B97F4A7C15ULL;
 
-    mix(a,b,c);
+    uint64_t a = (get_word(d, 0) ^ k) * 0xbf58476d1ce4e5b9ULL;
+    uint64_t b = (get_word(d, 1) ^ (k >> 1)) * 0x94d049bb133111ebULL;
 
-    a += *(uint32_t*)(d+36);    /* vlan tag, packet type, & version */
-    b += *(uint32_t*)(d+40);    /* mpls label */
-    c += *(uint32_t*)(d+44);    /* address space id and 16bits of zero'd pad */
+    a = (a ^ (a >> 31) ^ get_word(d, 2)) * 0xbf58476d1ce4e5b9ULL;
+    b = (b ^ (b >> 31) ^ get_word(d, 3)) * 0x94d049bb133111ebULL;
 
-    finalize(a,b,c);
+    a = (a ^ (a >> 31) ^ get_word(d, 4)) * 0xbf58476d1ce4e5b9ULL;
+    b = (b ^ (b >> 31) ^ get_word(d, 5)) * 0x94d049bb133111ebULL;
 
-    return c;
+    return fmix(a ^ (b << 1 | b >> 63));
 }
+#endif
 
 int FlowKey::compare(const void* s1, const void* s2, size_t)
 {
@@ -0,0 +1,194 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+
+#include "flow/flow_timer.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <string.h>
+
+#include "flow.h"
+
+// the slot index stored in the flow is offset by one so that zero means
+// unscheduled
+
+unsigned FlowTimer::level_of(unsigned slot)
+{ return (slot < L0_SIZE) ? 0 : 1 + (slot - L0_SIZE) / LN_SIZE; }
+
+FlowTimer::FlowTimer()
+{
+    memset(slots, 0, sizeof(slots));
+    memset(level_count, 0, sizeof(level_count));
+    count = 0;
+    clk = 0;
+}
+
+// level n holds expirations up to 64 level n ticks ahead of the clock;
+// anything beyond the top level is parked in the top level slot furthest
+// out and placed again when that slot is cascaded
+unsigned FlowTimer::get_slot(time_t expire)
+{
+    if ( expire < clk )
+        expire = clk;
+
+    if ( (uint64_t)(expire - clk) < L0_SIZE )
+        return expire & (L0_SIZE - 1);
+
+    unsigned shift = L0_BITS;
+    unsigned base = L0_SIZE;
+
+    for ( unsigned level = 1; level < LEVELS; ++level )
+    {
+        uint64_t ticks = (uint64_t)(expire >> shift) - (uint64_t)(clk >> shift);
+
+        if ( ticks < LN_SIZE )
+            return base + ((expire >> shift) & (LN_SIZE - 1));
+
+        if ( level == LEVELS - 1 )
+            return base + (((clk >> shift) + LN_SIZE - 1) & (LN_SIZE - 1));
+
+        shift += LN_BITS;
+        base += LN_SIZE;
+    }
+    assert(false);
+    return 0;
+}
+
+void FlowTimer::link(Flow* flow, unsigned slot)
+{
+    flow->timer_prev = nullptr;
+    flow->timer_next = slots[slot];
+
+    if ( slots[slot] )
+        slots[slot]->timer_prev = flow;
+
+    slots[slot] = flow;
+    flow->timer_slot = slot + 1;
+
+    level_count[level_of(slot)]++;
+}
+
+void FlowTimer::add(Flow* flow, time_t expire)
+{
+    assert(!flow->timer_slot);
+
+    // an empty wheel can be moved to any time
+    if ( !count and expire > clk )
+        clk = expire;
+
+    link(flow, get_slot(expire));
+    flow->timer_expire = expire;
+    count++;
+}
+
+void FlowTimer::remove(Flow* flow)
+{
+    if ( !flow->timer_slot )
+        return;
+
+    unsigned slot = flow->timer_slot - 1;
+
+    if ( flow->timer_prev )
+        flow->timer_prev->timer_next = flow->timer_next;
+    else
+        slots[slot] = flow->timer_next;
+
+    if ( flow->timer_next )
+        flow->timer_next->timer_prev = flow->timer_prev;
+
+    flow->timer_prev = flow->timer_next = nullptr;
+    flow->timer_slot = 0;
+
+    level_count[level_of(slot)]--;
+    count--;
+}
+
+// move the flows of the current slot at the given level down
+void FlowTimer::cascade(unsigned level)
+{
+    unsigned shift = L0_BITS + (level - 1) * LN_BITS;
+    unsigned slot = L0_SIZE + (level - 1) * LN_SIZE + ((clk >> shift) & (LN_SIZE - 1));
+
+    Flow* flow = slots[slot];
+    slots[slot] = nullptr;
+
+    while ( flow )
+    {
+        Flow* next = flow->timer_next;
+        level_count[level]--;
+        link(flow, get_slot(flow->timer_expire));
+        flow = next;
+    }
+}
+
+// advance one tick, or to the next boundary of the lowest occupied level
+// when the levels below it are empty
+void FlowTimer::advance(time_t now)
+{
+    unsigned shift = 0;
+
+    if ( !level_count[0] )
+    {
+        shift = L0_BITS;
+
+        for ( unsigned level = 1; level < LEVELS - 1 and !level_count[level]; ++level )
+            shift += LN_BITS;
+    }
+
+    time_t next = shift ? ((clk >> shift) + 1) << shift : clk + 1;
+
+    // don't run ahead of now or new flows would be scheduled late; no
+    // boundary lies between clk and next so nothing is missed
+    if ( next > now + 1 )
+        next = now + 1;
+
+    clk = next;
+
+    if ( clk & (L0_SIZE - 1) )
+        return;
+
+    // at a level 0 boundary; cascade from the top down
+    for ( unsigned level = LEVELS - 1; level > 0; --level )
+    {
+        unsigned mask = (1 << (L0_BITS + (level - 1) * LN_BITS)) - 1;
+
+        if ( !(clk & mask) )
+            cascade(level);
+    }
+}
+
+Flow* FlowTimer::expired(time_t now)
+{
+    while ( count and clk <= now )
+    {
+        Flow* flow = slots[clk & (L0_SIZE - 1)];
+
+        if ( flow )
+        {
+            remove(flow);
+            return flow;
+        }
+        advance(now);
+    }
+    return nullptr;
+}
+
@@ -0,0 +1,72 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+
+#ifndef FLOW_TIMER_H
+#define FLOW_TIMER_H
+
+// FlowTimer is a hierarchical timing wheel with one second ticks used to
+// retire idle flows.  Flows are linked into the wheel through fields in
+// Flow so scheduling and cancelling are O(1) and allocation free.  Flows are
+// scheduled once when created and are not moved as packets arrive; when a
+// flow comes due the owner checks last_data_seen and reschedules it if it
+// is still active.  So each flow is handled at most about once per idle
+// timeout and an expiration scan only touches flows that are due.
+
+#include <ctime>
+#include <cstdint>
+
+class Flow;
+
+class FlowTimer
+{
+public:
+    FlowTimer();
+
+    void add(Flow*, time_t expire);
+    void remove(Flow*);
+
+    // unlink and return a flow due at or before now or nullptr if none
+    Flow* expired(time_t now);
+
+    unsigned get_count() const
+    { return count; }
+
+private:
+    static unsigned level_of(unsigned slot);
+    unsigned get_slot(time_t expire);
+    void link(Flow*, unsigned slot);
+    void cascade(unsigned level);
+    void advance(time_t now);
+
+private:
+    static const unsigned LEVELS = 4;
+    static const unsigned L0_BITS = 8;
+    static const unsigned LN_BITS = 6;
+    static const unsigned L0_SIZE = 1 << L0_BITS;
+    static const unsigned LN_SIZE = 1 << LN_BITS;
+    static const unsigned SLOTS = L0_SIZE + (LEVELS - 1) * LN_SIZE;
+
+    Flow* slots[SLOTS];
+    unsigned level_count[LEVELS];
+    unsigned count;
+    time_t clk;
+};
+
+#endif
+
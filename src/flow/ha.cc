@@ -33,8 +33,9 @@
 #include "side_channel/side_channel.h"
 #include "stream/stream_api.h"
 #include "time/packet_time.h"
+#include "time/timersub.h"
 
-static const uint8_t HA_MESSAGE_VERSION = 3;
+static const uint8_t HA_MESSAGE_VERSION = 4;
 
 // define message size and content constants.
 static const uint8_t KEY_SIZE_IP6 = sizeof(FlowKey);
@@ -51,12 +52,13 @@ enum
 
 typedef std::array<FlowHAClient*, MAX_CLIENTS> ClientMap;
 
-THREAD_LOCAL SimpleStats ha_stats;
+THREAD_LOCAL HAStats ha_stats;
 THREAD_LOCAL ProfileStats ha_perf_stats;
 
 static THREAD_LOCAL HighAvailability* ha;
 PortBitSet* HighAvailabilityManager::ports = nullptr;
 bool HighAvailabilityManager::use_daq_channel = false;
+struct timeval HighAvailabilityManager::max_delay = { 0, 0 };
 struct timeval FlowHAState::min_session_lifetime;
 uint8_t s_handle_counter = 1; // stream client (index == 0) always exists
 
@@ -74,6 +76,11 @@ FlowHAState::FlowHAState()
 {
     state = INITIAL_STATE;
     pending = NONE_PENDING;
+    batch = 0;
+    offset = 0;
+    staged = NONE_PENDING;
+    sent_hash = 0;
+    sent_failures = 0;
 }
 
 void FlowHAState::set_pending(FlowHAClientHandle handle)
@@ -164,6 +171,11 @@ void FlowHAState::reset()
 {
     state = INITIAL_STATE;
     pending = NONE_PENDING;
+    batch = 0;
+    offset = 0;
+    staged = NONE_PENDING;
+    sent_hash = 0;
+    sent_failures = 0;
 }
 
 FlowHAClient::FlowHAClient(uint8_t length, bool session_client)
@@ -285,6 +297,32 @@ static inline uint8_t key_size(Flow* flow)
     return is_ip6_key(flow->key) ? KEY_SIZE_IP6 : KEY_SIZE_IP4;
 }
 
+// Return the length of the record starting with hdr or 0 if the key
+// type is invalid.
+static inline uint32_t record_length(const HAMessageHeader* hdr)
+{
+    if ( hdr->key_type == KEY_TYPE_IP6 )
+        return sizeof(HAMessageHeader) + KEY_SIZE_IP6 + hdr->total_length;
+
+    if ( hdr->key_type == KEY_TYPE_IP4 )
+        return sizeof(HAMessageHeader) + KEY_SIZE_IP4 + hdr->total_length;
+
+    return 0;
+}
+
+// FNV-1a; never 0 so that 0 can mean nothing sent yet
+static uint32_t hash_content(const uint8_t* data, unsigned length)
+{
+    uint32_t h = 2166136261u;
+
+    for ( unsigned i = 0; i < length; ++i )
+    {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
 static uint16_t calculate_msg_header_length(Flow* flow)
 {
     return sizeof(HAMessageHeader) + key_size(flow);
@@ -292,7 +330,7 @@ static uint16_t calculate_msg_header_length(Flow* flow)
 
 // Calculate the UPDATE message content length based on the
 // set of active clients.  The Session client is always present.
-static uint16_t calculate_update_msg_content_length(Flow* flow)
+static uint16_t calculate_update_msg_content_length(uint16_t clients)
 {
     assert(s_client_map);
     assert((*s_client_map)[0]);
@@ -301,7 +339,7 @@ static uint16_t calculate_update_msg_content_length(Flow* flow)
         length);
 
     for (int i=1; i<s_handle_counter; i++)
-        if ( flow->ha_state->check_pending(1<<i) )
+        if ( clients & (*s_client_map)[i]->handle )
         {
             assert((*s_client_map)[i]);
             length += ((*s_client_map)[i]->get_message_size() + sizeof(HAClientHeader));
@@ -332,12 +370,12 @@ static void write_update_msg_client( FlowHAClient* client, Flow* flow, HAMessage
     client->produce(flow, msg);
 }
 
-static void write_update_msg_content(Flow* flow, HAMessage* msg)
+static void write_update_msg_content(Flow* flow, uint16_t clients, HAMessage* msg)
 {
     assert(s_client_map);
 
     for ( int i=0; i<s_handle_counter; i++ )
-        if ( (i==SESSION_HA_CLIENT_INDEX) || flow->ha_state->check_pending(1<<i) )
+        if ( (i==SESSION_HA_CLIENT_INDEX) || (clients & (*s_client_map)[i]->handle) )
             write_update_msg_client((*s_client_map)[i],flow, msg);
 }
 
@@ -357,10 +395,10 @@ static void consume_receive_update_message(HAMessage* msg)
 
     assert(s_client_map);
 
-    // pointer to the last byte in the message
-    uint8_t* content_end = msg->content() + msg->content_length() - 1;
+    // pointer just past the last byte in the record
+    uint8_t* content_end = msg->content() + msg->content_length();
 
-    while( msg->cursor <= content_end )
+    while( msg->cursor < content_end )
     {
         // do we have sufficient message left to be able to have an HAClientHeader?
         if ( (int)(content_end - msg->cursor) < (int)sizeof( HAClientHeader ) )
@@ -371,6 +409,7 @@ static void consume_receive_update_message(HAMessage* msg)
 
         HAClientHeader* header = (HAClientHeader*)msg->cursor;
         msg->cursor += sizeof( HAClientHeader ); // step to the client content
+        uint8_t* client_content = msg->cursor;
 
         if ( (header->client >= s_handle_counter) ||
             ((*s_client_map)[header->client] == nullptr)  )
@@ -390,16 +429,15 @@ static void consume_receive_update_message(HAMessage* msg)
             ErrorMessage("Consuming HA Update message - error from client consume()\n");
             break;
         }
+        // client content is fixed size regardless of what consume() read
+        msg->cursor = client_content + header->length;
     }
 }
 
-static void consume_receive_message(HAMessage* msg)
+static void consume_receive_record(HAMessage* msg)
 {
     HAMessageHeader* hdr = (HAMessageHeader*)msg->content();
 
-    if ( hdr->version != HA_MESSAGE_VERSION)
-        return;
-
     switch ( hdr->event )
     {
         case HA_DELETE_EVENT:
@@ -417,7 +455,35 @@ static void consume_receive_message(HAMessage* msg)
     }
 }
 
-HighAvailability::HighAvailability(PortBitSet* ports, bool)
+// A message packs one or more records back to back.
+static void consume_receive_message(HAMessage* msg)
+{
+    uint8_t* record = msg->content();
+    uint8_t* end = record + msg->content_length();
+
+    while ( (int)(end - record) >= (int)sizeof(HAMessageHeader) )
+    {
+        HAMessageHeader* hdr = (HAMessageHeader*)record;
+
+        if ( hdr->version != HA_MESSAGE_VERSION)
+            return;
+
+        uint32_t length = record_length(hdr);
+
+        if ( !length || (uint32_t)(end - record) < length )
+        {
+            ErrorMessage("Consuming HA message - bad record length\n");
+            return;
+        }
+
+        HAMessage rec_msg(record, (uint16_t)length);
+        consume_receive_record(&rec_msg);
+        record += length;
+        ha_stats.records_received++;
+    }
+}
+
+HighAvailability::HighAvailability(PortBitSet* ports, bool, const struct timeval& delay)
 {
     SCPort port;
     using namespace std::placeholders;
@@ -449,6 +515,9 @@ HighAvailability::HighAvailability(PortBitSet* ports, bool)
     for ( int i=0; i<MAX_CLIENTS; i++ )
         (*s_client_map)[i] = nullptr;
 
+    max_delay = delay;
+    batch_time = { 0, 0 };
+
     // Only looking for side channel processing - FIXIT-H
 }
 
@@ -480,6 +549,69 @@ void HighAvailability::receive_handler(SCMessage* sc_msg)
     sc_msg->sc->discard_message(sc_msg);
 }
 
+// Add a record to the batch.  A record already staged for this flow is
+// overwritten if the new one is the same size and voided otherwise.
+void HighAvailability::stage(Flow* flow, const uint8_t* record, uint16_t length)
+{
+    FlowHAState* ha_state = flow->ha_state;
+
+    if ( ha_state->batch == batch_id )
+    {
+        HAMessageHeader* old = (HAMessageHeader*)(batch + ha_state->offset);
+        ha_stats.records_coalesced++;
+
+        if ( record_length(old) == length )
+        {
+            memcpy(old, record, length);
+            return;
+        }
+        old->event = HA_NO_EVENT;
+    }
+
+    if ( batch_len + length > sizeof(batch) )
+        flush();
+
+    if ( !batch_len )
+        packet_gettimeofday(&batch_time);
+
+    memcpy(batch + batch_len, record, length);
+    ha_state->batch = batch_id;
+    ha_state->offset = batch_len;
+    batch_len += length;
+    ha_stats.records_staged++;
+
+    if ( !max_delay.tv_sec && !max_delay.tv_usec )
+        flush();
+}
+
+void HighAvailability::flush()
+{
+    if ( !batch_len )
+        return;
+
+    SCMessage* sc_msg = sc->alloc_transmit_message((uint32_t)batch_len);
+
+    if ( sc_msg )
+    {
+        memcpy(sc_msg->content, batch, batch_len);
+        sc->transmit_message(sc_msg);
+        ha_stats.messages_sent++;
+        ha_stats.bytes_sent += batch_len;
+    }
+    else
+    {
+        // the staged records are lost so their hashes no longer count
+        transmit_failures++;
+        ha_stats.messages_dropped++;
+    }
+
+    batch_len = 0;
+
+    // staged offsets from earlier batches must not match
+    if ( !++batch_id )
+        batch_id = 1;
+}
+
 void HighAvailability::process_update(Flow* flow, const DAQ_PktHdr_t* pkthdr)
 {
     DebugMessage(DEBUG_HA,"HighAvailability::process_update()\n");
@@ -489,16 +621,46 @@ void HighAvailability::process_update(Flow* flow, const DAQ_PktHdr_t* pkthdr)
     if ( !sc || !flow )
         return;
 
+    // clients in a record that is still staged or may have been dropped
+    // must be in this one too since it replaces or resends that record
+    FlowHAState* ha_state = flow->ha_state;
+    uint16_t clients = ha_state->pending;
+
+    if ( ha_state->batch == batch_id or ha_state->sent_failures != transmit_failures )
+        clients |= ha_state->staged;
+
     const uint16_t header_len = calculate_msg_header_length(flow);
-    const uint16_t content_len = calculate_update_msg_content_length(flow);
+    const uint16_t content_len = calculate_update_msg_content_length(clients);
+    const uint16_t length = header_len + content_len;
 
-    SCMessage* sc_msg = sc->alloc_transmit_message((uint32_t)(header_len+content_len));
-    assert(sc_msg);
-    HAMessage ha_msg(sc_msg);
+    if ( length > sizeof(batch) )
+    {
+        ha_stats.updates_oversize++;
+        return;
+    }
+
+    uint8_t record[sizeof(batch)];
+    HAMessage ha_msg(record, length);
 
     write_msg_header(flow, HA_UPDATE_EVENT, content_len, &ha_msg);
-    write_update_msg_content(flow, &ha_msg);
-    sc->transmit_message(sc_msg);
+    write_update_msg_content(flow, clients, &ha_msg);
+
+    // nothing changed since the last update for this flow and that update
+    // is still staged or was transmitted
+    uint32_t hash = hash_content(record + header_len, content_len);
+
+    if ( hash == ha_state->sent_hash and
+        (ha_state->batch == batch_id or ha_state->sent_failures == transmit_failures) )
+    {
+        ha_stats.updates_suppressed++;
+        return;
+    }
+    ha_state->sent_hash = hash;
+    ha_state->sent_failures = transmit_failures;
+    ha_state->staged = clients;
+    ha_state->pending &= ~clients;
+
+    stage(flow, record, length);
 }
 
 void HighAvailability::process_deletion(Flow* flow)
@@ -516,14 +678,14 @@ void HighAvailability::process_deletion(Flow* flow)
     if ( !sc )
         return;
 
-    const uint32_t msg_len = calculate_msg_header_length(flow);
-    SCMessage* sc_msg = sc->alloc_transmit_message(msg_len);
-    HAMessage ha_msg(sc_msg);
+    const uint16_t length = calculate_msg_header_length(flow);
+    uint8_t record[sizeof(batch)];
+    HAMessage ha_msg(record, length);
 
     // No content, only header+key
     write_msg_header(flow, HA_DELETE_EVENT, 0, &ha_msg);
 
-    sc->transmit_message(sc_msg);
+    stage(flow, record, length);
 
     flow->ha_state->set(FlowHAState::DELETED);
 }
@@ -534,11 +696,32 @@ void HighAvailability::process_receive()
         sc->process(DISPATCH_ALL_RECEIVE);
 }
 
+void HighAvailability::process_transmit(bool force)
+{
+    if ( !sc || !batch_len )
+        return;
+
+    if ( !force )
+    {
+        struct timeval now, waited;
+        packet_gettimeofday(&now);
+        TIMERSUB(&now, &batch_time, &waited);
+
+        if ( waited.tv_sec < max_delay.tv_sec ||
+            (waited.tv_sec == max_delay.tv_sec && waited.tv_usec < max_delay.tv_usec) )
+            return;
+    }
+    flush();
+}
+
 // Called by the configuration parsing activity in the main thread.
-bool HighAvailabilityManager::instantiate(PortBitSet* mod_ports, bool mod_use_daq_channel)
+bool HighAvailabilityManager::instantiate(
+    PortBitSet* mod_ports, bool mod_use_daq_channel, uint32_t mod_max_delay)
 {
     DebugMessage(DEBUG_HA,"HighAvailabilityManager::instantiate()\n");
     ports = mod_ports;
+    max_delay.tv_sec = mod_max_delay / 1000;
+    max_delay.tv_usec = (mod_max_delay % 1000) * 1000;
 #ifdef HAVE_DAQ_EXT_MODFLOW
     use_daq_channel = mod_use_daq_channel;
 #else
@@ -554,6 +737,7 @@ void HighAvailabilityManager::pre_config_init()
     DebugFormat(DEBUG_HA,"HighAvailabilityManager::pre_config_init(): key size: %zu\n",
         sizeof(FlowKey));
     ports = nullptr;
+    max_delay = { 0, 0 };
 }
 
 // Called within the packet thread prior to packet processing
@@ -562,7 +746,7 @@ void HighAvailabilityManager::thread_init()
     DebugMessage(DEBUG_HA,"HighAvailabilityManager::thread_init()\n");
     // create a a thread local instance iff we are configured to operate.
     if ( (ports != nullptr) || use_daq_channel )
-        ha = new HighAvailability(ports,use_daq_channel);
+        ha = new HighAvailability(ports,use_daq_channel,max_delay);
     else
         ha = nullptr;
 }
@@ -573,6 +757,7 @@ void HighAvailabilityManager::thread_term()
     DebugMessage(DEBUG_HA,"HighAvailabilityManager::thread_term()\n");
     if ( ha != nullptr )
     {
+        ha->process_transmit(true);
         delete ha;
         ha = nullptr;
     }
@@ -597,6 +782,18 @@ void HighAvailabilityManager::process_receive()
         ha->process_receive();
 }
 
+void HighAvailabilityManager::process_transmit()
+{
+    if ( ha != nullptr )
+        ha->process_transmit(false);
+}
+
+void HighAvailabilityManager::flush()
+{
+    if ( ha != nullptr )
+        ha->process_transmit(true);
+}
+
 // Called in the packet threads to determine whether or not HA is active
 bool HighAvailabilityManager::active()
 {
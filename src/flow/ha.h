@@ -43,6 +43,7 @@ const uint8_t MAX_CLIENTS = 17;
 
 enum HAEvent
 {
+    HA_NO_EVENT = 0,        // superseded record; skipped by receivers
     HA_DELETE_EVENT = 1,
     HA_UPDATE_EVENT = 2
 };
@@ -79,6 +80,8 @@ public:
     void reset();
 
 private:
+    friend class HighAvailability;
+
     static const uint8_t INITIAL_STATE = 0x00;
     static const uint16_t NONE_PENDING = 0x0000;
     static const uint8_t PRIORITY_MASK = 0x30;
@@ -88,6 +91,18 @@ private:
     uint8_t state;
     uint16_t pending;
     struct timeval next_update;
+
+    // batch holding this flow's staged record (0 if none), its offset
+    // in that batch, the optional clients it carries, a hash of its
+    // content, and the transmit failure count when it was staged.  the
+    // record only counts as sent while its batch is pending or no
+    // transmit has failed since; until then its clients are carried
+    // into the next update for this flow.
+    uint32_t batch;
+    uint16_t offset;
+    uint16_t staged;
+    uint32_t sent_hash;
+    uint32_t sent_failures;
 };
 
 struct __attribute__((__packed__)) HAMessageHeader
@@ -104,22 +119,26 @@ struct __attribute__((__packed__)) HAClientHeader
     uint8_t length;
 };
 
-// Describe the message being produced or consumed.
+// Describe the message being produced or consumed.  A side channel
+// message carries one or more of these, each a header, key, and content.
 class HAMessage
 {
 public:
     HAMessage(SCMessage* msg)
-    { sc_msg = msg; }
+    { buf = msg->content; len = msg->content_length; }
+    HAMessage(uint8_t* content, uint16_t length)
+    { buf = content; len = length; }
     ~HAMessage() { }
 
     uint8_t* content()
-    { return sc_msg->content; }
+    { return buf; }
     uint16_t content_length()
-    { return sc_msg->content_length; }
+    { return len; }
     uint8_t* cursor;
 
 private:
-    SCMessage* sc_msg;
+    uint8_t* buf;
+    uint16_t len;
 };
 
 // A FlowHAClient subclass for each producer/consumer of flow HA data
@@ -143,19 +162,36 @@ protected:
 // HighAvailability is instantiated for each packet-thread.
 // FIXIT-M make the SideChannel the THREAD_LOCAL element and collapse
 //  into HighAvailabilityManager
+//
+// Update and deletion records are staged in a batch and sent together
+// in one side channel message when the batch fills, when the oldest
+// record is max_delay old, or when the thread is idle.  A flow's staged
+// record is replaced by its next one and updates with unchanged content
+// are not sent.
 class HighAvailability
 {
 public:
-    HighAvailability(PortBitSet*,bool);
+    HighAvailability(PortBitSet*,bool,const struct timeval& max_delay);
     ~HighAvailability();
 
     void process_update(Flow*, const DAQ_PktHdr_t*);
     void process_deletion(Flow*);
     void process_receive();
+    void process_transmit(bool force);
 
 private:
     void receive_handler(SCMessage*);
+    void stage(Flow*, const uint8_t* record, uint16_t length);
+    void flush();
+
     SideChannel* sc = nullptr;
+
+    uint8_t batch[MAXIMUM_SC_MESSAGE_CONTENT];
+    uint16_t batch_len = 0;
+    uint32_t batch_id = 1;
+    uint32_t transmit_failures = 0;
+    struct timeval batch_time;
+    struct timeval max_delay;
 };
 
 // Top level management of HighAvailability components.
@@ -164,8 +200,9 @@ class HighAvailabilityManager
 public:
     // Prior to parsing configuration
     static void pre_config_init();
-    // Invoked by the module configuration parsing to create HA instance
-    static bool instantiate(PortBitSet*,bool);
+    // Invoked by the module configuration parsing to create HA instance;
+    // records are held up to max_delay msec for batching (0 sends at once)
+    static bool instantiate(PortBitSet*, bool, uint32_t max_delay = 0);
     static void thread_init();
     static void thread_term();
     // true is we are configured and able to process
@@ -176,11 +213,16 @@ public:
     static void process_deletion(Flow*);
     // Look for and dispatch receive messages.
     static void process_receive();
+    // Send the staged records if the oldest has waited max_delay.
+    static void process_transmit();
+    // Send the staged records now.
+    static void flush();
 
 private:
     HighAvailabilityManager() = delete;
     static bool use_daq_channel;
     static PortBitSet* ports;
+    static struct timeval max_delay;
 };
 #endif
 
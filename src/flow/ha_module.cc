@@ -27,12 +27,17 @@
 
 static const PegInfo ha_pegs[] =
 {
+    { "records staged", "update and deletion records added to a batch" },
+    { "records coalesced", "staged records replaced by a later one for the same flow" },
+    { "updates suppressed", "updates not sent because the flow content was unchanged" },
+    { "updates oversize", "updates not sent because they exceed the maximum record size" },
+    { "messages sent", "side channel messages sent" },
+    { "messages dropped", "batches dropped because a side channel message could not be allocated" },
+    { "bytes sent", "side channel message bytes sent" },
+    { "records received", "update and deletion records received" },
     { nullptr, nullptr }
 };
 
-extern THREAD_LOCAL SimpleStats ha_stats;
-extern THREAD_LOCAL ProfileStats ha_perf_stats;
-
 //-------------------------------------------------------------------------
 // ha module
 //-------------------------------------------------------------------------
@@ -48,6 +53,9 @@ static const Parameter ha_params[] =
     { "ports", Parameter::PT_BIT_LIST, "65535", nullptr,
       "side channel message port list" },
 
+    { "max_delay", Parameter::PT_INT, "0:1000", "10",
+      "maximum msec to hold updates for batching; 0 sends each at once" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -58,6 +66,7 @@ HighAvailabilityModule::HighAvailabilityModule() :
     config.enabled = false;
     config.daq_channel = false;
     config.ports = nullptr;
+    config.max_delay = 10;
 }
 
 HighAvailabilityModule::~HighAvailabilityModule()
@@ -89,6 +98,9 @@ bool HighAvailabilityModule::set(const char* fqn, Value& v, SnortConfig*)
             config.ports = new PortBitSet;
         v.get_bits(*(config.ports) );
     }
+    else if ( v.is("max_delay") )
+        config.max_delay = v.get_long();
+
     else
         return false;
 
@@ -116,7 +128,8 @@ bool HighAvailabilityModule::end(const char* fqn, int idx, SnortConfig*)
     UNUSED(idx);
 #endif
 
-    if ( config.enabled && !HighAvailabilityManager::instantiate(config.ports,config.daq_channel) )
+    if ( config.enabled &&
+        !HighAvailabilityManager::instantiate(config.ports, config.daq_channel, config.max_delay) )
     {
         ParseWarning(WARN_CONF, "Illegal HighAvailability configuration");
         return false;
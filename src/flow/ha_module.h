@@ -32,9 +32,22 @@ struct HighAvailabilityConfig
     bool enabled;
     bool daq_channel;
     PortBitSet* ports = nullptr;
+    uint32_t max_delay;
 };
 
-extern THREAD_LOCAL SimpleStats ha_stats;
+struct HAStats
+{
+    PegCount records_staged;
+    PegCount records_coalesced;
+    PegCount updates_suppressed;
+    PegCount updates_oversize;
+    PegCount messages_sent;
+    PegCount messages_dropped;
+    PegCount bytes_sent;
+    PegCount records_received;
+};
+
+extern THREAD_LOCAL HAStats ha_stats;
 extern THREAD_LOCAL ProfileStats ha_perf_stats;
 
 class HighAvailabilityModule : public Module
@@ -0,0 +1,137 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// unit tests for FlowTimer class
+
+#include "flow/flow_timer.h"
+
+#include "flow/flow.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+//-------------------------------------------------------------------------
+// stubs
+//-------------------------------------------------------------------------
+
+Flow::Flow()
+{
+    timer_prev = timer_next = nullptr;
+    timer_expire = 0;
+    timer_slot = 0;
+}
+
+Flow::~Flow() { }
+
+//-------------------------------------------------------------------------
+// tests
+//-------------------------------------------------------------------------
+
+static const unsigned num_flows = 8;
+
+TEST_GROUP(flow_timer)
+{
+    FlowTimer* ft;
+    Flow* flows;
+
+    void setup() override
+    {
+        ft = new FlowTimer;
+        flows = new Flow[num_flows];
+    }
+
+    void teardown() override
+    {
+        delete[] flows;
+        delete ft;
+    }
+};
+
+TEST(flow_timer, level_0)
+{
+    ft->add(flows + 0, 100);
+    ft->add(flows + 1, 102);
+    ft->add(flows + 2, 101);
+
+    CHECK(ft->get_count() == 3);
+    CHECK(!ft->expired(99));
+
+    CHECK(ft->expired(100) == flows + 0);
+    CHECK(!ft->expired(100));
+
+    CHECK(ft->expired(102) == flows + 2);
+    CHECK(ft->expired(102) == flows + 1);
+    CHECK(!ft->expired(102));
+
+    CHECK(ft->get_count() == 0);
+    CHECK(!flows[1].timer_slot);
+}
+
+// each expiration must come due exactly on time after cascading down
+TEST(flow_timer, cascade)
+{
+    const time_t base = 1000000;
+    const time_t delta[] = { 0, 300, 20000, 2000000, 100000000 };
+    const unsigned num = sizeof(delta) / sizeof(delta[0]);
+
+    for ( unsigned i = 0; i < num; ++i )
+        ft->add(flows + i, base + delta[i]);
+
+    for ( unsigned i = 0; i < num; ++i )
+    {
+        CHECK(!ft->expired(base + delta[i] - 1));
+        CHECK(ft->expired(base + delta[i]) == flows + i);
+    }
+    CHECK(ft->get_count() == 0);
+}
+
+TEST(flow_timer, remove)
+{
+    ft->add(flows + 0, 50);
+    ft->add(flows + 1, 50);
+    ft->add(flows + 2, 5000);
+
+    ft->remove(flows + 0);
+    ft->remove(flows + 2);
+    ft->remove(flows + 2);
+
+    CHECK(ft->get_count() == 1);
+    CHECK(ft->expired(10000) == flows + 1);
+    CHECK(!ft->expired(10000));
+}
+
+// a flow scheduled behind the clock is due at the current tick
+TEST(flow_timer, late)
+{
+    ft->add(flows + 0, 100);
+    ft->add(flows + 1, 300);
+
+    CHECK(ft->expired(150) == flows + 0);
+    CHECK(!ft->expired(150));
+
+    ft->add(flows + 2, 120);
+    CHECK(!ft->expired(150));
+    CHECK(ft->expired(151) == flows + 2);
+    CHECK(ft->expired(300) == flows + 1);
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
@@ -31,7 +31,7 @@
 
 void LogMessage(const char*,...) { }
 
-THREAD_LOCAL SimpleStats ha_stats;
+THREAD_LOCAL HAStats ha_stats;
 THREAD_LOCAL ProfileStats ha_perf_stats;
 
 void show_stats(PegCount*, const PegInfo*, unsigned, const char*) { }
@@ -47,6 +47,7 @@ void Debug::print(const char*, int, uint64_t, const char*, ...) { }
 static bool s_port_1_set = false;
 static bool s_use_daq = false;
 static bool s_instantiate_called = false;
+static uint32_t s_max_delay = 0;
 
 static char* make_bit_string(int bit)
 {
@@ -59,11 +60,13 @@ static char* make_bit_string(int bit)
     return bit_string;
 }
 
-bool HighAvailabilityManager::instantiate(PortBitSet* mod_ports, bool mod_use_daq_channel)
+bool HighAvailabilityManager::instantiate(
+    PortBitSet* mod_ports, bool mod_use_daq_channel, uint32_t mod_max_delay)
 {
     s_instantiate_called = true;
     s_port_1_set = mod_ports->test(1);
     s_use_daq = mod_use_daq_channel;
+    s_max_delay = mod_max_delay;
 
     return true;
 }
@@ -157,6 +160,34 @@ TEST(high_availability_module_test, test_ha_valid_daq)
     CHECK(s_use_daq == true);
 }
 
+TEST(high_availability_module_test, test_ha_max_delay)
+{
+    Value ports_val(make_bit_string(1));
+    Value enable_val(true);
+    Value delay_val(100.0);
+    Parameter ports_param = {"ports", Parameter::PT_BIT_LIST, "65535", nullptr, "ports"};
+    Parameter enable_param = {"enable", Parameter::PT_BOOL, nullptr, "false", nullptr };
+    Parameter delay_param = {"max_delay", Parameter::PT_INT, "0:1000", "10", nullptr };
+
+    HighAvailabilityModule module;
+
+    ports_val.set(&ports_param);
+    enable_val.set(&enable_param);
+    delay_val.set(&delay_param);
+
+    s_instantiate_called = false;
+    s_max_delay = 0;
+
+    module.begin("high_availability", 0, nullptr);
+    module.set("high_availability.ports", ports_val, nullptr);
+    module.set("high_availability.enable", enable_val, nullptr);
+    module.set("high_availability.max_delay", delay_val, nullptr);
+    module.end("high_availability", 0, nullptr);
+
+    CHECK(s_instantiate_called == true);
+    CHECK(s_max_delay == 100);
+}
+
 int main(int argc, char** argv)
 {
     return CommandLineTestRunner::RunAllTests(argc, argv);
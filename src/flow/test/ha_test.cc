@@ -41,7 +41,7 @@ TEST_KEY
 static const uint8_t s_delete_message[] =
 {
     0x01,
-    0x03,
+    0x04,
     0x00,
     0x00,
     0x01,
@@ -56,6 +56,8 @@ static SCMessage s_sc_message;
 static SCMessage s_rec_sc_message;
 static bool s_get_session_called = false;
 static bool s_delete_session_called = false;
+static unsigned s_delete_session_count = 0;
+static uint8_t s_produce_seed = 0;
 static bool s_transmit_message_called = false;
 static uint8_t* s_message_content = nullptr;
 static uint8_t s_message_length = 0;
@@ -75,7 +77,7 @@ public:
     bool produce(Flow*, HAMessage* msg)
     {
         for ( uint8_t i=0; i<10; i++ )
-            *(msg->cursor)++ = i;
+            *(msg->cursor)++ = i + s_produce_seed;
         return true;
     }
     uint8_t get_message_size() { return 10; }
@@ -83,6 +85,22 @@ public:
 private:
 };
 
+class OptionalHAClient : public FlowHAClient
+{
+public:
+    OptionalHAClient() : FlowHAClient(4, false) { }
+    bool consume(Flow*, HAMessage*) { return true; }
+    bool produce(Flow*, HAMessage* msg)
+    {
+        for ( uint8_t i=0; i<4; i++ )
+            *(msg->cursor)++ = 0xa0 + i;
+        return true;
+    }
+};
+
+// optional clients can't be unregistered
+extern uint8_t s_handle_counter;
+
 Flow*  Stream::get_session(const FlowKey* flowkey)
 {
     s_flowkey = *flowkey;
@@ -94,6 +112,7 @@ void Stream::delete_session(const FlowKey* flowkey)
 {
     s_flowkey = *flowkey;
     s_delete_session_called = true;
+    s_delete_session_count++;
 }
 
 void ErrorMessage(const char*,...) { }
@@ -151,9 +170,11 @@ bool SideChannel::transmit_message(SCMessage* msg)
     s_message_length = msg->content_length;
     return true; }
 
+static bool s_alloc_fails = false;
+
 SCMessage* SideChannel::alloc_transmit_message(uint32_t len)
 {
-    if ( len > MSG_SIZE )
+    if ( len > MSG_SIZE or s_alloc_fails )
         return nullptr;
 
     s_sc_message.content = s_message;
@@ -208,6 +229,7 @@ TEST_GROUP(high_availability_test)
         HighAvailabilityManager::instantiate(&port_set, false);
         HighAvailabilityManager::thread_init();
         ha_client = new StreamHAClient;
+        s_flow.ha_state->reset();
     }
 
     void teardown()
@@ -235,6 +257,19 @@ TEST(high_availability_test, transmit_deletion)
     CHECK(s_transmit_message_called == true);
 }
 
+TEST(high_availability_test, receive_packed_deletions)
+{
+    static uint8_t packed[2 * sizeof(s_delete_message)];
+    memcpy(packed, s_delete_message, sizeof(s_delete_message));
+    memcpy(packed + sizeof(s_delete_message), s_delete_message, sizeof(s_delete_message));
+
+    s_delete_session_count = 0;
+    s_message_content = packed;
+    s_message_length = sizeof(packed);
+    HighAvailabilityManager::process_receive();
+    CHECK(s_delete_session_count == 2);
+}
+
 TEST(high_availability_test, transmit_update_stream_only)
 {
     s_transmit_message_called = false;
@@ -242,6 +277,135 @@ TEST(high_availability_test, transmit_update_stream_only)
     CHECK(s_transmit_message_called == true);
 }
 
+TEST_GROUP(high_availability_batch_test)
+{
+    void setup()
+    {
+        MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+        HighAvailabilityManager::pre_config_init();
+        PortBitSet port_set;
+        port_set.set(1);
+        HighAvailabilityManager::instantiate(&port_set, false, 1000);
+        HighAvailabilityManager::thread_init();
+        ha_client = new StreamHAClient;
+        s_flow.ha_state->reset();
+        s_time = { 0, 0 };
+    }
+
+    void teardown()
+    {
+        delete ha_client;
+        HighAvailabilityManager::thread_term();
+        MemoryLeakWarningPlugin::turnOnNewDeleteOverloads();
+    }
+};
+
+TEST(high_availability_batch_test, update_held_for_max_delay)
+{
+    s_transmit_message_called = false;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::process_transmit();
+    CHECK(s_transmit_message_called == false);
+
+    s_time.tv_sec = 1;
+    HighAvailabilityManager::process_transmit();
+    CHECK(s_transmit_message_called == true);
+}
+
+TEST(high_availability_batch_test, unchanged_update_suppressed)
+{
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+
+    s_transmit_message_called = false;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+    CHECK(s_transmit_message_called == false);
+}
+
+TEST(high_availability_batch_test, unchanged_update_resent_after_failure)
+{
+    s_alloc_fails = true;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+    s_alloc_fails = false;
+
+    s_transmit_message_called = false;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+    CHECK(s_transmit_message_called == true);
+
+    // sent this time so the next one is suppressed
+    s_transmit_message_called = false;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+    CHECK(s_transmit_message_called == false);
+}
+
+TEST(high_availability_batch_test, update_coalesced)
+{
+    s_produce_seed = 1;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+    uint8_t record_length = s_message_length;
+
+    s_transmit_message_called = false;
+    s_produce_seed = 2;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    s_produce_seed = 3;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+    s_produce_seed = 0;
+
+    CHECK(s_transmit_message_called == true);
+    CHECK(s_message_length == record_length);
+    CHECK(s_message_content[record_length - 1] == 9 + 3);
+}
+
+TEST(high_availability_batch_test, optional_content_kept_when_coalesced)
+{
+    OptionalHAClient* opt = new OptionalHAClient;
+
+    s_flow.ha_state->set_pending(opt->handle);
+    s_produce_seed = 1;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    s_produce_seed = 2;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+    s_produce_seed = 0;
+
+    // one record with the newest session content and the optional content
+    CHECK(s_transmit_message_called == true);
+    CHECK(s_message_content[s_message_length - 1] == 0xa3);
+    CHECK(s_message_content[s_message_length - 7] == 9 + 2);
+
+    delete opt;
+    s_handle_counter = 1;
+}
+
+TEST(high_availability_batch_test, optional_content_resent_after_failure)
+{
+    OptionalHAClient* opt = new OptionalHAClient;
+
+    s_flow.ha_state->set_pending(opt->handle);
+    s_alloc_fails = true;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+    s_alloc_fails = false;
+
+    s_transmit_message_called = false;
+    s_produce_seed = 1;
+    HighAvailabilityManager::process_update(&s_flow, &s_pkthdr);
+    HighAvailabilityManager::flush();
+    s_produce_seed = 0;
+
+    CHECK(s_transmit_message_called == true);
+    CHECK(s_message_content[s_message_length - 1] == 0xa3);
+
+    delete opt;
+    s_handle_counter = 1;
+}
+
 int main(int argc, char** argv)
 {
     return CommandLineTestRunner::RunAllTests(argc, argv);
@@ -22,6 +22,9 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
+#include <atomic>
+
 using namespace std;
 
 #include "main/snort_debug.h"
@@ -38,11 +41,15 @@ THREAD_LOCAL ProfileStats mpsePerfStats;
 // base stuff
 //-------------------------------------------------------------------------
 
+// instances are created by the main and reload threads
+static std::atomic<uint64_t> s_next_id(1);
+
 Mpse::Mpse(const char* m, bool use_gc)
 {
     method = m;
     inc_global_counter = use_gc;
     verbose = 0;
+    id = s_next_id++;
 }
 
 int Mpse::search(
@@ -66,6 +73,29 @@ int Mpse::search_all(
     return _search(T, n, match, context, current_state);
 }
 
+int Mpse::search_stream(
+    MpseStream*& stream, const unsigned char* T, int n,
+    MpseMatch match, void* context)
+{
+    Profile profile(mpsePerfStats);
+
+    int ret = _search_stream(stream, T, n, match, context);
+
+    if ( inc_global_counter )
+        s_bcnt += n;
+
+    return ret;
+}
+
+// engines without stream support search each buffer by itself
+int Mpse::_search_stream(
+    MpseStream*&, const unsigned char* T, int n,
+    MpseMatch match, void* context)
+{
+    int state = 0;
+    return _search(T, n, match, context, &state);
+}
+
 uint64_t Mpse::get_pattern_byte_count()
 {
     return s_bcnt;
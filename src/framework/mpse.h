@@ -36,12 +36,21 @@
 #include "search_engines/search_common.h"
 
 // this is the current version of the api
-#define SEAPI_VERSION ((BASE_API_VERSION << 16) | 0)
+#define SEAPI_VERSION ((BASE_API_VERSION << 16) | 3)
 
 struct SnortConfig;
 struct MpseApi;
 struct ProfileStats;
 
+// per flow direction match state for engines that can search a sequence
+// of buffers as one stream; engines derive from this and the caller owns
+// the instance (deleting it closes the stream)
+class SO_PUBLIC MpseStream
+{
+public:
+    virtual ~MpseStream() { }
+};
+
 class SO_PUBLIC Mpse
 {
 public:
@@ -67,12 +76,31 @@ public:
 
     virtual int prep_patterns(SnortConfig*) = 0;
 
+    // engines may split prep_patterns() into compile() and finish() so
+    // that many instances can be compiled concurrently.  compile() must
+    // not touch shared state and may run in a worker thread.  finish() is
+    // called on the main thread, in a fixed order, only if compile()
+    // succeeded; it builds the user trees and accrues summary stats.
+    // engines that don't split do all the work in finish().
+    virtual int compile(SnortConfig*) { return 0; }
+    virtual int finish(SnortConfig* sc) { return prep_patterns(sc); }
+
     int search(
         const uint8_t* T, int n, MpseMatch, void* context, int* current_state);
 
     virtual int search_all(
         const uint8_t* T, int n, MpseMatch, void* context, int* current_state);
 
+    // stream is null on the first call and is then set (and updated) by
+    // the engine; it is reset to null if the engine closes the stream
+    int search_stream(
+        MpseStream*& stream, const uint8_t* T, int n, MpseMatch, void* context);
+
+    // request stream support before prep_patterns(); can_stream() is true
+    // after prep only if the engine built a streaming database
+    virtual void set_stream(bool) { }
+    virtual bool can_stream() { return false; }
+
     virtual void set_opt(int) { }
     virtual int print_info() { return 0; }
     virtual int get_pattern_count() { return 0; }
@@ -83,17 +111,25 @@ public:
     void set_api(const MpseApi* p) { api = p; }
     const MpseApi* get_api() { return api; }
 
+    // unique for the life of the process, unlike the address which may be
+    // reused by a later config; never 0
+    uint64_t get_id() const { return id; }
+
 protected:
     Mpse(const char* method, bool use_gc);
 
     virtual int _search(
         const uint8_t* T, int n, MpseMatch, void* context, int* current_state) = 0;
 
+    virtual int _search_stream(
+        MpseStream*&, const uint8_t* T, int n, MpseMatch, void* context);
+
 private:
     std::string method;
     bool inc_global_counter;
     int verbose;
     const MpseApi* api;
+    uint64_t id;
 };
 
 extern THREAD_LOCAL ProfileStats mpsePerfStats;
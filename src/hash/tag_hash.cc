@@ -0,0 +1,503 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+
+#include "tag_hash.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "sfhashfcn.h"
+
+//-------------------------------------------------------------------------
+// control tags
+//-------------------------------------------------------------------------
+
+#define GROUP_SIZE 16
+
+// full slots hold the low 7 bits of the hash
+static const uint8_t TAG_EMPTY = 0x80;
+static const uint8_t TAG_DELETED = 0xFE;
+
+static inline uint8_t get_tag(unsigned hash)
+{ return hash & 0x7F; }
+
+static inline bool is_full(uint8_t tag)
+{ return !(tag & 0x80); }
+
+#ifdef __SSE2__
+static inline unsigned match_tag(const uint8_t* group, uint8_t tag)
+{
+    __m128i g = _mm_loadu_si128((const __m128i*)group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(tag)));
+}
+
+// empty or deleted both have the high bit set
+static inline unsigned match_free(const uint8_t* group)
+{
+    __m128i g = _mm_loadu_si128((const __m128i*)group);
+    return _mm_movemask_epi8(g);
+}
+#else
+static inline unsigned match_tag(const uint8_t* group, uint8_t tag)
+{
+    unsigned mask = 0;
+
+    for ( unsigned i = 0; i < GROUP_SIZE; ++i )
+        if ( group[i] == tag )
+            mask |= (1 << i);
+
+    return mask;
+}
+
+static inline unsigned match_free(const uint8_t* group)
+{
+    unsigned mask = 0;
+
+    for ( unsigned i = 0; i < GROUP_SIZE; ++i )
+        if ( group[i] & 0x80 )
+            mask |= (1 << i);
+
+    return mask;
+}
+#endif
+
+static inline unsigned match_empty(const uint8_t* group)
+{ return match_tag(group, TAG_EMPTY); }
+
+static inline unsigned match_full(const uint8_t* group)
+{ return ~match_free(group) & 0xFFFF; }
+
+static unsigned nearest_powerof2(unsigned n)
+{
+    unsigned p = GROUP_SIZE;
+
+    while ( p < n )
+        p <<= 1;
+
+    return p;
+}
+
+//-------------------------------------------------------------------------
+// private stuff
+//-------------------------------------------------------------------------
+
+static inline unsigned home_group(unsigned hash, unsigned ngroups)
+{ return (hash >> 7) & (ngroups - 1); }
+
+// groups are probed linearly from the home group given by the high bits
+int TagHash::find_slot(const void* key, unsigned hash, unsigned* probes)
+{
+    uint8_t tag = get_tag(hash);
+    unsigned g = home_group(hash, ngroups);
+    int ix = -1;
+    unsigned n = 0;
+
+    while ( n < ngroups )
+    {
+        const uint8_t* group = ctrl + g * GROUP_SIZE;
+        unsigned mask = match_tag(group, tag);
+        ++n;
+
+        while ( mask )
+        {
+            unsigned i = g * GROUP_SIZE + __builtin_ctz(mask);
+
+            if ( !sfhashfcn->keycmp_fcn(key_at(i), key, keysize) )
+            {
+                ix = i;
+                break;
+            }
+            mask &= mask - 1;
+        }
+
+        // a group with an empty slot never overflowed into the next
+        if ( ix >= 0 or match_empty(group) )
+            break;
+
+        g = (g + 1) & (ngroups - 1);
+    }
+
+    if ( probes )
+        *probes = n;
+
+    return ix;
+}
+
+int TagHash::find_free(unsigned hash)
+{
+    unsigned g = home_group(hash, ngroups);
+
+    for ( unsigned n = 0; n < ngroups; ++n )
+    {
+        unsigned mask = match_free(ctrl + g * GROUP_SIZE);
+
+        if ( mask )
+            return g * GROUP_SIZE + __builtin_ctz(mask);
+
+        g = (g + 1) & (ngroups - 1);
+    }
+    return -1;
+}
+
+// a slot may only revert to empty if its group was never full; otherwise
+// a probe for a key that overflowed this group would stop short
+void TagHash::clear_slot(unsigned ix)
+{
+    const uint8_t* group = ctrl + (ix & ~(GROUP_SIZE - 1));
+
+    if ( match_empty(group) )
+        ctrl[ix] = TAG_EMPTY;
+    else
+    {
+        ctrl[ix] = TAG_DELETED;
+        deleted++;
+    }
+    refs[ix] = 0;
+    data[ix] = nullptr;
+
+    if ( !--count )
+    {
+        memset(ctrl, TAG_EMPTY, nslots);
+        deleted = 0;
+    }
+}
+
+void TagHash::swap_slots(unsigned a, unsigned b)
+{
+    memcpy(scratch, key_at(a), keysize);
+    memcpy(key_at(a), key_at(b), keysize);
+    memcpy(key_at(b), scratch, keysize);
+
+    uint8_t r = refs[a];
+    refs[a] = refs[b];
+    refs[b] = r;
+
+    void* d = data[a];
+    data[a] = data[b];
+    data[b] = d;
+}
+
+// drop deleted tags without resizing: every full slot is marked pending
+// and then reinserted at the first free slot on its probe sequence.  an
+// entry already in the right group stays put; one that lands on a pending
+// slot swaps with it and the displaced entry is placed next.
+void TagHash::rehash()
+{
+    for ( unsigned i = 0; i < nslots; ++i )
+        ctrl[i] = is_full(ctrl[i]) ? TAG_DELETED : TAG_EMPTY;
+
+    for ( unsigned i = 0; i < nslots; ++i )
+    {
+        if ( ctrl[i] != TAG_DELETED )
+            continue;
+
+        unsigned h = hash(key_at(i));
+        unsigned home = home_group(h, ngroups);
+        int ix = find_free(h);
+        assert(ix >= 0);
+
+        unsigned j = (unsigned)ix;
+        unsigned pi = (i / GROUP_SIZE - home) & (ngroups - 1);
+        unsigned pj = (j / GROUP_SIZE - home) & (ngroups - 1);
+
+        if ( pi == pj )
+        {
+            ctrl[i] = get_tag(h);
+            continue;
+        }
+
+        if ( ctrl[j] == TAG_EMPTY )
+        {
+            memcpy(key_at(j), key_at(i), keysize);
+            refs[j] = refs[i];
+            data[j] = data[i];
+            ctrl[j] = get_tag(h);
+
+            ctrl[i] = TAG_EMPTY;
+            refs[i] = 0;
+            data[i] = nullptr;
+        }
+        else
+        {
+            swap_slots(i, j);
+            ctrl[j] = get_tag(h);
+            --i;  // place the entry swapped in
+        }
+    }
+    deleted = 0;
+    cursor = -1;
+
+    if ( move_fcn )
+    {
+        for ( unsigned i = 0; i < nslots; ++i )
+            if ( is_full(ctrl[i]) )
+                move_fcn(data[i], key_at(i));
+    }
+}
+
+// advance from start to the next full slot that has not been referenced
+// since the hand last passed, clearing reference bits along the way
+int TagHash::sweep(unsigned start)
+{
+    if ( !count )
+        return -1;
+
+    unsigned ix = start & (nslots - 1);
+
+    // the first lap may clear every reference bit
+    for ( unsigned n = 0; n < 2 * nslots + GROUP_SIZE; )
+    {
+        unsigned base = ix & ~(GROUP_SIZE - 1);
+        unsigned mask = match_full(ctrl + base) & (0xFFFF << (ix - base));
+
+        while ( mask )
+        {
+            unsigned i = base + __builtin_ctz(mask);
+
+            if ( !refs[i] )
+                return i;
+
+            refs[i] = 0;
+            mask &= mask - 1;
+        }
+        n += base + GROUP_SIZE - ix;
+        ix = (base + GROUP_SIZE) & (nslots - 1);
+    }
+    return -1;
+}
+
+//-------------------------------------------------------------------------
+// public stuff
+//-------------------------------------------------------------------------
+
+TagHash::TagHash(int rows, int keysz)
+{
+    // keep the load factor at or below 7/8 so probes stay short; the
+    // power of 2 rounding usually leaves more room than that
+    if ( rows > 0 )
+        nslots = nearest_powerof2(rows + rows / 7);
+    else
+        nslots = nearest_powerof2(-rows);
+
+    ngroups = nslots / GROUP_SIZE;
+
+    // rehash when live plus deleted slots pass 7/8 of the table but only
+    // after enough deletes have piled up to pay for the O(n) pass
+    max_fill = nslots - nslots / 8;
+
+    sfhashfcn = sfhashfcn_new(nslots);
+    keysize = keysz;
+
+    ctrl = new uint8_t[nslots];
+    memset(ctrl, TAG_EMPTY, nslots);
+
+    refs = new uint8_t[nslots]();
+    keys = new uint8_t[(size_t)nslots * keysize];
+    data = new void*[nslots]();
+    scratch = new uint8_t[keysize];
+    move_fcn = nullptr;
+
+    count = 0;
+    deleted = 0;
+    hand = 0;
+    cursor = -1;
+    last_key = nullptr;
+}
+
+TagHash::~TagHash()
+{
+    if ( sfhashfcn )
+        sfhashfcn_free(sfhashfcn);
+
+    delete[] ctrl;
+    delete[] refs;
+    delete[] keys;
+    delete[] data;
+    delete[] scratch;
+}
+
+void TagHash::push(void* p)
+{
+    free_list.push_back(p);
+}
+
+void* TagHash::pop()
+{
+    if ( free_list.empty() )
+        return nullptr;
+
+    void* pv = free_list.back();
+    free_list.pop_back();
+    return pv;
+}
+
+unsigned TagHash::hash(const void* key)
+{ return sfhashfcn->hash_fcn(sfhashfcn, (unsigned char*)key, keysize); }
+
+void* TagHash::find(const void* key)
+{ return find(key, hash(key)); }
+
+void* TagHash::find(const void* key, unsigned hash)
+{
+    int ix = find_slot(key, hash);
+
+    if ( ix < 0 )
+        return nullptr;
+
+    refs[ix] = 1;
+    last_key = key_at(ix);
+    return data[ix];
+}
+
+void* TagHash::get(const void* key)
+{ return get(key, hash(key)); }
+
+void* TagHash::get(const void* key, unsigned hash)
+{
+    int ix = find_slot(key, hash);
+
+    if ( ix >= 0 )
+    {
+        refs[ix] = 1;
+        last_key = key_at(ix);
+        return data[ix];
+    }
+
+    if ( free_list.empty() )
+        return nullptr;
+
+    if ( count + deleted >= max_fill and deleted >= nslots / 32 )
+        rehash();
+
+    ix = find_free(hash);
+
+    if ( ix < 0 )
+        return nullptr;
+
+    if ( ctrl[ix] == TAG_DELETED )
+        deleted--;
+
+    ctrl[ix] = get_tag(hash);
+    refs[ix] = 1;
+    memcpy(key_at(ix), key, keysize);
+    data[ix] = pop();
+
+    count++;
+    last_key = key_at(ix);
+    return data[ix];
+}
+
+void* TagHash::first()
+{
+    cursor = sweep(hand);
+
+    if ( cursor < 0 )
+        return nullptr;
+
+    hand = cursor;
+    return data[cursor];
+}
+
+void* TagHash::next()
+{
+    if ( cursor < 0 )
+        return nullptr;
+
+    cursor = sweep(cursor + 1);
+
+    if ( cursor < 0 )
+        return nullptr;
+
+    hand = cursor;
+    return data[cursor];
+}
+
+void* TagHash::current()
+{
+    if ( cursor < 0 )
+        return nullptr;
+
+    if ( is_full(ctrl[cursor]) )
+        return data[cursor];
+
+    // the entry at the hand was removed
+    return next();
+}
+
+// give the entry at the hand another lap
+bool TagHash::touch()
+{
+    if ( cursor < 0 or !is_full(ctrl[cursor]) )
+        return false;
+
+    refs[cursor] = 1;
+    hand = cursor + 1;
+    cursor = -1;
+
+    return count > 1;
+}
+
+bool TagHash::remove(const void* key)
+{
+    unsigned hash = sfhashfcn->hash_fcn(sfhashfcn, (unsigned char*)key, keysize);
+    int ix = find_slot(key, hash);
+
+    if ( ix < 0 )
+        return false;
+
+    push(data[ix]);
+    clear_slot(ix);
+    return true;
+}
+
+bool TagHash::remove()
+{
+    if ( cursor < 0 or !is_full(ctrl[cursor]) )
+        return false;
+
+    push(data[cursor]);
+    clear_slot(cursor);
+    return true;
+}
+
+unsigned TagHash::get_probes(const void* key)
+{
+    unsigned probes;
+    find_slot(key, hash(key), &probes);
+    return probes;
+}
+
+int TagHash::set_keyops(
+    unsigned (* hash_fcn)(SFHASHFCN* p, unsigned char* d, int n),
+    int (* keycmp_fcn)(const void* s1, const void* s2, size_t n))
+{
+    if ( hash_fcn && keycmp_fcn )
+        return sfhashfcn_set_keyops(sfhashfcn, hash_fcn, keycmp_fcn);
+
+    return -1;
+}
+
@@ -0,0 +1,128 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+
+#ifndef TAG_HASH_H
+#define TAG_HASH_H
+
+// TagHash is an open addressing alternative to ZHash with the same
+// interface.  Slots are grouped 16 to a group and each slot has a one byte
+// control tag (7 bits of hash or empty / deleted) so a group is probed with
+// a single SIMD compare.  Keys are stored inline in the table so a lookup
+// normally touches just the tags, one key, and the data.  Instead of a
+// global LRU list a clock hand sweeps the slots; find() and get() mark a
+// slot referenced and the hand skips (and clears) referenced slots.  So
+// first() yields an approximate least recently used entry.
+//
+// Since keys live in the slots, the key of a data item is only valid after
+// get() inserts it; use get_key() to obtain the stored copy.
+//
+// Removed entries leave deleted tags behind so probes for other keys keep
+// going.  When too few empty slots remain the table is rehashed in place,
+// which moves entries; set_move_fcn() lets users that hold stored key
+// pointers update them.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct SFHASHFCN;
+
+class TagHash
+{
+public:
+    TagHash(int nrows, int keysize);
+    ~TagHash();
+
+    // free list of data
+    void push(void* p);
+    void* pop();
+
+    // clock sweep
+    void* first();
+    void* next();
+    void* current();
+    bool touch();
+
+    void* find(const void* key);
+    void* get(const void* key);
+
+    // these take the hash of the key so it can be computed once for
+    // several lookups
+    unsigned hash(const void* key);
+    void* find(const void* key, unsigned hash);
+    void* get(const void* key, unsigned hash);
+
+    // stored key of the last entry found or inserted
+    const void* get_key() const
+    { return last_key; }
+
+    bool remove(const void* key);
+    bool remove();
+
+    inline unsigned get_count() { return count; }
+
+    // number of groups a lookup of key examines
+    unsigned get_probes(const void* key);
+
+    typedef void (* MoveFcn)(void* data, const void* key);
+
+    void set_move_fcn(MoveFcn f)
+    { move_fcn = f; }
+
+    int set_keyops(
+        unsigned (* hash_fcn)(SFHASHFCN* p, unsigned char* d, int n),
+        int (* keycmp_fcn)(const void* s1, const void* s2, size_t n));
+
+private:
+    int find_slot(const void* key, unsigned hash, unsigned* probes = nullptr);
+    int find_free(unsigned hash);
+    void clear_slot(unsigned);
+    int sweep(unsigned start);
+    void rehash();
+    void swap_slots(unsigned, unsigned);
+
+    uint8_t* key_at(unsigned ix)
+    { return keys + (size_t)ix * keysize; }
+
+private:
+    SFHASHFCN* sfhashfcn;
+    int keysize;
+
+    unsigned nslots;
+    unsigned ngroups;
+    unsigned count;
+    unsigned deleted;
+    unsigned max_fill;
+
+    uint8_t* ctrl;   // one tag per slot
+    uint8_t* refs;   // clock reference bits
+    uint8_t* keys;   // inline keys
+    void** data;
+    uint8_t* scratch;
+    MoveFcn move_fcn;
+
+    std::vector<void*> free_list;
+
+    unsigned hand;
+    int cursor;
+    const void* last_key;
+};
+
+#endif
+
@@ -0,0 +1,180 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+
+// microbenchmark comparing TagHash with ZHash for flow sized keys
+// usage: tag_hash_bench [flows ...]  (default 1M and 10M)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "hash/sfhashfcn.h"
+#include "hash/tag_hash.h"
+#include "hash/zhash.h"
+
+//-------------------------------------------------------------------------
+// stubs
+//-------------------------------------------------------------------------
+
+static SFHASHFCN s_fcn;
+
+SFHASHFCN* sfhashfcn_new(int)
+{ return &s_fcn; }
+
+void sfhashfcn_free(SFHASHFCN*) { }
+
+int sfhashfcn_set_keyops(
+    SFHASHFCN* p,
+    unsigned (* hash_fcn)(SFHASHFCN* p, unsigned char* d, int n),
+    int (* keycmp_fcn)(const void* s1, const void* s2, size_t n))
+{
+    p->hash_fcn = hash_fcn;
+    p->keycmp_fcn = keycmp_fcn;
+    return 0;
+}
+
+//-------------------------------------------------------------------------
+// same size and hash as FlowKey
+//-------------------------------------------------------------------------
+
+struct BenchKey
+{
+    uint32_t w[12];
+};
+
+static unsigned bench_hash(SFHASHFCN*, unsigned char* d, int)
+{
+    const uint32_t* k = (const uint32_t*)d;
+    uint32_t a = k[0], b = k[1], c = k[2];
+
+    mix(a, b, c);
+    a += k[3]; b += k[4]; c += k[5];
+    mix(a, b, c);
+    a += k[6]; b += k[7]; c += k[8];
+    mix(a, b, c);
+    a += k[9]; b += k[10]; c += k[11];
+    finalize(a, b, c);
+
+    return c;
+}
+
+static int bench_compare(const void* s1, const void* s2, size_t n)
+{ return memcmp(s1, s2, n); }
+
+struct BenchData
+{
+    uint64_t last_seen;
+    uint8_t pad[56];
+};
+
+//-------------------------------------------------------------------------
+// driver
+//-------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+template <typename Table>
+static void run(const char* name, Table& table, std::vector<BenchKey>& keys,
+    std::vector<unsigned>& order)
+{
+    std::vector<BenchData> data(keys.size());
+    unsigned n = keys.size();
+
+    table.set_keyops(bench_hash, bench_compare);
+
+    for ( auto& d : data )
+        table.push(&d);
+
+    auto start = Clock::now();
+
+    for ( unsigned i = 0; i < n; ++i )
+        table.get(&keys[i]);
+
+    auto insert = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+    unsigned hits = 0;
+    start = Clock::now();
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        BenchData* d = (BenchData*)table.find(&keys[order[i]]);
+
+        if ( d )
+        {
+            d->last_seen = i;
+            ++hits;
+        }
+    }
+
+    auto lookup = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+
+    printf("%-8s flows=%-9u insert=%7.1f ns/op  lookup=%7.1f ns/op  hits=%u\n",
+        name, n, insert, lookup, hits);
+
+    // leave the data for the table dtor
+    while ( table.first() )
+        table.remove();
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<unsigned> sizes;
+
+    for ( int i = 1; i < argc; ++i )
+        sizes.push_back(strtoul(argv[i], nullptr, 0));
+
+    if ( sizes.empty() )
+        sizes = { 1000000, 10000000 };
+
+    std::mt19937 rng(3193);
+
+    for ( auto n : sizes )
+    {
+        std::vector<BenchKey> keys(n);
+        std::vector<unsigned> order(n);
+
+        for ( unsigned i = 0; i < n; ++i )
+        {
+            memset(&keys[i], 0, sizeof(keys[i]));
+
+            // ipv4 addresses, ports, and packet type
+            keys[i].w[0] = rng();
+            keys[i].w[4] = rng();
+            keys[i].w[8] = rng();
+            keys[i].w[9] = 0x0406;
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), rng);
+
+        {
+            ZHash zh(n, sizeof(BenchKey));
+            run("zhash", zh, keys, order);
+        }
+        {
+            TagHash th(n, sizeof(BenchKey));
+            run("tag_hash", th, keys, order);
+        }
+    }
+    return 0;
+}
+
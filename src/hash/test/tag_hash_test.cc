@@ -0,0 +1,346 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+
+// unit tests for TagHash class
+
+#include "hash/tag_hash.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+#include <string.h>
+
+#include "hash/sfhashfcn.h"
+
+//-------------------------------------------------------------------------
+// stubs
+//-------------------------------------------------------------------------
+
+static SFHASHFCN s_fcn;
+
+SFHASHFCN* sfhashfcn_new(int)
+{ return &s_fcn; }
+
+void sfhashfcn_free(SFHASHFCN*) { }
+
+int sfhashfcn_set_keyops(
+    SFHASHFCN* p,
+    unsigned (* hash_fcn)(SFHASHFCN* p, unsigned char* d, int n),
+    int (* keycmp_fcn)(const void* s1, const void* s2, size_t n))
+{
+    p->hash_fcn = hash_fcn;
+    p->keycmp_fcn = keycmp_fcn;
+    return 0;
+}
+
+struct TestKey
+{
+    uint32_t id;
+    uint32_t pad[3];
+};
+
+static unsigned test_hash(SFHASHFCN*, unsigned char* d, int)
+{
+    uint32_t a = *(uint32_t*)d;
+    uint32_t b = 0, c = 0;
+    finalize(a, b, c);
+    return c;
+}
+
+// every key lands in the same home group with the same tag
+static unsigned same_hash(SFHASHFCN*, unsigned char*, int)
+{ return 0x5A; }
+
+static int test_compare(const void* s1, const void* s2, size_t n)
+{ return memcmp(s1, s2, n); }
+
+static const unsigned num_data = 256;
+
+TEST_GROUP(tag_hash)
+{
+    TagHash* th;
+    uint32_t data[num_data];
+
+    void setup() override
+    {
+        th = new TagHash(num_data, sizeof(TestKey));
+        th->set_keyops(test_hash, test_compare);
+
+        for ( unsigned i = 0; i < num_data; ++i )
+        {
+            data[i] = i;
+            th->push(data + i);
+        }
+    }
+
+    void teardown() override
+    {
+        delete th;
+    }
+
+    void* get(uint32_t id)
+    {
+        TestKey key = { id, { 0, 0, 0 } };
+        return th->get(&key);
+    }
+
+    void* find(uint32_t id)
+    {
+        TestKey key = { id, { 0, 0, 0 } };
+        return th->find(&key);
+    }
+
+    bool remove(uint32_t id)
+    {
+        TestKey key = { id, { 0, 0, 0 } };
+        return th->remove(&key);
+    }
+};
+
+TEST(tag_hash, get_find_remove)
+{
+    CHECK(th->get_count() == 0);
+    CHECK(find(7) == nullptr);
+
+    void* p = get(7);
+    CHECK(p != nullptr);
+    CHECK(th->get_count() == 1);
+    CHECK(((TestKey*)th->get_key())->id == 7);
+
+    CHECK(get(7) == p);
+    CHECK(find(7) == p);
+    CHECK(th->get_count() == 1);
+
+    CHECK(remove(7));
+    CHECK(!remove(7));
+    CHECK(find(7) == nullptr);
+    CHECK(th->get_count() == 0);
+}
+
+TEST(tag_hash, fill_and_drain)
+{
+    for ( unsigned i = 0; i < num_data; ++i )
+        CHECK(get(i) != nullptr);
+
+    CHECK(th->get_count() == num_data);
+
+    // no more free data
+    CHECK(get(num_data) == nullptr);
+
+    for ( unsigned i = 0; i < num_data; ++i )
+    {
+        void* p = find(i);
+        CHECK(p != nullptr);
+        CHECK(!memcmp(th->get_key(), &i, sizeof(i)));
+    }
+
+    for ( unsigned i = 0; i < num_data; i += 2 )
+        CHECK(remove(i));
+
+    CHECK(th->get_count() == num_data / 2);
+
+    for ( unsigned i = 1; i < num_data; i += 2 )
+        CHECK(find(i) != nullptr);
+
+    for ( unsigned i = 0; i < num_data; i += 2 )
+        CHECK(find(i) == nullptr);
+}
+
+TEST(tag_hash, clock)
+{
+    CHECK(th->first() == nullptr);
+
+    for ( unsigned i = 0; i < 4; ++i )
+        get(i);
+
+    // all referenced; the first lap clears them
+    void* p = th->first();
+    CHECK(p != nullptr);
+    CHECK(th->current() == p);
+
+    // touched entry gets another lap
+    CHECK(th->touch());
+    void* q = th->first();
+    CHECK(q != nullptr);
+    CHECK(q != p);
+
+    // removing at the hand moves current along
+    CHECK(th->remove());
+    CHECK(th->get_count() == 3);
+    CHECK(th->current() != q);
+
+    unsigned n = 0;
+
+    while ( th->first() )
+    {
+        CHECK(th->remove());
+        ++n;
+    }
+    CHECK(n == 3);
+    CHECK(th->get_count() == 0);
+}
+
+TEST(tag_hash, collisions)
+{
+    th->set_keyops(same_hash, test_compare);
+
+    // overflow several groups
+    for ( unsigned i = 0; i < 64; ++i )
+        CHECK(get(i) != nullptr);
+
+    for ( unsigned i = 0; i < 64; ++i )
+        CHECK(find(i) != nullptr);
+
+    // removing from the full home group must not hide the others
+    for ( unsigned i = 0; i < 8; ++i )
+        CHECK(remove(i));
+
+    for ( unsigned i = 8; i < 64; ++i )
+        CHECK(find(i) != nullptr);
+
+    // deleted slots are reused
+    for ( unsigned i = 0; i < 8; ++i )
+        CHECK(get(i) != nullptr);
+
+    CHECK(th->get_count() == 64);
+}
+
+//-------------------------------------------------------------------------
+// churn near the 7/8 load factor; deleted slots must not accumulate until
+// misses walk the whole table
+//-------------------------------------------------------------------------
+
+static const unsigned churn_rows = 1792;  // 2048 slots, 7/8 full
+
+struct ChurnData
+{
+    const TestKey* key;
+};
+
+static void move_churn(void* data, const void* key)
+{ ((ChurnData*)data)->key = (const TestKey*)key; }
+
+TEST_GROUP(tag_hash_churn)
+{
+    TagHash* th;
+    ChurnData data[churn_rows];
+
+    void setup() override
+    {
+        th = new TagHash(churn_rows, sizeof(TestKey));
+        th->set_keyops(test_hash, test_compare);
+        th->set_move_fcn(move_churn);
+
+        for ( unsigned i = 0; i < churn_rows; ++i )
+            th->push(data + i);
+    }
+
+    void teardown() override
+    {
+        delete th;
+    }
+
+    ChurnData* get(uint32_t id)
+    {
+        TestKey key = { id, { 0, 0, 0 } };
+        ChurnData* d = (ChurnData*)th->get(&key);
+
+        if ( d )
+            d->key = (const TestKey*)th->get_key();
+
+        return d;
+    }
+
+    ChurnData* find(uint32_t id)
+    {
+        TestKey key = { id, { 0, 0, 0 } };
+        return (ChurnData*)th->find(&key);
+    }
+
+    bool remove(uint32_t id)
+    {
+        TestKey key = { id, { 0, 0, 0 } };
+        return th->remove(&key);
+    }
+
+    unsigned probes(uint32_t id)
+    {
+        TestKey key = { id, { 0, 0, 0 } };
+        return th->get_probes(&key);
+    }
+};
+
+TEST(tag_hash_churn, probes_stay_bounded)
+{
+    uint32_t next_id = 0;
+    uint32_t live[churn_rows];
+
+    for ( unsigned i = 0; i < churn_rows; ++i )
+    {
+        live[i] = next_id++;
+        CHECK(get(live[i]) != nullptr);
+    }
+
+    uint32_t rnd = 12345;
+
+    for ( unsigned round = 0; round < 32; ++round )
+    {
+        // replace a random half
+        for ( unsigned n = 0; n < churn_rows / 2; ++n )
+        {
+            rnd = rnd * 1103515245 + 12345;
+            unsigned i = (rnd >> 8) % churn_rows;
+
+            CHECK(remove(live[i]));
+            live[i] = next_id++;
+            CHECK(get(live[i]) != nullptr);
+        }
+        CHECK(th->get_count() == churn_rows);
+
+        unsigned total = 0, most = 0;
+
+        for ( unsigned n = 0; n < 1000; ++n )
+        {
+            unsigned p = probes(next_id + 1000000 + n);
+            total += p;
+
+            if ( p > most )
+                most = p;
+        }
+        // a freshly filled table averages about 2 groups; without rehashing
+        // these reach the full 128 groups after a few rounds
+        CHECK(total / 1000 <= 8);
+        CHECK(most <= 48);
+    }
+
+    // entries moved by rehashing still have valid stored keys
+    for ( unsigned i = 0; i < churn_rows; ++i )
+    {
+        ChurnData* d = find(live[i]);
+        CHECK(d != nullptr);
+        CHECK(d->key == th->get_key());
+        CHECK(d->key->id == live[i]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
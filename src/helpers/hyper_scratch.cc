@@ -0,0 +1,88 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#include "hyper_scratch.h"
+
+#include <hs_runtime.h>
+
+#include "main/snort_config.h"
+#include "main/thread.h"
+
+bool HyperScratch::grow(SnortConfig* sc, Use u, const hs_database_t* db)
+{
+    // hs_alloc_scratch() reallocates the existing scratch if it is too
+    // small for the database
+    hs_scratch_t* s = sc->hyper_scratch[u];
+
+    if ( hs_alloc_scratch(db, &s) != HS_SUCCESS )
+        return false;
+
+    sc->hyper_scratch[u] = s;
+    return true;
+}
+
+void HyperScratch::setup(SnortConfig* sc)
+{
+    for ( unsigned i = 0; i < sc->num_slots; ++i )
+    {
+        SnortState* ss = sc->state + i;
+
+        for ( unsigned u = 0; u < MAX; ++u )
+        {
+            hs_scratch_t* s = nullptr;
+
+            if ( sc->hyper_scratch[u] )
+                hs_clone_scratch(sc->hyper_scratch[u], &s);
+
+            ss->hyper_scratch[u] = s;
+        }
+    }
+}
+
+void HyperScratch::cleanup(SnortConfig* sc)
+{
+    for ( unsigned i = 0; i < sc->num_slots; ++i )
+    {
+        SnortState* ss = sc->state + i;
+
+        for ( unsigned u = 0; u < MAX; ++u )
+        {
+            if ( ss->hyper_scratch[u] )
+            {
+                hs_free_scratch((hs_scratch_t*)ss->hyper_scratch[u]);
+                ss->hyper_scratch[u] = nullptr;
+            }
+        }
+    }
+
+    for ( unsigned u = 0; u < MAX; ++u )
+    {
+        if ( sc->hyper_scratch[u] )
+        {
+            hs_free_scratch(sc->hyper_scratch[u]);
+            sc->hyper_scratch[u] = nullptr;
+        }
+    }
+}
+
+hs_scratch_t* HyperScratch::get(Use u)
+{
+    SnortState* ss = snort_conf->state + get_instance_id();
+    return (hs_scratch_t*)ss->hyper_scratch[u];
+}
+
@@ -0,0 +1,57 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifndef HYPER_SCRATCH_H
+#define HYPER_SCRATCH_H
+
+// hyperscan scratch is managed per config.  as each database is compiled
+// on the main thread, the prototype scratch for its use is grown to cover
+// it.  setup then clones a scratch for each packet thread into the config's
+// SnortState.  on reload the new config gets its own scratch which packet
+// threads pick up when Swapper applies the new config so a scratch is never
+// resized while in use.
+//
+// hs_scan() can't be called on a scratch that is already in use.  fast
+// pattern matches may evaluate rules and hence ips options from the mpse
+// callback so the mpse and ips options need separate scratch.  ips options
+// don't nest so regex, sd_pattern, and pcre share one.
+
+#include "main/snort_types.h"
+
+struct SnortConfig;
+typedef struct hs_database hs_database_t;
+typedef struct hs_scratch hs_scratch_t;
+
+class SO_PUBLIC HyperScratch
+{
+public:
+    enum Use { MPSE, IPS, MAX };
+
+    // main thread; returns false if the scratch can't be allocated
+    static bool grow(SnortConfig*, Use, const hs_database_t*);
+
+    // clone the prototypes for each packet thread
+    static void setup(SnortConfig*);
+    static void cleanup(SnortConfig*);
+
+    // packet thread; null if no databases were added for the given use
+    static hs_scratch_t* get(Use);
+};
+
+#endif
+
@@ -22,6 +22,8 @@
 #include "config.h"
 #endif
 
+#include "ips_content.h"
+
 #include <errno.h>
 #ifdef DEBUG_MSGS
 # include <assert.h>
@@ -419,6 +421,12 @@ static int CheckANDPatternMatch(ContentData* idx, Cursor& c)
     }
 }
 
+int content_option_eval(void* v, Cursor& c, Packet*)
+{
+    ContentOption* opt = (ContentOption*)v;
+    return CheckANDPatternMatch(opt->get_data(), c);
+}
+
 //-------------------------------------------------------------------------
 // helper foo
 //-------------------------------------------------------------------------
@@ -1,5 +1,5 @@
 //--------------------------------------------------------------------------
-// Copyright (C) 2015-2016 Cisco and/or its affiliates. All rights reserved.
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
 //
 // This program is free software; you can redistribute it and/or modify it
 // under the terms of the GNU General Public License Version 2 as published
@@ -16,12 +16,15 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 //--------------------------------------------------------------------------
 
-#ifndef IPS_REGEX_H
-#define IPS_REGEX_H
+#ifndef IPS_CONTENT_H
+#define IPS_CONTENT_H
 
-struct SnortConfig;
-void regex_setup(SnortConfig*);
-void regex_cleanup(SnortConfig*);
+// direct evaluation for flat detection option trees
+
+class Cursor;
+struct Packet;
+
+int content_option_eval(void*, Cursor&, Packet*);
 
 #endif
 
@@ -39,6 +39,7 @@
 #include "stream/stream_api.h"
 #include "profiler/profiler.h"
 #include "detection/detection_defines.h"
+#include "detection/detection_options.h"
 #include "framework/ips_option.h"
 #include "framework/parameter.h"
 #include "framework/module.h"
@@ -263,6 +264,41 @@ int OtnFlowOnlyReassembled(OptTreeNode* otn)
     return 0;
 }
 
+uint32_t FlowQuickRejectNeeds(IpsOption* opt)
+{
+    if ( !opt or strcmp(opt->get_name(), s_name) )
+        return 0;
+
+    FlowCheckData* fcd = &((FlowCheckOption*)opt)->config;
+    uint32_t needs = 0;
+
+    if ( fcd->established )
+        needs |= QR_ESTABLISHED;
+
+    else if ( fcd->unestablished )
+        needs |= QR_UNESTABLISHED;
+
+    if ( fcd->from_client )
+        needs |= QR_CLIENT;
+
+    if ( fcd->from_server )
+        needs |= QR_SERVER;
+
+    if ( fcd->ignore_reassembled & IGNORE_STREAM )
+        needs |= QR_NO_STREAM;
+
+    if ( fcd->ignore_reassembled & IGNORE_FRAG )
+        needs |= QR_NO_FRAG;
+
+    if ( fcd->only_reassembled & ONLY_STREAM )
+        needs |= QR_ONLY_STREAM;
+
+    if ( fcd->only_reassembled & ONLY_FRAG )
+        needs |= QR_ONLY_FRAG;
+
+    return needs;
+}
+
 //-------------------------------------------------------------------------
 // support methods
 //-------------------------------------------------------------------------
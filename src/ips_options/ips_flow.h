@@ -21,12 +21,18 @@
 #ifndef IPS_FLOW_H
 #define IPS_FLOW_H
 
+#include <stdint.h>
+
 struct OptTreeNode;
+class IpsOption;
 
 int OtnFlowFromServer(OptTreeNode*);
 int OtnFlowFromClient(OptTreeNode*);
 int OtnFlowIgnoreReassembled(OptTreeNode*);
 int OtnFlowOnlyReassembled(OptTreeNode*);
 
+// quick reject bits required by a flow option; 0 for any other option
+uint32_t FlowQuickRejectNeeds(IpsOption*);
+
 #endif
 
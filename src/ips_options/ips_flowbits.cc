@@ -558,6 +558,12 @@ int FlowBits_SetOperation(void* option_data)
     return 0;
 }
 
+int flowbits_option_eval(void* v, Cursor& c, Packet* p)
+{
+    FlowBitsOption* opt = (FlowBitsOption*)v;
+    return opt->FlowBitsOption::eval(c, p);
+}
+
 //-------------------------------------------------------------------------
 // parsing methods
 //-------------------------------------------------------------------------
@@ -23,6 +23,11 @@
 void FlowbitResetCounts();
 int FlowBits_SetOperation(void*);
 
+// direct evaluation for flat detection option trees
+class Cursor;
+struct Packet;
+int flowbits_option_eval(void*, Cursor&, Packet*);
+
 void setFlowbitSize(unsigned);
 unsigned int getFlowbitSize();
 unsigned int getFlowbitSizeInBytes();
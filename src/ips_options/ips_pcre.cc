@@ -28,28 +28,44 @@
 #include <sys/types.h>
 #include <pcre.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_HYPERSCAN
+#include <hs_compile.h>
+#include <hs_runtime.h>
+#endif
+
 #include "main/snort_types.h"
 #include "main/snort_debug.h"
 #include "main/snort_config.h"
+#include "main/snort.h"
+#include "log/messages.h"
 #include "protocols/packet.h"
 #include "parser/parser.h"
 #include "utils/util.h"
 #include "utils/snort_bounds.h"
+#include "utils/stats.h"
 #include "hash/sfhashfcn.h"
+#include "helpers/hyper_scratch.h"
 #include "profiler/profiler.h"
 #include "detection/treenodes.h"
 #include "detection/detection_defines.h"
 #include "detection/detection_util.h"
+#include "detection/fp_detect.h"
 #include "framework/cursor.h"
 #include "framework/ips_option.h"
 #include "framework/parameter.h"
 #include "framework/module.h"
+#include "main/thread.h"
+#include "protocols/packet_manager.h"
 
 #ifndef PCRE_STUDY_JIT_COMPILE
-#define PCRE_STUDY_JIT_COMPILE 0
+#define NO_JIT // libpcre < 8.20
 #endif
 
-#define NO_JIT // uncomment to disable JIT for Xcode
+//#define NO_JIT // uncomment to disable JIT for Xcode
 
 #ifdef NO_JIT
 #define PCRE_STUDY_FLAGS 0
@@ -66,6 +82,13 @@
 
 #define s_name "pcre"
 
+// the jit stack starts small and grows as needed up to the max; a
+// separate stack is used by each packet thread.
+#define JIT_STACK_MIN  (32 * 1024)
+#define JIT_STACK_MAX (512 * 1024)
+
+struct PcreBatch;
+
 struct PcreData
 {
     pcre* re;           /* compiled regex */
@@ -73,6 +96,63 @@ struct PcreData
     bool free_pe;
     int options;        /* sp_pcre specfic options (relative & inverse) */
     char* expression;
+
+    char* pattern;      // regex without delimiters and flags
+    int compile_flags;  // pcre compile flags for pattern
+
+    const OptTreeNode* otn;  // first rule using this option
+    PcreBatch* batch;        // set by verify
+    unsigned id;             // index into batch
+    bool prefilter;          // pattern is in the batch database
+};
+
+// all pcre options from a config are collected in a batch.  the batch
+// has a hyperscan database compiled in prefilter mode from all compatible
+// patterns so that a single scan of a buffer determines which pcres can't
+// possibly match.  pcre_exec is only called for the rest.
+
+struct PcreSlot
+{
+#ifndef NO_JIT
+    pcre_jit_stack* jit_stack;
+#endif
+
+#ifdef HAVE_HYPERSCAN
+    // the last buffer scanned and the resulting hits
+    const uint8_t* buf;
+    unsigned len;
+    uint64_t pkt;
+    std::vector<bool> hits;  // indexed by option id
+#endif
+};
+
+struct PcreBatch
+{
+    std::vector<PcreData*> options;
+    std::vector<PcreSlot> slots;  // one per packet thread
+
+#ifdef HAVE_HYPERSCAN
+    hs_database_t* db = nullptr;
+#endif
+};
+
+struct PcreStats
+{
+    PegCount evals;
+    PegCount scans;
+    PegCount rejects;
+    PegCount execs;
+    PegCount errors;
+};
+
+static const PegInfo pcre_pegs[] =
+{
+    { "evals", "pcre options evaluated" },
+    { "prefilter scans", "buffers scanned with the batch prefilter" },
+    { "prefilter rejects", "pcre evaluations skipped by the batch prefilter" },
+    { "execs", "pcre_exec calls" },
+    { "errors", "pcre_exec calls that failed, eg due to match limits" },
+    { nullptr, nullptr }
 };
 
 /*
@@ -93,7 +173,12 @@ static int s_ovector_max = 0;
 // by verify; search uses the value in snort conf
 static int s_ovector_size = 0;
 
+// options parsed since the last verify; these are moved to the new
+// config's batch by verify
+static std::vector<PcreData*> s_pending;
+
 static THREAD_LOCAL ProfileStats pcrePerfStats;
+static THREAD_LOCAL PcreStats pcre_stats;
 
 //-------------------------------------------------------------------------
 // implementation foo
@@ -111,6 +196,19 @@ static void pcre_capture(
         s_ovector_size = tmp_ovector_size;
 }
 
+#ifndef NO_JIT
+// called by pcre_exec to get the jit stack for the current packet thread
+static pcre_jit_stack* pcre_get_jit_stack(void*)
+{
+    PcreBatch* batch = snort_conf->pcre_batch;
+
+    if ( !batch or batch->slots.empty() )
+        return nullptr;  // use the default machine stack
+
+    return batch->slots[get_instance_id()].jit_stack;
+}
+#endif
+
 static void pcre_check_anchored(PcreData* pcre_data)
 {
     int rc;
@@ -262,6 +360,9 @@ static void pcre_parse(const char* data, PcreData* pcre_data)
         opts++;
     }
 
+    pcre_data->pattern = snort_strdup(re);
+    pcre_data->compile_flags = compile_flags;
+
     /* now compile the re */
     DebugFormat(DEBUG_PATTERN_MATCH, "pcre: compiling %s\n", re);
     pcre_data->re = pcre_compile(re, compile_flags, &error, &erroffset, NULL);
@@ -278,6 +379,10 @@ static void pcre_parse(const char* data, PcreData* pcre_data)
 
     if (pcre_data->pe)
     {
+#ifndef NO_JIT
+        pcre_assign_jit_stack(pcre_data->pe, pcre_get_jit_stack, nullptr);
+#endif
+
         if ((SnortConfig::get_pcre_match_limit() != -1) &&
             !(pcre_data->options & SNORT_OVERRIDE_MATCH_LIMIT))
         {
@@ -405,6 +510,8 @@ static bool pcre_search(
         ss->pcre_ovector,      /* vector for substring information */
         snort_conf->pcre_ovector_size); /* number of elements in the vector */
 
+    ++pcre_stats.execs;
+
     if (result >= 0)
     {
         matched = true;
@@ -437,6 +544,7 @@ static bool pcre_search(
     else
     {
         DebugFormat(DEBUG_PATTERN_MATCH, "pcre_exec error : %d \n", result);
+        ++pcre_stats.errors;
         return false;
     }
 
@@ -449,6 +557,52 @@ static bool pcre_search(
     return matched;
 }
 
+#ifdef HAVE_HYPERSCAN
+static int pcre_hs_match(
+    unsigned int id, unsigned long long /*from*/, unsigned long long /*to*/,
+    unsigned int /*flags*/, void* context)
+{
+    std::vector<bool>* hits = (std::vector<bool>*)context;
+    (*hits)[id] = true;
+    return 0;
+}
+
+// returns false if the pattern can't match anywhere in the buffer.  the
+// whole buffer is scanned once per packet for all patterns in the batch
+// and the hits are cached for subsequent evaluations of the same buffer.
+static bool pcre_prefilter(const PcreData* pcre_data, const Cursor& c)
+{
+    // base64_data is rewritten by each base64_decode so the same buffer
+    // may hold different data for different rules in the same packet
+    if ( !pcre_data->prefilter or !c.size() or c.is("base64_data") )
+        return true;
+
+    PcreBatch* batch = pcre_data->batch;
+    PcreSlot& slot = batch->slots[get_instance_id()];
+
+    uint64_t pkt = rule_eval_pkt_count + PacketManager::get_rebuilt_packet_count();
+
+    if ( slot.buf != c.buffer() or slot.len != c.size() or slot.pkt != pkt )
+    {
+        std::fill(slot.hits.begin(), slot.hits.end(), false);
+
+        hs_error_t stat = hs_scan(
+            batch->db, (const char*)c.buffer(), c.size(), 0,
+            HyperScratch::get(HyperScratch::IPS), pcre_hs_match, &slot.hits);
+
+        // on error fall back to pcre for everything
+        if ( stat != HS_SUCCESS )
+            std::fill(slot.hits.begin(), slot.hits.end(), true);
+
+        slot.buf = c.buffer();
+        slot.len = c.size();
+        slot.pkt = pkt;
+        ++pcre_stats.scans;
+    }
+    return slot.hits[pcre_data->id];
+}
+#endif
+
 //-------------------------------------------------------------------------
 // class methods
 //-------------------------------------------------------------------------
@@ -489,9 +643,20 @@ PcreOption::~PcreOption()
     if ( !config )
         return;
 
+    if ( !config->batch )
+    {
+        auto it = std::find(s_pending.begin(), s_pending.end(), config);
+
+        if ( it != s_pending.end() )
+            s_pending.erase(it);
+    }
+
     if ( config->expression )
         snort_free(config->expression);
 
+    if ( config->pattern )
+        snort_free(config->pattern);
+
     if ( config->pe )
     {
         if ( config->free_pe )
@@ -597,6 +762,21 @@ int PcreOption::eval(Cursor& c, Packet*)
     if ( pos > c.size() )
         return DETECTION_OPTION_NO_MATCH;
 
+    ++pcre_stats.evals;
+
+#ifdef HAVE_HYPERSCAN
+    if ( !pcre_prefilter(pcre_data, c) )
+    {
+        // nothing in the buffer matches so only an inverted pcre matches
+        ++pcre_stats.rejects;
+
+        if ( pcre_data->options & SNORT_PCRE_INVERT )
+            return DETECTION_OPTION_MATCH;
+
+        return DETECTION_OPTION_NO_MATCH;
+    }
+#endif
+
     int found_offset = -1; // where is the ending location of the pattern
     bool matched = pcre_search(pcre_data, c.buffer(), c.size(), pos,
         &found_offset);
@@ -646,6 +826,27 @@ void pcre_setup(SnortConfig* sc)
         SnortState* ss = sc->state + i;
         ss->pcre_ovector = (int*)snort_calloc(s_ovector_max, sizeof(int));
     }
+
+    PcreBatch* batch = sc->pcre_batch;
+
+    if ( !batch )
+        return;
+
+    batch->slots.resize(sc->num_slots);
+
+    for ( auto& slot : batch->slots )
+    {
+#ifndef NO_JIT
+        slot.jit_stack = pcre_jit_stack_alloc(JIT_STACK_MIN, JIT_STACK_MAX);
+#endif
+
+#ifdef HAVE_HYPERSCAN
+        slot.buf = nullptr;
+        slot.len = 0;
+        slot.pkt = 0;
+        slot.hits.resize(batch->options.size());
+#endif
+    }
 }
 
 void pcre_cleanup(SnortConfig* sc)
@@ -659,6 +860,33 @@ void pcre_cleanup(SnortConfig* sc)
 
         ss->pcre_ovector = nullptr;
     }
+
+    PcreBatch* batch = sc->pcre_batch;
+
+    if ( !batch )
+        return;
+
+#ifndef NO_JIT
+    for ( auto& slot : batch->slots )
+    {
+        if ( slot.jit_stack )
+            pcre_jit_stack_free(slot.jit_stack);
+    }
+#endif
+
+#ifdef HAVE_HYPERSCAN
+    if ( batch->db )
+        hs_free_database(batch->db);
+#endif
+
+    delete batch;
+    sc->pcre_batch = nullptr;
+}
+
+int pcre_option_eval(void* v, Cursor& c, Packet* p)
+{
+    PcreOption* opt = (PcreOption*)v;
+    return opt->PcreOption::eval(c, p);
 }
 
 //-------------------------------------------------------------------------
@@ -691,6 +919,12 @@ public:
     ProfileStats* get_profile() const override
     { return &pcrePerfStats; }
 
+    const PegInfo* get_pegs() const override
+    { return pcre_pegs; }
+
+    PegCount* get_counts() const override
+    { return (PegCount*)&pcre_stats; }
+
     PcreData* get_data();
 
 private:
@@ -735,10 +969,12 @@ static void mod_dtor(Module* m)
     delete m;
 }
 
-static IpsOption* pcre_ctor(Module* p, OptTreeNode*)
+static IpsOption* pcre_ctor(Module* p, OptTreeNode* otn)
 {
     PcreModule* m = (PcreModule*)p;
     PcreData* d = m->get_data();
+    d->otn = otn;
+    s_pending.push_back(d);
     return new PcreOption(d);
 }
 
@@ -747,6 +983,179 @@ static void pcre_dtor(IpsOption* p)
     delete p;
 }
 
+#ifdef HAVE_HYPERSCAN
+// anchored patterns (A) are anchored at the cursor so they can't be
+// prefiltered from the start of the buffer.  other pcre specific flags
+// only restrict matches so the prefilter remains a superset.
+static bool pcre_get_expression(const PcreData* pd, std::string& re, unsigned& flags)
+{
+    if ( !pd->pattern or (pd->compile_flags & PCRE_ANCHORED) )
+        return false;
+
+    re = pd->pattern;
+
+    if ( pd->compile_flags & PCRE_EXTENDED )
+        re.insert(0, "(?x)");
+
+    flags = HS_FLAG_PREFILTER | HS_FLAG_SINGLEMATCH | HS_FLAG_ALLOWEMPTY;
+
+    if ( pd->compile_flags & PCRE_CASELESS )
+        flags |= HS_FLAG_CASELESS;
+
+    if ( pd->compile_flags & PCRE_DOTALL )
+        flags |= HS_FLAG_DOTALL;
+
+    if ( pd->compile_flags & PCRE_MULTILINE )
+        flags |= HS_FLAG_MULTILINE;
+
+    hs_expr_info_t* info = nullptr;
+    hs_compile_error_t* err = nullptr;
+
+    if ( hs_expression_info(re.c_str(), flags, &info, &err) != HS_SUCCESS )
+    {
+        hs_free_compile_error(err);
+        return false;
+    }
+    free(info);  // external allocation
+    return true;
+}
+
+// hs_expression_info() catches most unsupported expressions but some only
+// fail when compiled.  compiling each one is only done if the combined
+// compile fails so a bad expression costs n compiles rather than n^2.
+static bool pcre_compile_one(const std::string& re, unsigned flags)
+{
+    hs_database_t* db = nullptr;
+    hs_compile_error_t* err = nullptr;
+
+    if ( hs_compile(re.c_str(), flags, HS_MODE_BLOCK, nullptr, &db, &err) != HS_SUCCESS or !db )
+    {
+        hs_free_compile_error(err);
+        return false;
+    }
+    hs_free_database(db);
+    return true;
+}
+
+static bool pcre_compile_multi(
+    const std::vector<std::string>& exprs, const std::vector<unsigned>& flags,
+    const std::vector<unsigned>& ids, hs_database_t** db)
+{
+    std::vector<const char*> res;
+
+    for ( auto& re : exprs )
+        res.push_back(re.c_str());
+
+    hs_compile_error_t* err = nullptr;
+
+    if ( hs_compile_multi(&res[0], &flags[0], &ids[0], res.size(), HS_MODE_BLOCK,
+        nullptr, db, &err) == HS_SUCCESS and *db )
+        return true;
+
+    hs_free_compile_error(err);
+    *db = nullptr;
+    return false;
+}
+
+// patterns that couldn't be added to the batch database always fall back
+// to pcre_exec.  these are listed by sid at startup so they can be tuned.
+static void pcre_show_fallbacks(const PcreBatch* batch)
+{
+    std::vector<const OptTreeNode*> fallbacks;
+
+    for ( auto* pd : batch->options )
+    {
+        if ( !pd->prefilter )
+            fallbacks.push_back(pd->otn);
+    }
+
+    if ( fallbacks.empty() )
+        return;
+
+    std::sort(fallbacks.begin(), fallbacks.end(),
+        [](const OptTreeNode* a, const OptTreeNode* b)
+        {
+            if ( a->sigInfo.generator != b->sigInfo.generator )
+                return a->sigInfo.generator < b->sigInfo.generator;
+            return a->sigInfo.id < b->sigInfo.id;
+        });
+
+    LogLabel("pcre fallbacks (gid:sid)");
+
+    for ( const auto* otn : fallbacks )
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%u:%u", otn->sigInfo.generator, otn->sigInfo.id);
+        LogMessage("%25.25s\n", buf);
+    }
+}
+
+static void pcre_compile_batch(SnortConfig* sc, PcreBatch* batch)
+{
+    std::vector<std::string> exprs;
+    std::vector<unsigned> flags;
+    std::vector<unsigned> ids;
+
+    for ( auto* pd : batch->options )
+    {
+        std::string re;
+        unsigned f;
+
+        if ( !pcre_get_expression(pd, re, f) )
+            continue;
+
+        exprs.push_back(re);
+        flags.push_back(f);
+        ids.push_back(pd->id);
+    }
+
+    if ( exprs.empty() )
+        return;
+
+    if ( !pcre_compile_multi(exprs, flags, ids, &batch->db) )
+    {
+        // drop every expression that fails by itself and try once more
+        unsigned n = 0;
+
+        for ( unsigned i = 0; i < exprs.size(); ++i )
+        {
+            if ( !pcre_compile_one(exprs[i], flags[i]) )
+                continue;
+
+            exprs[n] = exprs[i];
+            flags[n] = flags[i];
+            ids[n++] = ids[i];
+        }
+        exprs.resize(n);
+        flags.resize(n);
+        ids.resize(n);
+
+        if ( exprs.empty() or !pcre_compile_multi(exprs, flags, ids, &batch->db) )
+        {
+            ParseWarning(WARN_RULES, "pcre batch prefilter disabled");
+            return;
+        }
+    }
+
+    if ( !HyperScratch::grow(sc, HyperScratch::IPS, batch->db) )
+    {
+        ParseWarning(WARN_RULES, "pcre batch prefilter disabled");
+        hs_free_database(batch->db);
+        batch->db = nullptr;
+        return;
+    }
+
+    for ( auto id : ids )
+        batch->options[id]->prefilter = true;
+
+    LogMessage("pcre batch prefilter: %zu of %zu patterns\n",
+        ids.size(), batch->options.size());
+
+    if ( !Snort::is_reloading() )
+        pcre_show_fallbacks(batch);
+}
+#endif
+
 static void pcre_verify(SnortConfig* sc)
 {
     /* The pcre_fullinfo() function can be used to find out how many
@@ -762,6 +1171,23 @@ static void pcre_verify(SnortConfig* sc)
 
     sc->pcre_ovector_size = s_ovector_size;
     s_ovector_size = 0;
+
+    assert(!sc->pcre_batch);
+    PcreBatch* batch = new PcreBatch;
+
+    batch->options.swap(s_pending);
+
+    for ( unsigned i = 0; i < batch->options.size(); ++i )
+    {
+        batch->options[i]->batch = batch;
+        batch->options[i]->id = i;
+    }
+
+#ifdef HAVE_HYPERSCAN
+    pcre_compile_batch(sc, batch);
+#endif
+
+    sc->pcre_batch = batch;
 }
 
 static const IpsApi pcre_api =
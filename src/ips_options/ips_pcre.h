@@ -24,5 +24,10 @@ struct SnortConfig;
 void pcre_setup(SnortConfig*);
 void pcre_cleanup(SnortConfig*);
 
+// direct evaluation for flat detection option trees
+class Cursor;
+struct Packet;
+int pcre_option_eval(void*, Cursor&, Packet*);
+
 #endif
 
@@ -19,8 +19,6 @@
 // ips_regex.cc author Russ Combs <rucombs@cisco.com>
 // FIXIT-M add ! and anchor support like pcre and update retry
 
-#include "ips_regex.h"
-
 #include <assert.h>
 #include <string.h>
 #include <string>
@@ -34,6 +32,7 @@
 #include "detection/detection_defines.h"
 #include "detection/pattern_match_data.h"
 #include "hash/sfhashfcn.h"
+#include "helpers/hyper_scratch.h"
 #include "main/snort_config.h"
 #include "main/thread.h"
 #include "parser/parser.h"
@@ -64,17 +63,6 @@ struct RegexConfig
     }
 };
 
-// we need to update scratch in the main thread as each pattern is processed
-// and then clone to thread specific after all rules are loaded.  s_scratch is
-// a prototype that is large enough for all uses.
-
-// FIXIT-L s_scratch persists for the lifetime of the program.  it is
-// modeled off 2X where, due to so rule processing at startup, it is necessary
-// to monotonically grow the ovector.  however, we should be able to free
-// s_scratch after cloning since so rules are now parsed the same as text
-// rules.
-
-static hs_scratch_t* s_scratch = nullptr;
 static THREAD_LOCAL unsigned s_to = 0;
 static THREAD_LOCAL ProfileStats regex_perf_stats;
 
@@ -112,13 +100,6 @@ RegexOption::RegexOption(const RegexConfig& c) :
     IpsOption(s_name, RULE_OPTION_TYPE_CONTENT)
 {
     config = c;
-
-    if ( /*hs_error_t err =*/ hs_alloc_scratch(config.db, &s_scratch) )
-    {
-        // FIXIT-L why is this failing but everything is working?
-        //ParseError("can't initialize regex for '%s' (%d) %p",
-        //    config.re.c_str(), err, s_scratch);
-    }
     config.pmd.pattern_buf = config.re.c_str();
     config.pmd.pattern_size = config.re.size();
     config.pmd.fp_length = config.pmd.pattern_size;
@@ -180,14 +161,14 @@ int RegexOption::eval(Cursor& c, Packet*)
     if ( pos > c.size() )
         return DETECTION_OPTION_NO_MATCH;
 
-    SnortState* ss = snort_conf->state + get_instance_id();
-    assert(ss->regex_scratch);
+    hs_scratch_t* scratch = HyperScratch::get(HyperScratch::IPS);
+    assert(scratch);
 
     s_to = 0;
 
     hs_error_t stat = hs_scan(
         config.db, (char*)c.buffer()+pos, c.size()-pos, 0,
-        (hs_scratch_t*)ss->regex_scratch, hs_match, nullptr);
+        scratch, hs_match, nullptr);
 
     if ( s_to and stat == HS_SCAN_TERMINATED )
     {
@@ -290,7 +271,7 @@ bool RegexModule::set(const char*, Value& v, SnortConfig*)
     return true;
 }
 
-bool RegexModule::end(const char*, int, SnortConfig*)
+bool RegexModule::end(const char*, int, SnortConfig* sc)
 {
     hs_compile_error_t* err = nullptr;
 
@@ -301,38 +282,13 @@ bool RegexModule::end(const char*, int, SnortConfig*)
         hs_free_compile_error(err);
         return false;
     }
-    return true;
-}
-
-//-------------------------------------------------------------------------
-// public methods
-//-------------------------------------------------------------------------
-
-void regex_setup(SnortConfig* sc)
-{
-    for ( unsigned i = 0; i < sc->num_slots; ++i )
-    {
-        SnortState* ss = sc->state + i;
-
-        if ( s_scratch )
-            hs_clone_scratch(s_scratch, (hs_scratch_t**)&ss->regex_scratch);
-        else
-            ss->regex_scratch = nullptr;
-    }
-}
 
-void regex_cleanup(SnortConfig* sc)
-{
-    for ( unsigned i = 0; i < sc->num_slots; ++i )
+    if ( !HyperScratch::grow(sc, HyperScratch::IPS, config.db) )
     {
-        SnortState* ss = sc->state + i;
-
-        if ( ss->regex_scratch )
-        {
-            hs_free_scratch((hs_scratch_t*)ss->regex_scratch);
-            ss->regex_scratch = nullptr;
-        }
+        ParseError("can't allocate scratch for regex '%s'", config.re.c_str());
+        return false;
     }
+    return true;
 }
 
 //-------------------------------------------------------------------------
@@ -356,14 +312,6 @@ static IpsOption* regex_ctor(Module* m, OptTreeNode*)
 static void regex_dtor(IpsOption* p)
 { delete p; }
 
-static void regex_pterm(SnortConfig*)
-{
-    if ( s_scratch )
-        hs_free_scratch(s_scratch);
-
-    s_scratch = nullptr;
-}
-
 static const IpsApi regex_api =
 {
     {
@@ -381,7 +329,7 @@ static const IpsApi regex_api =
     OPT_TYPE_DETECTION,
     0, 0,
     nullptr,
-    regex_pterm,
+    nullptr,
     nullptr,
     nullptr,
     regex_ctor,
@@ -18,11 +18,12 @@
 
 // ips_sd_pattern.cc author Victor Roemer <viroemer@cisco.com>
 
-// FIXIT-M use Hyperscan
-
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "framework/cursor.h"
 #include "framework/ips_option.h"
@@ -35,8 +36,18 @@
 #include "parser/parser.h"
 #include "profiler/profiler.h"
 #include "sd_pattern_match.h"
+#include "log/messages.h"
 #include "log/obfuscator.h"
 
+#ifdef HAVE_HYPERSCAN
+#include <hs_compile.h>
+#include <hs_runtime.h>
+
+#include "helpers/hyper_scratch.h"
+#include "protocols/packet_manager.h"
+#include "utils/stats.h"
+#endif
+
 #define s_name "sd_pattern"
 #define s_help "rule option for detecting sensitive data"
 
@@ -49,6 +60,47 @@ struct SdPatternConfig
 
 static THREAD_LOCAL ProfileStats sd_pattern_perf_stats;
 
+#ifdef HAVE_HYPERSCAN
+// all sd_pattern options in a config share one database with a regex for
+// each distinct pattern.  the regexes match a superset of
+// SdOptionData::match() so each buffer is scanned once per packet and
+// match(), including validation such as Luhn, is only tried where a
+// pattern may start.
+
+struct SdRegex
+{
+    unsigned min_len;
+    unsigned max_len;
+};
+
+struct SdDatabase
+{
+    hs_database_t* db = nullptr;
+    std::vector<SdRegex> regexes;  // indexed by hs id
+    unsigned gen = 0;
+    unsigned refs = 0;
+};
+
+// the regex match ends for the last buffer scanned; shared by all
+// sd_pattern options evaluated on that buffer
+struct SdCache
+{
+    unsigned gen = 0;
+    const uint8_t* buf = nullptr;
+    unsigned len = 0;
+    uint64_t pkt = 0;
+    std::vector<std::vector<unsigned>> ends;  // indexed by hs id
+};
+
+class SdPatternOption;
+
+// options parsed since the last verify
+static std::vector<SdPatternOption*> s_pending;
+static unsigned s_gen = 0;
+
+static THREAD_LOCAL SdCache* s_cache = nullptr;
+#endif
+
 //-------------------------------------------------------------------------
 // option
 //-------------------------------------------------------------------------
@@ -64,24 +116,145 @@ public:
 
     int eval(Cursor&, Packet* p) override;
 
+#ifdef HAVE_HYPERSCAN
+    bool get_regex(std::string& re, unsigned& min_len, unsigned& max_len) const
+    { return opt->get_regex(re, min_len, max_len); }
+
+    void set_database(SdDatabase*, int id);
+#endif
+
 private:
     unsigned SdSearch(Cursor&, Packet*);
 
+#ifdef HAVE_HYPERSCAN
+    const std::vector<unsigned>* get_ends(const Cursor&);
+    const uint8_t* next_start(const std::vector<unsigned>&, unsigned&, const uint8_t*, unsigned);
+#endif
+
     const SdPatternConfig config;
     SdOptionData* opt;
+
+#ifdef HAVE_HYPERSCAN
+    SdDatabase* sdb = nullptr;
+    int hs_id = -1;
+#endif
 };
 
 SdPatternOption::SdPatternOption(const SdPatternConfig& c) :
     IpsOption(s_name, RULE_OPTION_TYPE_BUFFER_USE), config(c)
 {
     opt = new SdOptionData(config.pii, config.obfuscate_pii);
+
+#ifdef HAVE_HYPERSCAN
+    s_pending.push_back(this);
+#endif
 }
 
 SdPatternOption::~SdPatternOption()
 {
+#ifdef HAVE_HYPERSCAN
+    auto it = std::find(s_pending.begin(), s_pending.end(), this);
+
+    if ( it != s_pending.end() )
+        s_pending.erase(it);
+
+    if ( sdb and !--sdb->refs )
+    {
+        if ( sdb->db )
+            hs_free_database(sdb->db);
+
+        delete sdb;
+    }
+#endif
+
     delete opt;
 }
 
+#ifdef HAVE_HYPERSCAN
+void SdPatternOption::set_database(SdDatabase* d, int id)
+{
+    sdb = d;
+    hs_id = id;
+    ++sdb->refs;
+}
+
+static int sd_hs_match(
+    unsigned int id, unsigned long long /*from*/, unsigned long long to,
+    unsigned int /*flags*/, void* context)
+{
+    std::vector<std::vector<unsigned>>* ends = (std::vector<std::vector<unsigned>>*)context;
+    (*ends)[id].push_back((unsigned)to);
+    return 0;
+}
+
+// returns the sorted regex match ends for this option's pattern or null
+// if the buffer must be searched exhaustively
+const std::vector<unsigned>* SdPatternOption::get_ends(const Cursor& c)
+{
+    // base64_data is rewritten by each base64_decode so the same buffer
+    // may hold different data for different rules in the same packet
+    if ( hs_id < 0 or c.is("base64_data") )
+        return nullptr;
+
+    hs_scratch_t* scratch = HyperScratch::get(HyperScratch::IPS);
+
+    if ( !scratch )
+        return nullptr;
+
+    if ( !s_cache )
+        s_cache = new SdCache;
+
+    uint64_t pkt = get_packet_number() + PacketManager::get_rebuilt_packet_count();
+
+    if ( s_cache->gen != sdb->gen or s_cache->buf != c.buffer() or
+        s_cache->len != c.size() or s_cache->pkt != pkt )
+    {
+        s_cache->ends.resize(sdb->regexes.size());
+
+        for ( auto& v : s_cache->ends )
+            v.clear();
+
+        if ( hs_scan(sdb->db, (const char*)c.buffer(), c.size(), 0, scratch,
+            sd_hs_match, &s_cache->ends) != HS_SUCCESS )
+        {
+            s_cache->gen = 0;
+            return nullptr;
+        }
+
+        for ( auto& v : s_cache->ends )
+            std::sort(v.begin(), v.end());
+
+        s_cache->gen = sdb->gen;
+        s_cache->buf = c.buffer();
+        s_cache->len = c.size();
+        s_cache->pkt = pkt;
+    }
+    return &s_cache->ends[hs_id];
+}
+
+// returns the first possible match start at or after buf or null if there
+// are no more.  idx is the index of the first regex match end that may be
+// used and is advanced as buf moves forward.
+const uint8_t* SdPatternOption::next_start(
+    const std::vector<unsigned>& ends, unsigned& idx, const uint8_t* buf, unsigned off)
+{
+    const SdRegex& r = sdb->regexes[hs_id];
+
+    while ( idx < ends.size() and ends[idx] - r.min_len < off )
+        ++idx;
+
+    if ( idx == ends.size() )
+        return nullptr;
+
+    unsigned start = ends[idx] > r.max_len ? ends[idx] - r.max_len : 0;
+
+    if ( start > off )
+        return buf + (start - off);
+
+    return buf;
+}
+#endif
+
 uint32_t SdPatternOption::hash() const
 {
     uint32_t a = 0, b = 0, c = 0;
@@ -112,9 +285,27 @@ unsigned SdPatternOption::SdSearch(Cursor& c, Packet* p)
     uint16_t buflen = c.length();
     const uint8_t* const end = buf + buflen;
 
+#ifdef HAVE_HYPERSCAN
+    const std::vector<unsigned>* ends = get_ends(c);
+    unsigned idx = 0;
+#endif
+
     unsigned count = 0;
     while (buf < end && count < config.threshold)
     {
+#ifdef HAVE_HYPERSCAN
+        if ( ends )
+        {
+            // skip ahead to where a match may start
+            const uint8_t* next = next_start(*ends, idx, buf, buf - start);
+
+            if ( !next or next >= end )
+                break;
+
+            buflen -= next - buf;
+            buf = next;
+        }
+#endif
         uint16_t match_len = 0;
 
         if ( opt->match(buf, &match_len, buflen) )
@@ -237,6 +428,84 @@ static IpsOption* sd_pattern_ctor(Module* m, OptTreeNode*)
 static void sd_pattern_dtor(IpsOption* p)
 { delete p; }
 
+#ifdef HAVE_HYPERSCAN
+static void sd_pattern_tterm(SnortConfig*)
+{
+    delete s_cache;
+    s_cache = nullptr;
+}
+
+// compile all patterns parsed for this config into one database.  options
+// whose pattern can't be translated search exhaustively.
+static void sd_pattern_verify(SnortConfig* sc)
+{
+    std::vector<std::pair<SdPatternOption*, int>> opts;
+    std::map<std::string, unsigned> ids;
+    std::vector<std::string> exprs;
+    std::vector<SdRegex> regexes;
+
+    for ( auto* p : s_pending )
+    {
+        std::string re;
+        SdRegex r;
+
+        if ( !p->get_regex(re, r.min_len, r.max_len) )
+            continue;
+
+        auto it = ids.find(re);
+
+        if ( it == ids.end() )
+        {
+            it = ids.insert(std::make_pair(re, exprs.size())).first;
+            exprs.push_back(re);
+            regexes.push_back(r);
+        }
+        opts.push_back(std::make_pair(p, it->second));
+    }
+    s_pending.clear();
+
+    if ( exprs.empty() )
+        return;
+
+    std::vector<const char*> pats;
+    std::vector<unsigned> flags(exprs.size(), HS_FLAG_DOTALL);
+    std::vector<unsigned> hs_ids;
+
+    for ( unsigned i = 0; i < exprs.size(); ++i )
+    {
+        pats.push_back(exprs[i].c_str());
+        hs_ids.push_back(i);
+    }
+
+    hs_database_t* db = nullptr;
+    hs_compile_error_t* err = nullptr;
+
+    if ( hs_compile_multi(&pats[0], &flags[0], &hs_ids[0], pats.size(), HS_MODE_BLOCK,
+        nullptr, &db, &err) != HS_SUCCESS or !db )
+    {
+        ParseWarning(WARN_RULES, "can't compile sd_pattern database: %s",
+            err ? err->message : "unknown error");
+        hs_free_compile_error(err);
+        return;
+    }
+
+    if ( !HyperScratch::grow(sc, HyperScratch::IPS, db) )
+    {
+        ParseWarning(WARN_RULES, "can't allocate sd_pattern scratch");
+        hs_free_database(db);
+        return;
+    }
+
+    SdDatabase* sdb = new SdDatabase;
+    sdb->db = db;
+    sdb->regexes.swap(regexes);
+    sdb->gen = ++s_gen;
+
+    for ( auto& p : opts )
+        p.first->set_database(sdb, p.second);
+}
+#endif
+
 static const IpsApi sd_pattern_api =
 {
     {
@@ -256,10 +525,18 @@ static const IpsApi sd_pattern_api =
     nullptr,
     nullptr,
     nullptr,
+#ifdef HAVE_HYPERSCAN
+    sd_pattern_tterm,
+#else
     nullptr,
+#endif
     sd_pattern_ctor,
     sd_pattern_dtor,
+#ifdef HAVE_HYPERSCAN
+    sd_pattern_verify
+#else
     nullptr
+#endif
 };
 
 #ifdef BUILDING_SO
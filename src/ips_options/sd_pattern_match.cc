@@ -250,3 +250,96 @@ match__rescan:
     return true;
 }
 
+#ifdef HAVE_HYPERSCAN
+static void add_literal(std::string& re, char c)
+{
+    char hex[8];
+    snprintf(hex, sizeof(hex), "\\x%02x", (uint8_t)c);
+    re += hex;
+}
+
+// translate the pattern into a Hyperscan regex that matches a superset of
+// what match() accepts.  \b matches a non-digit or nothing so it is only
+// supported as the first and / or last token and is dropped from the
+// regex.  a match() that starts at s ends a regex match at some e with s
+// in [e - max_len, e - min_len].  returns false if the pattern can't be
+// translated.
+bool SdOptionData::get_regex(std::string& re, unsigned& min_len, unsigned& max_len) const
+{
+    const char* pc = pattern;
+    bool lead = false;
+
+    re.clear();
+    min_len = max_len = 0;
+
+    while ( pc and *pc )
+    {
+        std::string tok;
+        const char* next;
+
+        if ( pc[0] == '\\' && pc[1] != '\0' )
+        {
+            next = pc + 2;
+
+            switch ( pc[1] )
+            {
+            case 'b':
+                if ( next[0] == '?' )
+                    return false;
+
+                if ( pc == pattern )
+                    lead = true;
+
+                else if ( next[0] != '\0' )
+                    return false;
+
+                pc = next;
+                continue;
+
+            case 'd': tok = "[0-9]"; break;
+            case 'D': tok = "[^0-9]"; break;
+            case 'w': tok = "[0-9A-Za-z]"; break;
+            case 'W': tok = "[^0-9A-Za-z]"; break;
+            case 'l': tok = "[A-Za-z]"; break;
+            case 'L': tok = "[^A-Za-z]"; break;
+
+            case '\\':
+            case '{':
+            case '}':
+            case '?':
+                add_literal(tok, pc[1]);
+                break;
+
+            // match() doesn't check other escapes
+            default: tok = "."; break;
+            }
+        }
+        else
+        {
+            next = pc + 1;
+            add_literal(tok, pc[0]);
+        }
+
+        re += tok;
+        ++max_len;
+
+        if ( next[0] == '?' )
+        {
+            re += '?';
+            ++next;
+        }
+        else
+            ++min_len;
+
+        pc = next;
+    }
+
+    if ( !min_len )
+        return false;
+
+    if ( lead )
+        ++max_len;
+
+    return true;
+}
+#endif
@@ -22,8 +22,13 @@
 #ifndef SD_PATTERN_MATCH_H
 #define SD_PATTERN_MATCH_H
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <iostream>
 #include <stdint.h>
+#include <string>
 #include "utils/util.h"
 
 #define SD_SOCIAL_PATTERN          "\\b\\d{3}-\\d{2}-\\d{4}\\b"
@@ -43,6 +48,10 @@ public:
     void ExpandBrackets();
     bool match(const uint8_t* const buf, uint16_t* const buf_index, uint16_t buflen);
 
+#ifdef HAVE_HYPERSCAN
+    bool get_regex(std::string& re, unsigned& min_len, unsigned& max_len) const;
+#endif
+
 private:
     char* pattern;
     int (*validate)(const uint8_t* buf, uint32_t buflen) = nullptr;
@@ -0,0 +1,474 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// ips_pcre_test.cc
+// checks that pcres the batch prefilter can't compile fall back to
+// pcre_exec, are listed once at startup, and cost a bounded number of
+// hyperscan compiles
+
+#include <hs_compile.h>
+#include <hs_runtime.h>
+#include <stdarg.h>
+
+#include <algorithm>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "framework/base_api.h"
+#include "framework/counts.h"
+#include "framework/cursor.h"
+#include "framework/ips_option.h"
+#include "framework/module.h"
+#include "detection/detection_defines.h"
+#include "detection/treenodes.h"
+#include "helpers/hyper_scratch.h"
+#include "ips_options/ips_pcre.h"
+#include "main/snort.h"
+#include "main/snort_config.h"
+#include "main/snort_debug.h"
+#include "profiler/memory_profiler_defs.h"
+#include "protocols/packet.h"
+#include "protocols/packet_manager.h"
+
+// must appear after snort_config.h to avoid broken c++ map include
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+//-------------------------------------------------------------------------
+// hyperscan spies
+//-------------------------------------------------------------------------
+
+// the prefilter database is faked with std::regex so compile failures can
+// be injected.  an expression with a callout passes hs_expression_info()
+// but fails to compile, like those only rejected by a full compile.
+
+static unsigned s_compile_one = 0;
+static unsigned s_compile_multi = 0;
+
+struct hs_database
+{
+    std::vector<std::regex> res;
+    std::vector<unsigned> ids;
+};
+
+struct hs_scratch { };
+static hs_scratch s_scratch;
+
+static bool compiles(const char* re)
+{ return !strstr(re, "(?C"); }
+
+static hs_compile_error_t* compile_error()
+{
+    hs_compile_error_t* err = new hs_compile_error_t;
+    err->message = nullptr;
+    err->expression = 0;
+    return err;
+}
+
+static std::regex get_regex(const char* re, unsigned flags)
+{
+    auto f = std::regex::ECMAScript;
+
+    if ( flags & HS_FLAG_CASELESS )
+        f |= std::regex::icase;
+
+    return std::regex(re, f);
+}
+
+hs_error_t hs_expression_info(
+    const char*, unsigned, hs_expr_info_t** info, hs_compile_error_t**)
+{
+    *info = (hs_expr_info_t*)calloc(1, sizeof(hs_expr_info_t));
+    return HS_SUCCESS;
+}
+
+hs_error_t hs_compile(
+    const char* re, unsigned flags, unsigned, const hs_platform_info_t*,
+    hs_database_t** db, hs_compile_error_t** err)
+{
+    ++s_compile_one;
+
+    if ( !compiles(re) )
+    {
+        *db = nullptr;
+        *err = compile_error();
+        return HS_COMPILER_ERROR;
+    }
+    *db = new hs_database;
+    (*db)->res.push_back(get_regex(re, flags));
+    (*db)->ids.push_back(0);
+    return HS_SUCCESS;
+}
+
+hs_error_t hs_compile_multi(
+    const char* const* res, const unsigned* flags, const unsigned* ids, unsigned n,
+    unsigned, const hs_platform_info_t*, hs_database_t** db, hs_compile_error_t** err)
+{
+    ++s_compile_multi;
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        if ( !compiles(res[i]) )
+        {
+            *db = nullptr;
+            *err = compile_error();
+            (*err)->expression = i;
+            return HS_COMPILER_ERROR;
+        }
+    }
+    *db = new hs_database;
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        (*db)->res.push_back(get_regex(res[i], flags[i]));
+        (*db)->ids.push_back(ids[i]);
+    }
+    return HS_SUCCESS;
+}
+
+hs_error_t hs_free_compile_error(hs_compile_error_t* err)
+{
+    delete err;
+    return HS_SUCCESS;
+}
+
+hs_error_t hs_free_database(hs_database_t* db)
+{
+    delete db;
+    return HS_SUCCESS;
+}
+
+hs_error_t hs_scan(
+    const hs_database_t* db, const char* data, unsigned len, unsigned,
+    hs_scratch_t*, match_event_handler cb, void* ctx)
+{
+    for ( unsigned i = 0; i < db->res.size(); ++i )
+    {
+        if ( std::regex_search(data, data + len, db->res[i]) )
+            cb(db->ids[i], 0, 0, 0, ctx);
+    }
+    return HS_SUCCESS;
+}
+
+bool HyperScratch::grow(SnortConfig*, Use, const hs_database_t*)
+{ return true; }
+
+hs_scratch_t* HyperScratch::get(Use)
+{ return &s_scratch; }
+
+//-------------------------------------------------------------------------
+// stubs, spies, etc.
+//-------------------------------------------------------------------------
+
+extern const BaseApi* ips_pcre;
+
+// everything logged at startup
+static std::vector<std::string> s_log;
+static unsigned s_warnings = 0;
+static bool s_reloading = false;
+
+void LogMessage(const char* fmt, ...)
+{
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    std::string s(buf);
+    s.erase(0, s.find_first_not_of(' '));
+    s.erase(s.find_last_not_of(" \n") + 1);
+    s_log.push_back(s);
+}
+
+void LogLabel(const char* s, FILE*)
+{ s_log.push_back(s); }
+
+void ParseError(const char*, ...) { }
+
+void ParseWarning(WarningGroup, const char*, ...)
+{ ++s_warnings; }
+
+bool Snort::is_reloading()
+{ return s_reloading; }
+
+void mix_str(uint32_t& a, uint32_t&, uint32_t&, const char* s, unsigned)
+{ a += strlen(s); }
+
+Packet::Packet(bool) { obfuscator = nullptr; }
+Packet::~Packet() { }
+
+Cursor::Cursor(Packet* p)
+{ set("pkt_data", p->data, p->dsize); }
+
+SnortConfig s_conf;
+THREAD_LOCAL SnortConfig* snort_conf = &s_conf;
+
+static SnortState s_state;
+
+SnortConfig::SnortConfig()
+{
+    state = &s_state;
+    memset(state, 0, sizeof(*state));
+    num_slots = 1;
+    pcre_match_limit = -1;
+    pcre_match_limit_recursion = -1;
+}
+
+SnortConfig::~SnortConfig() { }
+
+unsigned get_instance_id()
+{ return 0; }
+
+FileIdentifier::~FileIdentifier() { }
+
+FileVerdict FilePolicy::type_lookup(Flow*, FileContext*)
+{ return FILE_VERDICT_UNKNOWN; }
+
+FileVerdict FilePolicy::type_lookup(Flow*, FileInfo*)
+{ return FILE_VERDICT_UNKNOWN; }
+
+FileVerdict FilePolicy::signature_lookup(Flow*, FileContext*)
+{ return FILE_VERDICT_UNKNOWN; }
+
+FileVerdict FilePolicy::signature_lookup(Flow*, FileInfo*)
+{ return FILE_VERDICT_UNKNOWN; }
+
+MemoryContext::MemoryContext(MemoryTracker&) { }
+MemoryContext::~MemoryContext() { }
+
+void show_stats(PegCount*, const PegInfo*, unsigned, const char*) { }
+void show_stats(PegCount*, const PegInfo*, IndexVec&, const char*, FILE*) { }
+
+#ifdef DEBUG_MSGS
+void Debug::print(const char*, int, uint64_t, const char*, ...) { }
+#endif
+
+// each eval is a new packet so the cached scan is never reused
+THREAD_LOCAL uint64_t rule_eval_pkt_count = 0;
+
+uint64_t PacketManager::get_rebuilt_packet_count()
+{ return 0; }
+
+// released with snort_free()
+char* snort_strdup(const char* s)
+{
+    char* d = (char*)snort_calloc(strlen(s) + 1);
+    strcpy(d, s);
+    return d;
+}
+
+//-------------------------------------------------------------------------
+// helpers
+//-------------------------------------------------------------------------
+
+enum { EVALS, SCANS, REJECTS, EXECS, ERRORS };
+
+class PcreRules
+{
+public:
+    PcreRules()
+    {
+        mod = ips_pcre->mod_ctor();
+        api = (const IpsApi*)ips_pcre;
+        s_log.clear();
+        s_warnings = 0;
+        s_compile_one = s_compile_multi = 0;
+
+        for ( unsigned i = 0; mod->get_pegs()[i].name; ++i )
+            mod->get_counts()[i] = 0;
+    }
+
+    ~PcreRules()
+    {
+        for ( auto opt : opts )
+            api->dtor(opt);
+
+        pcre_cleanup(snort_conf);
+        ips_pcre->mod_dtor(mod);
+
+        for ( auto otn : otns )
+            delete otn;
+    }
+
+    // sids are 1, 2, ... in the order added
+    void add(const char* re)
+    {
+        mod->begin(ips_pcre->name, 0, snort_conf);
+
+        Value v(re);
+        v.set(mod->get_parameters());
+        mod->set(ips_pcre->name, v, snort_conf);
+        mod->end(ips_pcre->name, 0, snort_conf);
+
+        OptTreeNode* otn = new OptTreeNode;
+        memset(otn, 0, sizeof(*otn));
+        otn->sigInfo.generator = 1;
+        otn->sigInfo.id = otns.size() + 1;
+        otns.push_back(otn);
+
+        opts.push_back(api->ctor(mod, otn));
+    }
+
+    void verify()
+    {
+        api->verify(snort_conf);
+        pcre_setup(snort_conf);
+    }
+
+    int eval(unsigned sid, const char* s)
+    {
+        Packet pkt;
+        pkt.data = (const uint8_t*)s;
+        pkt.dsize = strlen(s);
+
+        Cursor c(&pkt);
+        ++rule_eval_pkt_count;
+        return opts[sid - 1]->eval(c, &pkt);
+    }
+
+    PegCount peg(unsigned i)
+    { return mod->get_counts()[i]; }
+
+private:
+    Module* mod;
+    const IpsApi* api;
+    std::vector<IpsOption*> opts;
+    std::vector<OptTreeNode*> otns;
+};
+
+// how many times s was logged
+static unsigned logged(const char* s)
+{ return std::count(s_log.begin(), s_log.end(), s); }
+
+//-------------------------------------------------------------------------
+// tests
+//-------------------------------------------------------------------------
+
+TEST_GROUP(pcre_prefilter) { };
+
+TEST(pcre_prefilter, fallback_to_pcre)
+{
+    PcreRules rules;
+    rules.add("\"/foo[0-9]+bar/\"");
+    rules.add("\"/ab(?C1)cd/\"");
+    rules.add("\"/xyz/i\"");
+    rules.verify();
+
+    CHECK(s_warnings == 0);
+    CHECK(logged("pcre batch prefilter: 2 of 3 patterns") == 1);
+
+    // only the fallback is listed and only once
+    CHECK(logged("pcre fallbacks (gid:sid)") == 1);
+    CHECK(logged("1:2") == 1);
+    CHECK(logged("1:1") == 0);
+    CHECK(logged("1:3") == 0);
+
+    // the prefilter rejects without pcre_exec
+    CHECK(rules.eval(1, "foo bar abcd") == DETECTION_OPTION_NO_MATCH);
+    CHECK(rules.peg(REJECTS) == 1);
+    CHECK(rules.peg(EXECS) == 0);
+
+    // a prefilter hit is confirmed by pcre_exec
+    CHECK(rules.eval(3, "..XYZ..") == DETECTION_OPTION_MATCH);
+    CHECK(rules.peg(EXECS) == 1);
+
+    // the fallback always calls pcre_exec
+    CHECK(rules.eval(2, "foo bar abcd") == DETECTION_OPTION_MATCH);
+    CHECK(rules.eval(2, "foo bar") == DETECTION_OPTION_NO_MATCH);
+    CHECK(rules.peg(EXECS) == 3);
+    CHECK(rules.peg(REJECTS) == 1);
+}
+
+TEST(pcre_prefilter, compile_retry_bound)
+{
+    PcreRules rules;
+
+    for ( unsigned i = 0; i < 8; ++i )
+        rules.add(i % 3 ? "\"/a[0-9]+b/\"" : "\"/a(?C)b/\"");
+
+    rules.verify();
+
+    // one combined compile, one per expression, and one more combined
+    CHECK(s_compile_multi == 2);
+    CHECK(s_compile_one == 8);
+
+    CHECK(logged("pcre batch prefilter: 5 of 8 patterns") == 1);
+    CHECK(logged("1:1") == 1);
+    CHECK(logged("1:4") == 1);
+    CHECK(logged("1:7") == 1);
+    CHECK(logged("1:2") == 0);
+}
+
+TEST(pcre_prefilter, no_retry_when_all_compile)
+{
+    PcreRules rules;
+    rules.add("\"/foo/\"");
+    rules.add("\"/bar/\"");
+    rules.verify();
+
+    CHECK(s_compile_multi == 1);
+    CHECK(s_compile_one == 0);
+    CHECK(logged("pcre fallbacks (gid:sid)") == 0);
+}
+
+TEST(pcre_prefilter, all_fallback)
+{
+    PcreRules rules;
+    rules.add("\"/a(?C)b/\"");
+    rules.add("\"/c(?C)d/\"");
+    rules.verify();
+
+    // no second combined compile when nothing is left
+    CHECK(s_compile_multi == 1);
+    CHECK(s_compile_one == 2);
+    CHECK(s_warnings == 1);
+    CHECK(logged("pcre fallbacks (gid:sid)") == 0);
+
+    CHECK(rules.eval(1, "ab") == DETECTION_OPTION_MATCH);
+    CHECK(rules.eval(2, "ab") == DETECTION_OPTION_NO_MATCH);
+    CHECK(rules.peg(EXECS) == 2);
+    CHECK(rules.peg(SCANS) == 0);
+}
+
+TEST(pcre_prefilter, reload_not_listed)
+{
+    s_reloading = true;
+
+    PcreRules rules;
+    rules.add("\"/foo/\"");
+    rules.add("\"/ab(?C1)cd/\"");
+    rules.verify();
+
+    s_reloading = false;
+
+    CHECK(logged("pcre batch prefilter: 1 of 2 patterns") == 1);
+    CHECK(logged("pcre fallbacks (gid:sid)") == 0);
+    CHECK(logged("1:2") == 0);
+}
+
+//-------------------------------------------------------------------------
+// main
+//-------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
@@ -18,14 +18,13 @@
 
 // ips_regex_test.cc author Russ Combs <rucombs@cisco.com>
 
-#include "ips_options/ips_regex.h"
-
 #include "framework/base_api.h"
 #include "framework/counts.h"
 #include "framework/cursor.h"
 #include "framework/ips_option.h"
 #include "framework/module.h"
 #include "detection/detection_defines.h"
+#include "helpers/hyper_scratch.h"
 #include "main/snort_config.h"
 #include "profiler/memory_profiler_defs.h"
 #include "protocols/packet.h"
@@ -127,7 +126,7 @@ static IpsOption* get_option(const char* pat, bool relative = false)
         vb.set(get_param(mod, "relative"));
         mod->set(ips_regex->name, vb, nullptr);
     }
-    mod->end(ips_regex->name, 0, nullptr);
+    mod->end(ips_regex->name, 0, snort_conf);
 
     IpsApi* api = (IpsApi*)ips_regex;
     IpsOption* opt = api->ctor(mod, nullptr);
@@ -185,9 +184,10 @@ TEST_GROUP(ips_regex_module)
     }
     void teardown()
     {
-        CHECK(mod->end(ips_regex->name, 0, nullptr) == end);
+        CHECK(mod->end(ips_regex->name, 0, snort_conf) == end);
         LONGS_EQUAL(expect, s_parse_errors);
         ips_regex->mod_dtor(mod);
+        HyperScratch::cleanup(snort_conf);
     }
 };
 
@@ -260,14 +260,13 @@ TEST_GROUP(ips_regex_option)
     void setup()
     {
         opt = get_option(" foo ");
-        regex_setup(snort_conf);
+        HyperScratch::setup(snort_conf);
     }
     void teardown()
     {
         IpsApi* api = (IpsApi*)ips_regex;
         api->dtor(opt);
-        regex_cleanup(snort_conf);
-        api->pterm(snort_conf);
+        HyperScratch::cleanup(snort_conf);
     }
 };
 
@@ -331,13 +330,13 @@ TEST_GROUP(ips_regex_option_relative)
     void setup()
     {
         opt = get_option("\\bfoo", true);
-        regex_setup(snort_conf);
+        HyperScratch::setup(snort_conf);
     }
     void teardown()
     {
         IpsApi* api = (IpsApi*)ips_regex;
         api->dtor(opt);
-        regex_cleanup(snort_conf);
+        HyperScratch::cleanup(snort_conf);
     }
 };
 
@@ -0,0 +1,529 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// sd_pattern_test.cc
+// checks the sd_pattern regex translation and that the hyperscan prefilter
+// finds everything the exhaustive search does
+
+#include <hs_compile.h>
+#include <hs_runtime.h>
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "framework/base_api.h"
+#include "framework/counts.h"
+#include "framework/cursor.h"
+#include "framework/ips_option.h"
+#include "framework/module.h"
+#include "detection/detection_defines.h"
+#include "helpers/hyper_scratch.h"
+#include "ips_options/sd_pattern_match.h"
+#include "log/obfuscator.h"
+#include "main/snort_config.h"
+#include "profiler/memory_profiler_defs.h"
+#include "protocols/packet.h"
+#include "protocols/packet_manager.h"
+
+// must appear after snort_config.h to avoid broken c++ map include
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+//-------------------------------------------------------------------------
+// stubs, spies, etc.
+//-------------------------------------------------------------------------
+
+extern const BaseApi* ips_sd_pattern;
+
+void mix_str(uint32_t& a, uint32_t&, uint32_t&, const char* s, unsigned)
+{ a += strlen(s); }
+
+Packet::Packet(bool) { obfuscator = nullptr; }
+Packet::~Packet() { }
+
+Cursor::Cursor(Packet* p)
+{ set("pkt_data", p->data, p->dsize); }
+
+void ParseError(const char*, ...) { }
+void ParseWarning(WarningGroup, const char*, ...) { }
+
+SnortConfig s_conf;
+THREAD_LOCAL SnortConfig* snort_conf = &s_conf;
+
+static SnortState s_state;
+
+SnortConfig::SnortConfig()
+{
+    state = &s_state;
+    memset(state, 0, sizeof(*state));
+    num_slots = 1;
+}
+
+SnortConfig::~SnortConfig() { }
+
+unsigned get_instance_id()
+{ return 0; }
+
+FileIdentifier::~FileIdentifier() { }
+
+FileVerdict FilePolicy::type_lookup(Flow*, FileContext*)
+{ return FILE_VERDICT_UNKNOWN; }
+
+FileVerdict FilePolicy::type_lookup(Flow*, FileInfo*)
+{ return FILE_VERDICT_UNKNOWN; }
+
+FileVerdict FilePolicy::signature_lookup(Flow*, FileContext*)
+{ return FILE_VERDICT_UNKNOWN; }
+
+FileVerdict FilePolicy::signature_lookup(Flow*, FileInfo*)
+{ return FILE_VERDICT_UNKNOWN; }
+
+MemoryContext::MemoryContext(MemoryTracker&) { }
+MemoryContext::~MemoryContext() { }
+
+void show_stats(PegCount*, const PegInfo*, unsigned, const char*) { }
+void show_stats(PegCount*, const PegInfo*, IndexVec&, const char*, FILE*) { }
+
+// each eval is a new packet so the cached scan is never reused
+static uint64_t s_pkt = 0;
+
+uint64_t get_packet_number()
+{ return s_pkt; }
+
+uint64_t PacketManager::get_rebuilt_packet_count()
+{ return 0; }
+
+// released with snort_free()
+char* snort_strdup(const char* s)
+{
+    char* d = (char*)snort_calloc(strlen(s) + 1);
+    strcpy(d, s);
+    return d;
+}
+
+//-------------------------------------------------------------------------
+// helpers
+//-------------------------------------------------------------------------
+
+static const char* s_builtins[] = { "credit_card", "us_social", "us_social_nodashes" };
+
+static const Parameter* get_param(Module* m, const char* s)
+{
+    const Parameter* p = m->get_parameters();
+
+    while ( p and p->name )
+    {
+        if ( !strcmp(p->name, s) )
+            return p;
+        ++p;
+    }
+    return nullptr;
+}
+
+static IpsOption* get_option(const char* pat, unsigned threshold)
+{
+    Module* mod = ips_sd_pattern->mod_ctor();
+    mod->begin(ips_sd_pattern->name, 0, nullptr);
+
+    // the module strips the quotes
+    std::string s = "\"";
+    s += pat;
+    s += "\"";
+
+    Value vs(s.c_str());
+    vs.set(get_param(mod, "~pattern"));
+    mod->set(ips_sd_pattern->name, vs, snort_conf);
+
+    Value vt((double)threshold);
+    vt.set(get_param(mod, "threshold"));
+    mod->set(ips_sd_pattern->name, vt, snort_conf);
+
+    mod->end(ips_sd_pattern->name, 0, snort_conf);
+
+    IpsApi* api = (IpsApi*)ips_sd_pattern;
+    IpsOption* opt = api->ctor(mod, nullptr);
+
+    ips_sd_pattern->mod_dtor(mod);
+    return opt;
+}
+
+// SdPatternOption::SdSearch() without the prefilter
+static unsigned exhaustive_count(SdOptionData& sd, const uint8_t* buf, unsigned len)
+{
+    const uint8_t* end = buf + len;
+    unsigned count = 0;
+
+    while ( buf < end )
+    {
+        uint16_t match_len = 0;
+
+        if ( sd.match(buf, &match_len, end - buf) )
+        {
+            buf += match_len;
+            count++;
+        }
+        else
+            buf++;
+    }
+    return count;
+}
+
+// every offset where match() succeeds, not just those the greedy search uses
+static std::vector<unsigned> match_starts(SdOptionData& sd, const std::string& s)
+{
+    std::vector<unsigned> v;
+
+    for ( unsigned i = 0; i < s.size(); ++i )
+    {
+        uint16_t match_len = 0;
+
+        if ( sd.match((const uint8_t*)s.data() + i, &match_len, s.size() - i) )
+            v.push_back(i);
+    }
+    return v;
+}
+
+static int collect_end(
+    unsigned, unsigned long long, unsigned long long to, unsigned, void* pv)
+{
+    ((std::set<unsigned>*)pv)->insert((unsigned)to);
+    return 0;
+}
+
+static std::set<unsigned> regex_ends(const std::string& re, const std::string& s)
+{
+    hs_database_t* db = nullptr;
+    hs_compile_error_t* err = nullptr;
+    hs_scratch_t* scratch = nullptr;
+    std::set<unsigned> ends;
+
+    CHECK(hs_compile(re.c_str(), HS_FLAG_DOTALL, HS_MODE_BLOCK, nullptr, &db, &err)
+        == HS_SUCCESS);
+    CHECK(hs_alloc_scratch(db, &scratch) == HS_SUCCESS);
+    CHECK(hs_scan(db, s.data(), s.size(), 0, scratch, collect_end, &ends) == HS_SUCCESS);
+
+    hs_free_scratch(scratch);
+    hs_free_database(db);
+    return ends;
+}
+
+// there must be a regex match end e for each start s with
+// s in [e - max_len, e - min_len]
+static void check_superset(const char* pat, const std::string& s)
+{
+    SdOptionData sd(pat, false);
+    std::string re;
+    unsigned min_len, max_len;
+
+    CHECK(sd.get_regex(re, min_len, max_len));
+
+    std::set<unsigned> ends = regex_ends(re, s);
+
+    for ( auto start : match_starts(sd, s) )
+    {
+        bool found = false;
+
+        for ( auto e : ends )
+        {
+            if ( e >= start + min_len and e <= start + max_len )
+            {
+                found = true;
+                break;
+            }
+        }
+        if ( !found )
+            FAIL((std::string(pat) + " missed at " + std::to_string(start) + " in " + s).c_str());
+    }
+}
+
+// the last regex match end must cover all match() starts
+static void check_window(
+    const char* pat, const std::string& s, std::set<unsigned> expect,
+    std::vector<unsigned> starts)
+{
+    SdOptionData sd(pat, false);
+    std::string re;
+    unsigned min_len, max_len;
+
+    CHECK(sd.get_regex(re, min_len, max_len));
+
+    std::set<unsigned> ends = regex_ends(re, s);
+    CHECK(ends == expect);
+    CHECK(match_starts(sd, s) == starts);
+
+    unsigned end = *ends.rbegin();
+
+    for ( auto start : starts )
+        CHECK(start + max_len >= end and start + min_len <= end);
+
+    check_superset(pat, s);
+}
+
+// the count with the prefilter is the exhaustive count
+static void check_eval(const char* pat, const std::string& s, unsigned delta = 0)
+{
+    SdOptionData sd(pat, false);
+    unsigned expect = exhaustive_count(
+        sd, (const uint8_t*)s.data() + delta, s.size() - delta);
+
+    IpsApi* api = (IpsApi*)ips_sd_pattern;
+    IpsOption* at = get_option(pat, expect ? expect : 1);
+    IpsOption* over = get_option(pat, expect + 1);
+
+    api->verify(snort_conf);
+    HyperScratch::setup(snort_conf);
+
+    Packet pkt;
+    pkt.data = (const uint8_t*)s.data();
+    pkt.dsize = s.size();
+
+    Cursor c1(&pkt);
+    c1.set_pos(delta);
+    ++s_pkt;
+    CHECK(at->eval(c1, &pkt) == (expect ? DETECTION_OPTION_MATCH : DETECTION_OPTION_NO_MATCH));
+
+    Cursor c2(&pkt);
+    c2.set_pos(delta);
+    ++s_pkt;
+    CHECK(over->eval(c2, &pkt) == DETECTION_OPTION_NO_MATCH);
+
+    api->dtor(at);
+    api->dtor(over);
+
+    HyperScratch::cleanup(snort_conf);
+    api->tterm(snort_conf);
+}
+
+static std::string random_text(std::mt19937& rng, unsigned len)
+{
+    static const char* alpha = "0123456789012345678901234567890123456789 - -\nxY";
+    unsigned n = strlen(alpha);
+    std::string s;
+
+    while ( s.size() < len )
+        s += alpha[rng() % n];
+
+    return s;
+}
+
+//-------------------------------------------------------------------------
+// translation
+//-------------------------------------------------------------------------
+
+TEST_GROUP(sd_pattern_regex) { };
+
+TEST(sd_pattern_regex, credit_card)
+{
+    SdOptionData sd("credit_card", false);
+    std::string re;
+    unsigned min_len, max_len;
+
+    CHECK(sd.get_regex(re, min_len, max_len));
+
+    std::string sep = "\\x20?\\x2d?";
+    std::string d4 = "[0-9][0-9][0-9][0-9]";
+    std::string d2 = "[0-9][0-9]";
+
+    STRCMP_EQUAL((d4 + sep + d4 + sep + d2 + sep + d2 + sep +
+        "[0-9][0-9][0-9][0-9]?").c_str(), re.c_str());
+
+    // 15 digits plus 1 optional and 8 separators plus the leading \b
+    UNSIGNED_LONGS_EQUAL(15, min_len);
+    UNSIGNED_LONGS_EQUAL(25, max_len);
+}
+
+TEST(sd_pattern_regex, us_social)
+{
+    SdOptionData sd("us_social", false);
+    std::string re;
+    unsigned min_len, max_len;
+
+    CHECK(sd.get_regex(re, min_len, max_len));
+    STRCMP_EQUAL("[0-9][0-9][0-9]\\x2d[0-9][0-9]\\x2d[0-9][0-9][0-9][0-9]", re.c_str());
+    UNSIGNED_LONGS_EQUAL(11, min_len);
+    UNSIGNED_LONGS_EQUAL(12, max_len);
+}
+
+TEST(sd_pattern_regex, us_social_nodashes)
+{
+    SdOptionData sd("us_social_nodashes", false);
+    std::string re;
+    unsigned min_len, max_len;
+
+    CHECK(sd.get_regex(re, min_len, max_len));
+    STRCMP_EQUAL("[0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9]", re.c_str());
+    UNSIGNED_LONGS_EQUAL(9, min_len);
+    UNSIGNED_LONGS_EQUAL(10, max_len);
+}
+
+TEST(sd_pattern_regex, classes)
+{
+    SdOptionData sd("\\d\\D\\w\\W\\l\\L\\q", false);
+    std::string re;
+    unsigned min_len, max_len;
+
+    CHECK(sd.get_regex(re, min_len, max_len));
+    STRCMP_EQUAL(
+        "[0-9][^0-9][0-9A-Za-z][^0-9A-Za-z][A-Za-z][^A-Za-z].", re.c_str());
+    UNSIGNED_LONGS_EQUAL(7, min_len);
+    UNSIGNED_LONGS_EQUAL(7, max_len);
+}
+
+TEST(sd_pattern_regex, literals)
+{
+    // escaped specials, regex metacharacters, and an optional literal
+    SdOptionData sd("a.\\{\\}\\?\\\\[b?", false);
+    std::string re;
+    unsigned min_len, max_len;
+
+    CHECK(sd.get_regex(re, min_len, max_len));
+    STRCMP_EQUAL("\\x61\\x2e\\x7b\\x7d\\x3f\\x5c\\x5b\\x62?", re.c_str());
+    UNSIGNED_LONGS_EQUAL(7, min_len);
+    UNSIGNED_LONGS_EQUAL(8, max_len);
+}
+
+TEST(sd_pattern_regex, expanded_brackets)
+{
+    SdOptionData sd("x\\d{3}\\?{2}", false);
+    std::string re;
+    unsigned min_len, max_len;
+
+    CHECK(sd.get_regex(re, min_len, max_len));
+    STRCMP_EQUAL("\\x78[0-9][0-9][0-9]\\x3f\\x3f", re.c_str());
+    UNSIGNED_LONGS_EQUAL(6, min_len);
+    UNSIGNED_LONGS_EQUAL(6, max_len);
+}
+
+TEST(sd_pattern_regex, rejected)
+{
+    std::string re;
+    unsigned min_len, max_len;
+
+    // \b only as first or last token and never optional
+    SdOptionData mid("\\d\\b\\d", false);
+    CHECK(!mid.get_regex(re, min_len, max_len));
+
+    SdOptionData opt("\\b?\\d", false);
+    CHECK(!opt.get_regex(re, min_len, max_len));
+
+    // nothing required
+    SdOptionData empty("a?b?", false);
+    CHECK(!empty.get_regex(re, min_len, max_len));
+
+    SdOptionData bounds("\\b\\b", false);
+    CHECK(!bounds.get_regex(re, min_len, max_len));
+}
+
+//-------------------------------------------------------------------------
+// superset
+//-------------------------------------------------------------------------
+
+TEST_GROUP(sd_pattern_superset) { };
+
+TEST(sd_pattern_superset, window_edges)
+{
+    // \b is skipped at the start of the buffer so s == e - min_len
+    check_window("us_social_nodashes", "123456789 ", { 9 }, { 0 });
+    check_window("us_social", "123-45-6789", { 11 }, { 0 });
+
+    // \b consumes a non-digit so s == e - max_len
+    check_window("us_social_nodashes", " 123456789", { 10 }, { 0, 1 });
+    check_window("us_social", "x123-45-6789", { 12 }, { 0, 1 });
+
+    // the longest credit card form with a leading non-digit
+    check_window("credit_card", "x4111 -1111 -11 -11 -1111 ", { 24, 25 }, { 0, 1 });
+}
+
+TEST(sd_pattern_superset, adjacent)
+{
+    check_superset("us_social", "123-45-6789 123-45-6789-123-45-6789");
+    check_superset("us_social_nodashes", "123456789 123456789 123456789");
+    check_superset("credit_card", "4111111111111111 4111-1111-1111-1111");
+}
+
+TEST(sd_pattern_superset, custom)
+{
+    check_superset("\\bx\\d?\\d\\b", "x1 x12 x x123 ax1\nx9");
+    check_superset("\\w\\W\\l?\\L", "a-b- 1 2 aa--\n\n");
+    check_superset("\\{\\d\\}", "{1}{{2}}{x}");
+}
+
+TEST(sd_pattern_superset, random)
+{
+    std::mt19937 rng(2016);
+
+    for ( unsigned i = 0; i < 200; ++i )
+    {
+        std::string s = random_text(rng, 1 + rng() % 64);
+
+        for ( auto b : s_builtins )
+            check_superset(b, s);
+
+        check_superset("\\d\\d-?\\d\\b", s);
+    }
+}
+
+//-------------------------------------------------------------------------
+// option
+//-------------------------------------------------------------------------
+
+TEST_GROUP(sd_pattern_option) { };
+
+TEST(sd_pattern_option, edges)
+{
+    check_eval("us_social_nodashes", "123456789");
+    check_eval("us_social_nodashes", "123456789 123456789");
+    check_eval("us_social_nodashes", "1234567890 123456789 ");
+    check_eval("us_social", "123-45-6789 123-45-6789-123-45-6789");
+    check_eval("credit_card", "4111111111111111 -4111 -1111 -11 -11 -1111");
+}
+
+TEST(sd_pattern_option, relative)
+{
+    // the cursor starts inside or just before a match
+    check_eval("us_social_nodashes", " 123456789 123456789", 1);
+    check_eval("us_social_nodashes", " 123456789 123456789", 2);
+    check_eval("us_social_nodashes", " 123456789 123456789", 10);
+    check_eval("us_social", "x123-45-6789 123-45-6789", 11);
+}
+
+TEST(sd_pattern_option, random)
+{
+    std::mt19937 rng(3193);
+
+    for ( unsigned i = 0; i < 100; ++i )
+    {
+        std::string s = random_text(rng, 1 + rng() % 128);
+        unsigned delta = rng() % s.size();
+
+        for ( auto b : s_builtins )
+            check_eval(b, s, delta);
+    }
+}
+
+//-------------------------------------------------------------------------
+// main
+//-------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
@@ -230,6 +230,10 @@ bool Analyzer::handle_command()
 
 void Analyzer::analyze()
 {
+    // a batch size of 0 acquires until the DAQ runs dry; otherwise housekeeping
+    // (flow timeouts, HA receive) runs once per batch instead of per packet
+    unsigned batch_size = daq_instance->get_batch_size();
+
     // The main analyzer loop is terminated by a command returning false or an error during acquire
     while (true)
     {
@@ -243,14 +247,19 @@ void Analyzer::analyze()
             this_thread::sleep_for(ms);
             continue;
         }
-        if (daq_instance->acquire(0, main_func))
+        if (daq_instance->acquire(batch_size, main_func))
             break;
 
         // FIXIT-L acquire(0) makes idle processing unlikely under high traffic
         // because it won't return until no packets, signal, etc.  that means
         // the idle processing may not be useful or that we need a hook to do
         // things periodically even when traffic is available
-        Snort::thread_idle();
+        if ( !batch_size )
+            Snort::thread_idle();
+
+        // a short batch means the DAQ ran dry
+        else if ( Snort::thread_batch() < batch_size )
+            Snort::thread_idle();
     }
 }
 
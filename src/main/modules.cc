@@ -191,6 +191,12 @@ function<const char*()> get_search_methods = []()
 
 static const Parameter search_engine_params[] =
 {
+    { "cache_dir", Parameter::PT_STRING, nullptr, nullptr,
+      "directory to save and load compiled hyperscan databases" },
+
+    { "cache_max_size", Parameter::PT_INT, "0:", "268435456",
+      "remove least recently used files from cache_dir beyond this many bytes (0 is unlimited)" },
+
     { "bleedover_port_limit", Parameter::PT_INT, "1:", "1024",
       "maximum ports in rule before demotion to any-any port group" },
 
@@ -200,6 +206,9 @@ static const Parameter search_engine_params[] =
     { "enable_single_rule_group", Parameter::PT_BOOL, nullptr, "false",
       "put all rules into one group" },
 
+    { "compile_threads", Parameter::PT_INT, "0:", "0",
+      "number of threads used to compile search engines (0 means compile in main thread)" },
+
     { "debug", Parameter::PT_BOOL, nullptr, "false",
       "print verbose fast pattern info" },
 
@@ -224,6 +233,9 @@ static const Parameter search_engine_params[] =
     { "max_queue_events", Parameter::PT_INT, nullptr, "5",
       "maximum number of matching fast pattern states to queue per packet" },
 
+    { "flat_option_trees", Parameter::PT_BOOL, nullptr, "false",
+      "evaluate rule option trees from a compact array layout instead of linked nodes" },
+
     { "inspect_stream_inserts", Parameter::PT_BOOL, nullptr, "false",
       "inspect reassembled payload - disabling is good for performance, bad for detection" },
 
@@ -233,6 +245,15 @@ static const Parameter search_engine_params[] =
     { "split_any_any", Parameter::PT_BOOL, nullptr, "false",
       "evaluate any-any rules separately to save memory" },
 
+    { "stream_file_data", Parameter::PT_BOOL, nullptr, "false",
+      "search file_data as a stream per flow direction if the search method supports it" },
+
+    { "stream_file_data_memcap", Parameter::PT_INT, "0:", "8388608",
+      "maximum bytes of open file_data stream state per packet thread; beyond this file_data is searched by buffer" },
+
+    { "teddy_max_patterns", Parameter::PT_INT, "0:", "0",
+      "use teddy for groups of up to this many literal patterns of at least 3 bytes (0 means use search_method)" },
+
     { "search_optimize", Parameter::PT_BOOL, nullptr, "true",
       "tweak state machine construction for better performance" },
 
@@ -252,6 +273,7 @@ const PegInfo mpse_pegs[] =
     { "total unique", "total unique fast pattern hits" },
     { "non-qualified events", "total non-qualified events" },
     { "qualified events", "total qualified events" },
+    { "quick rejects", "rule trees skipped by flow checks before evaluation" },
     { nullptr, nullptr }
 };
 
@@ -280,6 +302,15 @@ bool SearchEngineModule::set(const char*, Value& v, SnortConfig* sc)
         if ( v.get_bool() )
             fp->set_bleed_over_warnings();  // FIXIT-L these should take arg
     }
+    else if ( v.is("cache_dir") )
+        fp->set_cache_dir(v.get_string());
+
+    else if ( v.is("cache_max_size") )
+        fp->set_cache_max_size(v.get_long());
+
+    else if ( v.is("compile_threads") )
+        fp->set_compile_threads(v.get_long());
+
     else if ( v.is("enable_single_rule_group") )
     {
         if ( v.get_bool() )
@@ -330,6 +361,18 @@ bool SearchEngineModule::set(const char*, Value& v, SnortConfig* sc)
     else if ( v.is("split_any_any") )
         fp->set_split_any_any(v.get_long());
 
+    else if ( v.is("flat_option_trees") )
+        fp->set_flat_option_trees(v.get_bool());
+
+    else if ( v.is("stream_file_data") )
+        fp->set_stream_file_data(v.get_bool());
+
+    else if ( v.is("stream_file_data_memcap") )
+        fp->set_stream_file_data_memcap(v.get_long());
+
+    else if ( v.is("teddy_max_patterns") )
+        fp->set_teddy_max_patterns(v.get_long());
+
     else if ( v.is("search_optimize") )
         fp->set_search_opt(v.get_long());
 
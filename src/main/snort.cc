@@ -35,6 +35,7 @@
 #include <netinet/in.h>
 #include <sys/stat.h>
 
+#include "control/idle_processing.h"
 #include "detection/detect.h"
 #include "detection/detection_util.h"
 #include "detection/fp_config.h"
@@ -61,8 +62,10 @@
 #include "managers/mpse_manager.h"
 #include "managers/plugin_manager.h"
 #include "managers/script_manager.h"
+#include "memory/slab_allocator.h"
 #include "packet_io/sfdaq.h"
 #include "packet_io/active.h"
+#include "packet_io/packet_steer.h"
 #include "packet_io/trough.h"
 #include "parser/cmd_line.h"
 #include "parser/parser.h"
@@ -100,6 +103,14 @@ static THREAD_LOCAL DAQ_PktHdr_t s_pkth;
 static THREAD_LOCAL uint8_t s_data[65536];
 static THREAD_LOCAL Packet* s_packet = nullptr;
 
+// batched acquisition defers per packet housekeeping to the end of the batch
+static THREAD_LOCAL bool s_batched = false;
+static THREAD_LOCAL unsigned s_batch_pkts = 0;
+static THREAD_LOCAL time_t s_batch_time = 0;
+
+// passed as the callback user data for packets forwarded by PacketSteer
+static int s_steered = 0;
+
 //-------------------------------------------------------------------------
 // perf stats
 // FIXIT-M move these to appropriate modules
@@ -134,6 +145,21 @@ static ProfileStats* get_profile(const char* key)
     if ( !strcmp(key, "decode") )
         return &decodePerfStats;
 
+    if ( !strcmp(key, "decode_ip4_tcp") )
+        return &decodeShapePerfStats[DECODE_SHAPE_IP4_TCP];
+
+    if ( !strcmp(key, "decode_ip4_udp") )
+        return &decodeShapePerfStats[DECODE_SHAPE_IP4_UDP];
+
+    if ( !strcmp(key, "decode_ip6_tcp") )
+        return &decodeShapePerfStats[DECODE_SHAPE_IP6_TCP];
+
+    if ( !strcmp(key, "decode_ip6_udp") )
+        return &decodeShapePerfStats[DECODE_SHAPE_IP6_UDP];
+
+    if ( !strcmp(key, "decode_other") )
+        return &decodeShapePerfStats[DECODE_SHAPE_OTHER];
+
     if ( !strcmp(key, "eventq") )
         return &eventqPerfStats;
 
@@ -156,6 +182,11 @@ static void register_profiles()
     Profiler::register_module("rule_tree_eval", "rule_eval", get_profile);
     Profiler::register_module("nfp_rule_tree_eval", "rule_eval", get_profile);
     Profiler::register_module("decode", nullptr, get_profile);
+    Profiler::register_module("decode_ip4_tcp", "decode", get_profile);
+    Profiler::register_module("decode_ip4_udp", "decode", get_profile);
+    Profiler::register_module("decode_ip6_tcp", "decode", get_profile);
+    Profiler::register_module("decode_ip6_udp", "decode", get_profile);
+    Profiler::register_module("decode_other", "decode", get_profile);
     Profiler::register_module("eventq", nullptr, get_profile);
     Profiler::register_module("total", nullptr, get_profile);
     Profiler::register_module("daq_meta", nullptr, get_profile);
@@ -467,6 +498,7 @@ void Snort::setup(int argc, char* argv[])
 
     LogMessage("%s\n", LOG_DIV);
     SFDAQ::init(snort_conf);
+    PacketSteer::init(snort_conf, ThreadConfig::get_instance_max());
 
     if ( SnortConfig::daemon_mode() )
         daemonize();
@@ -487,6 +519,7 @@ void Snort::cleanup()
     TimeStop();
 
     SFDAQ::term();
+    PacketSteer::term();
 
     if ( !SnortConfig::test_mode() )  // FIXIT-M ideally the check is in one place
         PrintStatistics();
@@ -592,12 +625,40 @@ void Snort::capture_packet()
 
 void Snort::thread_idle()
 {
-    if ( flow_con )
-        flow_con->timeout_flows(16384, time(NULL));
+    if ( PacketSteer::enabled() )
+        PacketSteer::drain(packet_callback, &s_steered);
+    IdleProcessing::execute();
     perf_monitor_idle_process();
+    HighAvailabilityManager::flush();
     aux_counts.idle++;
 }
 
+// returns the number of packets processed since the last call; only
+// meaningful when the DAQ instance is configured with a batch size
+unsigned Snort::thread_batch()
+{
+    unsigned pkts = s_batch_pkts;
+
+    if ( pkts )
+    {
+        housekeeping(pkts, s_batch_time);
+        aux_counts.batches++;
+        s_batch_pkts = 0;
+    }
+    return pkts;
+}
+
+void Snort::housekeeping(unsigned pkts, time_t cur_time)
+{
+    if ( flow_con ) // FIXIT-M always instantiate
+    {
+        flow_con->timeout_flows(4 * pkts, cur_time);
+    }
+
+    HighAvailabilityManager::process_receive();
+    HighAvailabilityManager::process_transmit();
+}
+
 void Snort::thread_rotate()
 {
     SetRotatePerfFileFlag();
@@ -619,6 +680,9 @@ bool Snort::thread_init_privileged(const char* intf)
     if (!daq_instance->configure(snort_conf))
         return false;
 
+    s_batched = daq_instance->get_batch_size() > 0;
+    s_batch_pkts = 0;
+
     return true;
 }
 
@@ -650,10 +714,17 @@ void Snort::thread_init_unprivileged()
     SideChannelManager::thread_init();
     HighAvailabilityManager::thread_init(); // must be before InspectorManager::thread_init();
     InspectorManager::thread_init(snort_conf);
+
+    // must be last; other threads may forward packets once we are ready
+    if ( PacketSteer::enabled() )
+        PacketSteer::thread_init();
 }
 
 void Snort::thread_term()
 {
+    if ( PacketSteer::enabled() )
+        PacketSteer::thread_term(packet_callback, &s_steered);
+
     if ( !snort_conf->dirty_pig )
         InspectorManager::thread_stop(snort_conf);
 
@@ -691,6 +762,8 @@ void Snort::thread_term()
 
     SnortEventqFree();
     Active::term();
+
+    memory::SlabAllocator::thread_term();
 }
 
 void Snort::detect_rebuilt_packet(Packet* p)
@@ -712,6 +785,10 @@ void Snort::detect_rebuilt_packet(Packet* p)
     do_detect_content = save_do_detect_content;
 }
 
+// the flow of this packet must not be pruned while it is in use
+Packet* Snort::get_current_packet()
+{ return s_packet; }
+
 DAQ_Verdict Snort::process_packet(
     Packet* p, const DAQ_PktHdr_t* pkthdr, const uint8_t* pkt, bool is_frag)
 {
@@ -807,16 +884,31 @@ static DAQ_Verdict update_verdict(DAQ_Verdict verdict, int& inject)
 }
 
 DAQ_Verdict Snort::packet_callback(
-    void*, const DAQ_PktHdr_t* pkthdr, const uint8_t* pkt)
+    void* user, const DAQ_PktHdr_t* pkthdr, const uint8_t* pkt)
 {
     Profile profile(totalPerfStats);
 
-    pc.total_from_daq++;
-    rule_eval_pkt_count++;
+    // forwarded packets were already counted by the thread that acquired them
+    bool steered = (user == &s_steered);
+
+    if ( !steered )
+        pc.total_from_daq++;
+
     packet_time_update(&pkthdr->ts);
 
-    if ( snort_conf->pkt_skip && pc.total_from_daq <= snort_conf->pkt_skip )
+    if ( !steered && snort_conf->pkt_skip && pc.total_from_daq <= snort_conf->pkt_skip )
+        return DAQ_VERDICT_PASS;
+
+    // the owner is chosen from the raw headers so the packet is decoded and
+    // analyzed only by the owner.  steering is passive only so a forwarded
+    // packet can be passed here.
+    if ( !steered && PacketSteer::enabled() && PacketSteer::forward(pkthdr, pkt) )
+    {
+        end_packet(pkthdr);
         return DAQ_VERDICT_PASS;
+    }
+
+    rule_eval_pkt_count++;
 
     {
         Profile eventq_profile(eventqPerfStats);
@@ -839,21 +931,32 @@ DAQ_Verdict Snort::packet_callback(
     Active::reset();
     PacketManager::encode_reset();
 
-    if ( flow_con ) // FIXIT-M always instantiate
+    s_packet->pkth = nullptr;  // no longer avail upon sig segv
+
+    if ( !steered )
+        end_packet(pkthdr);
+
+    return verdict;
+}
+
+// per acquired packet work, whether analyzed here or forwarded
+void Snort::end_packet(const DAQ_PktHdr_t* pkthdr)
+{
+    if ( s_batched )
     {
-        flow_con->timeout_flows(4, pkthdr->ts.tv_sec);
+        s_batch_pkts++;
+        s_batch_time = pkthdr->ts.tv_sec;
     }
+    else
+        housekeeping(1, pkthdr->ts.tv_sec);
 
-    HighAvailabilityManager::process_receive();
-
-    s_packet->pkth = nullptr;  // no longer avail upon sig segv
+    if ( PacketSteer::enabled() )
+        PacketSteer::drain(packet_callback, &s_steered);
 
     if ( snort_conf->pkt_cnt && pc.total_from_daq >= snort_conf->pkt_cnt )
         SFDAQ::break_loop(-1);
 
     else if ( break_time() )
         SFDAQ::break_loop(0);
-
-    return verdict;
 }
 
@@ -54,9 +54,11 @@ public:
     static void thread_term();
 
     static void thread_idle();
+    static unsigned thread_batch();
     static void thread_rotate();
 
     static void capture_packet();
+    static Packet* get_current_packet();
     static void detect_rebuilt_packet(Packet*);
 
     static DAQ_Verdict process_packet(
@@ -69,6 +71,8 @@ public:
 private:
     static void init(int, char**);
     static void term();
+    static void housekeeping(unsigned pkts, time_t);
+    static void end_packet(const DAQ_PktHdr_t*);
     static void clean_exit(int);
 
 private:
@@ -45,11 +45,6 @@
 #include "thread_config.h"
 #include "target_based/sftarget_reader.h"
 
-#ifdef HAVE_HYPERSCAN
-#include "ips_options/ips_regex.h"
-#include "search_engines/hyperscan.h"
-#endif
-
 THREAD_LOCAL SnortConfig* snort_conf = nullptr;
 uint32_t SnortConfig::warning_flags = 0;
 
@@ -187,8 +182,7 @@ SnortConfig::~SnortConfig()
     FreeReferences(references);
 
 #ifdef HAVE_HYPERSCAN
-    hyperscan_cleanup(this);
-    regex_cleanup(this);
+    HyperScratch::cleanup(this);
 #endif
     pcre_cleanup(this);
 
@@ -274,8 +268,7 @@ void SnortConfig::setup()
     // allow pcre, regex, and hyperscan to be built dynamically.
     pcre_setup(this);
 #ifdef HAVE_HYPERSCAN
-    regex_setup(this);
-    hyperscan_setup(this);
+    HyperScratch::setup(this);
 #endif
 }
 
@@ -39,6 +39,7 @@
 #include "framework/bits.h"
 #include "events/event_queue.h"
 #include "file_api/file_config.h"
+#include "helpers/hyper_scratch.h"
 
 #define DEFAULT_LOG_DIR "."
 
@@ -123,6 +124,7 @@ struct PORT_RULE_MAP;
 struct SFXHASH;
 struct ProfilerConfig;
 struct MemoryConfig;
+struct PcreBatch;
 struct LatencyConfig;
 struct SFDAQConfig;
 class ThreadConfig;
@@ -136,11 +138,10 @@ struct SnortState
 {
     int* pcre_ovector;
 
-    // regex and hs are conditionally built but these are unconditional to
-    // avoid compatibility issues with plugins.  if these are conditional
+    // hyperscan is conditionally built but this is unconditional to
+    // avoid compatibility issues with plugins.  if this is conditional
     // then API_OPTIONS must be updated.  note: fwd decls don't work here.
-    void* regex_scratch;
-    void* hyperscan_scratch;
+    void* hyper_scratch[HyperScratch::MAX];
 };
 
 struct SnortConfig
@@ -188,6 +189,10 @@ public:
     long int pcre_match_limit = 1500;
     long int pcre_match_limit_recursion = 1500;
     int pcre_ovector_size = 0;
+    PcreBatch* pcre_batch = nullptr;
+
+    // hyperscan scratch prototypes, cloned into state by setup
+    hs_scratch_t* hyper_scratch[HyperScratch::MAX] = { };
 
     int asn1_mem = 0;
     uint32_t run_flags = 0;
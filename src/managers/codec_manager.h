@@ -51,6 +51,20 @@ struct ProfileStats;
 
 extern THREAD_LOCAL ProfileStats decodePerfStats;
 
+// decode time split by the shape of the decoded stack, ignoring vlan
+// tags.  these are children of the decode profile.
+enum DecodeShape
+{
+    DECODE_SHAPE_IP4_TCP,
+    DECODE_SHAPE_IP4_UDP,
+    DECODE_SHAPE_IP6_TCP,
+    DECODE_SHAPE_IP6_UDP,
+    DECODE_SHAPE_OTHER,
+    DECODE_SHAPE_MAX
+};
+
+extern THREAD_LOCAL ProfileStats decodeShapePerfStats[DECODE_SHAPE_MAX];
+
 #ifdef PIGLET
 struct CodecWrapper
 {
@@ -28,6 +28,7 @@ struct MemoryConfig
     size_t cap = 0;
     bool soft = false;
     size_t threshold = 0;
+    bool hugepages = false;
 
     constexpr MemoryConfig() = default;
 };
@@ -30,6 +30,7 @@
 
 #include "memory_allocator.h"
 #include "memory_cap.h"
+#include "reentry_context.h"
 
 #ifdef UNIT_TEST
 #include "catch/catch.hpp"
@@ -114,31 +115,13 @@ size_t Metadata::SANITY_CHECK_VALUE = 0xabcdef;
 // the meat
 // -----------------------------------------------------------------------------
 
-class ReentryContext
-{
-public:
-    ReentryContext(bool& flag) :
-        already_entered(flag), flag(flag)
-    { flag = true; }
-
-    ~ReentryContext()
-    { flag = false; }
-
-    bool is_reentry() const
-    { return already_entered; }
-
-private:
-    const bool already_entered;
-    bool& flag;
-};
+THREAD_LOCAL bool in_allocation_call = false;
 
 template<typename Allocator = MemoryAllocator, typename Cap = MemoryCap>
 struct Interface
 {
     static void* allocate(size_t);
     static void deallocate(void*);
-
-    static THREAD_LOCAL bool in_allocation_call;
 };
 
 template<typename Allocator, typename Cap>
@@ -172,9 +155,6 @@ void Interface<Allocator, Cap>::deallocate(void* p)
     Allocator::deallocate(meta);
 }
 
-template<typename Allocator, typename Cap>
-THREAD_LOCAL bool Interface<Allocator, Cap>::in_allocation_call = false;
-
 } //namespace memory
 
 // -----------------------------------------------------------------------------
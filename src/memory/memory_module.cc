@@ -43,6 +43,9 @@ static const Parameter s_params[] =
         "set the per-packet-thread threshold for preemptive cleanup actions "
         "(percent, 0 to disable)" },
 
+    { "hugepages", Parameter::PT_BOOL, nullptr, "false",
+        "back per-thread slabs of small objects with 2 MB hugepages if available" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -65,6 +68,9 @@ bool MemoryModule::set(const char*, Value& v, SnortConfig* sc)
     else if ( v.is("threshold") )
         sc->memory->threshold = v.get_long();
 
+    else if ( v.is("hugepages") )
+        sc->memory->hugepages = v.get_bool();
+
     else
         return false;
 
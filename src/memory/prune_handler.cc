@@ -22,6 +22,8 @@
 
 #include "flow/flow_cache.h"
 #include "flow/flow_control.h"
+#include "main/snort.h"
+#include "protocols/packet.h"
 #include "stream/stream.h"
 
 namespace memory
@@ -31,7 +33,11 @@ void prune_handler()
 {
     // assert(flow_con);
     if ( flow_con )
-        flow_con->prune_one(PruneReason::MEMCAP, false);
+    {
+        // the clock order does not keep the current flow out of reach
+        const Packet* p = Snort::get_current_packet();
+        flow_con->prune_one(PruneReason::MEMCAP, false, p ? p->flow : nullptr);
+    }
 }
 
 } // namespace memory
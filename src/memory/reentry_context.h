@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifndef REENTRY_CONTEXT_H
+#define REENTRY_CONTEXT_H
+
+// the allocators check the cap and may prune while doing so; pruning must
+// not allocate through them again
+
+#include "main/thread.h"
+
+namespace memory
+{
+
+extern THREAD_LOCAL bool in_allocation_call;
+
+class ReentryContext
+{
+public:
+    ReentryContext(bool& flag) :
+        already_entered(flag), flag(flag)
+    { flag = true; }
+
+    ~ReentryContext()
+    { flag = false; }
+
+    bool is_reentry() const
+    { return already_entered; }
+
+private:
+    const bool already_entered;
+    bool& flag;
+};
+
+} // namespace memory
+
+#endif
+
@@ -0,0 +1,462 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#include "slab_allocator.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "main/snort_config.h"
+#include "main/thread.h"
+
+#include "memory_cap.h"
+#include "memory_config.h"
+#include "reentry_context.h"
+
+#ifdef UNIT_TEST
+#include <cstring>
+#include <thread>
+
+#include "catch/catch.hpp"
+#endif
+
+namespace memory
+{
+
+namespace
+{
+
+const size_t NUM_CLASSES = SlabAllocator::MAX_SIZE / SlabAllocator::ALIGN;
+
+const size_t CHUNK_SIZE = 2 * 1024 * 1024;
+const size_t MAX_CHUNKS = 4096;
+
+// the class is only used on the remote free list
+struct FreeNode
+{
+    FreeNode* next;
+    size_t cls;
+};
+
+// arenas are allocated outside the memory manager so they are not
+// charged to the cap and can't recurse into it
+struct Arena
+{
+    FreeNode* free_list[NUM_CLASSES];
+
+    uint8_t* cursor;
+    size_t remaining;
+
+    // allocated less freed by the owning thread
+    long in_use;
+
+    // objects freed by other threads are pushed here and moved to the
+    // free lists by the owner.  shared starts at OWNER_BIAS and is
+    // decremented by each remote free.  at thread_term the owner adds its
+    // in_use less the bias, leaving the number of live objects; whoever
+    // takes it to zero releases the arena.
+    std::atomic<FreeNode*> remote;
+    std::atomic<long> shared;
+
+    unsigned num_chunks;
+    void* chunks[MAX_CHUNKS];
+};
+
+const long OWNER_BIAS = LONG_MAX / 2;
+
+// chunks are CHUNK_SIZE aligned so an object's arena is found from the
+// header at the start of its chunk
+struct ChunkHeader
+{
+    Arena* owner;
+};
+
+const size_t HEADER_SIZE = SlabAllocator::ALIGN;
+static_assert(sizeof(ChunkHeader) <= HEADER_SIZE, "chunk header too big");
+
+THREAD_LOCAL Arena* s_arena = nullptr;
+
+// -----------------------------------------------------------------------------
+// helpers
+// -----------------------------------------------------------------------------
+
+inline size_t get_class_index(size_t n)
+{ return (SlabAllocator::get_size_class(n) / SlabAllocator::ALIGN) - 1; }
+
+inline Arena* get_owner(void* p)
+{
+    uintptr_t base = reinterpret_cast<uintptr_t>(p) & ~(uintptr_t)(CHUNK_SIZE - 1);
+    return reinterpret_cast<ChunkHeader*>(base)->owner;
+}
+
+// map twice the size and trim to get an aligned chunk
+void* map_aligned_chunk()
+{
+    void* p = mmap(nullptr, 2 * CHUNK_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if ( p == MAP_FAILED )
+        return nullptr;
+
+    uint8_t* start = static_cast<uint8_t*>(p);
+    uint8_t* chunk = reinterpret_cast<uint8_t*>(
+        (reinterpret_cast<uintptr_t>(start) + CHUNK_SIZE - 1) & ~(uintptr_t)(CHUNK_SIZE - 1));
+
+    if ( chunk > start )
+        munmap(start, chunk - start);
+
+    if ( start + CHUNK_SIZE > chunk )
+        munmap(chunk + CHUNK_SIZE, start + CHUNK_SIZE - chunk);
+
+    return chunk;
+}
+
+void* map_chunk(bool hugepages)
+{
+    void* p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    // hugepage mappings are aligned to the hugepage size
+    if ( hugepages )
+    {
+        p = mmap(nullptr, CHUNK_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if ( p != MAP_FAILED and (reinterpret_cast<uintptr_t>(p) & (CHUNK_SIZE - 1)) )
+        {
+            munmap(p, CHUNK_SIZE);
+            p = MAP_FAILED;
+        }
+    }
+#endif
+
+    if ( p == MAP_FAILED )
+    {
+        p = map_aligned_chunk();
+
+        if ( !p )
+            return nullptr;
+
+#ifdef MADV_HUGEPAGE
+        // no reserved hugepages; ask for transparent hugepages instead
+        if ( hugepages )
+            madvise(p, CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+    }
+    return p;
+}
+
+Arena* get_arena()
+{
+    if ( !s_arena )
+    {
+        void* p = calloc(1, sizeof(Arena));
+
+        if ( p )
+        {
+            s_arena = new (p) Arena;
+            s_arena->remote = nullptr;
+            s_arena->shared = OWNER_BIAS;
+        }
+    }
+    return s_arena;
+}
+
+void release_arena(Arena* a)
+{
+    for ( unsigned i = 0; i < a->num_chunks; ++i )
+        munmap(a->chunks[i], CHUNK_SIZE);
+
+    a->~Arena();
+    free(a);
+}
+
+// move objects freed by other threads to the free lists
+void drain_remote(Arena* a)
+{
+    FreeNode* node = a->remote.exchange(nullptr, std::memory_order_acquire);
+
+    while ( node )
+    {
+        FreeNode* next = node->next;
+        FreeNode*& head = a->free_list[node->cls];
+        node->next = head;
+        head = node;
+        node = next;
+    }
+}
+
+void remote_free(Arena* a, FreeNode* node, size_t cls)
+{
+    node->cls = cls;
+    node->next = a->remote.load(std::memory_order_relaxed);
+
+    while ( !a->remote.compare_exchange_weak(
+        node->next, node, std::memory_order_release, std::memory_order_relaxed) )
+        ;
+
+    if ( a->shared.fetch_sub(1, std::memory_order_acq_rel) == 1 )
+        release_arena(a);
+}
+
+bool add_chunk(Arena* a)
+{
+    if ( a->num_chunks == MAX_CHUNKS )
+        return false;
+
+    bool hugepages = snort_conf and snort_conf->memory and snort_conf->memory->hugepages;
+    void* p = map_chunk(hugepages);
+
+    if ( !p )
+        return false;
+
+    static_cast<ChunkHeader*>(p)->owner = a;
+    a->chunks[a->num_chunks++] = p;
+    a->cursor = static_cast<uint8_t*>(p) + HEADER_SIZE;
+    a->remaining = CHUNK_SIZE - HEADER_SIZE;
+    return true;
+}
+
+// any tail too small for the request is abandoned with the old chunk
+void* carve(Arena* a, size_t n)
+{
+    if ( a->remaining < n and !add_chunk(a) )
+        return nullptr;
+
+    void* p = a->cursor;
+    a->cursor += n;
+    a->remaining -= n;
+    return p;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// public interface
+// -----------------------------------------------------------------------------
+
+const size_t SlabAllocator::ALIGN;
+const size_t SlabAllocator::MAX_SIZE;
+
+void* SlabAllocator::allocate(size_t n)
+{
+    if ( n > MAX_SIZE )
+        return ::operator new(n);
+
+    size_t size = get_size_class(n);
+
+    {
+        // prevent allocation reentry
+        ReentryContext reentry_context(in_allocation_call);
+        assert(!reentry_context.is_reentry());
+
+        if ( !MemoryCap::free_space(size) )
+            throw std::bad_alloc();
+    }
+
+    Arena* a = get_arena();
+
+    if ( !a )
+        throw std::bad_alloc();
+
+    FreeNode*& head = a->free_list[get_class_index(n)];
+    void* p;
+
+    if ( !head and a->remote.load(std::memory_order_relaxed) )
+        drain_remote(a);
+
+    if ( head )
+    {
+        p = head;
+        head = head->next;
+    }
+    else if ( !(p = carve(a, size)) )
+        throw std::bad_alloc();
+
+    a->in_use++;
+    MemoryCap::update_allocations(size);
+    return p;
+}
+
+void SlabAllocator::deallocate(void* p, size_t n)
+{
+    if ( !p )
+        return;
+
+    if ( n > MAX_SIZE )
+    {
+        ::operator delete(p);
+        return;
+    }
+
+    Arena* a = get_owner(p);
+    FreeNode* node = static_cast<FreeNode*>(p);
+    size_t cls = get_class_index(n);
+
+    MemoryCap::update_deallocations(get_size_class(n));
+
+    if ( a != s_arena )
+    {
+        remote_free(a, node, cls);
+        return;
+    }
+
+    FreeNode*& head = a->free_list[cls];
+
+    node->next = head;
+    head = node;
+
+    a->in_use--;
+}
+
+void SlabAllocator::thread_term()
+{
+    Arena* a = s_arena;
+
+    if ( !a )
+        return;
+
+    s_arena = nullptr;
+
+    // the arena outlives this thread until its last object is freed
+    long live = a->in_use - OWNER_BIAS;
+
+    if ( a->shared.fetch_add(live, std::memory_order_acq_rel) + live == 0 )
+        release_arena(a);
+}
+
+} // namespace memory
+
+// -----------------------------------------------------------------------------
+// unit tests
+// -----------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+namespace t_slab_allocator
+{
+
+struct Base : public memory::SlabObject
+{
+    virtual ~Base() { }
+    uint8_t a[24];
+};
+
+struct Derived : public Base
+{
+    uint8_t b[100];
+};
+
+struct Large : public memory::SlabObject
+{
+    uint8_t c[memory::SlabAllocator::MAX_SIZE + 1];
+};
+
+} // namespace t_slab_allocator
+
+TEST_CASE( "slab size classes", "[memory]" )
+{
+    using memory::SlabAllocator;
+
+    CHECK( SlabAllocator::get_size_class(1) == 16 );
+    CHECK( SlabAllocator::get_size_class(16) == 16 );
+    CHECK( SlabAllocator::get_size_class(17) == 32 );
+    CHECK( SlabAllocator::get_size_class(SlabAllocator::MAX_SIZE) == SlabAllocator::MAX_SIZE );
+}
+
+TEST_CASE( "slab objects", "[memory]" )
+{
+    using namespace t_slab_allocator;
+
+    SECTION( "freed objects are reused by size class" )
+    {
+        Base* b = new Derived;
+        delete b;
+
+        Base* d = new Derived;
+        CHECK( d == b );
+
+        Base* e = new Base;
+        CHECK( e != d );
+
+        delete d;
+        delete e;
+    }
+
+    SECTION( "objects are carved contiguously" )
+    {
+        Base* b1 = new Base;
+        Base* b2 = new Base;
+        Base* b3 = new Base;
+
+        CHECK( (uint8_t*)b3 - (uint8_t*)b2 == (long)sizeof(Base) );
+        CHECK( (uint8_t*)b2 - (uint8_t*)b1 == (long)sizeof(Base) );
+
+        delete b1;
+        delete b2;
+        delete b3;
+    }
+
+    SECTION( "large objects pass through" )
+    {
+        Large* l = new Large;
+        CHECK( l );
+        delete l;
+    }
+
+    SECTION( "objects freed by another thread go back to their arena" )
+    {
+        Base* b = new Base;
+        std::thread t([b]() { delete b; });
+        t.join();
+
+        Base* c = new Base;
+        CHECK( c == b );
+        delete c;
+    }
+
+    SECTION( "arena outlives its thread until the last object is freed" )
+    {
+        Base* b = nullptr;
+        std::thread t([&b]()
+        {
+            b = new Base;
+            memory::SlabAllocator::thread_term();
+        });
+        t.join();
+
+        // the other thread's chunk is still mapped
+        memset(b->a, 0, sizeof(b->a));
+        delete b;
+    }
+
+    memory::SlabAllocator::thread_term();
+}
+
+#endif
+
@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+// SlabAllocator provides per thread free lists of small fixed size objects
+// carved from large chunks so that hot per flow objects avoid malloc and
+// the memory manager header.  Sizes are rounded up to a multiple of 16 and
+// anything larger than MAX_SIZE is passed through to the global allocator.
+// Chunks are 2 MB and hugepage backed when memory.hugepages is set.
+//
+// Objects are charged to MemoryCap at their size class when allocated and
+// credited when freed so pruning works as before.  An object freed by
+// another thread is returned to the arena of the thread that allocated it.
+
+#include <cstddef>
+
+#include "main/snort_types.h"
+
+namespace memory
+{
+
+class SO_PUBLIC SlabAllocator
+{
+public:
+    static void* allocate(size_t);
+    static void deallocate(void*, size_t);
+
+    // release the calling thread's chunks; if any objects are still
+    // outstanding the last one freed releases them
+    static void thread_term();
+
+    static size_t get_size_class(size_t n)
+    { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+
+    static const size_t ALIGN = 16;
+    static const size_t MAX_SIZE = 1024;
+};
+
+// derive from SlabObject to allocate a class and its subclasses from
+// slabs; the base class must have a virtual destructor so the sized
+// delete gets the size of the most derived class
+struct SO_PUBLIC SlabObject
+{
+    static void* operator new(size_t n)
+    { return SlabAllocator::allocate(n); }
+
+    static void operator delete(void* p, size_t n)
+    { SlabAllocator::deallocate(p, n); }
+};
+
+} // namespace memory
+
+#endif
+
@@ -25,6 +25,7 @@
 
 #include <string.h>
 
+#include "codecs/ip/checksum.h"
 #include "main/snort_config.h"
 #include "packet_io/sfdaq.h"
 #include "protocols/ipv4.h"
@@ -141,7 +142,9 @@ int Norm_Packet(NormalizerConfig* c, Packet* p)
 //
 // also note that checksums are not calculated here.  they are only
 // calculated once after all normalizations are done (here, stream)
-// and any replacements are made.
+// and any replacements are made.  the exception is the ip4 header
+// checksum which is updated incrementally (rfc 1624) as the header is
+// edited so that encode only has to account for the length change.
 //-----------------------------------------------------------------------
 
 #if 0
@@ -162,6 +165,9 @@ static int Norm_Eth(Packet* p, uint8_t layer, int changes)
 // ether header + min payload (excludes FCS, which makes it 64 total)
 #define ETH_MIN_LEN 60
 
+// 15 words of IHL
+#define IP4_MAX_HLEN 60
+
 static inline NormMode get_norm_mode(const NormalizerConfig* const c, const Packet * const p)
 {
     NormMode mode = c->norm_mode;
@@ -180,6 +186,14 @@ static int Norm_IP4(
     uint16_t origbits = fragbits;
     const NormMode mode = get_norm_mode(c, p);
 
+    // header edits update ip_csum incrementally; see Ipv4Codec::update()
+    const uint16_t hlen = p->layers[layer].length;
+    uint16_t orig[IP4_MAX_HLEN / 2];
+    int orig_changes = changes;
+
+    if ( mode == NORM_MODE_ON )
+        memcpy(orig, h, hlen);
+
     if ( Norm_IsEnabled(c, NORM_IP4_TRIM) && (layer == 1) )
     {
         uint32_t len = p->layers[0].length + ntohs(h->ip_len);
@@ -268,6 +282,9 @@ static int Norm_IP4(
         }
         normStats[PC_IP4_OPTS][mode]++;
     }
+    if ( changes > orig_changes )
+        h->ip_csum = checksum::update(h->ip_csum, orig, (uint16_t*)h, hlen);
+
     return changes;
 }
 
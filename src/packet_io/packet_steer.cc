@@ -0,0 +1,368 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "packet_steer.h"
+
+#include <string.h>
+
+#include <atomic>
+
+#include <sfbpf_dlt.h>
+
+#include "sfdaq.h"
+#include "sfdaq_config.h"
+#include "hash/sfhashfcn.h"
+#include "helpers/ring.h"
+#include "log/messages.h"
+#include "main/snort_config.h"
+#include "main/thread.h"
+#include "utils/stats.h"
+
+//-------------------------------------------------------------------------
+// ring slots are reused in place so the payload buffer is only allocated
+// the first time a slot is written
+//-------------------------------------------------------------------------
+
+struct SteerSlot
+{
+    DAQ_PktHdr_t pkth;
+    uint8_t* data = nullptr;
+
+    ~SteerSlot()
+    { delete[] data; }
+};
+
+typedef Ring<SteerSlot> SteerRing;
+
+// a producer counts itself in before checking that the owner is alive so
+// the owner can wait out any push that raced with its termination
+struct SteerPeer
+{
+    std::atomic<bool> alive;
+    std::atomic<unsigned> producers;
+
+    SteerPeer()
+    { alive = false; producers = 0; }
+};
+
+class SteerMesh
+{
+public:
+    SteerMesh(unsigned threads, unsigned depth);
+    ~SteerMesh();
+
+    SteerRing* get(unsigned src, unsigned dst)
+    { return rings[src * num + dst]; }
+
+    unsigned num;
+    uint32_t snap;
+    SteerPeer* peers;
+
+private:
+    SteerRing** rings;
+};
+
+SteerMesh::SteerMesh(unsigned threads, unsigned depth)
+{
+    num = threads;
+    snap = SFDAQ::get_snap_len();
+    rings = new SteerRing*[num * num];
+    peers = new SteerPeer[num];
+
+    // a thread never forwards to itself
+    for ( unsigned src = 0; src < num; ++src )
+        for ( unsigned dst = 0; dst < num; ++dst )
+            rings[src * num + dst] = (src == dst) ? nullptr : new SteerRing(depth);
+}
+
+SteerMesh::~SteerMesh()
+{
+    for ( unsigned i = 0; i < num * num; ++i )
+        delete rings[i];
+
+    delete[] rings;
+    delete[] peers;
+}
+
+//-------------------------------------------------------------------------
+// raw header parsing
+// only ethernet (with up to 2 vlan tags) and raw ip are understood; the
+// owner is chosen before decode so the packet is decoded and counted once,
+// by the thread that analyzes it.
+//-------------------------------------------------------------------------
+
+#define ETH_HDR_LEN 14
+#define VLAN_TAG_LEN 4
+#define MAX_VLAN_TAGS 2
+
+#define STEER_ETYPE_IPV4 0x0800
+#define STEER_ETYPE_IPV6 0x86DD
+#define STEER_ETYPE_8021Q 0x8100
+#define STEER_ETYPE_8021AD 0x88A8
+#define STEER_ETYPE_QINQ 0x9100
+
+static THREAD_LOCAL int s_dlt = -1;
+
+static inline uint16_t get_u16(const uint8_t* p)
+{ return (p[0] << 8) | p[1]; }
+
+static bool get_ip_addrs(
+    const uint8_t* pkt, uint32_t len, const uint8_t*& src, const uint8_t*& dst, unsigned& n)
+{
+    if ( len < 1 )
+        return false;
+
+    switch ( pkt[0] >> 4 )
+    {
+    case 4:
+        if ( len < 20 )
+            return false;
+        src = pkt + 12;
+        dst = pkt + 16;
+        n = 4;
+        return true;
+
+    case 6:
+        if ( len < 40 )
+            return false;
+        src = pkt + 8;
+        dst = pkt + 24;
+        n = 16;
+        return true;
+    }
+    return false;
+}
+
+static bool get_addrs(
+    const uint8_t* pkt, uint32_t len, const uint8_t*& src, const uint8_t*& dst,
+    unsigned& n, uint16_t& vid)
+{
+    vid = 0;
+
+    switch ( s_dlt )
+    {
+    case DLT_EN10MB:
+        break;
+
+    case DLT_RAW:
+#ifdef DLT_IPV4
+    case DLT_IPV4:
+#endif
+#ifdef DLT_IPV6
+    case DLT_IPV6:
+#endif
+        return get_ip_addrs(pkt, len, src, dst, n);
+
+    default:
+        return false;
+    }
+
+    if ( len < ETH_HDR_LEN )
+        return false;
+
+    uint16_t type = get_u16(pkt + 12);
+    uint32_t off = ETH_HDR_LEN;
+
+    for ( unsigned i = 0; i < MAX_VLAN_TAGS; ++i )
+    {
+        if ( type != STEER_ETYPE_8021Q and type != STEER_ETYPE_8021AD and type != STEER_ETYPE_QINQ )
+            break;
+
+        if ( len < off + VLAN_TAG_LEN )
+            return false;
+
+        // the outer tag identifies the network
+        if ( !i )
+            vid = get_u16(pkt + off) & 0x0FFF;
+
+        type = get_u16(pkt + off + 2);
+        off += VLAN_TAG_LEN;
+    }
+
+    if ( type != STEER_ETYPE_IPV4 and type != STEER_ETYPE_IPV6 )
+        return false;
+
+    return get_ip_addrs(pkt + off, len - off, src, dst, n);
+}
+
+//-------------------------------------------------------------------------
+// public methods
+//-------------------------------------------------------------------------
+
+SteerMesh* PacketSteer::mesh = nullptr;
+
+void PacketSteer::init(const SnortConfig* sc, unsigned threads)
+{
+    if ( !sc->daq_config->steer_flows or threads < 2 )
+        return;
+
+    // forwarded packets are passed on the receiving thread before they are
+    // inspected so this can't be used when we are able to block
+    if ( SnortConfig::inline_mode() or SnortConfig::adaptor_inline_mode() )
+    {
+        ParseWarning(WARN_DAQ, "daq.steer_flows is not supported in inline mode\n");
+        return;
+    }
+    mesh = new SteerMesh(threads, sc->daq_config->steer_depth);
+}
+
+void PacketSteer::term()
+{
+    delete mesh;
+    mesh = nullptr;
+}
+
+void PacketSteer::thread_init()
+{
+    s_dlt = SFDAQ::get_base_protocol();
+    mesh->peers[get_instance_id()].alive = true;
+}
+
+void PacketSteer::thread_term(DAQ_Analysis_Func_t callback, void* user)
+{
+    SteerPeer& peer = mesh->peers[get_instance_id()];
+    peer.alive = false;
+
+    // a push that saw us alive completes before the final drain
+    while ( peer.producers )
+        ;
+
+    drain(callback, user);
+}
+
+// symmetric hash of the outermost address pair so that both directions of
+// a conversation, and all fragments of a datagram, land on the same thread.
+// ports are not included since non-initial fragments don't have them.
+// packets that are not ip are handled by the acquiring thread.
+unsigned PacketSteer::get_owner(const DAQ_PktHdr_t* pkth, const uint8_t* pkt)
+{
+    const uint8_t* src;
+    const uint8_t* dst;
+    unsigned len;
+    uint16_t vid;
+
+    if ( !get_addrs(pkt, pkth->caplen, src, dst, len, vid) )
+        return get_instance_id();
+
+    if ( memcmp(src, dst, len) > 0 )
+    {
+        const uint8_t* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    uint32_t s[4] = { 0, 0, 0, 0 };
+    uint32_t d[4] = { 0, 0, 0, 0 };
+
+    memcpy(s, src, len);
+    memcpy(d, dst, len);
+
+    uint32_t a = s[0] ^ s[1];
+    uint32_t b = s[2] ^ s[3];
+    uint32_t c = pkth->address_space_id;
+
+    mix(a, b, c);
+
+    a += d[0] ^ d[1];
+    b += d[2] ^ d[3];
+    c += vid;
+
+    finalize(a, b, c);
+
+    return c % mesh->num;
+}
+
+bool PacketSteer::forward(const DAQ_PktHdr_t* pkth, const uint8_t* pkt)
+{
+    unsigned self = get_instance_id();
+    unsigned owner = get_owner(pkth, pkt);
+
+    if ( owner == self )
+        return false;
+
+    if ( pkth->caplen > mesh->snap )
+    {
+        aux_counts.steer_overflows++;
+        return false;
+    }
+
+    // an owner that has not started or has terminated can't take it
+    SteerPeer& peer = mesh->peers[owner];
+    peer.producers++;
+
+    if ( !peer.alive )
+    {
+        peer.producers--;
+        return false;
+    }
+
+    SteerRing* ring = mesh->get(self, owner);
+    SteerSlot* slot = ring->write();
+
+    // never wait on the owner; it may be waiting on us
+    if ( !slot )
+    {
+        peer.producers--;
+        aux_counts.steer_overflows++;
+        return false;
+    }
+
+    if ( !slot->data )
+        slot->data = new uint8_t[mesh->snap];
+
+    slot->pkth = *pkth;
+    memcpy(slot->data, pkt, pkth->caplen);
+
+    ring->push();
+    peer.producers--;
+
+    aux_counts.steer_forwarded++;
+    return true;
+}
+
+unsigned PacketSteer::drain(DAQ_Analysis_Func_t callback, void* user)
+{
+    unsigned self = get_instance_id();
+    unsigned n = 0;
+
+    for ( unsigned src = 0; src < mesh->num; ++src )
+    {
+        if ( src == self )
+            continue;
+
+        SteerRing* ring = mesh->get(src, self);
+        SteerSlot* slot;
+
+        // don't chase a busy producer indefinitely
+        int max = ring->count();
+
+        while ( max-- > 0 and (slot = ring->read()) )
+        {
+            callback(user, &slot->pkth, slot->data);
+            ring->pop();
+            ++n;
+        }
+    }
+    aux_counts.steer_received += n;
+    return n;
+}
+
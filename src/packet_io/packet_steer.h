@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+
+#ifndef PACKET_STEER_H
+#define PACKET_STEER_H
+
+// PacketSteer provides optional software flow affinity between packet
+// threads.  When the DAQ does not deliver both directions of a conversation
+// to the same thread, the raw headers of each packet are hashed
+// symmetrically before decode and packets owned by another thread are
+// copied onto a single producer / single consumer ring for that thread.
+// Each (source, destination) thread pair has its own ring so no locking is
+// required.  When disabled, the only cost is one test of enabled() per
+// packet.
+
+extern "C" {
+#include <daq.h>
+}
+
+#include "main/snort_types.h"
+
+struct SnortConfig;
+
+class PacketSteer
+{
+public:
+    // main thread; rings are only built for passive multi-thread operation
+    static void init(const SnortConfig*, unsigned threads);
+    static void term();
+
+    static bool enabled()
+    { return mesh != nullptr; }
+
+    // packet thread: accept forwarded packets once ready to analyze them
+    static void thread_init();
+
+    // packet thread: stop accepting forwarded packets and drain the rest
+    static void thread_term(DAQ_Analysis_Func_t, void* user);
+
+    // packet thread: returns the instance id owning the raw packet
+    static unsigned get_owner(const DAQ_PktHdr_t*, const uint8_t* pkt);
+
+    // packet thread: returns true if the packet was copied to its owner
+    static bool forward(const DAQ_PktHdr_t*, const uint8_t* pkt);
+
+    // packet thread: process packets forwarded to this thread
+    static unsigned drain(DAQ_Analysis_Func_t, void* user);
+
+private:
+    static class SteerMesh* mesh;
+};
+
+#endif
+
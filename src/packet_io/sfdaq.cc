@@ -287,6 +287,7 @@ SFDAQInstance::SFDAQInstance(const char* intf)
     daq_hand = nullptr;
     daq_dlt = -1;
     s_error = DAQ_SUCCESS;
+    batch_size = 0;
     memset(&daq_stats, 0, sizeof(daq_stats));
 }
 
@@ -363,6 +364,7 @@ bool SFDAQInstance::configure(const SnortConfig* sc)
         FatalError("DAQ configuration incompatible with intended operation.\n");
 
     set_filter(sc->bpf_filter.c_str());
+    batch_size = sc->daq_config->batch_size;
 
     return true;
 }
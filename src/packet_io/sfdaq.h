@@ -50,6 +50,7 @@ public:
     bool was_started();
     bool stop();
     void set_metacallback(DAQ_Meta_Func_t);
+    unsigned get_batch_size() { return batch_size; }
     int acquire(int max, DAQ_Analysis_Func_t);
     int inject(const DAQ_PktHdr_t*, int rev, const uint8_t* buf, uint32_t len);
     bool break_loop(int error);
@@ -62,6 +63,7 @@ private:
     void* daq_hand;
     int daq_dlt;
     int s_error;
+    unsigned batch_size;
     DAQ_Stats_t daq_stats;
 };
 
@@ -23,6 +23,7 @@
 using namespace std;
 
 static const unsigned DEFAULT_PKT_TIMEOUT = 1000;    // ms, worst daq resolution is 1 sec
+static const unsigned DEFAULT_STEER_DEPTH = 1024;    // packets per thread pair
 
 static pair<string, string> parse_variable(const char* varkvp)
 {
@@ -70,6 +71,9 @@ SFDAQConfig::SFDAQConfig()
 {
     mru_size = -1;
     timeout = DEFAULT_PKT_TIMEOUT;
+    batch_size = 0;
+    steer_flows = false;
+    steer_depth = DEFAULT_STEER_DEPTH;
 }
 
 SFDAQConfig::~SFDAQConfig()
@@ -121,6 +125,21 @@ void SFDAQConfig::set_mru_size(int mru_size_value)
     mru_size = mru_size_value;
 }
 
+void SFDAQConfig::set_batch_size(unsigned batch_size_value)
+{
+    batch_size = batch_size_value;
+}
+
+void SFDAQConfig::set_steer_flows(bool steer_flows_value)
+{
+    steer_flows = steer_flows_value;
+}
+
+void SFDAQConfig::set_steer_depth(unsigned steer_depth_value)
+{
+    steer_depth = steer_depth_value;
+}
+
 void SFDAQConfig::set_variable(const char* varkvp, int instance_id)
 {
     if (instance_id >= 0)
@@ -159,6 +178,15 @@ void SFDAQConfig::overlay(const SFDAQConfig* other)
     if (other->mru_size != -1)
         mru_size = other->mru_size;
 
+    if (other->batch_size)
+        batch_size = other->batch_size;
+
+    if (other->steer_flows)
+        steer_flows = other->steer_flows;
+
+    if (other->steer_depth != DEFAULT_STEER_DEPTH)
+        steer_depth = other->steer_depth;
+
     for (auto oit = other->instances.begin(); oit != other->instances.end(); oit++)
     {
         SFDAQInstanceConfig* oic = oit->second;
@@ -47,6 +47,9 @@ struct SFDAQConfig
     void set_input_spec(const char*, int instance_id = -1);
     void set_module_name(const char*);
     void set_mru_size(int);
+    void set_batch_size(unsigned);
+    void set_steer_flows(bool);
+    void set_steer_depth(unsigned);
     void set_variable(const char* varkvp, int instance_id = -1);
 
     void overlay(const SFDAQConfig*);
@@ -59,6 +62,9 @@ struct SFDAQConfig
     std::vector<std::pair<std::string, std::string>> variables;
     int mru_size;
     unsigned int timeout;
+    unsigned int batch_size;
+    bool steer_flows;
+    unsigned int steer_depth;
     std::unordered_map<unsigned, SFDAQInstanceConfig*> instances;
 };
 
@@ -58,6 +58,9 @@ static const Parameter s_params[] =
     { "instances", Parameter::PT_LIST, instance_params, nullptr, "DAQ instance overrides" },
     { "snaplen", Parameter::PT_INT, "0:65535", nullptr, "set snap length (same as -s)" },
     { "no_promisc", Parameter::PT_BOOL, nullptr, "false", "whether to put DAQ device into promiscuous mode" },
+    { "steer_flows", Parameter::PT_BOOL, nullptr, "false", "hand packets off between packet threads so both directions of a conversation are analyzed by the same thread (passive only)" },
+    { "steer_depth", Parameter::PT_INT, "16:65536", "1024", "packets queued from each packet thread to each other packet thread when steering" },
+    { "batch_size", Parameter::PT_INT, "0:65535", "0", "maximum packets acquired per DAQ call before housekeeping (0 = acquire until idle)" },
 
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
@@ -109,6 +112,18 @@ bool SFDAQModule::set(const char* fqn, Value& v, SnortConfig* sc)
     {
         config->set_mru_size(v.get_long());
     }
+    else if (!strcmp(fqn, "daq.batch_size"))
+    {
+        config->set_batch_size(v.get_long());
+    }
+    else if (!strcmp(fqn, "daq.steer_flows"))
+    {
+        config->set_steer_flows(v.get_bool());
+    }
+    else if (!strcmp(fqn, "daq.steer_depth"))
+    {
+        config->set_steer_depth(v.get_long());
+    }
     else if (!strcmp(fqn, "daq.no_promisc"))
     {
         v.update_mask(sc->run_flags, RUN_FLAG__NO_PROMISCUOUS);
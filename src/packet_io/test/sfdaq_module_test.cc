@@ -53,6 +53,15 @@ TEST_CASE("Kitchen Sink", "[SFDAQModule]")
     Value snaplen(static_cast<double>(6666));
     CHECK(sfdm.set("daq.snaplen", snaplen, &sc));
 
+    Value batch_size(static_cast<double>(64));
+    CHECK(sfdm.set("daq.batch_size", batch_size, &sc));
+
+    Value steer_flows(true);
+    CHECK(sfdm.set("daq.steer_flows", steer_flows, &sc));
+
+    Value steer_depth(static_cast<double>(256));
+    CHECK(sfdm.set("daq.steer_depth", steer_depth, &sc));
+
     Value no_promisc(true);
     CHECK(sfdm.set("daq.no_promisc", no_promisc, &sc));
 
@@ -96,6 +105,11 @@ TEST_CASE("Kitchen Sink", "[SFDAQModule]")
 
     CHECK(cfg->mru_size == 6666);
 
+    CHECK(cfg->batch_size == 64);
+
+    CHECK(cfg->steer_flows);
+    CHECK(cfg->steer_depth == 256);
+
     REQUIRE(cfg->instances.size() == 1);
     for (auto it : cfg->instances)
     {
@@ -118,6 +132,7 @@ TEST_CASE("Kitchen Sink", "[SFDAQModule]")
     sc2.daq_config->set_input_spec("cli_input_spec");
     sc2.daq_config->set_variable("cli_global_variable=abc");
     sc2.daq_config->set_mru_size(3333);
+    sc2.daq_config->set_batch_size(128);
     sc2.daq_config->set_input_spec(NULL, 2);
     sc2.daq_config->set_input_spec("cli_instance_2_input", 2);
     sc2.daq_config->set_input_spec("cli_instance_5_input", 5);
@@ -133,6 +148,7 @@ TEST_CASE("Kitchen Sink", "[SFDAQModule]")
     CHECK(cfg->variables[0].first == "cli_global_variable");
     CHECK(cfg->variables[0].second == "abc");
     CHECK(cfg->mru_size == 3333);
+    CHECK(cfg->batch_size == 128);
     REQUIRE(cfg->instances.size() == 2);
     for (auto it : cfg->instances)
     {
@@ -55,6 +55,7 @@ static inline OtnState& operator+=(OtnState& lhs, const OtnState& rhs)
     lhs.checks += rhs.checks;
     lhs.matches += rhs.matches;
     lhs.alerts += rhs.alerts;
+    lhs.rejects += rhs.rejects;
     return lhs;
 }
 
@@ -76,6 +77,7 @@ static const StatsTable::Field fields[] =
     { "avg/non-match", 14, '\0', 1, std::ios_base::fmtflags() },
     { "timeouts", 9, '\0', 0, std::ios_base::fmtflags() },
     { "suspends", 9, '\0', 0, std::ios_base::fmtflags() },
+    { "rejects", 8, '\0', 0, std::ios_base::fmtflags() },
     { nullptr, 0, '\0', 0, std::ios_base::fmtflags() }
 };
 
@@ -111,6 +113,9 @@ struct View
     uint64_t suspends() const
     { return state.latency_suspends; }
 
+    uint64_t rejects() const
+    { return state.rejects; }
+
     hr_duration time_per(hr_duration d, uint64_t v) const
     {
         if ( v  == 0 )
@@ -242,6 +247,7 @@ static void print_single_entry(const View& v, unsigned n)
 
         table << v.timeouts();
         table << v.suspends();
+        table << v.rejects();
     }
 
     LogMessage("%s", ss.str().c_str());
@@ -404,6 +410,7 @@ TEST_CASE( "otn state", "[profiler][rule_profiler]" )
         state_b.matches = 6;
         state_b.noalerts = 7;
         state_b.alerts = 8;
+        state_b.rejects = 9;
 
         state_a += state_b;
 
@@ -412,6 +419,7 @@ TEST_CASE( "otn state", "[profiler][rule_profiler]" )
         CHECK( state_a.checks == 6 );
         CHECK( state_a.matches == 8 );
         CHECK( state_a.alerts == 12 );
+        CHECK( state_a.rejects == 9 );
     }
 
     SECTION( "reset" )
@@ -448,6 +456,7 @@ TEST_CASE( "rule entry", "[profiler][rule_profiler]" )
     entry.state.alerts = 77;
     entry.state.latency_timeouts = 5;
     entry.state.latency_suspends = 2;
+    entry.state.rejects = 9;
 
     SECTION( "copy assignment" )
     {
@@ -512,6 +521,11 @@ TEST_CASE( "rule entry", "[profiler][rule_profiler]" )
         CHECK( entry.suspends() == 2 );
     }
 
+    SECTION( "rejects" )
+    {
+        CHECK( entry.rejects() == 9 );
+    }
+
 
     SECTION( "avg_match" )
     {
@@ -51,6 +51,7 @@
 #include "packet_io/active.h"
 
 THREAD_LOCAL ProfileStats decodePerfStats;
+THREAD_LOCAL ProfileStats decodeShapePerfStats[DECODE_SHAPE_MAX];
 
 // Decoding statistics
 
@@ -115,6 +116,44 @@ void PacketManager::pop_teredo(Packet* p, RawData& raw)
     raw.len += lyr_len;
 }
 
+// eth, any vlan tags, ip4 or ip6 without extensions, and tcp or udp
+static DecodeShape get_decode_shape(const Packet* p)
+{
+    const Layer* lyr = p->layers;
+    const uint8_t n = p->num_layers;
+    uint8_t i = 1;
+
+    if ( n < 3 || lyr[0].prot_id != ProtocolId::ETHERNET_802_3 )
+        return DECODE_SHAPE_OTHER;
+
+    while ( i < n && lyr[i].prot_id == ProtocolId::ETHERTYPE_8021Q )
+        ++i;
+
+    if ( n - i != 2 )
+        return DECODE_SHAPE_OTHER;
+
+    const ProtocolId ip = lyr[i].prot_id;
+    const ProtocolId xport = lyr[i+1].prot_id;
+
+    if ( ip == ProtocolId::ETHERTYPE_IPV4 )
+    {
+        if ( xport == ProtocolId::TCP )
+            return DECODE_SHAPE_IP4_TCP;
+
+        if ( xport == ProtocolId::UDP )
+            return DECODE_SHAPE_IP4_UDP;
+    }
+    else if ( ip == ProtocolId::ETHERTYPE_IPV6 )
+    {
+        if ( xport == ProtocolId::TCP )
+            return DECODE_SHAPE_IP6_TCP;
+
+        if ( xport == ProtocolId::UDP )
+            return DECODE_SHAPE_IP6_UDP;
+    }
+    return DECODE_SHAPE_OTHER;
+}
+
 //-------------------------------------------------------------------------
 // Initialization and setup
 //-------------------------------------------------------------------------
@@ -141,6 +180,14 @@ void PacketManager::decode(
 {
     Profile profile(decodePerfStats);
 
+    // the shape isn't known until decode is done so time it directly,
+    // but only when time profiling is on
+    const bool shape_timing = SnortConfig::get_profiler()->time.show;
+    Stopwatch<hr_clock> shape_sw;
+
+    if ( shape_timing )
+        shape_sw.start();
+
     DecodeData unsure_encap_ptrs;
 
     ProtocolIndex mapped_prot = CodecManager::grinder;
@@ -298,6 +345,9 @@ void PacketManager::decode(
 
     if ( !p->proto_bits )
         p->proto_bits = PROTO_BIT__OTHER;
+
+    if ( shape_timing )
+        decodeShapePerfStats[get_decode_shape(p)].time.update(shape_sw.get());
 }
 
 //-------------------------------------------------------------------------
@@ -76,6 +76,17 @@ public:
         return bnfaCompile(sc, obj);
     }
 
+    int compile(SnortConfig*) override
+    {
+        return bnfaCompileStates(obj);
+    }
+
+    int finish(SnortConfig* sc) override
+    {
+        bnfaFinish(sc, obj);
+        return 0;
+    }
+
     int _search(
         const uint8_t* T, int n, MpseMatch match,
         void* context, int* current_state) override
@@ -0,0 +1,223 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#include "acsmx2.h"
+
+#include "framework/mpse.h"
+#include "main/snort_config.h"
+
+#ifdef UNIT_TEST
+#include <string.h>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#endif
+
+//-------------------------------------------------------------------------
+// "ac_full_simd"
+//
+// ac_full with a vectorized filter that skips text which can't leave the
+// start state.  this helps most when the port group patterns start with
+// relatively few distinct bytes.  instances with too many first bytes
+// just run ac_full.
+//-------------------------------------------------------------------------
+
+class AcfsMpse : public Mpse
+{
+private:
+    ACSM_STRUCT2* obj;
+
+public:
+    AcfsMpse(SnortConfig*, bool use_gc, const MpseAgent* agent)
+        : Mpse("ac_full_simd", use_gc)
+    {
+        obj = acsmNew2(agent, ACF_FULL);
+        obj->enable_dfa();
+        obj->enable_filter();
+    }
+
+    ~AcfsMpse()
+    { acsmFree2(obj); }
+
+    void set_opt(int flag) override
+    { acsmCompressStates(obj, flag); }
+
+    int add_pattern(
+        SnortConfig*, const uint8_t* P, unsigned m,
+        const PatternDescriptor& desc, void* user) override
+    {
+        return acsmAddPattern2(obj, P, m, desc.no_case, desc.negated, user);
+    }
+
+    int prep_patterns(SnortConfig* sc) override
+    { return acsmCompile2(sc, obj); }
+
+    int compile(SnortConfig*) override
+    { return acsmCompileStates2(obj); }
+
+    int finish(SnortConfig* sc) override
+    {
+        acsmFinish2(sc, obj);
+        return 0;
+    }
+
+    int _search(
+        const uint8_t* T, int n, MpseMatch match,
+        void* context, int* current_state) override
+    {
+        return acsm_search_dfa_full_filtered(obj, T, n, match, context, current_state);
+    }
+
+    int print_info() override
+    { return acsmPrintDetailInfo2(obj); }
+
+    int get_pattern_count() override
+    { return acsmPatternCount2(obj); }
+};
+
+//-------------------------------------------------------------------------
+// api
+//-------------------------------------------------------------------------
+
+static Mpse* acfs_ctor(
+    SnortConfig* sc, class Module*, bool use_gc, const MpseAgent* agent)
+{
+    return new AcfsMpse(sc, use_gc, agent);
+}
+
+static void acfs_dtor(Mpse* p)
+{
+    delete p;
+}
+
+static void acfs_init()
+{
+    acsmx2_init_xlatcase();
+    acsm_init_summary();
+}
+
+static void acfs_print()
+{
+    acsmPrintSummaryInfo2();
+}
+
+static const MpseApi acfs_api =
+{
+    {
+        PT_SEARCH_ENGINE,
+        sizeof(MpseApi),
+        SEAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        "ac_full_simd",
+        "Aho-Corasick Full with vectorized start state skipping (avx2 or ssse3)",
+        nullptr,
+        nullptr
+    },
+    false,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    acfs_ctor,
+    acfs_dtor,
+    acfs_init,
+    acfs_print,
+};
+
+const BaseApi* se_ac_full_simd = &acfs_api.base;
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+typedef std::vector<std::pair<void*, int>> Hits;
+
+static int add_hit(void* user, void*, int index, void* context, void*)
+{
+    ((Hits*)context)->push_back(std::make_pair(user, index));
+    return 0;
+}
+
+TEST_CASE("ac_full_simd matches ac_full", "[ac_full_simd]")
+{
+    static const char* pats[] = { "GET", "post", "/../", "%00", "<script" };
+    static const char* fill = "0123456789 xyzXYZ\n";
+    acsmx2_init_xlatcase();
+
+    for ( int compress = 0; compress < 2; ++compress )
+    {
+        ACSM_STRUCT2* full = acsmNew2(nullptr, ACF_FULL);
+        ACSM_STRUCT2* simd = acsmNew2(nullptr, ACF_FULL);
+
+        full->enable_dfa();
+        simd->enable_dfa();
+        simd->enable_filter();
+
+        acsmCompressStates(full, compress);
+        acsmCompressStates(simd, compress);
+
+        for ( unsigned i = 0; i < sizeof(pats)/sizeof(pats[0]); ++i )
+        {
+            unsigned n = strlen(pats[i]);
+            acsmAddPattern2(full, (const uint8_t*)pats[i], n, i % 2, false, (void*)pats[i]);
+            acsmAddPattern2(simd, (const uint8_t*)pats[i], n, i % 2, false, (void*)pats[i]);
+        }
+        CHECK(acsmCompile2(nullptr, full) == 0);
+        CHECK(acsmCompile2(nullptr, simd) == 0);
+        CHECK(simd->filter);
+
+        std::vector<uint8_t> text(4096);
+        unsigned seed = 1;
+
+        for ( unsigned i = 0; i < text.size(); ++i )
+        {
+            seed = seed * 1103515245 + 12345;
+
+            if ( (seed >> 16) % 50 )
+                text[i] = fill[(seed >> 8) % strlen(fill)];
+            else
+            {
+                const char* p = pats[(seed >> 8) % 5];
+                unsigned n = strlen(p);
+
+                for ( unsigned j = 0; j < n and i < text.size(); ++j )
+                    text[i++] = p[j];
+            }
+        }
+
+        Hits a, b;
+        int sa = 0, sb = 0;
+
+        acsm_search_dfa_full(full, &text[0], text.size(), add_hit, &a, &sa);
+        acsm_search_dfa_full_filtered(simd, &text[0], text.size(), add_hit, &b, &sb);
+
+        CHECK(!a.empty());
+        CHECK(a == b);
+        CHECK(sa == sb);
+
+        acsmFree2(full);
+        acsmFree2(simd);
+    }
+}
+
+#endif
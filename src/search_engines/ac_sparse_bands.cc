@@ -59,6 +59,15 @@ public:
     int prep_patterns(SnortConfig* sc) override
     { return acsmCompile2(sc, obj); }
 
+    int compile(SnortConfig*) override
+    { return acsmCompileStates2(obj); }
+
+    int finish(SnortConfig* sc) override
+    {
+        acsmFinish2(sc, obj);
+        return 0;
+    }
+
     int _search(
         const uint8_t* T, int n, MpseMatch match,
         void* context, int* current_state) override
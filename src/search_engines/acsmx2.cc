@@ -122,6 +122,7 @@
 #include <string.h>
 #include <ctype.h>
 
+#include <atomic>
 #include <list>
 
 #define ACSMX2_TRACK_Q
@@ -135,19 +136,23 @@
 #include "utils/stats.h"
 #include "utils/util.h"
 
+#include "first_byte_filter.h"
+
 #define printf LogMessage
 
 #define MEMASSERT(p,s) if (!p) { FatalError("ACSM-No Memory: %s\n",s); }
 
-static int acsm2_total_memory = 0;
-static int acsm2_pattern_memory = 0;
-static int acsm2_matchlist_memory = 0;
-static int acsm2_transtable_memory = 0;
-static int acsm2_dfa_memory = 0;
-static int acsm2_dfa1_memory = 0;
-static int acsm2_dfa2_memory = 0;
-static int acsm2_dfa4_memory = 0;
-static int acsm2_failstate_memory = 0;
+// these are updated by acsmCompileStates2() which may run concurrently
+// for multiple instances; see fp_create.cc
+static std::atomic<int> acsm2_total_memory(0);
+static std::atomic<int> acsm2_pattern_memory(0);
+static std::atomic<int> acsm2_matchlist_memory(0);
+static std::atomic<int> acsm2_transtable_memory(0);
+static std::atomic<int> acsm2_dfa_memory(0);
+static std::atomic<int> acsm2_dfa1_memory(0);
+static std::atomic<int> acsm2_dfa2_memory(0);
+static std::atomic<int> acsm2_dfa4_memory(0);
+static std::atomic<int> acsm2_failstate_memory(0);
 
 struct acsm_summary_t
 {
@@ -160,6 +165,7 @@ struct acsm_summary_t
     unsigned num_1byte_instances;
     unsigned num_2byte_instances;
     unsigned num_4byte_instances;
+    unsigned num_filtered_instances;
     ACSM_STRUCT2 acsm;
 };
 
@@ -176,6 +182,7 @@ void acsm_init_summary()
     summary.num_1byte_instances = 0;
     summary.num_2byte_instances = 0;
     summary.num_4byte_instances = 0;
+    summary.num_filtered_instances = 0;
     memset(&summary.acsm, 0, sizeof(ACSM_STRUCT2));
     acsm2_total_memory = 0;
     acsm2_pattern_memory = 0;
@@ -1143,8 +1150,6 @@ static void acsmUpdateMatchStates(ACSM_STRUCT2* acsm)
                 p[1] = 1;
                 break;
             }
-
-            summary.num_match_states++;
         }
     }
 }
@@ -1220,11 +1225,7 @@ static inline int _acsmCompile2(ACSM_STRUCT2* acsm)
 
     /* Add each Pattern to the State Table - This forms a keywords state table  */
     for (plist = acsm->acsmPatterns; plist != NULL; plist = plist->next)
-    {
-        summary.num_patterns++;
-        summary.num_characters += plist->n;
         AddPatternStates(acsm, plist);
-    }
 
     /* Add the 0'th state */
     acsm->acsmNumStates++;
@@ -1232,20 +1233,13 @@ static inline int _acsmCompile2(ACSM_STRUCT2* acsm)
     if (acsm->compress_states)
     {
         if (acsm->acsmNumStates < UINT8_MAX)
-        {
             acsm->sizeofstate = 1;
-            summary.num_1byte_instances++;
-        }
+
         else if (acsm->acsmNumStates < UINT16_MAX)
-        {
             acsm->sizeofstate = 2;
-            summary.num_2byte_instances++;
-        }
+
         else
-        {
             acsm->sizeofstate = 4;
-            summary.num_4byte_instances++;
-        }
     }
     else
     {
@@ -1312,25 +1306,108 @@ static inline int _acsmCompile2(ACSM_STRUCT2* acsm)
     /* Free up the Table Of Transition Lists */
     List_FreeTransTable(acsm);
 
-    /* Accrue Summary State Stats */
+    return 0;
+}
+
+/* Accrue Summary State Stats */
+static void acsmAccrueSummary2(ACSM_STRUCT2* acsm)
+{
+    for ( ACSM_PATTERN2* plist = acsm->acsmPatterns; plist; plist = plist->next )
+    {
+        summary.num_patterns++;
+        summary.num_characters += plist->n;
+    }
+
+    for ( int i = 0; i < acsm->acsmNumStates; i++ )
+    {
+        if ( acsm->acsmMatchList[i] )
+            summary.num_match_states++;
+    }
+
+    if ( acsm->compress_states )
+    {
+        if ( acsm->sizeofstate == 1 )
+            summary.num_1byte_instances++;
+
+        else if ( acsm->sizeofstate == 2 )
+            summary.num_2byte_instances++;
+
+        else
+            summary.num_4byte_instances++;
+    }
+
+    if ( acsm->filter )
+        summary.num_filtered_instances++;
+
     summary.num_states += acsm->acsmNumStates;
     summary.num_transitions += acsm->acsmNumTrans;
     summary.num_instances++;
 
     memcpy(&summary.acsm, acsm, sizeof(ACSM_STRUCT2));
+}
 
-    return 0;
+// with more than this many first bytes the filter stops often enough
+// that it costs more than it saves
+#define MAX_FIRST_BYTES 64
+
+static acstate_t acsmGetFullNextState2(ACSM_STRUCT2* acsm, int state, unsigned c)
+{
+    switch ( acsm->sizeofstate )
+    {
+    case 1:
+        return ((uint8_t**)acsm->acsmNextState)[state][2u + c];
+    case 2:
+        return ((uint16_t**)acsm->acsmNextState)[state][2u + c];
+    default:
+        return acsm->acsmNextState[state][2u + c];
+    }
 }
 
-int acsmCompile2(
-    SnortConfig* sc, ACSM_STRUCT2* acsm)
+static void acsmBuildFilter2(ACSM_STRUCT2* acsm)
+{
+    if ( !acsm->dfa or acsm->acsmFormat != ACF_FULL or acsm->acsmMatchList[0] )
+        return;
+
+    FirstByteFilter* f = new FirstByteFilter;
+
+    for ( unsigned b = 0; b < 256; ++b )
+    {
+        if ( acsmGetFullNextState2(acsm, 0, xlatcase[b]) )
+            f->add((uint8_t)b);
+    }
+
+    if ( f->size() > MAX_FIRST_BYTES )
+        delete f;
+    else
+        acsm->filter = f;
+}
+
+int acsmCompileStates2(ACSM_STRUCT2* acsm)
 {
     if ( int rval = _acsmCompile2(acsm) )
         return rval;
 
+    if ( acsm->want_filter )
+        acsmBuildFilter2(acsm);
+
+    return 0;
+}
+
+void acsmFinish2(SnortConfig* sc, ACSM_STRUCT2* acsm)
+{
+    acsmAccrueSummary2(acsm);
+
     if ( acsm->agent )
         acsmBuildMatchStateTrees2(sc, acsm);
+}
+
+int acsmCompile2(
+    SnortConfig* sc, ACSM_STRUCT2* acsm)
+{
+    if ( int rval = acsmCompileStates2(acsm) )
+        return rval;
 
+    acsmFinish2(sc, acsm);
     return 0;
 }
 
@@ -1701,6 +1778,106 @@ int acsm_search_dfa_full(
 *    2) using 'nocase' improves performance again by 10-15%, since memcmp is not needed
 *    3)
 */
+// same as AC_SEARCH except that runs of text that can't leave the start
+// state are skipped.  the start state has no matches (else there is no
+// filter) so nothing is missed.
+#define AC_SEARCH_FILTERED \
+    for (; T < Tend; T++ ) \
+    { \
+        if ( !state ) \
+        { \
+            T = filter->skip(T, Tend); \
+            if ( T == Tend ) \
+                break; \
+        } \
+        ps = NextState[ state ]; \
+        sindex = xlatcase[T[0]]; \
+        if (ps[1]) \
+        { \
+            mlist = MatchList[state]; \
+            if (mlist) \
+            { \
+                index = T - Tx; \
+                nfound++; \
+                if (match (mlist->udata, mlist->rule_option_tree, index, context, \
+                    mlist->neg_list) > 0) \
+                { \
+                    *current_state = state; \
+                    return nfound; \
+                } \
+            } \
+        } \
+        state = ps[2u + sindex]; \
+    }
+
+int acsm_search_dfa_full_filtered(
+    ACSM_STRUCT2* acsm, const uint8_t* Tx, int n, MpseMatch match,
+    void* context, int* current_state)
+{
+    const FirstByteFilter* filter = acsm->filter;
+
+    if ( !filter )
+        return acsm_search_dfa_full(acsm, Tx, n, match, context, current_state);
+
+    ACSM_PATTERN2* mlist;
+    const uint8_t* Tend;
+    const uint8_t* T;
+    int index;
+    int sindex;
+    int nfound = 0;
+    acstate_t state;
+    ACSM_PATTERN2** MatchList = acsm->acsmMatchList;
+
+    T = Tx;
+    Tend = Tx + n;
+
+    if (current_state == NULL)
+        return 0;
+
+    state = *current_state;
+
+    switch (acsm->sizeofstate)
+    {
+    case 1:
+    {
+        uint8_t* ps;
+        uint8_t** NextState = (uint8_t**)acsm->acsmNextState;
+        AC_SEARCH_FILTERED;
+    }
+    break;
+    case 2:
+    {
+        uint16_t* ps;
+        uint16_t** NextState = (uint16_t**)acsm->acsmNextState;
+        AC_SEARCH_FILTERED;
+    }
+    break;
+    default:
+    {
+        acstate_t* ps;
+        acstate_t** NextState = acsm->acsmNextState;
+        AC_SEARCH_FILTERED;
+    }
+    break;
+    }
+
+    /* Check the last state for a pattern match */
+    mlist = MatchList[state];
+    if (mlist)
+    {
+        index = T - Tx;
+        nfound++;
+        if (match(mlist->udata, mlist->rule_option_tree, index, context, mlist->neg_list) > 0)
+        {
+            *current_state = state;
+            return nfound;
+        }
+    }
+
+    *current_state = state;
+    return nfound;
+}
+
 #define AC_SEARCH_ALL \
     for (; T < Tend; T++ ) \
     { \
@@ -1980,6 +2157,7 @@ void acsmFree2(ACSM_STRUCT2* acsm)
     AC_FREE_DFA(acsm->acsmNextState, 0, 0);
     AC_FREE(acsm->acsmFailState, 0, ACSM2_MEMORY_TYPE__NONE);
     AC_FREE(acsm->acsmMatchList, 0, ACSM2_MEMORY_TYPE__NONE);
+    delete acsm->filter;
     AC_FREE(acsm, 0, ACSM2_MEMORY_TYPE__NONE);
 }
 
@@ -2137,6 +2315,12 @@ int acsmPrintSummaryInfo2()
             LogCount("4 byte states", summary.num_4byte_instances);
     }
 
+    if ( summary.num_filtered_instances )
+    {
+        LogCount("filtered instances", summary.num_filtered_instances);
+        LogValue("filter kernel", FirstByteFilter::get_kernel());
+    }
+
     double scale;
 
     if ( acsm2_total_memory < 1024*1024 )
@@ -126,11 +126,19 @@ struct ACSM_STRUCT2
 
     bool dfa;
 
+    // set for ac_full_simd; acsmCompileStates2() builds the filter if the
+    // start state of a full dfa has few enough exits to make it worthwhile
+    bool want_filter;
+    class FirstByteFilter* filter;
+
     void enable_dfa()
     { dfa = true; }
 
     bool dfa_enabled()
     { return dfa; }
+
+    void enable_filter()
+    { want_filter = true; }
 };
 
 /*
@@ -146,6 +154,11 @@ int acsmAddPattern2(
 
 int acsmCompile2(struct SnortConfig*, ACSM_STRUCT2*);
 
+// acsmCompile2() == acsmCompileStates2() + acsmFinish2(); the former
+// does not touch any shared state so it may run in a worker thread
+int acsmCompileStates2(ACSM_STRUCT2*);
+void acsmFinish2(struct SnortConfig*, ACSM_STRUCT2*);
+
 int acsm_search_nfa(
     ACSM_STRUCT2*, const uint8_t* T, int n, MpseMatch, void* context, int* current_state);
 
@@ -158,6 +171,11 @@ int acsm_search_dfa_banded(
 int acsm_search_dfa_full(
     ACSM_STRUCT2*, const uint8_t* T, int n, MpseMatch, void* context, int* current_state);
 
+// skips text that can't leave the start state with FirstByteFilter and
+// otherwise runs the full dfa; same as acsm_search_dfa_full() w/o filter
+int acsm_search_dfa_full_filtered(
+    ACSM_STRUCT2*, const uint8_t* T, int n, MpseMatch, void* context, int* current_state);
+
 int acsm_search_dfa_full_all(
     ACSM_STRUCT2*, const uint8_t* Tx, int n, MpseMatch, void* context, int* current_state);
 
@@ -27,6 +27,7 @@
 #ifdef BUILDING_SO
 extern const BaseApi* se_ac_banded;
 extern const BaseApi* se_ac_full;
+extern const BaseApi* se_ac_full_simd;
 extern const BaseApi* se_ac_sparse;
 extern const BaseApi* se_ac_sparse_bands;
 
@@ -34,6 +35,7 @@ SO_PUBLIC const BaseApi* snort_plugins[] =
 {
     se_ac_banded,
     se_ac_full,
+    se_ac_full_simd,
     se_ac_sparse,
     se_ac_sparse_bands,
     nullptr
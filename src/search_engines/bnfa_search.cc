@@ -1456,20 +1456,29 @@ static inline int _bnfaCompile(bnfa_struct_t* bnfa)
 
     bnfa->bnfaMatchStates = cntMatchStates;
 
+    return 0;
+}
+
+int bnfaCompileStates(bnfa_struct_t* bnfa)
+{
+    return _bnfaCompile(bnfa);
+}
+
+void bnfaFinish(SnortConfig* sc, bnfa_struct_t* bnfa)
+{
     bnfaAccumInfo(bnfa);
 
-    return 0;
+    if ( bnfa->agent )
+        bnfaBuildMatchStateTrees(sc, bnfa);
 }
 
 int bnfaCompile(
     SnortConfig* sc, bnfa_struct_t* bnfa)
 {
-    if ( int rval = _bnfaCompile (bnfa) )
+    if ( int rval = bnfaCompileStates(bnfa) )
         return rval;
 
-    if ( bnfa->agent )
-        bnfaBuildMatchStateTrees(sc, bnfa);
-
+    bnfaFinish(sc, bnfa);
     return 0;
 }
 
@@ -168,6 +168,11 @@ int bnfaAddPattern(
 
 int bnfaCompile(struct SnortConfig*, bnfa_struct_t*);
 
+// bnfaCompile() == bnfaCompileStates() + bnfaFinish(); the former does
+// not touch any shared state so it may run in a worker thread
+int bnfaCompileStates(bnfa_struct_t*);
+void bnfaFinish(struct SnortConfig*, bnfa_struct_t*);
+
 unsigned _bnfa_search_csparse_nfa(
     bnfa_struct_t * pstruct, const uint8_t* t, int tlen, MpseMatch,
     void* context, unsigned sindex, int* current_state);
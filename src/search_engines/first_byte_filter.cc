@@ -0,0 +1,256 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "first_byte_filter.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FBF_X86
+#endif
+
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
+typedef const uint8_t* (*SkipFunc)(
+    const uint8_t* lo, const uint8_t* hi, const bool* set,
+    const uint8_t* p, const uint8_t* end);
+
+static const uint8_t* skip_scalar(
+    const uint8_t*, const uint8_t*, const bool* set,
+    const uint8_t* p, const uint8_t* end)
+{
+    while ( p < end and !set[*p] )
+        ++p;
+
+    return p;
+}
+
+#ifdef FBF_X86
+
+// candidates in mask m (bit i for p[i]) are confirmed against the set
+static inline const uint8_t* confirm(
+    const bool* set, const uint8_t* p, unsigned m)
+{
+    while ( m )
+    {
+        unsigned i = __builtin_ctz(m);
+
+        if ( set[p[i]] )
+            return p + i;
+
+        m &= m - 1;
+    }
+    return nullptr;
+}
+
+__attribute__((target("ssse3")))
+static const uint8_t* skip_ssse3(
+    const uint8_t* lo, const uint8_t* hi, const bool* set,
+    const uint8_t* p, const uint8_t* end)
+{
+    const __m128i lo_t = _mm_load_si128((const __m128i*)lo);
+    const __m128i hi_t = _mm_load_si128((const __m128i*)hi);
+    const __m128i nib = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+
+    while ( p + 16 <= end )
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i l = _mm_shuffle_epi8(lo_t, _mm_and_si128(v, nib));
+        __m128i h = _mm_shuffle_epi8(hi_t, _mm_and_si128(_mm_srli_epi16(v, 4), nib));
+        __m128i z = _mm_cmpeq_epi8(_mm_and_si128(l, h), zero);
+        unsigned m = ~(unsigned)_mm_movemask_epi8(z) & 0xFFFF;
+
+        if ( m )
+        {
+            if ( const uint8_t* q = confirm(set, p, m) )
+                return q;
+        }
+        p += 16;
+    }
+    return skip_scalar(lo, hi, set, p, end);
+}
+
+__attribute__((target("avx2")))
+static const uint8_t* skip_avx2(
+    const uint8_t* lo, const uint8_t* hi, const bool* set,
+    const uint8_t* p, const uint8_t* end)
+{
+    const __m256i lo_t = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)lo));
+    const __m256i hi_t = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)hi));
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+
+    while ( p + 32 <= end )
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i l = _mm256_shuffle_epi8(lo_t, _mm256_and_si256(v, nib));
+        __m256i h = _mm256_shuffle_epi8(hi_t, _mm256_and_si256(_mm256_srli_epi16(v, 4), nib));
+        __m256i z = _mm256_cmpeq_epi8(_mm256_and_si256(l, h), zero);
+        unsigned m = ~(unsigned)_mm256_movemask_epi8(z);
+
+        if ( m )
+        {
+            if ( const uint8_t* q = confirm(set, p, m) )
+                return q;
+        }
+        p += 32;
+    }
+    return skip_ssse3(lo, hi, set, p, end);
+}
+
+#endif
+
+struct Kernel
+{
+    SkipFunc func;
+    const char* name;
+};
+
+static Kernel select_kernel()
+{
+#ifdef FBF_X86
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports("avx2") )
+        return { skip_avx2, "avx2" };
+
+    if ( __builtin_cpu_supports("ssse3") )
+        return { skip_ssse3, "ssse3" };
+#endif
+    return { skip_scalar, "scalar" };
+}
+
+static const Kernel s_kernel = select_kernel();
+
+//-------------------------------------------------------------------------
+// filter methods
+//-------------------------------------------------------------------------
+
+FirstByteFilter::FirstByteFilter()
+{ clear(); }
+
+void FirstByteFilter::clear()
+{
+    memset(set, 0, sizeof(set));
+    memset(lo, 0, sizeof(lo));
+    memset(hi, 0, sizeof(hi));
+    count = 0;
+
+    for ( unsigned n = 0; n < 16; ++n )
+        hi[n] = 1 << (n % 8);
+}
+
+void FirstByteFilter::add(uint8_t b)
+{
+    if ( set[b] )
+        return;
+
+    set[b] = true;
+    lo[b & 0xF] |= 1 << ((b >> 4) % 8);
+    ++count;
+}
+
+const uint8_t* FirstByteFilter::skip(const uint8_t* p, const uint8_t* end) const
+{
+    return s_kernel.func(lo, hi, set, p, end);
+}
+
+const char* FirstByteFilter::get_kernel()
+{ return s_kernel.name; }
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+static const uint8_t* slow_skip(
+    const FirstByteFilter& f, const uint8_t* p, const uint8_t* end)
+{
+    while ( p < end and !f.has(*p) )
+        ++p;
+    return p;
+}
+
+TEST_CASE("first byte filter empty", "[FirstByteFilter]")
+{
+    FirstByteFilter f;
+    uint8_t buf[100];
+    memset(buf, 'x', sizeof(buf));
+
+    CHECK(f.size() == 0);
+    CHECK(f.skip(buf, buf + sizeof(buf)) == buf + sizeof(buf));
+}
+
+TEST_CASE("first byte filter aliases", "[FirstByteFilter]")
+{
+    // 0x11 and 0x91 share a nibble lookup bucket
+    FirstByteFilter f;
+    f.add(0x11);
+
+    uint8_t buf[77];
+    memset(buf, 0x91, sizeof(buf));
+    buf[70] = 0x11;
+
+    CHECK(f.size() == 1);
+    CHECK(f.skip(buf, buf + sizeof(buf)) == buf + 70);
+    CHECK(f.skip(buf + 71, buf + sizeof(buf)) == buf + sizeof(buf));
+}
+
+TEST_CASE("first byte filter random", "[FirstByteFilter]")
+{
+    FirstByteFilter f;
+    uint8_t buf[1024];
+    unsigned seed = 1;
+
+    for ( unsigned i = 0; i < 8; ++i )
+    {
+        seed = seed * 1103515245 + 12345;
+        f.add((uint8_t)(seed >> 16));
+    }
+
+    for ( auto& b : buf )
+    {
+        seed = seed * 1103515245 + 12345;
+        b = (uint8_t)(seed >> 16);
+    }
+
+    const uint8_t* end = buf + sizeof(buf);
+
+    for ( unsigned start = 0; start < 64; ++start )
+    {
+        const uint8_t* p = buf + start;
+
+        while ( p < end )
+        {
+            const uint8_t* q = f.skip(p, end);
+            CHECK(q == slow_skip(f, p, end));
+            p = q + 1;
+        }
+    }
+}
+
+#endif
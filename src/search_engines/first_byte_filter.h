@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifndef FIRST_BYTE_FILTER_H
+#define FIRST_BYTE_FILTER_H
+
+// FirstByteFilter finds the next byte in a buffer that is a member of a
+// given set.  it is used to skip quickly through text that can't start a
+// pattern.  the set is tested with a vectorized nibble lookup (SSSE3 or
+// AVX2, selected at runtime by cpuid) and candidates are confirmed with a
+// table lookup so skip() is exact.
+
+#include <stdint.h>
+
+class FirstByteFilter
+{
+public:
+    FirstByteFilter();
+
+    void add(uint8_t);
+    void clear();
+
+    unsigned size() const
+    { return count; }
+
+    bool has(uint8_t b) const
+    { return set[b]; }
+
+    // return first p in [start, end) with has(*p) or end if none
+    const uint8_t* skip(const uint8_t* start, const uint8_t* end) const;
+
+    // name of the kernel selected for this cpu
+    static const char* get_kernel();
+
+private:
+    bool set[256];
+    unsigned count;
+
+    // bit (hi nibble % 8) is set in lo[b & 0xF] for each member b
+    // and hi[n] = 1 << (n % 8); b may be a member iff the and is not 0
+    alignas(16) uint8_t lo[16];
+    alignas(16) uint8_t hi[16];
+};
+
+#endif
@@ -18,12 +18,18 @@
 
 // hyperscan.cc author Russ Combs <rucombs@cisco.com>
 
-#include "hyperscan.h"
-
 #include <assert.h>
 #include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -32,6 +38,8 @@
 
 #include "framework/mpse.h"
 #include "log/messages.h"
+#include "detection/fp_config.h"
+#include "helpers/hyper_scratch.h"
 #include "main/snort_config.h"
 #include "utils/stats.h"
 
@@ -86,11 +94,262 @@ void Pattern::escape(const uint8_t* s, unsigned n, bool literal)
 
 typedef std::vector<Pattern> PatternVector;
 
-// we need to update scratch in the main thread as each pattern is processed
-// and then clone to thread specific after all rules are loaded.  s_scratch is
-// a prototype that is large enough for all uses.
+//-------------------------------------------------------------------------
+// database cache
+//-------------------------------------------------------------------------
+
+// compiling large pattern sets dominates startup and reload so compiled
+// databases are saved in search_engine.cache_dir and loaded on the next
+// start if the patterns, flags, mode, hyperscan version, and platform all
+// match.  the file name is a hash of those.  the platform is included
+// because hs_deserialize_database() only rejects a different version; a
+// database built for cpu features this host lacks would be accepted.
+// databases are compiled for the populated host platform, not the generic
+// default, so the key matches what was built.  files are touched when
+// loaded and the least recently used are removed once the directory
+// exceeds search_engine.cache_max_size.
+
+// compile_multi() may run in worker threads
+static std::atomic<uint64_t> cache_hits(0);
+static std::atomic<uint64_t> cache_misses(0);
+static std::atomic<uint64_t> cache_errors(0);
+static uint64_t cache_prunes = 0;
+
+static uint64_t cache_hash(uint64_t h, const void* pv, size_t n)
+{
+    const uint8_t* p = (const uint8_t*)pv;
+
+    for ( size_t i = 0; i < n; ++i )
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ull;  // fnv-1a
+    }
+    return h;
+}
+
+static std::string cache_file(
+    const char* dir, const char* const* pats, const unsigned* flags,
+    unsigned n, unsigned mode, const hs_platform_info_t& plat)
+{
+    const char* ver = hs_version();
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    h = cache_hash(h, ver, strlen(ver) + 1);
+    h = cache_hash(h, &mode, sizeof(mode));
+    h = cache_hash(h, &plat.tune, sizeof(plat.tune));
+    h = cache_hash(h, &plat.cpu_features, sizeof(plat.cpu_features));
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        h = cache_hash(h, pats[i], strlen(pats[i]) + 1);
+        h = cache_hash(h, flags + i, sizeof(flags[i]));
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "/hs-%016llx.db", (unsigned long long)h);
+
+    std::string file = dir;
+    file += name;
+    return file;
+}
+
+static hs_database_t* cache_load(const std::string& file)
+{
+    FILE* f = fopen(file.c_str(), "rb");
+
+    if ( !f )
+        return nullptr;
+
+    hs_database_t* db = nullptr;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if ( len > 0 )
+    {
+        std::vector<char> buf(len);
+
+        if ( fread(&buf[0], 1, len, f) == (size_t)len and
+            hs_deserialize_database(&buf[0], len, &db) != HS_SUCCESS )
+            db = nullptr;
+    }
+    fclose(f);
+
+    // mark it used for pruning
+    if ( db )
+        utime(file.c_str(), nullptr);
+
+    return db;
+}
+
+static void cache_save(const std::string& file, const hs_database_t* db)
+{
+    char* bytes = nullptr;
+    size_t len = 0;
+
+    if ( hs_serialize_database(db, &bytes, &len) != HS_SUCCESS )
+        return;
+
+    // write a uniquely named temporary and rename so concurrent loaders
+    // never see a partial file and concurrent savers of the same database,
+    // in this process or another one sharing the dir, don't collide.  the
+    // temporary doesn't end in .db so it is never pruned.
+    std::string tmp = file + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    FILE* f = nullptr;
+
+    if ( fd >= 0 )
+    {
+        fchmod(fd, 0644);
+
+        if ( !(f = fdopen(fd, "wb")) )
+        {
+            close(fd);
+            unlink(tmp.c_str());
+        }
+    }
+
+    if ( !f )
+    {
+        ++cache_errors;
+        free(bytes);
+        return;
+    }
+    bool ok = fwrite(bytes, 1, len, f) == len;
+    ok = (fclose(f) == 0) and ok;
+
+    if ( !ok or rename(tmp.c_str(), file.c_str()) )
+    {
+        ++cache_errors;
+        unlink(tmp.c_str());
+    }
+
+    free(bytes);
+}
+
+struct CacheEntry
+{
+    std::string file;
+    time_t mtime;
+    off_t size;
+};
+
+// runs once per load on the main thread after all databases are compiled
+static void cache_prune(const char* dir, unsigned long max_size)
+{
+    DIR* d = opendir(dir);
+
+    if ( !d )
+        return;
+
+    std::vector<CacheEntry> entries;
+    unsigned long total = 0;
+
+    while ( struct dirent* de = readdir(d) )
+    {
+        size_t len = strlen(de->d_name);
+
+        if ( strncmp(de->d_name, "hs-", 3) or len < 6 or strcmp(de->d_name + len - 3, ".db") )
+            continue;
+
+        CacheEntry e;
+        e.file = dir;
+        e.file += "/";
+        e.file += de->d_name;
+
+        struct stat st;
+
+        if ( stat(e.file.c_str(), &st) or !S_ISREG(st.st_mode) )
+            continue;
+
+        e.mtime = st.st_mtime;
+        e.size = st.st_size;
+        total += e.size;
+        entries.push_back(e);
+    }
+    closedir(d);
+
+    if ( total <= max_size )
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+        [](const CacheEntry& a, const CacheEntry& b) { return a.mtime < b.mtime; });
+
+    for ( auto& e : entries )
+    {
+        if ( total <= max_size )
+            break;
+
+        if ( !unlink(e.file.c_str()) )
+        {
+            total -= e.size;
+            ++cache_prunes;
+        }
+    }
+}
+
+static hs_error_t compile_multi(
+    SnortConfig* sc, const char* const* pats, const unsigned* flags, const unsigned* ids,
+    unsigned n, unsigned mode, hs_database_t** db, hs_compile_error_t** err)
+{
+    hs_platform_info_t plat;
+
+    if ( hs_populate_platform(&plat) != HS_SUCCESS )
+        return hs_compile_multi(pats, flags, ids, n, mode, nullptr, db, err);
+
+    const char* dir = sc->fast_pattern_config->get_cache_dir();
+
+    if ( !dir )
+        return hs_compile_multi(pats, flags, ids, n, mode, &plat, db, err);
+
+    std::string file = cache_file(dir, pats, flags, n, mode, plat);
+
+    if ( (*db = cache_load(file)) )
+    {
+        ++cache_hits;
+        return HS_SUCCESS;
+    }
+    ++cache_misses;
+
+    hs_error_t ret = hs_compile_multi(pats, flags, ids, n, mode, &plat, db, err);
 
-static hs_scratch_t* s_scratch = nullptr;
+    if ( ret == HS_SUCCESS and *db )
+        cache_save(file, *db);
+
+    return ret;
+}
+
+//-------------------------------------------------------------------------
+// stream
+//-------------------------------------------------------------------------
+
+// hyperscan reports match offsets from the start of the stream; base is
+// the stream offset of the current buffer so matches can be reported
+// relative to it like block mode.
+
+// open streams are held by flows so their state is charged to a per
+// packet thread memcap; file_data is searched by buffer when exhausted.
+static THREAD_LOCAL unsigned long stream_mem_in_use = 0;
+
+class HyperscanStream : public MpseStream
+{
+public:
+    HyperscanStream(hs_stream_t* s, size_t n)
+    {
+        id = s; base = 0; size = n;
+        stream_mem_in_use += size;
+    }
+
+    ~HyperscanStream()
+    {
+        hs_close_stream(id, nullptr, nullptr, nullptr);
+        stream_mem_in_use -= size;
+    }
+
+    hs_stream_t* id;
+    unsigned long long base;
+    size_t size;
+};
 
 //-------------------------------------------------------------------------
 // mpse
@@ -99,11 +358,11 @@ static hs_scratch_t* s_scratch = nullptr;
 class HyperscanMpse : public Mpse
 {
 public:
-    HyperscanMpse(SnortConfig*, bool use_gc, const MpseAgent* a)
+    HyperscanMpse(SnortConfig* sc, bool use_gc, const MpseAgent* a)
         : Mpse("hyperscan", use_gc)
     {
         agent = a;
-        ++instances;
+        stream_memcap = sc->fast_pattern_config->get_stream_file_data_memcap();
     }
 
     ~HyperscanMpse()
@@ -111,6 +370,9 @@ public:
         if ( hs_db )
             hs_free_database(hs_db);
 
+        if ( hs_stream_db )
+            hs_free_database(hs_stream_db);
+
         user_dtor();
     }
 
@@ -120,23 +382,44 @@ public:
     {
         Pattern p(pat, len, desc, user);
         pvector.push_back(p);
-        ++patterns;
         return 0;
     }
 
     int prep_patterns(SnortConfig*) override;
+    int compile(SnortConfig*) override;
+    int finish(SnortConfig*) override;
 
     int _search(const uint8_t*, int, MpseMatch, void*, int*) override;
+    int _search_stream(MpseStream*&, const uint8_t*, int, MpseMatch, void*) override;
+
+    void set_stream(bool b) override
+    { stream = b; }
+
+    bool can_stream() override
+    { return hs_stream_db != nullptr; }
 
     int get_pattern_count() override
     { return pvector.size(); }
 
-    int match(unsigned id, unsigned long long to);
+    struct ScanContext
+    {
+        const HyperscanMpse* mpse;
+        MpseMatch match_cb;
+        void* match_ctx;
+        unsigned long long base;
+        unsigned len;
+    };
+
+    int match(unsigned id, unsigned long long to, MpseMatch, void*) const;
 
     static int match(
         unsigned id, unsigned long long from, unsigned long long to,
         unsigned flags, void*);
 
+    static int stream_match(
+        unsigned id, unsigned long long from, unsigned long long to,
+        unsigned flags, void*);
+
 private:
     void user_ctor(SnortConfig*);
     void user_dtor();
@@ -145,9 +428,10 @@ private:
     PatternVector pvector;
 
     hs_database_t* hs_db = nullptr;
-
-    MpseMatch match_cb = nullptr;
-    void* match_ctx = nullptr;
+    hs_database_t* hs_stream_db = nullptr;
+    size_t stream_size = 0;
+    unsigned long stream_memcap;
+    bool stream = false;
 
 public:
     static uint64_t instances;
@@ -193,7 +477,11 @@ void HyperscanMpse::user_dtor()
     }
 }
 
-int HyperscanMpse::prep_patterns(SnortConfig* sc)
+// compiling is the expensive part and only touches this instance so it
+// may run in a worker thread.  scratch is shared by all instances so it
+// is sized in finish() on the main thread.
+
+int HyperscanMpse::compile(SnortConfig* sc)
 {
     hs_compile_error_t* err = nullptr;
     std::vector<const char*> pats;
@@ -209,38 +497,99 @@ int HyperscanMpse::prep_patterns(SnortConfig* sc)
         ids.push_back(id++);
     }
 
-    if ( hs_compile_multi(&pats[0], &flags[0], &ids[0], pvector.size(), HS_MODE_BLOCK,
-            nullptr, &hs_db, &err) or !hs_db )
+    // FIXIT-L emit data from err
+    if ( compile_multi(sc, &pats[0], &flags[0], &ids[0], pvector.size(), HS_MODE_BLOCK,
+            &hs_db, &err) or !hs_db )
     {
-        // FIXIT-L emit data from err
-        ParseError("can't compile pattern database '%s'", "hs_compile_multi");
         hs_free_compile_error(err);
         return -1;
     }
 
-    if ( hs_error_t err = hs_alloc_scratch(hs_db, &s_scratch) )
+    // the stream database is in addition to the block database because
+    // the block scan is cheaper for buffers searched only once
+    if ( stream )
+    {
+        if ( compile_multi(sc, &pats[0], &flags[0], &ids[0], pvector.size(), HS_MODE_STREAM,
+                &hs_stream_db, &err) or !hs_stream_db )
+        {
+            hs_free_compile_error(err);
+            return -1;
+        }
+        if ( hs_stream_size(hs_stream_db, &stream_size) != HS_SUCCESS )
+            return -1;
+    }
+    return 0;
+}
+
+int HyperscanMpse::finish(SnortConfig* sc)
+{
+    if ( !HyperScratch::grow(sc, HyperScratch::MPSE, hs_db) )
+    {
+        ParseError("can't allocate search scratch space");
+        return -2;
+    }
+
+    if ( hs_stream_db and !HyperScratch::grow(sc, HyperScratch::MPSE, hs_stream_db) )
     {
-        ParseError("can't allocate search scratch space (%d)", err);
+        ParseError("can't allocate search scratch space");
         return -2;
     }
 
+    // counted here so port group duplicates that are deleted in favor of
+    // a shared instance aren't included
+    ++instances;
+    patterns += pvector.size();
+
     user_ctor(sc);
     return 0;
 }
 
-int HyperscanMpse::match(unsigned id, unsigned long long to)
+int HyperscanMpse::prep_patterns(SnortConfig* sc)
+{
+    if ( int ret = compile(sc) )
+    {
+        ParseError("can't compile pattern database '%s'", "hs_compile_multi");
+        return ret;
+    }
+    return finish(sc);
+}
+
+// per scan state is kept in a ScanContext on the caller's stack since the
+// same mpse instance is searched by all packet threads at once
+int HyperscanMpse::match(
+    unsigned id, unsigned long long to, MpseMatch mf, void* pv) const
 {
     assert(id < pvector.size());
-    Pattern& p = pvector[id];
-    return match_cb(p.user, p.user_tree, (int)to, match_ctx, p.user_list);
+    const Pattern& p = pvector[id];
+    return mf(p.user, p.user_tree, (int)to, pv, p.user_list);
 }
 
 int HyperscanMpse::match(
     unsigned id, unsigned long long /*from*/, unsigned long long to,
     unsigned /*flags*/, void* pv)
 {
-    HyperscanMpse* h = (HyperscanMpse*)pv;
-    return  h->match(id, to);
+    const ScanContext* sc = (ScanContext*)pv;
+    return sc->mpse->match(id, to, sc->match_cb, sc->match_ctx);
+}
+
+// a match that straddles buffers ends in the current one but starts in a
+// previous one.  its offset is clamped so the whole pattern lies within
+// the current buffer since that is all that rule options can see.
+int HyperscanMpse::stream_match(
+    unsigned id, unsigned long long /*from*/, unsigned long long to,
+    unsigned /*flags*/, void* pv)
+{
+    const ScanContext* sc = (ScanContext*)pv;
+    assert(id < sc->mpse->pvector.size());
+    assert(to >= sc->base);
+
+    unsigned long long end = to - sc->base;
+    unsigned len = sc->mpse->pvector[id].len;
+
+    if ( end < len )
+        end = len < sc->len ? len : sc->len;
+
+    return sc->mpse->match(id, end, sc->match_cb, sc->match_ctx);
 }
 
 int HyperscanMpse::_search(
@@ -248,54 +597,54 @@ int HyperscanMpse::_search(
 {
     *current_state = 0;
 
-    match_cb = mf;
-    match_ctx = pv;
-
-    SnortState* ss = snort_conf->state + get_instance_id();
+    ScanContext sc = { this, mf, pv, 0, (unsigned)n };
+    hs_scratch_t* scratch = HyperScratch::get(HyperScratch::MPSE);
 
     // scratch is null for the degenerate case w/o patterns
-    assert(!hs_db or ss->hyperscan_scratch);
+    assert(!hs_db or scratch);
 
-    hs_scan(hs_db, (char*)buf, n, 0, (hs_scratch_t*)ss->hyperscan_scratch,
-        HyperscanMpse::match, this);
+    hs_scan(hs_db, (char*)buf, n, 0, scratch, HyperscanMpse::match, &sc);
 
     return 0;
 }
 
-//-------------------------------------------------------------------------
-// public methods
-//-------------------------------------------------------------------------
-
-void hyperscan_setup(SnortConfig* sc)
+int HyperscanMpse::_search_stream(
+    MpseStream*& ms, const uint8_t* buf, int n, MpseMatch mf, void* pv)
 {
-    for ( unsigned i = 0; i < sc->num_slots; ++i )
-    {
-        SnortState* ss = sc->state + i;
+    if ( !hs_stream_db )
+        return Mpse::_search_stream(ms, buf, n, mf, pv);
 
-        if ( s_scratch )
-            hs_clone_scratch(s_scratch, (hs_scratch_t**)&ss->hyperscan_scratch);
-        else
-            ss->hyperscan_scratch = nullptr;
-    }
-    if ( s_scratch )
+    HyperscanStream* hss = (HyperscanStream*)ms;
+
+    if ( !hss )
     {
-        hs_free_scratch(s_scratch);
-        s_scratch = nullptr;
+        if ( stream_mem_in_use + stream_size > stream_memcap )
+            return Mpse::_search_stream(ms, buf, n, mf, pv);
+
+        hs_stream_t* id = nullptr;
+
+        if ( hs_open_stream(hs_stream_db, 0, &id) != HS_SUCCESS )
+            return Mpse::_search_stream(ms, buf, n, mf, pv);
+
+        ms = hss = new HyperscanStream(id, stream_size);
     }
-}
 
-void hyperscan_cleanup(SnortConfig* sc)
-{
-    for ( unsigned i = 0; i < sc->num_slots; ++i )
-    {
-        SnortState* ss = sc->state + i;
+    ScanContext sc = { this, mf, pv, hss->base, (unsigned)n };
+    hs_scratch_t* scratch = HyperScratch::get(HyperScratch::MPSE);
+    assert(scratch);
 
-        if ( ss->hyperscan_scratch )
-        {
-            hs_free_scratch((hs_scratch_t*)ss->hyperscan_scratch);
-            ss->hyperscan_scratch = nullptr;
-        }
+    hs_error_t ret = hs_scan_stream(hss->id, (char*)buf, n, 0,
+        scratch, HyperscanMpse::stream_match, &sc);
+
+    hss->base += n;
+
+    // a terminated stream can't be scanned again; start over next time
+    if ( ret == HS_SCAN_TERMINATED )
+    {
+        delete hss;
+        ms = nullptr;
     }
+    return 0;
 }
 
 //-------------------------------------------------------------------------
@@ -313,16 +662,33 @@ static void hs_dtor(Mpse* p)
     delete p;
 }
 
+static void hs_setup(SnortConfig* sc)
+{
+    const char* dir = sc->fast_pattern_config->get_cache_dir();
+    unsigned long max_size = sc->fast_pattern_config->get_cache_max_size();
+
+    if ( dir and max_size )
+        cache_prune(dir, max_size);
+}
+
 static void hs_init()
 {
     HyperscanMpse::instances = 0;
     HyperscanMpse::patterns = 0;
+    cache_hits = 0;
+    cache_misses = 0;
+    cache_errors = 0;
+    cache_prunes = 0;
 }
 
 static void hs_print()
 {
     LogCount("instances", HyperscanMpse::instances);
     LogCount("patterns", HyperscanMpse::patterns);
+    LogCount("cache hits", cache_hits);
+    LogCount("cache misses", cache_misses);
+    LogCount("cache errors", cache_errors);
+    LogCount("cache prunes", cache_prunes);
 }
 
 static const MpseApi hs_api =
@@ -341,7 +707,7 @@ static const MpseApi hs_api =
     },
     false,
     nullptr,  // activate
-    nullptr,  // setup
+    hs_setup,
     nullptr,  // start
     nullptr,  // stop
     hs_ctor,
@@ -33,6 +33,7 @@ struct PatMatQStat
     PegCount tot_inq_uinserts;
     PegCount non_qualified_events;
     PegCount qualified_events;
+    PegCount quick_rejects;
 };
 
 SO_PUBLIC extern THREAD_LOCAL PatMatQStat pmqs;
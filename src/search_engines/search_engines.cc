@@ -25,6 +25,7 @@
 struct BaseApi;
 
 extern const BaseApi* se_ac_bnfa;
+extern const BaseApi* se_teddy;
 
 #ifdef INTEL_SOFT_CPM
 extern const BaseApi* se_intel_cpm;
@@ -37,6 +38,7 @@ extern const BaseApi* se_hyperscan;
 #ifdef STATIC_SEARCH_ENGINES
 extern const BaseApi* se_ac_banded;
 extern const BaseApi* se_ac_full;
+extern const BaseApi* se_ac_full_simd;
 extern const BaseApi* se_ac_sparse;
 extern const BaseApi* se_ac_sparse_bands;
 extern const BaseApi* se_ac_std;
@@ -45,6 +47,7 @@ extern const BaseApi* se_ac_std;
 const BaseApi* search_engines[] =
 {
     se_ac_bnfa,
+    se_teddy,
 
 #ifdef INTEL_SOFT_CPM
     se_intel_cpm,
@@ -57,6 +60,7 @@ const BaseApi* search_engines[] =
 #ifdef STATIC_SEARCH_ENGINES
     se_ac_banded,
     se_ac_full,
+    se_ac_full_simd,
     se_ac_sparse,
     se_ac_sparse_bands,
     se_ac_std,
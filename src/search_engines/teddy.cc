@@ -0,0 +1,589 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// teddy is a bucketed literal matcher for small pattern sets.  patterns
+// are split into 8 buckets and the first m bytes (m <= 3 and <= the
+// shortest pattern) of each pattern set a bucket bit in a pair of 16 byte
+// nibble tables per position.  the text is then tested 16 positions at a
+// time with pshufb and any position whose bucket bits survive all m
+// tables is a candidate which is verified exactly against the patterns in
+// those buckets.  unlike an automaton, the tables fit in a few cache
+// lines.  matches are reported with the end offset like hyperscan.
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TEDDY_X86
+#endif
+
+#include "framework/mpse.h"
+#include "log/messages.h"
+#include "main/snort_config.h"
+#include "utils/stats.h"
+
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
+#define NUM_BUCKETS 8
+#define MAX_MASKS 3
+
+struct TeddyPattern
+{
+    std::string pat;   // folded to upper case if no_case
+    bool no_case;
+    bool negate;
+
+    void* user;
+    void* user_tree;
+    void* user_list;
+};
+
+//-------------------------------------------------------------------------
+// mpse
+//-------------------------------------------------------------------------
+
+class TeddyMpse : public Mpse
+{
+public:
+    TeddyMpse(SnortConfig*, bool use_gc, const MpseAgent* a)
+        : Mpse("teddy", use_gc)
+    {
+        agent = a;
+        masks = 0;
+    }
+
+    ~TeddyMpse()
+    {
+        if ( agent )
+            user_dtor();
+    }
+
+    int add_pattern(
+        SnortConfig*, const uint8_t* pat, unsigned len,
+        const PatternDescriptor&, void* user) override;
+
+    int prep_patterns(SnortConfig* sc) override
+    {
+        if ( int ret = compile(sc) )
+            return ret;
+
+        return finish(sc);
+    }
+
+    int compile(SnortConfig*) override;
+    int finish(SnortConfig*) override;
+
+    int _search(const uint8_t*, int, MpseMatch, void*, int*) override;
+
+    int get_pattern_count() override
+    { return pvector.size(); }
+
+    int print_info() override;
+
+#ifdef TEDDY_X86
+    __attribute__((target("ssse3")))
+    int scan_ssse3(const uint8_t*, int, MpseMatch, void*);
+#endif
+
+    int scan_scalar(const uint8_t*, int, int start, MpseMatch, void*);
+
+private:
+    void add_mask(unsigned bucket, unsigned pos, uint8_t);
+    bool verify(const uint8_t*, int n, int pos, unsigned bits, MpseMatch, void*);
+
+    void user_ctor(SnortConfig*);
+    void user_dtor();
+
+    const MpseAgent* agent;
+    std::vector<TeddyPattern> pvector;
+    std::vector<unsigned> buckets[NUM_BUCKETS];
+
+    unsigned masks;
+    alignas(16) uint8_t lo[MAX_MASKS][16];
+    alignas(16) uint8_t hi[MAX_MASKS][16];
+
+public:
+    static uint64_t instances;
+    static uint64_t patterns;
+};
+
+uint64_t TeddyMpse::instances = 0;
+uint64_t TeddyMpse::patterns = 0;
+
+// ascii only so bytes >= 0x80 are never folded, regardless of locale
+static inline uint8_t teddy_upper(uint8_t c)
+{ return (c >= 'a' and c <= 'z') ? c - ('a' - 'A') : c; }
+
+static inline uint8_t teddy_lower(uint8_t c)
+{ return (c >= 'A' and c <= 'Z') ? c + ('a' - 'A') : c; }
+
+int TeddyMpse::add_pattern(
+    SnortConfig*, const uint8_t* pat, unsigned len,
+    const PatternDescriptor& desc, void* user)
+{
+    if ( !len )
+        return -1;
+
+    TeddyPattern p;
+    p.pat.assign((const char*)pat, len);
+    p.no_case = desc.no_case;
+    p.negate = desc.negated;
+    p.user = user;
+    p.user_tree = p.user_list = nullptr;
+
+    if ( p.no_case )
+    {
+        for ( auto& c : p.pat )
+            c = (char)teddy_upper((uint8_t)c);
+    }
+
+    pvector.push_back(p);
+    return 0;
+}
+
+void TeddyMpse::add_mask(unsigned b, unsigned k, uint8_t c)
+{
+    lo[k][c & 0xF] |= 1 << b;
+    hi[k][c >> 4] |= 1 << b;
+}
+
+// patterns are sorted by prefix before they are dealt into buckets so
+// similar prefixes share a bucket which keeps false positives down
+int TeddyMpse::compile(SnortConfig*)
+{
+    if ( pvector.empty() )
+        return -1;
+
+    size_t min_len = pvector[0].pat.size();
+
+    for ( auto& p : pvector )
+        min_len = std::min(min_len, p.pat.size());
+
+    masks = std::min(min_len, (size_t)MAX_MASKS);
+
+    std::vector<unsigned> order(pvector.size());
+
+    for ( unsigned i = 0; i < order.size(); ++i )
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [this](unsigned a, unsigned b)
+        { return pvector[a].pat.compare(0, masks, pvector[b].pat, 0, masks) < 0; });
+
+    memset(lo, 0, sizeof(lo));
+    memset(hi, 0, sizeof(hi));
+
+    unsigned per = (order.size() + NUM_BUCKETS - 1) / NUM_BUCKETS;
+
+    for ( unsigned i = 0; i < order.size(); ++i )
+    {
+        unsigned b = i / per;
+        const TeddyPattern& p = pvector[order[i]];
+        buckets[b].push_back(order[i]);
+
+        for ( unsigned k = 0; k < masks; ++k )
+        {
+            uint8_t c = p.pat[k];
+            add_mask(b, k, c);
+
+            if ( p.no_case )
+                add_mask(b, k, teddy_lower(c));
+        }
+    }
+    return 0;
+}
+
+// teddy has no match states so each pattern gets its own tree like hyperscan
+void TeddyMpse::user_ctor(SnortConfig* sc)
+{
+    for ( auto& p : pvector )
+    {
+        if ( p.user )
+        {
+            if ( p.negate )
+                agent->negate_list(p.user, &p.user_list);
+            else
+                agent->build_tree(sc, p.user, &p.user_tree);
+        }
+        agent->build_tree(sc, nullptr, &p.user_tree);
+    }
+}
+
+void TeddyMpse::user_dtor()
+{
+    for ( auto& p : pvector )
+    {
+        if ( p.user )
+            agent->user_free(p.user);
+
+        if ( p.user_list )
+            agent->list_free(&p.user_list);
+
+        if ( p.user_tree )
+            agent->tree_free(&p.user_tree);
+    }
+}
+
+// counted here rather than as built so port group duplicates that are
+// deleted in favor of a shared instance aren't included
+int TeddyMpse::finish(SnortConfig* sc)
+{
+    ++instances;
+    patterns += pvector.size();
+
+    if ( agent )
+        user_ctor(sc);
+
+    return 0;
+}
+
+int TeddyMpse::print_info()
+{
+    LogMessage("teddy: %zu patterns, %u masks\n", pvector.size(), masks);
+    return 0;
+}
+
+static inline bool match_nocase(const uint8_t* t, const std::string& p)
+{
+    for ( unsigned i = 0; i < p.size(); ++i )
+    {
+        if ( teddy_upper(t[i]) != (uint8_t)p[i] )
+            return false;
+    }
+    return true;
+}
+
+// return true to stop searching
+bool TeddyMpse::verify(
+    const uint8_t* T, int n, int pos, unsigned bits, MpseMatch mf, void* pv)
+{
+    while ( bits )
+    {
+        unsigned b = __builtin_ctz(bits);
+        bits &= bits - 1;
+
+        for ( auto i : buckets[b] )
+        {
+            TeddyPattern& p = pvector[i];
+            int end = pos + p.pat.size();
+
+            if ( end > n )
+                continue;
+
+            bool hit = p.no_case ? match_nocase(T + pos, p.pat) :
+                !memcmp(T + pos, p.pat.data(), p.pat.size());
+
+            if ( hit and mf(p.user, p.user_tree, end, pv, p.user_list) > 0 )
+                return true;
+        }
+    }
+    return false;
+}
+
+int TeddyMpse::scan_scalar(
+    const uint8_t* T, int n, int start, MpseMatch mf, void* pv)
+{
+    for ( int i = start; i + (int)masks <= n; ++i )
+    {
+        unsigned bits = 0xFF;
+
+        for ( unsigned k = 0; k < masks and bits; ++k )
+        {
+            uint8_t c = T[i + k];
+            bits &= lo[k][c & 0xF] & hi[k][c >> 4];
+        }
+
+        if ( bits and verify(T, n, i, bits, mf, pv) )
+            return i;
+    }
+    return n;
+}
+
+#ifdef TEDDY_X86
+
+__attribute__((target("ssse3")))
+int TeddyMpse::scan_ssse3(const uint8_t* T, int n, MpseMatch mf, void* pv)
+{
+    const __m128i nib = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i lo_t[MAX_MASKS], hi_t[MAX_MASKS];
+
+    for ( unsigned k = 0; k < masks; ++k )
+    {
+        lo_t[k] = _mm_load_si128((const __m128i*)lo[k]);
+        hi_t[k] = _mm_load_si128((const __m128i*)hi[k]);
+    }
+
+    int i = 0;
+
+    // positions i .. i+15 need bytes through i+15+masks-1
+    for ( ; i + 15 + (int)masks <= n; i += 16 )
+    {
+        __m128i res = _mm_set1_epi8((char)0xFF);
+
+        for ( unsigned k = 0; k < masks; ++k )
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(T + i + k));
+            __m128i l = _mm_shuffle_epi8(lo_t[k], _mm_and_si128(v, nib));
+            __m128i h = _mm_shuffle_epi8(hi_t[k], _mm_and_si128(_mm_srli_epi16(v, 4), nib));
+            res = _mm_and_si128(res, _mm_and_si128(l, h));
+        }
+
+        unsigned m = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(res, zero)) & 0xFFFF;
+
+        if ( !m )
+            continue;
+
+        alignas(16) uint8_t bits[16];
+        _mm_store_si128((__m128i*)bits, res);
+
+        while ( m )
+        {
+            unsigned j = __builtin_ctz(m);
+            m &= m - 1;
+
+            if ( verify(T, n, i + j, bits[j], mf, pv) )
+                return i + j;
+        }
+    }
+    return scan_scalar(T, n, i, mf, pv);
+}
+
+static bool use_ssse3()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+static const bool s_ssse3 = use_ssse3();
+
+#endif
+
+int TeddyMpse::_search(
+    const uint8_t* T, int n, MpseMatch mf, void* pv, int* current_state)
+{
+    *current_state = 0;
+
+    if ( !masks )
+        return 0;
+
+#ifdef TEDDY_X86
+    if ( s_ssse3 )
+    {
+        scan_ssse3(T, n, mf, pv);
+        return 0;
+    }
+#endif
+
+    scan_scalar(T, n, 0, mf, pv);
+    return 0;
+}
+
+//-------------------------------------------------------------------------
+// api
+//-------------------------------------------------------------------------
+
+static Mpse* teddy_ctor(
+    SnortConfig* sc, class Module*, bool use_gc, const MpseAgent* a)
+{
+    return new TeddyMpse(sc, use_gc, a);
+}
+
+static void teddy_dtor(Mpse* p)
+{
+    delete p;
+}
+
+static void teddy_init()
+{
+    TeddyMpse::instances = 0;
+    TeddyMpse::patterns = 0;
+}
+
+static void teddy_print()
+{
+    LogCount("instances", TeddyMpse::instances);
+    LogCount("patterns", TeddyMpse::patterns);
+}
+
+static const MpseApi teddy_api =
+{
+    {
+        PT_SEARCH_ENGINE,
+        sizeof(MpseApi),
+        SEAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        "teddy",
+        "bucketed simd literal matcher for small sets of patterns",
+        nullptr,
+        nullptr
+    },
+    false,
+    nullptr,  // activate
+    nullptr,  // setup
+    nullptr,  // start
+    nullptr,  // stop
+    teddy_ctor,
+    teddy_dtor,
+    teddy_init,
+    teddy_print,
+};
+
+const BaseApi* se_teddy = &teddy_api.base;
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+struct TeddyHit
+{
+    std::vector<std::pair<long, int>> hits;
+    int stop_after = 0;
+};
+
+static int teddy_match(void* user, void*, int index, void* pv, void*)
+{
+    TeddyHit* th = (TeddyHit*)pv;
+    th->hits.push_back({ (long)user, index });
+    return th->stop_after and (int)th->hits.size() >= th->stop_after;
+}
+
+static void teddy_load(TeddyMpse& mpse, const char** pats, bool no_case)
+{
+    Mpse::PatternDescriptor desc(no_case, false, true);
+
+    for ( long i = 0; pats[i]; ++i )
+        mpse.add_pattern(nullptr, (const uint8_t*)pats[i], strlen(pats[i]), desc, (void*)(i + 1));
+
+    mpse.prep_patterns(nullptr);
+}
+
+static void teddy_naive(
+    const char** pats, bool no_case, const std::string& s, TeddyHit& th)
+{
+    for ( unsigned pos = 0; pos < s.size(); ++pos )
+    {
+        for ( long i = 0; pats[i]; ++i )
+        {
+            size_t len = strlen(pats[i]);
+
+            if ( pos + len > s.size() )
+                continue;
+
+            bool hit = no_case ? !strncasecmp(s.c_str() + pos, pats[i], len) :
+                !strncmp(s.c_str() + pos, pats[i], len);
+
+            if ( hit )
+                th.hits.push_back({ i + 1, (int)(pos + len) });
+        }
+    }
+}
+
+static void teddy_check(const char** pats, bool no_case, const std::string& s)
+{
+    TeddyMpse mpse(nullptr, false, nullptr);
+    teddy_load(mpse, pats, no_case);
+
+    TeddyHit got, want;
+    int state = 0;
+    mpse.search((const uint8_t*)s.c_str(), s.size(), teddy_match, &got, &state);
+    teddy_naive(pats, no_case, s, want);
+
+    // bucket order within a position differs from pattern order
+    std::sort(got.hits.begin(), got.hits.end());
+    std::sort(want.hits.begin(), want.hits.end());
+    CHECK(got.hits == want.hits);
+}
+
+static const char* teddy_pats[] =
+{
+    "GET", "POST", "HTTP/1.", "Host:", "cmd.exe", "/bin/sh", "passwd",
+    "union", "select", "<script", "eval(", "%u00", "../..", "\x90\x90\x90",
+    "abcdef", "abd", nullptr
+};
+
+TEST_CASE("teddy exact", "[teddy]")
+{
+    std::string s =
+        "GET /index.html HTTP/1.1\r\nHost: x\r\n\r\n"
+        "POST /cgi-bin/../../bin/sh?cmd.exe&passwd HTTP/1.0\r\n"
+        "abcdabdabcdef<script>eval(x)</script>%u0041 union select";
+
+    // every offset so all lanes and the scalar tail are exercised
+    for ( unsigned i = 0; i < s.size(); ++i )
+        teddy_check(teddy_pats, false, s.substr(i));
+}
+
+TEST_CASE("teddy nocase", "[teddy]")
+{
+    std::string s = "get / http/1.0\r\nHOST: a\r\nUnIoN SeLeCt * from PASSWD<SCRIPT>";
+
+    for ( unsigned i = 0; i < s.size(); ++i )
+        teddy_check(teddy_pats, true, s.substr(i));
+}
+
+TEST_CASE("teddy nocase high bytes", "[teddy]")
+{
+    // only ascii letters are folded; 0xE9 and 0xC9 are e acute in latin-1
+    const char* pats[] = { "\xe9t\xe9", "\xff\x80x", nullptr };
+    TeddyMpse mpse(nullptr, false, nullptr);
+    teddy_load(mpse, pats, true);
+
+    std::string s = "\xe9T\xe9 \xc9t\xc9 \xff\x80X \xdf\x80x";
+    TeddyHit th;
+    int state = 0;
+    mpse.search((const uint8_t*)s.c_str(), s.size(), teddy_match, &th, &state);
+
+    std::sort(th.hits.begin(), th.hits.end());
+    std::vector<std::pair<long, int>> want = { { 1, 3 }, { 2, 11 } };
+    CHECK(th.hits == want);
+}
+
+TEST_CASE("teddy short", "[teddy]")
+{
+    const char* pats[] = { "a", "bc", "xyz", nullptr };
+    std::string s = "aabcbcxyzxyxyzaa";
+
+    for ( unsigned i = 0; i < s.size(); ++i )
+        teddy_check(pats, false, s.substr(i));
+}
+
+TEST_CASE("teddy stop", "[teddy]")
+{
+    TeddyMpse mpse(nullptr, false, nullptr);
+    teddy_load(mpse, teddy_pats, false);
+
+    std::string s = "GET GET GET GET GET GET GET GET GET GET GET GET";
+    TeddyHit th;
+    th.stop_after = 2;
+    int state = 0;
+    mpse.search((const uint8_t*)s.c_str(), s.size(), teddy_match, &th, &state);
+    CHECK(th.hits.size() == 2);
+}
+
+#endif
@@ -0,0 +1,374 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// microbenchmark comparing ac_full, ac_full_simd, and ac_bnfa on the same
+// patterns and text searched in 1460 byte packets
+// usage: ac_bench [-p pattern_file] [-c corpus_file] [-n patterns]
+//                 [-f first_bytes ...] [-m corpus_mb]
+// with no files, patterns are random and start with one of first_bytes
+// distinct bytes (default 1, 4, 16, and 64) and the corpus is random text
+// with the same alphabet
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "log/messages.h"
+#include "search_engines/acsmx2.h"
+#include "search_engines/bnfa_search.h"
+#include "search_engines/first_byte_filter.h"
+
+//-------------------------------------------------------------------------
+// stubs
+//-------------------------------------------------------------------------
+
+void LogMessage(const char*, ...) { }
+void LogValue(const char*, const char*, FILE*) { }
+void LogCount(const char*, uint64_t, FILE*) { }
+void LogStat(const char*, double, FILE*) { }
+[[noreturn]] void FatalError(const char*, ...) { exit(1); }
+
+//-------------------------------------------------------------------------
+// engines
+//-------------------------------------------------------------------------
+
+static int count_match(void*, void*, int, void* context, void*)
+{
+    ++*(unsigned*)context;
+    return 0;
+}
+
+struct Engine
+{
+    virtual ~Engine() { }
+    virtual const char* name() = 0;
+    virtual void add(const std::string&, void* user) = 0;
+    virtual void compile() = 0;
+    virtual void search(const uint8_t*, int, unsigned& matches) = 0;
+};
+
+struct AcFull : public Engine
+{
+    ACSM_STRUCT2* obj;
+    bool filter;
+
+    AcFull(bool f) : filter(f)
+    {
+        obj = acsmNew2(nullptr, ACF_FULL);
+        obj->enable_dfa();
+
+        if ( filter )
+            obj->enable_filter();
+    }
+
+    ~AcFull()
+    { acsmFree2(obj); }
+
+    const char* name() override
+    { return filter ? "ac_full_simd" : "ac_full"; }
+
+    void add(const std::string& s, void* user) override
+    { acsmAddPattern2(obj, (const uint8_t*)s.data(), s.size(), true, false, user); }
+
+    void compile() override
+    { acsmCompile2(nullptr, obj); }
+
+    void search(const uint8_t* T, int n, unsigned& matches) override
+    {
+        int state = 0;
+
+        if ( filter )
+            acsm_search_dfa_full_filtered(obj, T, n, count_match, &matches, &state);
+        else
+            acsm_search_dfa_full(obj, T, n, count_match, &matches, &state);
+    }
+};
+
+struct AcBnfa : public Engine
+{
+    bnfa_struct_t* obj;
+
+    AcBnfa()
+    {
+        obj = bnfaNew(nullptr);
+        obj->bnfaMethod = 1;
+    }
+
+    ~AcBnfa()
+    { bnfaFree(obj); }
+
+    const char* name() override
+    { return "ac_bnfa"; }
+
+    void add(const std::string& s, void* user) override
+    { bnfaAddPattern(obj, (const uint8_t*)s.data(), s.size(), true, false, user); }
+
+    void compile() override
+    { bnfaCompile(nullptr, obj); }
+
+    void search(const uint8_t* T, int n, unsigned& matches) override
+    {
+        int state = 0;
+        _bnfa_search_csparse_nfa(obj, T, n, count_match, &matches, 0, &state);
+    }
+};
+
+//-------------------------------------------------------------------------
+// data
+//-------------------------------------------------------------------------
+
+static const unsigned PKT_SIZE = 1460;
+static const unsigned PASSES = 3;
+
+static bool load_lines(const char* file, std::vector<std::string>& v)
+{
+    std::ifstream in(file);
+    std::string s;
+
+    while ( std::getline(in, s) )
+        if ( !s.empty() )
+            v.push_back(s);
+
+    return !v.empty();
+}
+
+static bool load_file(const char* file, std::string& s)
+{
+    std::ifstream in(file, std::ios::binary);
+
+    if ( !in )
+        return false;
+
+    s.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !s.empty();
+}
+
+// printable text without upper case (patterns are nocase); the first
+// bytes of patterns are the first few symbols so about first / 69 of the
+// text can start a pattern
+static const std::string s_alphabet = []
+{
+    std::string s(" ");
+
+    for ( char c = 0x21; c < 0x7F; ++c )
+        if ( !isupper(c) )
+            s += c;
+
+    return s;
+}();
+
+static void make_patterns(
+    std::mt19937& rng, unsigned num, unsigned first, std::vector<std::string>& v)
+{
+    for ( unsigned i = 0; i < num; ++i )
+    {
+        std::string s(1, s_alphabet[1 + rng() % first]);
+        unsigned len = 4 + rng() % 12;
+
+        while ( s.size() < len )
+            s += s_alphabet[1 + rng() % (s_alphabet.size() - 1)];
+
+        v.push_back(s);
+    }
+}
+
+// random text with a pattern inserted about every 4 KB
+static void make_corpus(
+    std::mt19937& rng, unsigned mb, const std::vector<std::string>& pats, std::string& s)
+{
+    size_t size = (size_t)mb << 20;
+    s.reserve(size + 64);
+
+    while ( s.size() < size )
+    {
+        if ( rng() % 4096 == 0 )
+            s += pats[rng() % pats.size()];
+        else
+            s += s_alphabet[rng() % s_alphabet.size()];
+    }
+    s.resize(size);
+}
+
+//-------------------------------------------------------------------------
+// driver
+//-------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+static unsigned run(Engine& e, const std::vector<std::string>& pats, const std::string& text)
+{
+    for ( unsigned i = 0; i < pats.size(); ++i )
+        e.add(pats[i], (void*)(uintptr_t)(i + 1));
+
+    e.compile();
+
+    const uint8_t* T = (const uint8_t*)text.data();
+    unsigned n = text.size();
+    unsigned matches = 0;
+
+    // warm up
+    for ( unsigned i = 0; i < n and i < (1u << 20); i += PKT_SIZE )
+        e.search(T + i, std::min(PKT_SIZE, n - i), matches);
+
+    // best of a few passes to ride out noise
+    double ns = 0;
+
+    for ( unsigned pass = 0; pass < PASSES; ++pass )
+    {
+        matches = 0;
+        auto start = Clock::now();
+
+        for ( unsigned i = 0; i < n; i += PKT_SIZE )
+            e.search(T + i, std::min(PKT_SIZE, n - i), matches);
+
+        auto t = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        if ( !pass or t < ns )
+            ns = t;
+    }
+
+    printf("%-13s %8.1f MB/s  %5.2f ns/byte  matches=%u\n",
+        e.name(), (n / 1048576.0) / (ns / 1e9), ns / n, matches);
+
+    return matches;
+}
+
+static void run_all(const std::vector<std::string>& pats, const std::string& text)
+{
+    bool firsts[256] = { };
+    unsigned nfirst = 0;
+
+    for ( auto& p : pats )
+    {
+        uint8_t b = tolower((uint8_t)p[0]);
+
+        if ( !firsts[b] )
+        {
+            firsts[b] = firsts[toupper(b)] = true;
+            ++nfirst;
+        }
+    }
+
+    size_t hits = 0;
+
+    for ( auto b : text )
+        hits += firsts[(uint8_t)b];
+
+    printf("patterns=%zu  first bytes=%u (%.1f%% of text)  corpus=%zu bytes\n",
+        pats.size(), nfirst, 100.0 * hits / text.size(), text.size());
+
+    AcFull full(false), simd(true);
+    AcBnfa bnfa;
+
+    unsigned a = run(full, pats, text);
+    unsigned b = run(simd, pats, text);
+    run(bnfa, pats, text);
+
+    if ( a != b )
+        printf("*** ac_full_simd matches differ from ac_full\n");
+
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* pat_file = nullptr;
+    const char* text_file = nullptr;
+    std::vector<unsigned> firsts;
+    unsigned num = 100;
+    unsigned mb = 16;
+    int c;
+
+    while ( (c = getopt(argc, argv, "p:c:n:f:m:")) != -1 )
+    {
+        switch ( c )
+        {
+        case 'p': pat_file = optarg; break;
+        case 'c': text_file = optarg; break;
+        case 'n': num = strtoul(optarg, nullptr, 0); break;
+        case 'f': firsts.push_back(strtoul(optarg, nullptr, 0)); break;
+        case 'm': mb = strtoul(optarg, nullptr, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-p pattern_file] [-c corpus_file] "
+                "[-n patterns] [-f first_bytes ...] [-m corpus_mb]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if ( firsts.empty() )
+        firsts = { 1, 4, 16, 64 };
+
+    for ( auto& f : firsts )
+        f = std::max(1u, std::min(f, (unsigned)s_alphabet.size() - 1));
+
+    acsmx2_init_xlatcase();
+    bnfa_init_xlatcase();
+
+    printf("FirstByteFilter kernel: %s\n\n", FirstByteFilter::get_kernel());
+    std::mt19937 rng(3193);
+
+    if ( pat_file )
+    {
+        std::vector<std::string> pats;
+        std::string text;
+
+        if ( !load_lines(pat_file, pats) )
+        {
+            fprintf(stderr, "can't load patterns from %s\n", pat_file);
+            return 1;
+        }
+
+        if ( text_file )
+        {
+            if ( !load_file(text_file, text) )
+            {
+                fprintf(stderr, "can't load corpus from %s\n", text_file);
+                return 1;
+            }
+        }
+        else
+            make_corpus(rng, mb, pats, text);
+
+        run_all(pats, text);
+        return 0;
+    }
+
+    for ( auto f : firsts )
+    {
+        std::vector<std::string> pats;
+        std::string text;
+
+        make_patterns(rng, num, f, pats);
+
+        if ( !text_file or !load_file(text_file, text) )
+            make_corpus(rng, mb, pats, text);
+
+        run_all(pats, text);
+    }
+    return 0;
+}
+
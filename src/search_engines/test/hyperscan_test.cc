@@ -18,12 +18,12 @@
 
 // hyperscan_test.cc author Russ Combs <rucombs@cisco.com>
 
-#include "search_engines/hyperscan.h"
-
 #include <string.h>
 
+#include "detection/fp_config.h"
 #include "framework/base_api.h"
 #include "framework/mpse.h"
+#include "helpers/hyper_scratch.h"
 #include "main/snort_config.h"
 
 // must appear after snort_config.h to avoid broken c++ map include
@@ -50,6 +50,21 @@ int Mpse::search_all(
     return _search(T, n, match, context, current_state);
 }
 
+int Mpse::search_stream(
+    MpseStream*& ms, const unsigned char* T, int n,
+    MpseMatch match, void* context)
+{
+    return _search_stream(ms, T, n, match, context);
+}
+
+int Mpse::_search_stream(
+    MpseStream*&, const unsigned char* T, int n,
+    MpseMatch match, void* context)
+{
+    int state = 0;
+    return _search(T, n, match, context, &state);
+}
+
 uint64_t Mpse::get_pattern_byte_count()
 { return 0; }
 
@@ -75,6 +90,13 @@ static int match(
     void* /*user*/, void* /*tree*/, int /*index*/, void* /*context*/, void* /*list*/)
 { ++hits; return 0; }
 
+FastPatternConfig::FastPatternConfig()
+{ memset(this, 0, sizeof(*this)); }
+
+FastPatternConfig::~FastPatternConfig() { }
+
+static FastPatternConfig s_fp_conf;
+
 SnortConfig s_conf;
 THREAD_LOCAL SnortConfig* snort_conf = &s_conf;
 
@@ -85,6 +107,7 @@ SnortConfig::SnortConfig()
     state = &s_state;
     memset(state, 0, sizeof(*state));
     num_slots = 1;
+    fast_pattern_config = &s_fp_conf;
 }
 
 SnortConfig::~SnortConfig() { }
@@ -189,7 +212,7 @@ TEST_GROUP(mpse_hs_match)
     void teardown()
     {
         mpse_api->dtor(hs);
-        hyperscan_cleanup(snort_conf);
+        HyperScratch::cleanup(snort_conf);
     }
 };
 
@@ -204,6 +227,28 @@ TEST(mpse_hs_match, empty)
     CHECK(hits == 0);
 }
 
+TEST(mpse_hs_match, stream)
+{
+    Mpse::PatternDescriptor desc;
+
+    hs->set_stream(true);
+    CHECK(hs->add_pattern(nullptr, (uint8_t*)"foo", 3, desc, s_user) == 0);
+    CHECK(hs->prep_patterns(snort_conf) == 0);
+    CHECK(hs->can_stream());
+
+    HyperScratch::setup(snort_conf);
+
+    MpseStream* ms = nullptr;
+    CHECK(hs->search_stream(ms, (uint8_t*)"xfo", 3, match, nullptr) == 0);
+    CHECK(ms);
+    CHECK(hits == 0);
+
+    CHECK(hs->search_stream(ms, (uint8_t*)"ox", 2, match, nullptr) == 0);
+    CHECK(hits == 1);
+
+    delete ms;
+}
+
 TEST(mpse_hs_match, single)
 {
     Mpse::PatternDescriptor desc;
@@ -212,7 +257,7 @@ TEST(mpse_hs_match, single)
     CHECK(hs->prep_patterns(snort_conf) == 0);
     CHECK(hs->get_pattern_count() == 1);
 
-    hyperscan_setup(snort_conf);
+    HyperScratch::setup(snort_conf);
 
     int state = 0;
     CHECK(hs->search((uint8_t*)"foo", 3, match, nullptr, &state) == 0);
@@ -230,7 +275,7 @@ TEST(mpse_hs_match, other)
     CHECK(hs->prep_patterns(snort_conf) == 0);
     CHECK(hs->get_pattern_count() == 3);
 
-    hyperscan_setup(snort_conf);
+    HyperScratch::setup(snort_conf);
 
     int state = 0;
     CHECK(hs->search((uint8_t*)"foo", 3, match, nullptr, &state) == 0);
@@ -247,7 +292,7 @@ TEST(mpse_hs_match, multi)
 
     CHECK(hs->prep_patterns(snort_conf) == 0);
     CHECK(hs->get_pattern_count() == 3);
-    hyperscan_setup(snort_conf);
+    HyperScratch::setup(snort_conf);
 
     int state = 0;
     CHECK(hs->search((uint8_t*)"foo bar baz", 11, match, nullptr, &state) == 0);
@@ -264,7 +309,7 @@ TEST(mpse_hs_match, regex)
 
     CHECK(hs->prep_patterns(snort_conf) == 0);
     CHECK(hs->get_pattern_count() == 1);
-    hyperscan_setup(snort_conf);
+    HyperScratch::setup(snort_conf);
 
     int state = 0;
     CHECK(hs->search((uint8_t*)"foo bar baz", 11, match, nullptr, &state) == 0);
@@ -281,7 +326,7 @@ TEST(mpse_hs_match, pcre)
 
     CHECK(hs->prep_patterns(snort_conf) == 0);
     CHECK(hs->get_pattern_count() == 1);
-    hyperscan_setup(snort_conf);
+    HyperScratch::setup(snort_conf);
 
     int state = 0;
     CHECK(hs->search((uint8_t*)":definition(", 12, match, nullptr, &state) == 0);
@@ -319,7 +364,7 @@ TEST_GROUP(mpse_hs_multi)
     {
         mpse_api->dtor(hs1);
         mpse_api->dtor(hs2);
-        hyperscan_cleanup(snort_conf);
+        HyperScratch::cleanup(snort_conf);
     }
 };
 
@@ -336,7 +381,7 @@ TEST(mpse_hs_multi, single)
     CHECK(hs1->get_pattern_count() == 1);
     CHECK(hs2->get_pattern_count() == 1);
 
-    hyperscan_setup(snort_conf);
+    HyperScratch::setup(snort_conf);
 
     int state = 0;
     CHECK(hs1->search((uint8_t*)"fubar", 5, match, nullptr, &state) == 0);
@@ -26,6 +26,7 @@
 
 #include "stream_module.h"
 #include "stream_ha.h"
+#include "control/idle_processing.h"
 #include "main/snort_debug.h"
 #include "managers/inspector_manager.h"
 #include "flow/flow_control.h"
@@ -294,6 +295,19 @@ static void base_dtor(Inspector* p)
     delete p;
 }
 
+// runs on packet threads when the DAQ is idle; flow_con is null on the
+// main thread
+static void base_idle()
+{
+    if ( flow_con )
+        flow_con->timeout_flows(16384, time(nullptr));
+}
+
+static void base_init()
+{
+    IdleProcessing::register_handler(base_idle);
+}
+
 static void base_tterm()
 {
     delete flow_con;
@@ -318,7 +332,7 @@ static const InspectApi base_api =
     (unsigned)PktType::ANY_SSN,
     nullptr, // buffers
     nullptr, // service
-    nullptr, // init
+    base_init,
     nullptr, // term
     nullptr, // tinit
     base_tterm,
@@ -75,6 +75,7 @@
 #include <rpc/types.h>
 #include <errno.h>
 #include <array>
+#include <vector>
 
 #include "framework/codec.h"
 #include "flow/flow_control.h"
@@ -155,6 +156,36 @@ static THREAD_LOCAL unsigned long mem_in_use = 0; /* memory in use, used for sel
 static THREAD_LOCAL uint32_t pkt_snaplen = 0;
 static THREAD_LOCAL Packet** defrag_pkts;  // An array of Packet pointers
 
+/*  F R A G M E N T   P O O L  **************************************/
+
+// each packet thread recycles its fragment nodes.  a node has room for
+// an ethernet mtu of payload after the Fragment, so the common case is a
+// single allocation from the free list.  larger payloads are allocated
+// separately.  max_frags bounds the number of nodes in use.  it is read
+// from the engine on each packet so a reload applies it.  at the limit,
+// the least recently used trackers holding fragments are released (never
+// the current one) and if that frees nothing the fragment is dropped, so a
+// fragment flood cannot grow the pool without bound.
+
+#define FRAG_NODE_PAYLOAD 1500
+#define FRAG_NODE_SIZE (sizeof(Fragment) + FRAG_NODE_PAYLOAD)
+
+// free nodes beyond this are returned to the heap
+#define FRAG_NODE_CACHE 1024
+
+struct FragPool
+{
+    std::vector<Fragment*> free_list;
+    uint32_t in_use = 0;
+};
+
+static THREAD_LOCAL FragPool* frag_pool = nullptr;
+
+// kept apart from the pool since trackers are released by flow teardown
+// after tterm()
+static THREAD_LOCAL FragTracker* lru_head = nullptr;
+static THREAD_LOCAL FragTracker* lru_tail = nullptr;
+
 /* enum for policy names */
 static const char* const frag_policy_names[] =
 {
@@ -916,6 +947,47 @@ static void FragRebuild(FragTracker* ft, Packet* p)
     ft->frag_flags = ft->frag_flags | FRAG_REBUILT;
 }
 
+//-------------------------------------------------------------------------
+// tracker lru
+// a tracker is listed while it holds fragments.  it is moved to the tail
+// whenever a fragment is added and unlisted when its fragments are deleted.
+//-------------------------------------------------------------------------
+
+static void lru_unlink(FragTracker* ft)
+{
+    if ( !ft->lru_prev and lru_head != ft )
+        return;
+
+    if ( ft->lru_prev )
+        ft->lru_prev->lru_next = ft->lru_next;
+    else
+        lru_head = ft->lru_next;
+
+    if ( ft->lru_next )
+        ft->lru_next->lru_prev = ft->lru_prev;
+    else
+        lru_tail = ft->lru_prev;
+
+    ft->lru_prev = ft->lru_next = nullptr;
+}
+
+static void lru_touch(FragTracker* ft)
+{
+    if ( lru_tail == ft )
+        return;
+
+    lru_unlink(ft);
+
+    ft->lru_prev = lru_tail;
+
+    if ( lru_tail )
+        lru_tail->lru_next = ft;
+    else
+        lru_head = ft;
+
+    lru_tail = ft;
+}
+
 /**
  * Plug a Fragment into the fraglist of a FragTracker
  *
@@ -950,6 +1022,7 @@ static inline void add_node(FragTracker* ft, Fragment* prev,
     }
 
     ft->fraglist_count++;
+    lru_touch(ft);
 }
 
 /**
@@ -961,17 +1034,70 @@ static inline void add_node(FragTracker* ft, Fragment* prev,
  */
 static void delete_frag(Fragment* frag)
 {
-    /*
-     * delete the fragment either in prealloc or dynamic mode
-     */
-    snort_free(frag->fptr);
-    mem_in_use -= frag->flen;
-
-    snort_free(frag);
-    mem_in_use -= sizeof(Fragment);
+    unsigned long size = FRAG_NODE_SIZE;
 
+    if ( frag->fptr != (uint8_t*)(frag + 1) )
+    {
+        size += frag->flen;
+        snort_free(frag->fptr);
+    }
+    mem_in_use -= size;
     ip_stats.mem_in_use = mem_in_use;
     ip_stats.nodes_released++;
+
+    // nodes released after tterm() go straight back to the heap
+    if ( !frag_pool )
+    {
+        snort_free(frag);
+        return;
+    }
+    frag_pool->in_use--;
+
+    if ( frag_pool->free_list.size() < FRAG_NODE_CACHE )
+        frag_pool->free_list.push_back(frag);
+    else
+        snort_free(frag);
+}
+
+/**
+ * Get a zeroed Fragment with room for flen bytes of payload at fptr
+ *
+ * @param flen payload length
+ *
+ * @return the new Fragment
+ */
+static Fragment* new_frag(uint16_t flen)
+{
+    Fragment* frag;
+
+    if ( !frag_pool->free_list.empty() )
+    {
+        frag = frag_pool->free_list.back();
+        frag_pool->free_list.pop_back();
+        ip_stats.nodes_reused++;
+    }
+    else
+        frag = (Fragment*)snort_alloc(sizeof(Fragment) + FRAG_NODE_PAYLOAD);
+
+    memset(frag, 0, sizeof(*frag));
+
+    // the whole node is in use regardless of flen
+    unsigned long size = FRAG_NODE_SIZE;
+
+    if ( flen <= FRAG_NODE_PAYLOAD )
+        frag->fptr = (uint8_t*)(frag + 1);
+    else
+    {
+        frag->fptr = (uint8_t*)snort_alloc(flen);
+        size += flen;
+    }
+    frag->flen = flen;
+    frag_pool->in_use++;
+
+    mem_in_use += size;
+    ip_stats.mem_in_use = mem_in_use;
+
+    return frag;
 }
 
 /**
@@ -1007,6 +1133,9 @@ static inline void delete_node(FragTracker* ft, Fragment* node)
 
     delete_frag(node);
     ft->fraglist_count--;
+
+    if ( !ft->fraglist )
+        lru_unlink(ft);
 }
 
 /**
@@ -1035,6 +1164,9 @@ static void delete_tracker(FragTracker* ft)
         delete_frag(dump_me);
     }
     ft->fraglist = NULL;
+    ft->fraglist_tail = NULL;
+    lru_unlink(ft);
+
     if (ft->ip_options_data)
     {
         snort_free(ft->ip_options_data);
@@ -1052,6 +1184,35 @@ static void release_tracker(FragTracker* ft)
     ip_stats.trackers_released++;
 }
 
+/**
+ * Release lru trackers until this thread's fragment nodes are below
+ * max_frags.  The current tracker is never released.
+ *
+ * @param save_me the current tracker
+ * @param max_frags the current engine's limit
+ *
+ * @return true if another node can be added
+ */
+static bool prune_frags(FragTracker* save_me, uint32_t max_frags)
+{
+    FragTracker* ft = lru_head;
+
+    while ( frag_pool->in_use >= max_frags )
+    {
+        if ( ft == save_me )
+            ft = ft->lru_next;
+
+        if ( !ft )
+            return false;
+
+        FragTracker* next = ft->lru_next;
+        release_tracker(ft);
+        ip_stats.max_frags_prunes++;
+        ft = next;
+    }
+    return true;
+}
+
 //-------------------------------------------------------------------------
 // Defrag methods
 //-------------------------------------------------------------------------
@@ -1074,6 +1235,9 @@ void Defrag::tinit()
 
     defrag_pkts[0] = new Packet();
     pkt_snaplen = SFDAQ::get_snap_len();
+
+    if ( !frag_pool )
+        frag_pool = new FragPool;
 }
 
 void Defrag::tterm()
@@ -1089,6 +1253,15 @@ void Defrag::tterm()
 
     delete[] defrag_pkts;
     defrag_pkts = nullptr;
+
+    if ( frag_pool )
+    {
+        for ( auto frag : frag_pool->free_list )
+            snort_free(frag);
+
+        delete frag_pool;
+        frag_pool = nullptr;
+    }
 }
 
 void Defrag::show(SnortConfig*)
@@ -1170,9 +1343,17 @@ void Defrag::process(Packet* p, FragTracker* ft)
 
     pkttime = (struct timeval*)&p->pkth->ts;
 
+    if ( !prune_frags(ft, fe->max_frags) )
+    {
+        DisableDetect();
+        ip_stats.max_frags_drops++;
+        return;
+    }
+
     if (!ft->engine )
     {
-        new_tracker(p, ft);
+        if ( new_tracker(p, ft) )
+            lru_touch(ft);
         return;
     }
     else if (expire(p, ft, fe) == FRAG_TRACKER_TIMEOUT)
@@ -1475,32 +1656,41 @@ int Defrag::insert(Packet* p, FragTracker* ft, FragEngine* fe)
 
     /*
      * Need to figure out where in the frag list this frag should go
-     * and who its neighbors are
+     * and who its neighbors are.  The list is sorted by offset and
+     * fragments mostly arrive in order so check the tail first to keep
+     * floods from walking the whole list for every insert.
      */
-    for (idx = ft->fraglist; idx; idx = idx->next)
+    if (ft->fraglist && ft->fraglist_tail->offset < frag_offset)
     {
-        i++;
-        right = idx;
+        left = ft->fraglist_tail;
+    }
+    else
+    {
+        for (idx = ft->fraglist; idx; idx = idx->next)
+        {
+            i++;
+            right = idx;
 
-        DebugFormat(DEBUG_FRAG,
-            "%d right o %d s %d ptr %p prv %p nxt %p\n",
-            i, right->offset, right->size, (void*) right,
-            (void*) right->prev, (void*) right->next);
+            DebugFormat(DEBUG_FRAG,
+                "%d right o %d s %d ptr %p prv %p nxt %p\n",
+                i, right->offset, right->size, (void*) right,
+                (void*) right->prev, (void*) right->next);
 
-        if (right->offset >= frag_offset)
-        {
-            break;
+            if (right->offset >= frag_offset)
+            {
+                break;
+            }
+
+            left = right;
         }
 
-        left = right;
+        /*
+         * null things out if we walk to the end of the list
+         */
+        if (idx == NULL)
+            right = NULL;
     }
 
-    /*
-     * null things out if we walk to the end of the list
-     */
-    if (idx == NULL)
-        right = NULL;
-
     /*
      * handle forward (left-side) overlaps...
      */
@@ -2097,15 +2287,7 @@ int Defrag::new_tracker(Packet* p, FragTracker* ft)
     /*
      * get our first fragment storage struct
      */
-    {
-        f = (Fragment*)snort_calloc(sizeof(Fragment));
-        mem_in_use += sizeof(Fragment);
-
-        f->fptr = (uint8_t*)snort_calloc(fragLength);
-        mem_in_use += fragLength;
-
-        ip_stats.mem_in_use = mem_in_use;
-    }
+    f = new_frag(fragLength);
 
     /* initialize the fragment list */
     ft->fraglist = NULL;
@@ -2235,25 +2417,9 @@ int Defrag::add_frag_node(
     /*
      * grab/generate a new frag node
      */
-    {
-        /*
-         * build a frag struct to track this particular fragment
-         */
-        newfrag = (Fragment*)snort_calloc(sizeof(Fragment));
-        mem_in_use += sizeof(Fragment);
-
-        /*
-         * allocate some space to hold the actual data
-         */
-        newfrag->fptr = (uint8_t*)snort_calloc(fragLength);
-        mem_in_use += fragLength;
-
-        ip_stats.mem_in_use = mem_in_use;
-    }
-
+    newfrag = new_frag(fragLength);
     ip_stats.nodes_created++;
 
-    newfrag->flen = fragLength;
     memcpy(newfrag->fptr, fragStart, fragLength);
     newfrag->ord = ft->ordinal++;
 
@@ -2316,29 +2482,13 @@ int Defrag::dup_frag_node(
     /*
      * grab/generate a new frag node
      */
-    {
-        /*
-         * build a frag struct to track this particular fragment
-         */
-        newfrag = (Fragment*)snort_calloc(sizeof(Fragment));
-        mem_in_use += sizeof(Fragment);
-
-        /*
-         * allocate some space to hold the actual data
-         */
-        newfrag->fptr = (uint8_t*)snort_calloc(left->flen);
-        mem_in_use += left->flen;
-
-        ip_stats.mem_in_use = mem_in_use;
-    }
-
+    newfrag = new_frag(left->flen);
     ip_stats.nodes_created++;
 
     newfrag->ord = ft->ordinal++;
     /*
      * twiddle the frag values for overlaps
      */
-    newfrag->flen = left->flen;
     memcpy(newfrag->fptr, left->fptr, newfrag->flen);
     newfrag->data = newfrag->fptr + (left->data - left->fptr);
     newfrag->size = left->size;
@@ -77,6 +77,9 @@ struct IpStats
     PegCount mem_in_use;        // frag_mem_in_use
     PegCount reassembled_bytes; // total_ipreassembled_bytes
     PegCount fragmented_bytes;  // total_ipfragmented_bytes
+    PegCount nodes_reused;
+    PegCount max_frags_prunes;
+    PegCount max_frags_drops;
 };
 
 extern const PegInfo ip_pegs[];
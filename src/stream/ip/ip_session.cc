@@ -53,6 +53,9 @@ const PegInfo ip_pegs[] =
     { "memory used", "current memory usage in bytes" },
     { "reassembled bytes", "total reassembled bytes" },
     { "fragmented bytes", "total fragmented bytes" },
+    { "nodes reused", "fragment nodes taken from the free list" },
+    { "max frags prunes", "datagram trackers pruned to stay within max_frags" },
+    { "max frags drops", "fragments dropped at max_frags when nothing could be pruned" },
     { nullptr, nullptr }
 };
 
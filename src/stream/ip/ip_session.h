@@ -74,6 +74,10 @@ struct FragTracker
 
     // Count of IP fragment overlap for each packet id.
     uint32_t overlap_count;
+
+    // trackers holding fragments, least recently used first
+    FragTracker* lru_prev;
+    FragTracker* lru_next;
 };
 
 class IpSession : public Session
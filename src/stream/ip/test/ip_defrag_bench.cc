@@ -0,0 +1,317 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// fragment flood microbenchmark for Defrag::process()
+// usage: ip_defrag_bench [-n inserts] [-q queued ...]
+// each datagram queues q fragments in a given order before it is released;
+// none of them complete so only insertion is measured.  the flood case
+// spreads fragments over more trackers than max_frags allows so every
+// insert prunes.
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "detection/detect.h"
+#include "events/event_queue.h"
+#include "main/snort.h"
+#include "main/snort_debug.h"
+#include "packet_io/active.h"
+#include "packet_io/sfdaq.h"
+#include "profiler/profiler.h"
+#include "protocols/ipv4_options.h"
+#include "protocols/layer.h"
+#include "protocols/packet.h"
+#include "protocols/packet_manager.h"
+#include "sfip/sf_ip.h"
+#include "stream/ip/ip_defrag.h"
+#include "stream/ip/ip_module.h"
+#include "stream/ip/ip_session.h"
+#include "stream/ip/stream_ip.h"
+
+//-------------------------------------------------------------------------
+// stubs
+//-------------------------------------------------------------------------
+
+THREAD_LOCAL IpStats ip_stats;
+THREAD_LOCAL Active::ActiveAction Active::active_action = Active::ACT_PASS;
+THREAD_LOCAL bool do_detect = true;
+THREAD_LOCAL bool do_detect_content = true;
+
+void LogMessage(const char*, ...) { }
+
+#ifdef DEBUG_MSGS
+void Debug::print(const char*, int, uint64_t, const char*, ...) { }
+#endif
+
+MemoryContext::MemoryContext(MemoryTracker&) { }
+MemoryContext::~MemoryContext() { }
+
+void Active::daq_drop_packet(const Packet*) { }
+uint32_t SFDAQ::get_snap_len() { return 65535; }
+
+int SnortEventqAdd(uint32_t, uint32_t, RuleType) { return 0; }
+void SnortEventqPush() { }
+void SnortEventqPop() { }
+
+Packet::Packet(bool)
+{
+    layers = nullptr;
+    pkt = nullptr;
+    pkth = nullptr;
+    allocated = false;
+    obfuscator = nullptr;
+    flow = nullptr;
+    num_layers = 0;
+    ptrs.reset();
+}
+
+Packet::~Packet() { }
+
+int PacketManager::encode_format(
+    EncodeFlags, const Packet*, Packet*, PseudoPacketType, const DAQ_PktHdr_t*, uint32_t)
+{ return -1; }
+void PacketManager::encode_set_pkt(Packet*) { }
+void PacketManager::encode_update(Packet*) { }
+
+DAQ_Verdict Snort::process_packet(Packet*, const DAQ_PktHdr_t*, const uint8_t*, bool)
+{ return DAQ_VERDICT_PASS; }
+
+const ip::IP6Frag* layer::get_inner_ip6_frag() { return nullptr; }
+SFIP_RET sfip_set_ip(sfip_t*, const sfip_t*) { return SFIP_SUCCESS; }
+
+namespace ip
+{
+IpOptionIterator::IpOptionIterator(const IP4Hdr* const, const Packet* const)
+{ start_ptr = end_ptr = nullptr; }
+IpOptionIteratorIter IpOptionIterator::begin() const
+{ return IpOptionIteratorIter(nullptr); }
+IpOptionIteratorIter IpOptionIterator::end() const
+{ return IpOptionIteratorIter(nullptr); }
+IpOptionIteratorIter::IpOptionIteratorIter(const IpOptions* p) : opt(p) { }
+const IpOptions& IpOptionIteratorIter::operator*() const
+{ return *opt; }
+}
+
+FragEngine::FragEngine()
+{
+    max_frags = 8192;
+    max_overlaps = 0;
+    min_fragment_length = 0;
+    frag_timeout = 60;
+    frag_policy = FRAG_POLICY_DEFAULT;
+    min_ttl = 1;
+}
+
+//-------------------------------------------------------------------------
+// fragments
+//-------------------------------------------------------------------------
+
+static const unsigned FRAG_LEN = 16;
+
+static uint64_t s_flow_buf[sizeof(Flow) / sizeof(uint64_t) + 1];
+static Flow* s_flow = (Flow*)s_flow_buf;
+
+// a non-first fragment with more to follow; never completes a datagram
+struct Frag
+{
+    uint8_t buf[sizeof(ip::IP4Hdr) + FRAG_LEN];
+    DAQ_PktHdr_t hdr;
+    Packet pkt;
+
+    void set(uint16_t id, uint16_t offset)
+    {
+        memset(buf, 0, sizeof(buf));
+        ip::IP4Hdr* h = (ip::IP4Hdr*)buf;
+
+        h->ip_verhl = 0x45;
+        h->ip_len = htons(sizeof(buf));
+        h->ip_id = htons(id);
+        h->ip_off = htons(0x2000 | (offset >> 3));
+        h->ip_ttl = 64;
+        h->ip_proto = IpProtocol::UDP;
+
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.caplen = hdr.pktlen = sizeof(buf);
+
+        pkt.pkth = &hdr;
+        pkt.flow = s_flow;
+        pkt.ptrs.ip_api.set(h);
+        pkt.ptrs.decode_flags = DECODE_FRAG | DECODE_MF;
+        pkt.data = buf + sizeof(*h);
+        pkt.dsize = FRAG_LEN;
+    }
+};
+
+enum Order { IN_ORDER, REVERSE, RANDOM, LAST_FIRST };
+
+static const char* order_names[] = { "in order", "reverse", "random", "last first" };
+
+// offsets of q fragments in arrival order; last first sends the highest
+// offset and then the rest ascending so each insert lands just before the
+// tail
+static void make_offsets(Order o, unsigned q, std::mt19937& rng, std::vector<uint16_t>& v)
+{
+    v.clear();
+
+    for ( unsigned i = 1; i <= q; ++i )
+        v.push_back(i * FRAG_LEN);
+
+    switch ( o )
+    {
+    case IN_ORDER:
+        break;
+    case REVERSE:
+        std::reverse(v.begin(), v.end());
+        break;
+    case RANDOM:
+        std::shuffle(v.begin(), v.end(), rng);
+        break;
+    case LAST_FIRST:
+        std::rotate(v.begin(), v.end() - 1, v.end());
+        break;
+    }
+}
+
+//-------------------------------------------------------------------------
+// driver
+//-------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+static void queued(unsigned n, unsigned q, Order o)
+{
+    FragEngine fe;
+    fe.max_frags = q + 1;
+
+    Defrag defrag(fe);
+    defrag.tinit();
+
+    std::mt19937 rng(3193);
+    std::vector<uint16_t> offs;
+    make_offsets(o, q, rng, offs);
+
+    std::vector<Frag> frags(q);
+
+    for ( unsigned i = 0; i < q; ++i )
+        frags[i].set(1, offs[i]);
+
+    FragTracker ft;
+    memset(&ft, 0, sizeof(ft));
+
+    unsigned rounds = std::max(1u, n / q);
+    auto start = Clock::now();
+
+    for ( unsigned r = 0; r < rounds; ++r )
+    {
+        for ( auto& f : frags )
+            defrag.process(&f.pkt, &ft);
+
+        defrag.cleanup(&ft);
+    }
+
+    auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    printf("%-10s  queued=%-5u  %8.1f ns/frag\n", order_names[o], q, ns / (rounds * q));
+    defrag.tterm();
+}
+
+// round robin over more trackers than fit so each insert prunes one
+static void flood(unsigned n, unsigned max_frags)
+{
+    FragEngine fe;
+    fe.max_frags = max_frags;
+
+    Defrag defrag(fe);
+    defrag.tinit();
+
+    unsigned num = 2 * max_frags;
+    std::vector<FragTracker> fts(num);
+    std::vector<Frag> frags(num);
+
+    for ( unsigned i = 0; i < num; ++i )
+    {
+        memset(&fts[i], 0, sizeof(fts[i]));
+        frags[i].set(i, FRAG_LEN);
+    }
+
+    unsigned rounds = std::max(1u, n / num);
+    auto start = Clock::now();
+
+    for ( unsigned r = 0; r < rounds; ++r )
+        for ( unsigned i = 0; i < num; ++i )
+            defrag.process(&frags[i].pkt, &fts[i]);
+
+    auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    printf("flood       max_frags=%-5u  %8.1f ns/frag  prunes=%lu\n",
+        max_frags, ns / (rounds * num), (unsigned long)ip_stats.max_frags_prunes);
+
+    for ( auto& ft : fts )
+        defrag.cleanup(&ft);
+
+    defrag.tterm();
+    memset(&ip_stats, 0, sizeof(ip_stats));
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<unsigned> qs;
+    unsigned n = 1u << 20;
+    int c;
+
+    while ( (c = getopt(argc, argv, "n:q:")) != -1 )
+    {
+        switch ( c )
+        {
+        case 'n': n = strtoul(optarg, nullptr, 0); break;
+        case 'q': qs.push_back(strtoul(optarg, nullptr, 0)); break;
+        default:
+            fprintf(stderr, "usage: %s [-n inserts] [-q queued ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if ( qs.empty() )
+        qs = { 16, 256, 1024, 4095 };
+
+    // offsets must fit in the 13 bit fragment offset field
+    for ( auto& q : qs )
+        q = std::max(1u, std::min(q, 65528u / FRAG_LEN - 1));
+
+    for ( auto o : { IN_ORDER, REVERSE, RANDOM, LAST_FIRST } )
+    {
+        for ( auto q : qs )
+            queued(n, q, o);
+
+        printf("\n");
+    }
+
+    for ( auto q : qs )
+        flood(n, q);
+
+    return 0;
+}
+
@@ -0,0 +1,321 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// ip_defrag_test.cc
+// unit test main
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "detection/detect.h"
+#include "events/event_queue.h"
+#include "main/snort.h"
+#include "main/snort_debug.h"
+#include "packet_io/active.h"
+#include "packet_io/sfdaq.h"
+#include "profiler/profiler.h"
+#include "protocols/ipv4_options.h"
+#include "protocols/layer.h"
+#include "protocols/packet.h"
+#include "protocols/packet_manager.h"
+#include "sfip/sf_ip.h"
+#include "stream/ip/ip_defrag.h"
+#include "stream/ip/ip_module.h"
+#include "stream/ip/ip_session.h"
+#include "stream/ip/stream_ip.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+//-------------------------------------------------------------------------
+// stubs, spies, etc.
+//-------------------------------------------------------------------------
+
+THREAD_LOCAL IpStats ip_stats;
+THREAD_LOCAL Active::ActiveAction Active::active_action = Active::ACT_PASS;
+THREAD_LOCAL bool do_detect = true;
+THREAD_LOCAL bool do_detect_content = true;
+
+void LogMessage(const char*, ...) { }
+
+#ifdef DEBUG_MSGS
+void Debug::print(const char*, int, uint64_t, const char*, ...) { }
+#endif
+
+MemoryContext::MemoryContext(MemoryTracker&) { }
+MemoryContext::~MemoryContext() { }
+
+void Active::daq_drop_packet(const Packet*) { }
+uint32_t SFDAQ::get_snap_len() { return 65535; }
+
+int SnortEventqAdd(uint32_t, uint32_t, RuleType) { return 0; }
+void SnortEventqPush() { }
+void SnortEventqPop() { }
+
+// packets are only built here; none of the fragments below complete a
+// datagram so nothing is rebuilt or encoded
+Packet::Packet(bool)
+{
+    layers = nullptr;
+    pkt = nullptr;
+    pkth = nullptr;
+    allocated = false;
+    obfuscator = nullptr;
+    flow = nullptr;
+    num_layers = 0;
+    ptrs.reset();
+}
+
+Packet::~Packet() { }
+
+int PacketManager::encode_format(
+    EncodeFlags, const Packet*, Packet*, PseudoPacketType, const DAQ_PktHdr_t*, uint32_t)
+{ return -1; }
+void PacketManager::encode_set_pkt(Packet*) { }
+void PacketManager::encode_update(Packet*) { }
+
+DAQ_Verdict Snort::process_packet(Packet*, const DAQ_PktHdr_t*, const uint8_t*, bool)
+{ return DAQ_VERDICT_PASS; }
+
+const ip::IP6Frag* layer::get_inner_ip6_frag() { return nullptr; }
+SFIP_RET sfip_set_ip(sfip_t*, const sfip_t*) { return SFIP_SUCCESS; }
+
+namespace ip
+{
+IpOptionIterator::IpOptionIterator(const IP4Hdr* const, const Packet* const)
+{ start_ptr = end_ptr = nullptr; }
+IpOptionIteratorIter IpOptionIterator::begin() const
+{ return IpOptionIteratorIter(nullptr); }
+IpOptionIteratorIter IpOptionIterator::end() const
+{ return IpOptionIteratorIter(nullptr); }
+IpOptionIteratorIter::IpOptionIteratorIter(const IpOptions* p) : opt(p) { }
+const IpOptions& IpOptionIteratorIter::operator*() const
+{ return *opt; }
+}
+
+FragEngine::FragEngine()
+{
+    max_frags = 8192;
+    max_overlaps = 0;
+    min_fragment_length = 0;
+    frag_timeout = 60;
+    frag_policy = FRAG_POLICY_DEFAULT;
+    min_ttl = 1;
+}
+
+//-------------------------------------------------------------------------
+// fragments
+//-------------------------------------------------------------------------
+
+// only the flow's policy is used
+static uint64_t s_flow_buf[sizeof(Flow) / sizeof(uint64_t) + 1];
+static Flow* s_flow = (Flow*)s_flow_buf;
+
+// a non-first fragment of datagram id; offset is in bytes
+class Frag
+{
+public:
+    Frag(uint16_t id, uint16_t offset, uint16_t len = 64, bool more = true)
+    {
+        memset(buf, 0, sizeof(buf));
+        ip::IP4Hdr* h = (ip::IP4Hdr*)buf;
+
+        h->ip_verhl = 0x45;
+        h->ip_len = htons(sizeof(*h) + len);
+        h->ip_id = htons(id);
+        h->ip_off = htons((more ? 0x2000 : 0) | (offset >> 3));
+        h->ip_ttl = 64;
+        h->ip_proto = IpProtocol::UDP;
+        h->ip_src = htonl(0x0a000001);
+        h->ip_dst = htonl(0x0a000002);
+
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.caplen = hdr.pktlen = sizeof(*h) + len;
+
+        pkt.pkth = &hdr;
+        pkt.flow = s_flow;
+        pkt.ptrs.ip_api.set(h);
+        pkt.ptrs.decode_flags = DECODE_FRAG | (more ? DECODE_MF : 0);
+        pkt.data = buf + sizeof(*h);
+        pkt.dsize = len;
+    }
+
+    Packet* operator&()
+    { return &pkt; }
+
+private:
+    uint8_t buf[sizeof(ip::IP4Hdr) + 4096];
+    DAQ_PktHdr_t hdr;
+    Packet pkt;
+};
+
+//-------------------------------------------------------------------------
+// tests
+//-------------------------------------------------------------------------
+
+TEST_GROUP(ip_defrag)
+{
+    FragEngine engine;
+    Defrag* defrag = nullptr;
+    FragTracker ft[4];
+
+    void setup()
+    {
+        memset(&ip_stats, 0, sizeof(ip_stats));
+        memset(ft, 0, sizeof(ft));
+        engine.max_frags = 4;
+        defrag = new Defrag(engine);
+        defrag->tinit();
+    }
+
+    void teardown()
+    {
+        for ( auto& t : ft )
+            defrag->cleanup(&t);
+
+        CHECK(ip_stats.mem_in_use == 0);
+        defrag->tterm();
+        delete defrag;
+    }
+
+    void add(Defrag* d, FragTracker& t, uint16_t id, uint16_t off, uint16_t len = 64)
+    {
+        Frag f(id, off, len);
+        d->process(&f, &t);
+    }
+
+    void add(FragTracker& t, uint16_t id, uint16_t off, uint16_t len = 64)
+    { add(defrag, t, id, off, len); }
+};
+
+TEST(ip_defrag, released_nodes_reused)
+{
+    for ( unsigned i = 1; i <= 4; ++i )
+        add(ft[0], 1, i * 64);
+
+    CHECK(ft[0].fraglist_count == 4);
+    CHECK(ip_stats.nodes_reused == 0);
+
+    defrag->cleanup(&ft[0]);
+    CHECK(ip_stats.nodes_released == 4);
+    CHECK(ip_stats.mem_in_use == 0);
+
+    for ( unsigned i = 1; i <= 4; ++i )
+        add(ft[1], 2, i * 64);
+
+    CHECK(ip_stats.nodes_reused == 4);
+    CHECK(ip_stats.max_frags_prunes == 0);
+}
+
+TEST(ip_defrag, large_payload_accounted)
+{
+    add(ft[0], 1, 64);
+    PegCount small = ip_stats.mem_in_use;
+
+    // more than fits in a node gets its own buffer
+    add(ft[0], 1, 128, 2000);
+    CHECK(ip_stats.mem_in_use == 2 * small + 2000);
+
+    defrag->cleanup(&ft[0]);
+    CHECK(ip_stats.mem_in_use == 0);
+
+    add(ft[1], 2, 64, 2000);
+    CHECK(ip_stats.nodes_reused == 1);
+    CHECK(ip_stats.mem_in_use == small + 2000);
+}
+
+TEST(ip_defrag, prune_skips_current_tracker)
+{
+    add(ft[0], 1, 64);
+    add(ft[0], 1, 128);
+    add(ft[1], 2, 64);
+    add(ft[1], 2, 128);
+
+    // ft[0] is least recent but it gets the new fragment
+    add(ft[0], 1, 192);
+
+    CHECK(ip_stats.max_frags_prunes == 1);
+    CHECK(ft[0].fraglist_count == 3);
+    CHECK(ft[1].engine == nullptr);
+    CHECK(ft[1].fraglist == nullptr);
+}
+
+TEST(ip_defrag, prune_least_recently_used)
+{
+    add(ft[0], 1, 64);
+    add(ft[1], 2, 64);
+    add(ft[2], 3, 64);
+
+    // ft[0] moves to the tail leaving ft[1] least recent
+    add(ft[0], 1, 128);
+    add(ft[3], 4, 64);
+
+    CHECK(ip_stats.max_frags_prunes == 1);
+    CHECK(ft[1].engine == nullptr);
+    CHECK(ft[0].fraglist_count == 2);
+    CHECK(ft[2].fraglist_count == 1);
+    CHECK(ft[3].fraglist_count == 1);
+
+    // a released tracker is off the list so ft[2] goes next
+    add(ft[3], 4, 128);
+
+    CHECK(ip_stats.max_frags_prunes == 2);
+    CHECK(ft[2].engine == nullptr);
+    CHECK(ft[0].fraglist_count == 2);
+    CHECK(ft[3].fraglist_count == 2);
+}
+
+TEST(ip_defrag, drop_when_nothing_to_prune)
+{
+    for ( unsigned i = 1; i <= 5; ++i )
+        add(ft[0], 1, i * 64);
+
+    CHECK(ft[0].fraglist_count == 4);
+    CHECK(ip_stats.max_frags_prunes == 0);
+    CHECK(ip_stats.max_frags_drops == 1);
+    CHECK(ip_stats.total == 5);
+}
+
+TEST(ip_defrag, reload_applies_max_frags)
+{
+    // a reload configures a new instance without calling tinit() again
+    FragEngine fe;
+    fe.max_frags = 2;
+    Defrag reloaded(fe);
+
+    for ( unsigned i = 1; i <= 3; ++i )
+        add(&reloaded, ft[0], 1, i * 64);
+
+    CHECK(ft[0].fraglist_count == 2);
+    CHECK(ip_stats.max_frags_drops == 1);
+
+    defrag->cleanup(&ft[0]);
+    fe.max_frags = 6;
+
+    for ( unsigned i = 1; i <= 6; ++i )
+        add(&reloaded, ft[1], 2, i * 64);
+
+    CHECK(ft[1].fraglist_count == 6);
+    CHECK(ip_stats.max_frags_drops == 1);
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
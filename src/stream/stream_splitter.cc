@@ -37,12 +37,22 @@ unsigned StreamSplitter::max(Flow*)
 { return max_pdu; }
 
 const StreamBuffer* StreamSplitter::reassemble(
-    Flow*, unsigned, unsigned offset, const uint8_t* p,
+    Flow*, unsigned total, unsigned offset, const uint8_t* p,
     unsigned n, uint32_t flags, unsigned& copied)
 {
+    copied = n;
+
+    // a pdu contained in a single segment is presented in place; the
+    // segment outlives inspection of the rebuilt packet
+    if ( (flags & PKT_PDU_HEAD) and (flags & PKT_PDU_TAIL) and n == total )
+    {
+        str_buf.data = p;
+        str_buf.length = n;
+        return &str_buf;
+    }
+
     assert(offset + n < sizeof(pdu_buf));
     memcpy(pdu_buf+offset, p, n);
-    copied = n;
 
     if ( flags & PKT_PDU_TAIL )
     {
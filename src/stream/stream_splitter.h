@@ -66,6 +66,10 @@ public:
 
     // the last call to reassemble() will be made with len == 0 if
     // finish() returned true as an opportunity for a final flush
+    //
+    // the default implementation returns the data in place when the pdu
+    // is passed in one call (head and tail with len == total) and
+    // otherwise copies it into a thread local buffer
     virtual const StreamBuffer* reassemble(
         Flow*,
         unsigned total,        // total amount to flush (sum of iterations)
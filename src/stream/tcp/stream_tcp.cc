@@ -24,6 +24,7 @@
 
 #include "stream_tcp.h"
 #include "tcp_module.h"
+#include "tcp_segment_pool.h"
 #include "tcp_session.h"
 
 #include "stream/flush_bucket.h"
@@ -130,6 +131,7 @@ static void tcp_tterm()
 {
     TcpSession::sterm();
     FlushBucket::clear();
+    TcpSegmentPool::clear();
 }
 
 static const InspectApi tcp_api =
@@ -60,6 +60,7 @@ const PegInfo tcp_pegs[] =
     { "rebuilt packets", "total reassembled PDUs" },
     { "rebuilt buffers", "rebuilt PDU sections" },
     { "rebuilt bytes", "total rebuilt bytes" },
+    { "rebuilt in place", "reassembled PDUs inspected directly from a single segment" },
     { "overlaps", "overlapping segments queued" },
     { "gaps", "missing data between PDUs" },
     { "max segs", "number of times the maximum queued segment limit was reached" },
@@ -68,6 +69,10 @@ const PegInfo tcp_pegs[] =
     { "client cleanups", "number of times data from server was flushed when session released" },
     { "server cleanups", "number of times data from client was flushed when session released" },
     { "memory", "current memory in use" },
+    { "payloads allocated", "segment payload buffers allocated from the heap" },
+    { "payloads reused", "segment payload buffers recycled from the pool" },
+    { "memcap prunes", "flows pruned to keep queued segment data under memcap" },
+    { "memcap overruns", "segment allocations exceeding memcap after pruning" },
     { "initializing", "number of sessions currently initializing" },
     { "established", "number of sessions currently established" },
     { "closing", "number of sessions currently closing" },
@@ -156,6 +161,9 @@ static const Parameter s_params[] =
     { "max_pdu", Parameter::PT_INT, "1460:65535", "16384",
       "maximum reassembled PDU size" },
 
+    { "memcap", Parameter::PT_INT, "0:", "0",
+      "maximum bytes of segment data queued per packet thread; 0 is unlimited" },
+
     { "policy", Parameter::PT_ENUM, TCP_POLICIES, "bsd",
       "determines operating system characteristics like reassembly" },
 
@@ -306,6 +314,9 @@ bool StreamTcpModule::set(const char*, Value& v, SnortConfig*)
     else if ( v.is("max_pdu") )
         config->paf_max = v.get_long();
 
+    else if ( v.is("memcap") )
+        config->memcap = v.get_long();
+
     else if ( v.is("policy") )
         config->policy = static_cast< StreamPolicy >( v.get_long() + 1 );
 
@@ -85,6 +85,7 @@ struct TcpStats
     PegCount rebuilt_packets;   //iStreamFlushes
     PegCount rebuilt_buffers;
     PegCount rebuilt_bytes;     //total_rebuilt_bytes
+    PegCount rebuilt_in_place;
     PegCount overlaps;
     PegCount gaps;
     PegCount max_segs;
@@ -93,6 +94,10 @@ struct TcpStats
     PegCount s5tcp1;
     PegCount s5tcp2;
     PegCount mem_in_use;
+    PegCount payloads_allocated;
+    PegCount payloads_reused;
+    PegCount memcap_prunes;
+    PegCount memcap_overruns;
     PegCount sessions_initializing;
     PegCount sessions_established;
     PegCount sessions_closing;
@@ -249,7 +249,7 @@ int TcpReassembler::add_reassembly_segment(TcpSegmentDescriptor& tsd, int16_t le
     }
 
     // FIXIT-L don't allocate overlapped part
-    tsn = TcpSegmentNode::init(tsd);
+    tsn = TcpSegmentNode::init(tsd, session->config->memcap);
     tsn->payload = tsn->data + slide;
     tsn->payload_size = (uint16_t)newSize;
     tsn->seq = seq;
@@ -506,6 +506,9 @@ int TcpReassembler::flush_data_segments(Packet* p, uint32_t toSeq, uint8_t* flus
         flags = 0;
         if ( sb )
         {
+            if ( sb->data == tsn->payload )
+                tcpStats.rebuilt_in_place++;
+
             s5_pkt->data = sb->data;
             s5_pkt->dsize = sb->length;
             assert(sb->length <= s5_pkt->max_dsize);
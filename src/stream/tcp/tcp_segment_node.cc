@@ -25,6 +25,7 @@
 #include "protocols/packet.h"
 #include "utils/util.h"
 #include "tcp_module.h"
+#include "tcp_segment_pool.h"
 
 TcpSegmentNode::TcpSegmentNode() :
     prev(nullptr), next(nullptr), tv({ 0, 0 }), ts(0), seq(0), orig_dsize(0),
@@ -40,9 +41,10 @@ TcpSegmentNode::~TcpSegmentNode()
 //-------------------------------------------------------------------------
 // TcpSegment stuff
 //-------------------------------------------------------------------------
-TcpSegmentNode* TcpSegmentNode::init(TcpSegmentDescriptor& tsd)
+TcpSegmentNode* TcpSegmentNode::init(TcpSegmentDescriptor& tsd, size_t memcap)
 {
-    return init(tsd.get_pkt()->pkth->ts, tsd.get_pkt()->data, tsd.get_seg_len() );
+    return init(tsd.get_pkt()->pkth->ts, tsd.get_pkt()->data, tsd.get_seg_len(),
+        memcap, tsd.get_flow());
 }
 
 TcpSegmentNode* TcpSegmentNode::init(TcpSegmentNode& tsn)
@@ -50,10 +52,12 @@ TcpSegmentNode* TcpSegmentNode::init(TcpSegmentNode& tsn)
     return init(tsn.tv, tsn.payload, tsn.payload_size);
 }
 
-TcpSegmentNode* TcpSegmentNode::init(const struct timeval& tv, const uint8_t* data, unsigned dsize)
+TcpSegmentNode* TcpSegmentNode::init(
+    const struct timeval& tv, const uint8_t* data, unsigned dsize,
+    size_t memcap, const Flow* flow)
 {
     TcpSegmentNode* ss = new TcpSegmentNode;
-    ss->data = ( uint8_t* )snort_alloc(dsize);
+    ss->data = TcpSegmentPool::acquire(dsize, memcap, flow);
     ss->payload = ss->data;
     ss->tv = tv;
     memcpy(ss->payload, data, dsize);
@@ -65,7 +69,7 @@ TcpSegmentNode* TcpSegmentNode::init(const struct timeval& tv, const uint8_t* da
 
 void TcpSegmentNode::term()
 {
-    snort_free(data);
+    TcpSegmentPool::release(data, orig_dsize);
     tcpStats.segs_released++;
     tcpStats.mem_in_use -= orig_dsize;
     delete this;
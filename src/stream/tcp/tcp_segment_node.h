@@ -23,6 +23,7 @@
 #define TCP_SEGMENT_H
 
 #include "main/snort_debug.h"
+#include "memory/slab_allocator.h"
 #include "protocols/packet.h"
 
 #include "tcp_defs.h"
@@ -34,15 +35,18 @@
 // ... however, use of padding below is critical, adjust if needed
 //-----------------------------------------------------------------
 
-class TcpSegmentNode
+class TcpSegmentNode : public memory::SlabObject
 {
 public:
     TcpSegmentNode();
     virtual ~TcpSegmentNode();
 
-    static TcpSegmentNode* init(TcpSegmentDescriptor& tsd);
+    static TcpSegmentNode* init(TcpSegmentDescriptor& tsd, size_t memcap);
     static TcpSegmentNode* init(TcpSegmentNode& tsn);
-    static TcpSegmentNode* init(const struct timeval&, const uint8_t*, unsigned);
+    // flow is protected from memcap pruning; null disables pruning
+    static TcpSegmentNode* init(
+        const struct timeval&, const uint8_t*, unsigned,
+        size_t memcap = 0, const Flow* = nullptr);
 
     void term();
     bool is_retransmit(const uint8_t*, uint16_t size, uint32_t);
@@ -0,0 +1,176 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#include "tcp_segment_pool.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <vector>
+
+#include "flow/flow_control.h"
+#include "flow/prune_stats.h"
+#include "main/thread.h"
+#include "stream/stream.h"
+#include "utils/util.h"
+
+#include "tcp_module.h"
+
+// 1500 and 9000 cover standard and jumbo frame payloads
+static const unsigned class_size[] = { 256, 1500, 9000 };
+static const unsigned num_classes = sizeof(class_size) / sizeof(class_size[0]);
+
+// freed buffers beyond this are returned to the heap
+static const size_t max_cached = 8 * 1024 * 1024;
+
+// flows pruned per allocation before giving up and exceeding the memcap
+static const unsigned max_prunes = 8;
+
+struct SegmentPool
+{
+    std::vector<uint8_t*> free_list[num_classes];
+    size_t in_use = 0;
+    size_t cached = 0;
+
+    // set by clear() while segments are still held by flows
+    bool closing = false;
+};
+
+static THREAD_LOCAL SegmentPool* pool = nullptr;
+
+static inline unsigned get_class(unsigned size)
+{
+    for ( unsigned i = 0; i < num_classes; ++i )
+        if ( size <= class_size[i] )
+            return i;
+
+    return num_classes;
+}
+
+static inline unsigned get_alloc_size(unsigned size)
+{
+    unsigned c = get_class(size);
+    return c < num_classes ? class_size[c] : size;
+}
+
+static inline SegmentPool* get_pool()
+{
+    if ( !pool )
+        pool = new SegmentPool;
+
+    return pool;
+}
+
+uint8_t* TcpSegmentPool::acquire(unsigned size, size_t memcap, const Flow* save_me)
+{
+    SegmentPool* sp = get_pool();
+    unsigned alloc_size = get_alloc_size(size);
+
+    if ( memcap and save_me and flow_con )
+    {
+        unsigned n = 0;
+
+        while ( sp->in_use + alloc_size > memcap )
+        {
+            if ( n++ == max_prunes or !flow_con->prune_one(PruneReason::MEMCAP, false, save_me) )
+            {
+                tcpStats.memcap_overruns++;
+                break;
+            }
+            tcpStats.memcap_prunes++;
+        }
+    }
+
+    sp->in_use += alloc_size;
+    unsigned c = get_class(size);
+
+    if ( c < num_classes and !sp->free_list[c].empty() )
+    {
+        uint8_t* p = sp->free_list[c].back();
+        sp->free_list[c].pop_back();
+        sp->cached -= alloc_size;
+        tcpStats.payloads_reused++;
+        return p;
+    }
+
+    tcpStats.payloads_allocated++;
+    return (uint8_t*)snort_alloc(alloc_size);
+}
+
+void TcpSegmentPool::release(uint8_t* p, unsigned size)
+{
+    SegmentPool* sp = pool;
+    unsigned alloc_size = get_alloc_size(size);
+    unsigned c = get_class(size);
+
+    // don't recreate the pool for releases after it is gone
+    if ( !sp )
+    {
+        snort_free(p);
+        return;
+    }
+
+    sp->in_use -= alloc_size;
+
+    if ( sp->closing )
+    {
+        snort_free(p);
+
+        if ( !sp->in_use )
+        {
+            delete sp;
+            pool = nullptr;
+        }
+        return;
+    }
+
+    if ( c < num_classes and sp->cached + alloc_size <= max_cached )
+    {
+        sp->free_list[c].push_back(p);
+        sp->cached += alloc_size;
+        return;
+    }
+    snort_free(p);
+}
+
+void TcpSegmentPool::clear()
+{
+    if ( !pool )
+        return;
+
+    for ( auto& fl : pool->free_list )
+    {
+        for ( auto p : fl )
+            snort_free(p);
+
+        fl.clear();
+    }
+    pool->cached = 0;
+
+    // flows may be torn down after tcp; the last release deletes the pool
+    if ( pool->in_use )
+    {
+        pool->closing = true;
+        return;
+    }
+
+    delete pool;
+    pool = nullptr;
+}
+
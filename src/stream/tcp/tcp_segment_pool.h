@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+#ifndef TCP_SEGMENT_POOL_H
+#define TCP_SEGMENT_POOL_H
+
+// TcpSegmentPool recycles segment payload buffers per packet thread in a
+// few fixed size classes so queueing segments under loss does not churn
+// the heap.  Larger payloads are allocated directly.  The bytes in use are
+// charged against stream_tcp.memcap; when an allocation would exceed it
+// flows are pruned to make room instead of failing the allocation.  The
+// memcap is taken from the flow's config with each allocation, so like the
+// other stream_tcp limits a reloaded value applies to new flows.
+
+#include <cstddef>
+#include <cstdint>
+
+class Flow;
+
+class TcpSegmentPool
+{
+public:
+    // the current flow is never pruned to satisfy the memcap; a memcap of
+    // 0 or a null flow disables pruning
+    static uint8_t* acquire(unsigned size, size_t memcap, const Flow* save_me);
+    static void release(uint8_t*, unsigned size);
+
+    // free cached buffers; if segments are still held, the pool is
+    // deleted when the last one is released
+    static void clear();
+};
+
+#endif
+
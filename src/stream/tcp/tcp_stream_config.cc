@@ -56,6 +56,9 @@ void TcpStreamConfig::show_config(TcpStreamConfig* config)
         LogMessage("    Maximum number of segs to queue per session: %d\n",
             config->max_queued_segs);
 
+    if ( config->memcap != 0 )
+        LogMessage("    Maximum bytes of segment data per thread: %zu\n", config->memcap);
+
     if ( config->flags )
     {
         LogMessage("    Options:\n");
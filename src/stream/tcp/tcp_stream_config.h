@@ -68,6 +68,7 @@ public:
     int hs_timeout = -1;
     int footprint = 0;
     uint32_t paf_max = 16384;
+    size_t memcap = 0;
 };
 
 #endif
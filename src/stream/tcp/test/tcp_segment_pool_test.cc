@@ -0,0 +1,182 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// tcp_segment_pool_test.cc
+// unit test main
+
+#include "stream/tcp/tcp_segment_pool.h"
+
+#include <vector>
+
+#include "flow/flow_control.h"
+#include "stream/stream.h"
+#include "stream/tcp/tcp_module.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+THREAD_LOCAL TcpStats tcpStats;
+THREAD_LOCAL FlowControl* flow_con = nullptr;
+
+// each prune releases one held buffer as if its flow were torn down
+static std::vector<uint8_t*> s_held;
+static unsigned s_held_size = 0;
+static unsigned s_prunes = 0;
+
+bool FlowControl::prune_one(PruneReason, bool, const Flow*)
+{
+    ++s_prunes;
+
+    if ( s_held.empty() )
+        return false;
+
+    TcpSegmentPool::release(s_held.back(), s_held_size);
+    s_held.pop_back();
+    return true;
+}
+
+// prune_one() is the only member used and the stub doesn't touch the
+// instance; the pool only passes the current flow through to it
+static uint8_t s_flow_con[sizeof(FlowControl)];
+static uint8_t s_flow_buf[1];
+static const Flow* s_flow = (const Flow*)s_flow_buf;
+
+TEST_GROUP(tcp_segment_pool)
+{
+    void setup()
+    {
+        memset(&tcpStats, 0, sizeof(tcpStats));
+        flow_con = (FlowControl*)s_flow_con;
+        s_held.clear();
+        s_held_size = 0;
+        s_prunes = 0;
+    }
+
+    void teardown()
+    {
+        TcpSegmentPool::clear();
+        flow_con = nullptr;
+    }
+};
+
+TEST(tcp_segment_pool, released_buffer_reused_by_class)
+{
+    uint8_t* p = TcpSegmentPool::acquire(100, 0, nullptr);
+    TcpSegmentPool::release(p, 100);
+
+    // 200 is in the same 256 byte class as 100
+    uint8_t* q = TcpSegmentPool::acquire(200, 0, nullptr);
+    CHECK(q == p);
+    CHECK(tcpStats.payloads_allocated == 1);
+    CHECK(tcpStats.payloads_reused == 1);
+
+    uint8_t* r = TcpSegmentPool::acquire(1000, 0, nullptr);
+    CHECK(r != q);
+    CHECK(tcpStats.payloads_allocated == 2);
+
+    TcpSegmentPool::release(q, 200);
+    TcpSegmentPool::release(r, 1000);
+}
+
+TEST(tcp_segment_pool, oversize_buffer_not_cached)
+{
+    uint8_t* p = TcpSegmentPool::acquire(10000, 0, nullptr);
+    TcpSegmentPool::release(p, 10000);
+
+    uint8_t* q = TcpSegmentPool::acquire(10000, 0, nullptr);
+    CHECK(tcpStats.payloads_allocated == 2);
+    CHECK(tcpStats.payloads_reused == 0);
+    TcpSegmentPool::release(q, 10000);
+}
+
+TEST(tcp_segment_pool, memcap_prunes_other_flows)
+{
+    s_held_size = 256;
+    s_held.push_back(TcpSegmentPool::acquire(256, 512, s_flow));
+    s_held.push_back(TcpSegmentPool::acquire(256, 512, s_flow));
+    CHECK(s_prunes == 0);
+
+    uint8_t* p = TcpSegmentPool::acquire(256, 512, s_flow);
+    CHECK(s_prunes == 1);
+    CHECK(tcpStats.memcap_prunes == 1);
+    CHECK(tcpStats.memcap_overruns == 0);
+
+    // the pruned flow's buffer is reused
+    CHECK(tcpStats.payloads_reused == 1);
+
+    TcpSegmentPool::release(p, 256);
+
+    for ( auto b : s_held )
+        TcpSegmentPool::release(b, 256);
+}
+
+TEST(tcp_segment_pool, memcap_overrun_when_nothing_to_prune)
+{
+    uint8_t* p = TcpSegmentPool::acquire(256, 256, s_flow);
+    uint8_t* q = TcpSegmentPool::acquire(256, 256, s_flow);
+
+    CHECK(q != nullptr);
+    CHECK(s_prunes == 1);
+    CHECK(tcpStats.memcap_prunes == 0);
+    CHECK(tcpStats.memcap_overruns == 1);
+
+    TcpSegmentPool::release(p, 256);
+    TcpSegmentPool::release(q, 256);
+}
+
+TEST(tcp_segment_pool, no_pruning_without_flow_or_memcap)
+{
+    uint8_t* p = TcpSegmentPool::acquire(256, 256, nullptr);
+    uint8_t* q = TcpSegmentPool::acquire(256, 256, nullptr);
+    uint8_t* r = TcpSegmentPool::acquire(256, 0, s_flow);
+
+    CHECK(s_prunes == 0);
+    CHECK(tcpStats.memcap_overruns == 0);
+
+    TcpSegmentPool::release(p, 256);
+    TcpSegmentPool::release(q, 256);
+    TcpSegmentPool::release(r, 256);
+}
+
+TEST(tcp_segment_pool, pool_kept_until_last_release)
+{
+    uint8_t* p = TcpSegmentPool::acquire(256, 0, nullptr);
+    uint8_t* q = TcpSegmentPool::acquire(256, 0, nullptr);
+
+    // flows are torn down after tcp; a closing pool frees instead of caching
+    TcpSegmentPool::clear();
+    TcpSegmentPool::release(p, 256);
+
+    uint8_t* r = TcpSegmentPool::acquire(256, 0, nullptr);
+    CHECK(tcpStats.payloads_reused == 0);
+
+    TcpSegmentPool::release(q, 256);
+    TcpSegmentPool::release(r, 256);
+
+    // the last release deleted the pool so a new one starts empty
+    uint8_t* s = TcpSegmentPool::acquire(256, 0, nullptr);
+    CHECK(tcpStats.payloads_reused == 0);
+    CHECK(tcpStats.payloads_allocated == 4);
+    TcpSegmentPool::release(s, 256);
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
@@ -183,6 +183,10 @@ const PegInfo daq_names[] =
     { "internal whitelist", "packets whitelisted internally due to lack of DAQ support" },
     { "skipped", "packets skipped at startup" },
     { "idle", "attempts to acquire from DAQ without available packets" },
+    { "batches", "batches of packets acquired from DAQ with a batch size" },
+    { "steer forwarded", "packets copied to the packet thread owning their flow" },
+    { "steer received", "packets received from other packet threads" },
+    { "steer overflows", "packets processed locally because the owner's ring was full" },
     { nullptr, nullptr }
 };
 
@@ -276,6 +280,10 @@ void get_daq_stats(DAQStats& daq_stats)
     daq_stats.internal_whitelist = gaux.internal_whitelist;
     daq_stats.skipped = snort_conf->pkt_skip;
     daq_stats.idle = gaux.idle;
+    daq_stats.batches = gaux.batches;
+    daq_stats.steer_forwarded = gaux.steer_forwarded;
+    daq_stats.steer_received = gaux.steer_received;
+    daq_stats.steer_overflows = gaux.steer_overflows;
 }
 
 void DropStats()
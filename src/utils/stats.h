@@ -76,6 +76,10 @@ struct AuxCount
     PegCount internal_blacklist;
     PegCount internal_whitelist;
     PegCount idle;
+    PegCount batches;
+    PegCount steer_forwarded;
+    PegCount steer_received;
+    PegCount steer_overflows;
 };
 
 //-------------------------------------------------------------------------
@@ -100,6 +104,10 @@ struct DAQStats
     PegCount internal_whitelist;
     PegCount skipped;
     PegCount idle;
+    PegCount batches;
+    PegCount steer_forwarded;
+    PegCount steer_received;
+    PegCount steer_overflows;
 };
 
 extern ProcessCount proc_stats;